@@ -131,6 +131,38 @@ typedef void mapper_signal_update_handler(mapper_signal sig, mapper_id instance,
 void mapper_signal_set_callback(mapper_signal sig,
                                 mapper_signal_update_handler *handler);
 
+/*! Set when the update handler of an input signal is called.  By default it
+ *  is called for every incoming update.  With MAPPER_CALLBACK_COALESCE,
+ *  incoming values only overwrite the value of their instance, and the
+ *  handler is called at most once for each updated instance during
+ *  mapper_device_poll(), with the latest value.  Instance releases are always
+ *  passed to the handler immediately.
+ *  \param sig          The signal to operate on.
+ *  \param mode         The callback mode, from mapper_callback_mode. */
+void mapper_signal_set_callback_mode(mapper_signal sig,
+                                     mapper_callback_mode mode);
+
+/*! Get the callback mode of a signal.
+ *  \param sig          The signal to check.
+ *  \return             The callback mode, from mapper_callback_mode. */
+mapper_callback_mode mapper_signal_callback_mode(mapper_signal sig);
+
+/*! A handler function called once with every instance of a signal updated
+ *  since the device was last polled.  The values can be retrieved using
+ *  mapper_signal_instance_value(). */
+typedef void mapper_signal_batch_handler(mapper_signal sig, int num_instances,
+                                         mapper_id *instances);
+
+/*! Set or unset a handler to be called instead of the update handler when
+ *  coalesced updates are delivered.  This has no effect unless the callback
+ *  mode is MAPPER_CALLBACK_COALESCE, and an update handler must still be set
+ *  for the signal to receive updates.
+ *  \param sig          The signal to operate on.
+ *  \param handler      A pointer to a mapper_signal_batch_handler function,
+ *                      or 0 to call the update handler for each instance. */
+void mapper_signal_set_batch_callback(mapper_signal sig,
+                                      mapper_signal_batch_handler *handler);
+
 /**** Signal Instances ****/
 
 /*! Add new instances to the reserve list. Note that if instance ids are
@@ -424,6 +456,22 @@ void mapper_signal_set_minimum(mapper_signal sig, const void *minimum);
  *                      non-periodic signals. */
 void mapper_signal_set_rate(mapper_signal sig, float rate);
 
+/*! Set the policy limiting which updates of a local signal are sent. It
+ *  applies to each outgoing map from this signal that does not have a policy
+ *  of its own, and is enforced before updates are serialized. Held values
+ *  are sent when the device is polled.
+ *  \param sig          The signal to modify.
+ *  \param policy       The send policy, or 0 to send every update. */
+void mapper_signal_set_send_policy(mapper_signal sig,
+                                   const mapper_send_policy_t *policy);
+
+/*! Get the send policy of a local signal.
+ *  \param sig          The signal to check.
+ *  \param policy       A pointer to a structure to receive the policy.
+ *  \return             Zero if the signal has a send policy, otherwise
+ *                      non-zero. */
+int mapper_signal_send_policy(mapper_signal sig, mapper_send_policy_t *policy);
+
 /*! Set the unit of a signal.
  *  \param sig          The signal to operate on.
  *  \param unit     	The unit value to set. */
@@ -562,6 +610,55 @@ typedef void mapper_device_map_handler(mapper_device dev, mapper_map map,
 void mapper_device_set_map_callback(mapper_device dev,
                                     mapper_device_map_handler *handler);
 
+/*! Enable or disable collection of runtime statistics for the maps and links
+ *  of a local device. Statistics include message and byte counts, dropped
+ *  samples, and histograms of evaluation time and end-to-end latency. They
+ *  can be retrieved using mapper_map_stats() and mapper_link_stats().
+ *  \param dev          The device to use.
+ *  \param flags        A combination of mapper_stats_flags values. If
+ *                      MAPPER_STATS_PUBLISH is set, statistics are also copied
+ *                      to read-only properties prefixed with "stats_" and sent
+ *                      to subscribers each time the device syncs. */
+void mapper_device_set_stats(mapper_device dev, int flags);
+
+/*! Get the statistics flags for a local device.
+ *  \param dev          The device to check.
+ *  \return             A combination of mapper_stats_flags values. */
+int mapper_device_stats(mapper_device dev);
+
+/*! Enable or disable timetag scheduling of incoming signal updates. When
+ *  enabled, updates carrying a timetag in the future are held and delivered
+ *  by mapper_device_poll() when they become due. Timetags are converted to
+ *  local time using the clock offset estimated for the link the update
+ *  arrived through. Updates that are already due are delivered immediately.
+ *  Disabling scheduling delivers any updates that are still waiting.
+ *  \param dev          The device to use.
+ *  \param enable       Non-zero to enable scheduling, zero to disable it. */
+void mapper_device_set_scheduling(mapper_device dev, int enable);
+
+/*! Check whether timetag scheduling is enabled for a local device.
+ *  \param dev          The device to check.
+ *  \return             Non-zero if scheduling is enabled. */
+int mapper_device_scheduling(mapper_device dev);
+
+/*! Enable or disable direct delivery of outgoing signal updates. When
+ *  enabled, which is the default, updates for devices in the same process,
+ *  including self-maps, are passed to the destination device through a
+ *  bounded queue instead of being sent through the network. They are
+ *  delivered by the destination's next call to mapper_device_poll(). Updates
+ *  for devices in other processes on the same host are written to a ring
+ *  buffer in shared memory owned by the destination, falling back to the
+ *  network when it is full. Queries are always sent through the network.
+ *  \param dev          The device to use.
+ *  \param enable       Non-zero to enable direct delivery, zero to disable
+ *                      it. */
+void mapper_device_set_direct_delivery(mapper_device dev, int enable);
+
+/*! Check whether direct delivery is enabled for a local device.
+ *  \param dev          The device to check.
+ *  \return             Non-zero if direct delivery is enabled. */
+int mapper_device_direct_delivery(mapper_device dev);
+
 /*! Allocate and initialize a mapper device.
  *  \param name_prefix  A short descriptive string to identify the device.
  *                      Must not contain spaces or the slash character '/'.
@@ -904,10 +1001,13 @@ unsigned int mapper_device_port(mapper_device dev);
  *  \return             A positive ordinal unique to this device (per name). */
 unsigned int mapper_device_ordinal(mapper_device dev);
 
-/*! Start a time-tagged mapper queue.
+/*! Start a time-tagged mapper queue. Signal updates using the same timetag
+ *  are bundled per link until the queue is sent.
  *  \param dev          The device to use.
- *  \param tt           A timetag to use for the updates bundled by this queue. */
-void mapper_device_start_queue(mapper_device dev, mapper_timetag_t tt);
+ *  \param tt           A timetag to use for the updates bundled by this queue.
+ *  \return             A handle for the queue, or zero on error. If a queue with
+ *                      this timetag is already open it is returned. */
+mapper_queue mapper_device_start_queue(mapper_device dev, mapper_timetag_t tt);
 
 /*! Dispatch a time-tagged mapper queue.
  *  \param dev          The device to use.
@@ -915,6 +1015,17 @@ void mapper_device_start_queue(mapper_device dev, mapper_timetag_t tt);
  *                      mapper_device_start_queue(). */
 void mapper_device_send_queue(mapper_device dev, mapper_timetag_t tt);
 
+/*! Dispatch a time-tagged mapper queue using the handle returned by
+ *  mapper_device_start_queue(). Only links that received updates while the
+ *  queue was open are sent a bundle. The handle is invalid after this call.
+ *  \param queue        The queue to send. */
+void mapper_queue_send(mapper_queue queue);
+
+/*! Get the timetag of an open queue.
+ *  \param queue        The queue to check.
+ *  \return             The timetag used for updates bundled by this queue. */
+mapper_timetag_t mapper_queue_timetag(mapper_queue queue);
+
 /*! Get access to the device's underlying lo_server.
  *  \param dev          The device to use.
  *  \return             The liblo server used by this device. */
@@ -1044,6 +1155,40 @@ const char *mapper_network_group(mapper_network net);
  *  \return             The port number used by this network. */
 int mapper_network_port(mapper_network net);
 
+/*! Get the number of administrative messages of a given kind that a network
+ *  has sent and received. Messages sent to several subscribers at once are
+ *  counted once.
+ *  \param net          The network structure to query.
+ *  \param path         The path of the messages to count, e.g. "/sync" or
+ *                      "/who". The device name is left out of paths that
+ *                      start with one, e.g. "/subscribe". If NULL, all
+ *                      messages are counted.
+ *  \param sent         Set to the number of messages sent, if not NULL.
+ *  \param received     Set to the number of messages received, if not NULL.
+ *  \return             Zero if successful, or non-zero if the path is not
+ *                      that of an administrative message. */
+int mapper_network_message_counts(mapper_network net, const char *path,
+                                  int *sent, int *received);
+
+/*! Set the total rate of /sync announcements that devices on the bus aim
+ *  for. Each device announces itself less often as more peers are heard,
+ *  but never more often than every 5 seconds. Defaults to 20 per second.
+ *  While devices from versions that do not announce their interval are
+ *  heard, the default interval is kept. Databases from those versions that
+ *  monitor a bus with no such devices may still expire devices announcing
+ *  less often than every 10 seconds, and rediscover them at their next
+ *  announcement.
+ *  \param net          The network structure to modify.
+ *  \param rate         The rate in messages per second, or 0 for the
+ *                      default. */
+void mapper_network_set_max_sync_rate(mapper_network net, float rate);
+
+/*! Get the current interval between /sync announcements of a network's
+ *  device, which depends on the number of peers heard on the bus.
+ *  \param net          The network structure to query.
+ *  \return             The interval in seconds. */
+int mapper_network_sync_interval(mapper_network net);
+
 /*! Interface to send an arbitrary OSC message to the administrative bus.
  *  \param net          The networking structure to use for sending the message.
  *  \param path         The path for the OSC message.
@@ -1200,6 +1345,54 @@ mapper_link *mapper_link_query_copy(mapper_link *query);
  *  \param query        The previous link record pointer. */
 void mapper_link_query_done(mapper_link *query);
 
+/*! Retrieve the runtime counters for a local link. Statistics must first be
+ *  enabled using mapper_device_set_stats().
+ *  \param link         The link to check.
+ *  \param stats        A pointer to a structure to receive the counters.
+ *  \return             Zero if statistics are available, otherwise non-zero. */
+int mapper_link_stats(mapper_link link, mapper_stats_t *stats);
+
+/*! Retrieve a percentile from one of the timing histograms of a local link.
+ *  \param link         The link to check.
+ *  \param timer        The timing distribution to query.
+ *  \param percentile   The percentile to retrieve, between 0 and 100. Use 100
+ *                      to retrieve the exact maximum.
+ *  \return             The approximate value in seconds, or 0 if no samples
+ *                      have been recorded. */
+double mapper_link_stats_percentile(mapper_link link, mapper_stat_timer timer,
+                                    double percentile);
+
+/*! Reset the runtime statistics of a local link.
+ *  \param link         The link to reset. */
+void mapper_link_reset_stats(mapper_link link);
+
+/*! Retrieve the estimated clock offset between the local device and the
+ *  remote device of a local link.  Adding the offset to a timetag produced by
+ *  the remote device converts it to local time.
+ *  \param link         The link to check.
+ *  \param offset       A pointer to receive the offset in seconds.
+ *  \param error        A pointer to receive the bound on the estimation error in
+ *                      seconds, or zero.
+ *  \return             Zero if an estimate is available, otherwise non-zero. */
+int mapper_link_clock_offset(mapper_link link, double *offset, double *error);
+
+/*! Retrieve the estimated rate difference between the remote and local clocks
+ *  of a local link.
+ *  \param link         The link to check.
+ *  \return             The skew as a fraction, e.g. 1e-4 for 100 ppm. */
+double mapper_link_clock_skew(mapper_link link);
+
+/*! Retrieve the number of bytes of updates waiting to be written to the stream
+ *  connection of a local link. Setting the link property "transport" to "tcp"
+ *  sends map updates over a TCP connection to the remote device instead of
+ *  UDP; updates are then never fragmented or lost, but when the connection
+ *  cannot keep up they wait in a bounded backlog, and further updates are
+ *  dropped and counted in mapper_stats_t.dropped_backpressure.
+ *  \param link         The link to check.
+ *  \return             The number of bytes waiting, or zero if the link does
+ *                      not use a stream connection. */
+int mapper_link_stream_backlog(mapper_link link);
+
 /*! Helper to print the properties of a specific network link.
  *  \param link         The link to print. */
 void mapper_link_print(mapper_link link);
@@ -1354,6 +1547,44 @@ void mapper_map_set_muted(mapper_map map, int muted);
  *                      the destination. */
 void mapper_map_set_process_location(mapper_map map, mapper_location location);
 
+/*! Set the policy limiting which updates are sent by a local map, overriding
+ *  the policy of its source signal. Policies only apply to single-sample
+ *  updates processed by this device; updates carrying several samples and
+ *  instance releases are always sent. The number of suppressed updates is
+ *  included in the map statistics.
+ *  \param map          The map to modify.
+ *  \param policy       The send policy, or 0 to use the policy of the source
+ *                      signal. */
+void mapper_map_set_send_policy(mapper_map map,
+                                const mapper_send_policy_t *policy);
+
+/*! Get the send policy of a local map.
+ *  \param map          The map to check.
+ *  \param policy       A pointer to a structure to receive the policy.
+ *  \return             Zero if the map has its own send policy, otherwise
+ *                      non-zero. */
+int mapper_map_send_policy(mapper_map map, mapper_send_policy_t *policy);
+
+/*! Set when a local convergent map is evaluated by its destination device.
+ *  By default the expression is evaluated whenever a source is updated; when
+ *  waiting for all sources, updates that arrive together (e.g. in the same
+ *  bundle) are combined into a single evaluation. A source that is updated
+ *  again before the others have arrived causes the waiting update to be
+ *  evaluated first. Only single-sample updates are combined.
+ *  \param map          The map to modify.
+ *  \param mode         MAPPER_CONVERGE_EACH or MAPPER_CONVERGE_ALL.
+ *  \param timeout      The maximum time in seconds to wait for the remaining
+ *                      sources, or zero to evaluate incomplete updates when
+ *                      the device is next polled. */
+void mapper_map_set_convergence(mapper_map map, mapper_convergence_mode mode,
+                                double timeout);
+
+/*! Get the convergence mode of a local map.
+ *  \param map          The map to check.
+ *  \param timeout      A pointer to receive the timeout in seconds, or 0.
+ *  \return             The convergence mode of the map. */
+mapper_convergence_mode mapper_map_convergence(mapper_map map, double *timeout);
+
 /*! Set an arbitrary property for a specific map.  Changes to remote maps will
  *  not take effect until synchronized with the network using mapper_map_push().
  *  \param map          The map to modify.
@@ -1486,6 +1717,27 @@ mapper_map *mapper_map_query_copy(mapper_map *query);
  *  \param query        The previous map record pointer. */
 void mapper_map_query_done(mapper_map *query);
 
+/*! Retrieve the runtime counters for a local map. Statistics must first be
+ *  enabled using mapper_device_set_stats().
+ *  \param map          The map to check.
+ *  \param stats        A pointer to a structure to receive the counters.
+ *  \return             Zero if statistics are available, otherwise non-zero. */
+int mapper_map_stats(mapper_map map, mapper_stats_t *stats);
+
+/*! Retrieve a percentile from one of the timing histograms of a local map.
+ *  \param map          The map to check.
+ *  \param timer        The timing distribution to query.
+ *  \param percentile   The percentile to retrieve, between 0 and 100. Use 100
+ *                      to retrieve the exact maximum.
+ *  \return             The approximate value in seconds, or 0 if no samples
+ *                      have been recorded. */
+double mapper_map_stats_percentile(mapper_map map, mapper_stat_timer timer,
+                                   double percentile);
+
+/*! Reset the runtime statistics of a local map.
+ *  \param map          The map to reset. */
+void mapper_map_reset_stats(mapper_map map);
+
 /*! Helper to print the properties of a specific map.
  *  \param map          The map to print. */
 void mapper_map_print(mapper_map map);
@@ -1732,6 +1984,53 @@ void mapper_database_free(mapper_database db);
 void mapper_database_subscribe(mapper_database db, mapper_device dev, int flags,
                                int timeout);
 
+/*! Create a filter limiting the signals and maps received through a
+ *  subscription. Filters are applied by the subscribed device before it sends
+ *  anything, so information that is not of interest never crosses the network.
+ *  \param pattern      A signal name pattern which may contain '*' wildcards,
+ *                      or NULL to match signals of any name.
+ *  \return             A new subscription filter. */
+mapper_subscription_filter mapper_subscription_filter_new(const char *pattern);
+
+/*! Add a property test to a subscription filter. Signals are only sent if they
+ *  pass all of the filter's tests, and maps are only sent if one of their
+ *  signals on the subscribed device passes.
+ *  \param filter       The filter to modify.
+ *  \param property     The name of the signal property to test.
+ *  \param op           The comparison to use.
+ *  \param length       The length of the value argument. Ignored for the
+ *                      MAPPER_OP_EXISTS and MAPPER_OP_DOES_NOT_EXIST
+ *                      operators.
+ *  \param type         The type of the value argument. Can be 'i', 'f', 'd',
+ *                      'h', or 's'.
+ *  \param value        The value to compare with the signal property.
+ *  \return             Zero if the test was added, or non-zero if the
+ *                      arguments are not supported. */
+int mapper_subscription_filter_add_predicate(mapper_subscription_filter filter,
+                                             const char *property,
+                                             mapper_op op, int length,
+                                             char type, const void *value);
+
+/*! Free a subscription filter.
+ *  \param filter       The filter to free. */
+void mapper_subscription_filter_free(mapper_subscription_filter filter);
+
+/*! Subscribe to information about a specific device, limiting the signals and
+ *  maps received to those passing a filter.
+ *  \param db           The database to use.
+ *  \param dev          The device of interest. Filters cannot be used when
+ *                      autosubscribing, so the call is ignored if this is
+ *                      NULL and a filter is given.
+ *  \param flags        Bitflags setting the type of information of interest,
+ *                      as for mapper_database_subscribe().
+ *  \param timeout      The length in seconds for this subscription, or -1 to
+ *                      renew the subscription automatically.
+ *  \param filter       The filter to apply, or NULL to receive everything.
+ *                      The filter is copied and may be freed afterwards. */
+void mapper_database_subscribe_filtered(mapper_database db, mapper_device dev,
+                                        int flags, int timeout,
+                                        mapper_subscription_filter filter);
+
 /*! Unsubscribe from information about a specific device.
  *  \param db           The database to use.
  *  \param dev          The device of interest. If NULL the database will
@@ -2063,6 +2362,212 @@ mapper_map *mapper_database_maps_by_slot_property(mapper_database db,
                                                   char type, const void *value,
                                                   mapper_op op);
 
+/*! Add a secondary index on a device, signal or map property. Queries using
+ *  the MAPPER_OP_EQUAL operator on an indexed property, including their
+ *  intersections with other queries, only examine records sharing the same
+ *  value. Signals may also be indexed by "device", which is used by
+ *  mapper_device_signals(), and by "direction", which is used by
+ *  mapper_database_signals(). Indexes are rebuilt the first time they are
+ *  used after the database changes.
+ *  \param db           The database to index.
+ *  \param type         The object type, one of MAPPER_OBJ_DEVICES,
+ *                      MAPPER_OBJ_SIGNALS or MAPPER_OBJ_MAPS.
+ *  \param name         The name of the property to index.
+ *  \return             Zero if the index was added, or non-zero if the
+ *                      property cannot be indexed. */
+int mapper_database_add_index(mapper_database db, mapper_object_type type,
+                              const char *name);
+
+/*! Remove a secondary index added using mapper_database_add_index().
+ *  \param db           The database.
+ *  \param type         The object type.
+ *  \param name         The name of the indexed property. */
+void mapper_database_remove_index(mapper_database db, mapper_object_type type,
+                                  const char *name);
+
+/*! Begin collecting map requests. Until the transaction is committed using
+ *  mapper_database_commit_transaction(), the messages sent by
+ *  mapper_map_push() and mapper_map_release() are held back. Creations and
+ *  removals are grouped by destination device, and sent directly to each
+ *  destination device if it is linked to the database's own device.
+ *  Transactions may be nested, in which case the messages are sent when the
+ *  outermost transaction is committed.
+ *  \param db           The database to use. */
+void mapper_database_begin_transaction(mapper_database db);
+
+/*! Send the map requests collected since the matching call to
+ *  mapper_database_begin_transaction() in bundles.
+ *  \param db           The database to use.
+ *  \return             The number of map requests sent, or 0 if this was a
+ *                      nested transaction. */
+int mapper_database_commit_transaction(mapper_database db);
+
+/*! Save the active maps in the database to a JSON file. Maps are written one
+ *  at a time, including their slots, expressions, boundary actions and
+ *  scopes, so a session can later be restored using
+ *  mapper_database_load_maps().
+ *  \param db           The database containing the maps.
+ *  \param path         The file to write.
+ *  \return             The number of maps saved, or -1 on error. */
+int mapper_database_save_maps(mapper_database db, const char *path);
+
+/*! A callback function prototype for reporting the progress of loading maps.
+ *  Such a function is passed in to mapper_database_load_maps().
+ *  \param db           The database loading the maps.
+ *  \param num_loaded   The number of maps pushed to the network so far.
+ *  \param num_skipped  The number of maps skipped so far since their signals
+ *                      are not known to the database.
+ *  \param user         The user context pointer passed to
+ *                      mapper_database_load_maps(). */
+typedef void mapper_database_load_handler(mapper_database db, int num_loaded,
+                                          int num_skipped, const void *user);
+
+/*! Load maps from a file written by mapper_database_save_maps(). Each map is
+ *  created and pushed to the network as soon as it is read, and the resulting
+ *  map requests are sent in bundles. Signals are looked up by name, so the
+ *  devices involved must already be known to the database.
+ *  \param db           The database to use.
+ *  \param path         The file to read.
+ *  \param h            A function to call after each bundle of maps is sent,
+ *                      or 0.
+ *  \param user         A user-defined pointer to be passed to the callback.
+ *  \return             The number of maps pushed, or -1 if the file could not
+ *                      be read or parsed. */
+int mapper_database_load_maps(mapper_database db, const char *path,
+                              mapper_database_load_handler *h,
+                              const void *user);
+
+/*! Add a change feed to the database. A change feed logs the changes to
+ *  records, so that they can be read in batches using
+ *  mapper_change_feed_read() instead of being handled one at a time by
+ *  callbacks. Until a change has been read, later changes to the same record
+ *  are merged into it, so a record which is added and then modified is
+ *  reported once as MAPPER_ADDED, and a record which is added and then
+ *  removed is not reported. If more changes are waiting than the feed can
+ *  hold, they are discarded and the next read starts with a change of type
+ *  MAPPER_OBJ_ALL and event MAPPER_MODIFIED, after which all records should
+ *  be read again.
+ *  \param db           The database to use.
+ *  \param flags        Bitflags indicating which object types to record.
+ *  \param capacity     The number of changes the feed can hold. This is
+ *                      rounded up to a power of two.
+ *  \return             The new change feed. */
+mapper_change_feed mapper_database_add_change_feed(mapper_database db,
+                                                   int flags, int capacity);
+
+/*! Remove and free a change feed added using
+ *  mapper_database_add_change_feed().
+ *  \param db           The database.
+ *  \param feed         The change feed to remove. */
+void mapper_database_remove_change_feed(mapper_database db,
+                                        mapper_change_feed feed);
+
+/*! Read the changes waiting in a change feed, oldest first. Changes are
+ *  removed from the feed once read.
+ *  \param feed         The change feed to read.
+ *  \param changes      An array to receive the changes.
+ *  \param num          The size of the array.
+ *  \return             The number of changes copied to the array. */
+int mapper_change_feed_read(mapper_change_feed feed, mapper_change_t *changes,
+                            int num);
+
+/*! Get the number of changes waiting in a change feed.
+ *  \param feed         The change feed.
+ *  \return             An upper bound on the number of changes which would
+ *                      be returned by mapper_change_feed_read(), since
+ *                      changes may still be merged. */
+int mapper_change_feed_num_pending(mapper_change_feed feed);
+
+/*! Enable or disable snapshots of the database. While enabled, polling the
+ *  database or its device publishes an immutable copy of its devices,
+ *  signals, links and maps whenever they have changed. Snapshots may be read
+ *  from other threads without locking while the database continues to be
+ *  updated. Besides their own properties, signal records include the
+ *  property "device_id", link records "device_ids", and map records
+ *  "source_ids" and "destination_id".
+ *  \param db           The database to use.
+ *  \param enable       Non-zero to publish snapshots, or zero to stop. */
+void mapper_database_set_snapshots(mapper_database db, int enable);
+
+/*! Acquire the latest snapshot of the database. The snapshot and its records
+ *  remain valid and unchanged until released, even if the records are
+ *  removed from the database.
+ *  \param db           The database to use.
+ *  \return             The snapshot, which must be released using
+ *                      mapper_snapshot_release(), or zero if snapshots are
+ *                      not enabled. */
+mapper_snapshot mapper_database_snapshot(mapper_database db);
+
+/*! Release a snapshot acquired using mapper_database_snapshot().
+ *  \param snap         The snapshot to release. */
+void mapper_snapshot_release(mapper_snapshot snap);
+
+/*! Get the number of records of a given type in a snapshot.
+ *  \param snap         The snapshot to query.
+ *  \param type         One of MAPPER_OBJ_DEVICES, MAPPER_OBJ_SIGNALS,
+ *                      MAPPER_OBJ_LINKS or MAPPER_OBJ_MAPS.
+ *  \return             The number of records. */
+int mapper_snapshot_num_records(mapper_snapshot snap, mapper_object_type type);
+
+/*! Look up a snapshot record by index. Records are ordered by id.
+ *  \param snap         The snapshot to query.
+ *  \param type         The record type.
+ *  \param index        The index of the record.
+ *  \return             The record, or zero if not found. */
+mapper_snapshot_record mapper_snapshot_record_by_index(mapper_snapshot snap,
+                                                       mapper_object_type type,
+                                                       int index);
+
+/*! Look up a snapshot record by the id of its device, signal, link or map.
+ *  \param snap         The snapshot to query.
+ *  \param type         The record type.
+ *  \param id           The id to look up.
+ *  \return             The record, or zero if not found. */
+mapper_snapshot_record mapper_snapshot_record_by_id(mapper_snapshot snap,
+                                                    mapper_object_type type,
+                                                    mapper_id id);
+
+/*! Get the id of a snapshot record.
+ *  \param rec          The snapshot record.
+ *  \return             The id of the device, signal, link or map. */
+mapper_id mapper_snapshot_record_id(mapper_snapshot_record rec);
+
+/*! Get the number of properties held by a snapshot record.
+ *  \param rec          The snapshot record.
+ *  \return             The number of properties. */
+int mapper_snapshot_record_num_properties(mapper_snapshot_record rec);
+
+/*! Look up a property of a snapshot record by name.
+ *  \param rec          The snapshot record.
+ *  \param name         The name of the property to retrieve.
+ *  \param length       A pointer to a location to receive the vector length
+ *                      of the property value (Optional).
+ *  \param type         A pointer to a location to receive the type of the
+ *                      property value (Optional).
+ *  \param value        A pointer to a location to receive the address of the
+ *                      property's value (Optional).
+ *  \return             Zero if found, otherwise non-zero. */
+int mapper_snapshot_record_property(mapper_snapshot_record rec,
+                                    const char *name, int *length, char *type,
+                                    const void **value);
+
+/*! Look up a property of a snapshot record by index.
+ *  \param rec          The snapshot record.
+ *  \param index        Numerical index of the property.
+ *  \param name         A pointer to a location to receive the name of the
+ *                      property value (Optional).
+ *  \param length       A pointer to a location to receive the vector length
+ *                      of the property value (Optional).
+ *  \param type         A pointer to a location to receive the type of the
+ *                      property value (Optional).
+ *  \param value        A pointer to a location to receive the address of the
+ *                      property's value (Optional).
+ *  \return             Zero if found, otherwise non-zero. */
+int mapper_snapshot_record_property_index(mapper_snapshot_record rec,
+                                          unsigned int index,
+                                          const char **name, int *length,
+                                          char *type, const void **value);
+
 /* @} */
 
 /***** Time *****/
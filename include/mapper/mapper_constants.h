@@ -114,6 +114,24 @@ typedef enum {
     MAPPER_STEAL_NEWEST,    //!< Steal the newest instance.
 } mapper_instance_stealing_type;
 
+/*! Describes when the update handler of an input signal is called.
+ *  @ingroup signals */
+typedef enum {
+    MAPPER_CALLBACK_IMMEDIATE,  //!< Call the handler for every update.
+    MAPPER_CALLBACK_COALESCE,   /*!< Only store incoming values, and call the
+                                 *   handler once for each updated instance
+                                 *   when the device is polled. */
+} mapper_callback_mode;
+
+/*! Describes when a convergent map is evaluated by its destination device.
+ *  @ingroup map */
+typedef enum {
+    MAPPER_CONVERGE_EACH,   //!< Evaluate whenever any source is updated.
+    MAPPER_CONVERGE_ALL,    /*!< Evaluate once every source that causes updates
+                             *   has been updated, or when the convergence
+                             *   timeout expires. */
+} mapper_convergence_mode;
+
 /*! The set of possible events for a database record, used to inform callbacks
  *  of what is happening to a record.
  *  @ingroup database */
@@ -125,6 +143,80 @@ typedef enum {
                              *   entity. */
 } mapper_record_event;
 
+/*! A change to a database record, read from a change feed.
+ *  @ingroup database */
+typedef struct {
+    mapper_id id;               //!< The id of the changed record.
+    mapper_object_type type;    /*!< One of MAPPER_OBJ_DEVICES,
+                                 *   MAPPER_OBJ_SIGNALS, MAPPER_OBJ_LINKS or
+                                 *   MAPPER_OBJ_MAPS, or MAPPER_OBJ_ALL if
+                                 *   changes were lost. */
+    mapper_record_event event;  //!< What happened to the record.
+} mapper_change_t;
+
+/*! Bit flags for enabling runtime statistics on a local device.
+ *  @ingroup devices */
+typedef enum {
+    MAPPER_STATS_NONE       = 0x00, //!< Statistics are not collected.
+    MAPPER_STATS_COLLECT    = 0x01, /*!< Collect statistics for local maps and
+                                     *   links. */
+    MAPPER_STATS_PUBLISH    = 0x03, /*!< Also publish statistics as read-only
+                                     *   map and link properties. */
+} mapper_stats_flags;
+
+/*! Timing distributions recorded by runtime statistics.
+ *  @ingroup maps */
+typedef enum {
+    MAPPER_STAT_EVAL_TIME,  //!< Time spent processing a sample, in seconds.
+    MAPPER_STAT_LATENCY,    /*!< End-to-end latency of received updates
+                             *   corrected by the link clock offset, in
+                             *   seconds. */
+    MAPPER_STAT_SCHEDULE_ERROR, /*!< Difference between the delivery time of
+                                 *   scheduled updates and their timetag, in
+                                 *   seconds. */
+    NUM_MAPPER_STAT_TIMERS
+} mapper_stat_timer;
+
+/*! A snapshot of the runtime counters for a map or link.
+ *  @ingroup maps */
+typedef struct {
+    uint64_t sent;                  //!< Number of messages sent.
+    uint64_t received;              //!< Number of messages received.
+    uint64_t bytes_sent;            //!< Number of bytes sent.
+    uint64_t bytes_received;        //!< Number of bytes received.
+    uint64_t dropped_muted;         /*!< Samples dropped by muting or by a
+                                     *   MAPPER_BOUND_MUTE boundary. */
+    uint64_t dropped_out_of_scope;  //!< Instance updates out of map scope.
+    uint64_t dropped_not_ready;     //!< Samples arriving before map is ready.
+    uint64_t dropped_backpressure;  /*!< Updates dropped because a stream
+                                     *   connection was not keeping up. */
+    uint64_t scheduled;             /*!< Updates held for delivery at their
+                                     *   timetag. */
+    uint64_t late;                  /*!< Updates arriving after their timetag
+                                     *   when scheduling is enabled. */
+    uint64_t coalesced;             /*!< Updates replaced by a newer value
+                                     *   before being sent. */
+    uint64_t rate_limited;          /*!< Updates suppressed by the maximum
+                                     *   send rate. */
+    uint64_t below_deadband;        /*!< Updates suppressed since no element
+                                     *   changed by more than the deadband. */
+    uint64_t converged;             /*!< Source updates of a convergent map
+                                     *   combined into a later evaluation. */
+} mapper_stats_t;
+
+/*! A policy limiting which updates of an outgoing signal are sent.
+ *  @ingroup signals */
+typedef struct {
+    int coalesce;       /*!< Non-zero to hold updates and send only the latest
+                         *   value of each instance when the device is
+                         *   polled. */
+    float max_rate;     /*!< Maximum number of updates sent per second for each
+                         *   instance, or zero for no limit. */
+    double deadband;    /*!< Suppress updates in which no element changed by
+                         *   more than this amount since the last update sent,
+                         *   or zero to send all updates. */
+} mapper_send_policy_t;
+
 #ifdef __cplusplus
 }
 #endif
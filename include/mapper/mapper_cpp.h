@@ -467,6 +467,19 @@ namespace mapper {
         int port() const
             { return mapper_network_port(_net); }
 
+        /*! Get the number of administrative messages of a given kind that
+         *  this Network has sent and received.
+         *  \param path The path of the messages to count, or NULL for all.
+         *  \return     Zero if successful, or non-zero if the path is not
+         *              that of an administrative message. */
+        int message_counts(const char *path, int *sent, int *received) const
+            { return mapper_network_message_counts(_net, path, sent,
+                                                   received); }
+        Network& set_max_sync_rate(float rate)
+            { mapper_network_set_max_sync_rate(_net, rate); return (*this); }
+        int sync_interval() const
+            { return mapper_network_sync_interval(_net); }
+
     protected:
         friend class Device;
         friend class Database;
@@ -1069,6 +1082,25 @@ namespace mapper {
         Map& set_muted(bool muted)
             { mapper_map_set_muted(_map, (int)muted); return (*this); }
 
+        /*! Retrieve runtime counters for this Map. Statistics must first be
+         *  enabled using Device::set_stats().
+         *  \param stats    A structure to receive the counters.
+         *  \return         True if statistics are available, false otherwise. */
+        bool stats(mapper_stats_t &stats) const
+            { return !mapper_map_stats(_map, &stats); }
+
+        /*! Retrieve a percentile from one of the timing histograms of this Map.
+         *  \param timer        The timing distribution to query.
+         *  \param percentile   The percentile to retrieve, between 0 and 100.
+         *  \return             The approximate value in seconds. */
+        double stats_percentile(mapper_stat_timer timer, double percentile) const
+            { return mapper_map_stats_percentile(_map, timer, percentile); }
+
+        /*! Reset the runtime statistics of this Map.
+         *  \return         Self. */
+        Map& reset_stats()
+            { mapper_map_reset_stats(_map); return (*this); }
+
         /*! Get the process location for a this Map.
          *  \return     MAPPER_LOC_SOURCE if processing is evaluated at the
          *              source device, MAPPER_LOC_DESTINATION otherwise. */
@@ -1089,6 +1121,31 @@ namespace mapper {
          *  \return         Self. */
         Map& set_process_location(mapper_location location)
             { mapper_map_set_process_location(_map, location); return (*this); }
+        /*! Set the policy limiting which updates are sent by this Map.
+         *  \param policy   The send policy, overriding that of the source Signal.
+         *  \return         Self. */
+        Map& set_send_policy(const mapper_send_policy_t &policy)
+            { mapper_map_set_send_policy(_map, &policy); return (*this); }
+        /*! Remove the send policy of this Map, using that of its source Signal.
+         *  \return         Self. */
+        Map& clear_send_policy()
+            { mapper_map_set_send_policy(_map, 0); return (*this); }
+        /*! Retrieve the send policy of this Map.
+         *  \param policy   A structure to receive the policy.
+         *  \return         True if the Map has its own policy, false otherwise. */
+        bool send_policy(mapper_send_policy_t &policy) const
+            { return !mapper_map_send_policy(_map, &policy); }
+        /*! Set when this convergent Map is evaluated by its destination.
+         *  \param mode     MAPPER_CONVERGE_EACH or MAPPER_CONVERGE_ALL.
+         *  \param timeout  The longest time in seconds to wait for all sources.
+         *  \return         Self. */
+        Map& set_convergence(mapper_convergence_mode mode, double timeout=0)
+            { mapper_map_set_convergence(_map, mode, timeout); return (*this); }
+        /*! Get the convergence mode of this Map.
+         *  \param timeout  A pointer to receive the timeout in seconds, or 0.
+         *  \return         The convergence mode. */
+        mapper_convergence_mode convergence(double *timeout=0) const
+            { return mapper_map_convergence(_map, timeout); }
 
         /*! Return the unique id assigned to this Map.
          *  \return     The unique id assigned to this Map. */
@@ -1416,6 +1473,20 @@ namespace mapper {
             { mapper_link_set_user_data(_link, user_data); return (*this); }
         void *user_data() const
             { return mapper_link_user_data(_link); }
+        bool stats(mapper_stats_t &stats) const
+            { return !mapper_link_stats(_link, &stats); }
+        double stats_percentile(mapper_stat_timer timer, double percentile) const
+            { return mapper_link_stats_percentile(_link, timer, percentile); }
+        Link& reset_stats()
+            { mapper_link_reset_stats(_link); return (*this); }
+        int clock_offset(double *offset, double *error=0) const
+            { return mapper_link_clock_offset(_link, offset, error); }
+        double clock_skew() const
+            { return mapper_link_clock_skew(_link); }
+        /*! Get the number of bytes waiting to be written to the stream of this Link.
+         *  \return         The bytes waiting, or zero if no stream is used. */
+        int stream_backlog() const
+            { return mapper_link_stream_backlog(_link); }
         PROPERTY_METHODS(Link, link, _link);
         /*! Query objects provide a lazily-computed iterable list of results
          *  from running queries against Databases or Devices. */
@@ -1544,6 +1615,20 @@ namespace mapper {
             { return mapper_signal_user_data(_sig); }
         Signal& set_callback(mapper_signal_update_handler *h)
             { mapper_signal_set_callback(_sig, h); return (*this); }
+        /*! Set when the update handler of this input Signal is called.
+         *  \param mode     The callback mode, e.g. MAPPER_CALLBACK_COALESCE.
+         *  \return         Self. */
+        Signal& set_callback_mode(mapper_callback_mode mode)
+            { mapper_signal_set_callback_mode(_sig, mode); return (*this); }
+        /*! Get the callback mode of this Signal.
+         *  \return         The callback mode. */
+        mapper_callback_mode callback_mode() const
+            { return mapper_signal_callback_mode(_sig); }
+        /*! Set the handler called with all coalesced updates of this Signal.
+         *  \param h        The batch handler, or 0 to call the update handler.
+         *  \return         Self. */
+        Signal& set_batch_callback(mapper_signal_batch_handler *h)
+            { mapper_signal_set_batch_callback(_sig, h); return (*this); }
         int num_maps(mapper_direction dir=MAPPER_DIR_ANY) const
             { return mapper_signal_num_maps(_sig, dir); }
         Property minimum() const
@@ -1572,6 +1657,20 @@ namespace mapper {
             { return mapper_signal_rate(_sig); }
         Signal& set_rate(int rate)
             { mapper_signal_set_rate(_sig, rate); return (*this); }
+        /*! Set the policy limiting which updates of this Signal are sent.
+         *  \param policy   The send policy for outgoing Maps without their own.
+         *  \return         Self. */
+        Signal& set_send_policy(const mapper_send_policy_t &policy)
+            { mapper_signal_set_send_policy(_sig, &policy); return (*this); }
+        /*! Remove the send policy of this Signal, sending every update.
+         *  \return         Self. */
+        Signal& clear_send_policy()
+            { mapper_signal_set_send_policy(_sig, 0); return (*this); }
+        /*! Retrieve the send policy of this Signal.
+         *  \param policy   A structure to receive the policy.
+         *  \return         True if the Signal has a policy, false otherwise. */
+        bool send_policy(mapper_send_policy_t &policy) const
+            { return !mapper_signal_send_policy(_sig, &policy); }
 
         class Instance {
         public:
@@ -1859,6 +1958,23 @@ namespace mapper {
             { mapper_device_set_link_callback(_dev, h); return (*this); }
         Device& set_map_callback(mapper_device_map_handler h)
             { mapper_device_set_map_callback(_dev, h); return (*this); }
+        Device& set_stats(int flags)
+            { mapper_device_set_stats(_dev, flags); return (*this); }
+        int stats() const
+            { return mapper_device_stats(_dev); }
+        Device& set_scheduling(bool enable)
+            { mapper_device_set_scheduling(_dev, enable); return (*this); }
+        bool scheduling() const
+            { return mapper_device_scheduling(_dev); }
+        /*! Enable or disable direct delivery of updates to local Devices.
+         *  \param enable   True to enable direct delivery, false to disable it.
+         *  \return         Self. */
+        Device& set_direct_delivery(bool enable)
+            { mapper_device_set_direct_delivery(_dev, enable); return (*this); }
+        /*! Check whether direct delivery is enabled for this Device.
+         *  \return         True if direct delivery is enabled. */
+        bool direct_delivery() const
+            { return mapper_device_direct_delivery(_dev); }
         Link link(Device remote)
         {
             return Link(mapper_device_link_by_remote_device(_dev, remote._dev));
@@ -2170,6 +2286,40 @@ namespace mapper {
 
         // database maps
         DATABASE_METHODS(Map, map, Map::Query);
+        int save_maps(const string_type &path) const
+            { return mapper_database_save_maps(_db, path); }
+        int load_maps(const string_type &path,
+                      mapper_database_load_handler *h=0, void *user=0) const
+            { return mapper_database_load_maps(_db, path, h, user); }
+        const Database& begin_transaction() const
+        {
+            mapper_database_begin_transaction(_db);
+            return (*this);
+        }
+        int commit_transaction() const
+            { return mapper_database_commit_transaction(_db); }
+        int add_index(mapper_object_type type, const string_type &name) const
+            { return mapper_database_add_index(_db, type, name); }
+        const Database& remove_index(mapper_object_type type,
+                                     const string_type &name) const
+        {
+            mapper_database_remove_index(_db, type, name);
+            return (*this);
+        }
+        const Database& set_snapshots(bool enable) const
+        {
+            mapper_database_set_snapshots(_db, enable);
+            return (*this);
+        }
+        mapper_snapshot snapshot() const
+            { return mapper_database_snapshot(_db); }
+        mapper_change_feed add_change_feed(int flags, int capacity) const
+            { return mapper_database_add_change_feed(_db, flags, capacity); }
+        const Database& remove_change_feed(mapper_change_feed feed) const
+        {
+            mapper_database_remove_change_feed(_db, feed);
+            return (*this);
+        }
 
     private:
         mapper_database _db;
@@ -29,6 +29,21 @@ typedef void *mapper_network;
 //! This can be retrieved by calling mapper_network_db() or mapper_device_db().
 typedef void *mapper_database;
 
+//! An immutable copy of a database's records.
+//! This can be retrieved by calling mapper_database_snapshot().
+typedef void *mapper_snapshot;
+
+//! A device, signal, link or map record held by a database snapshot.
+typedef void *mapper_snapshot_record;
+
+//! Limits the signals and maps received through a subscription.
+//! This can be created by calling mapper_subscription_filter_new().
+typedef void *mapper_subscription_filter;
+
+//! A bounded log of changes to database records.
+//! This can be created by calling mapper_database_add_change_feed().
+typedef void *mapper_change_feed;
+
 //! An internal data structure defining a mapper queue
 //! Used to handle a queue of mapper signals
 typedef void *mapper_queue;
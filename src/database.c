@@ -38,6 +38,8 @@ void mapper_database_free(mapper_database db)
 
     // remove callbacks now so they won't be called when removing devices
     mapper_database_remove_all_callbacks(db);
+    while (db->change_feeds)
+        mapper_database_remove_change_feed(db, db->change_feeds);
 
     mapper_network_remove_database(db->network);
 
@@ -86,6 +88,12 @@ void mapper_database_free(mapper_database db)
             mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
     }
 
+    // readers may still hold earlier snapshots
+    mapper_database_set_snapshots(db, 0);
+
+    while (db->indexes)
+        mapper_database_remove_index(db, db->indexes->type, db->indexes->name);
+
     if (!db->network->device && !db->network->own_network)
         mapper_network_free(db->network);
 }
@@ -182,6 +190,8 @@ mapper_device mapper_database_add_or_update_device(mapper_database db,
         mapper_timetag_now(&dev->synced);
 
         if (rc || updated) {
+            mapper_database_log_change(db, MAPPER_OBJ_DEVICES, dev->id,
+                                       rc ? MAPPER_ADDED : MAPPER_MODIFIED);
             fptr_list cb = db->device_callbacks;
             while (cb) {
                 mapper_database_device_handler *h = cb->f;
@@ -219,9 +229,11 @@ void mapper_database_remove_device(mapper_database db, mapper_device dev,
                                                                 MAPPER_DIR_ANY),
                                             event);
 
+    mapper_database_remove_record(dev->props);
     mapper_list_remove_item((void**)&db->devices, dev);
 
     if (!quiet) {
+        mapper_database_log_change(db, MAPPER_OBJ_DEVICES, dev->id, event);
         fptr_list cb = db->device_callbacks;
         while (cb) {
             mapper_database_device_handler *h = cb->f;
@@ -279,7 +291,7 @@ mapper_device mapper_database_device_by_id(mapper_database db, mapper_id id)
     return 0;
 }
 
-static int match_pattern(const char* string, const char* pattern)
+int mapper_match_pattern(const char* string, const char* pattern)
 {
     if (!string || !pattern)
         return 0;
@@ -311,7 +323,7 @@ static int match_pattern(const char* string, const char* pattern)
 static int cmp_query_devices_by_name(const void *context_data, mapper_device dev)
 {
     const char *name = (const char*)context_data;
-    return match_pattern(dev->name, name);
+    return mapper_match_pattern(dev->name, name);
 }
 
 mapper_device *mapper_database_devices_by_name(mapper_database db,
@@ -327,7 +339,7 @@ static inline int check_type(char type)
     return strchr("ifdscth", type) != 0;
 }
 
-static int compare_value(mapper_op op, int length, char type, const void *val1,
+int mapper_compare_value(mapper_op op, int length, char type, const void *val1,
                          const void *val2)
 {
     int i, compare = 0, difference = 0;
@@ -400,6 +412,378 @@ static int compare_value(mapper_op op, int length, char type, const void *val1,
     }
 }
 
+/**** Secondary indexes ****/
+
+/* Properties which are updated directly rather than through the property
+ * table, so an index would not notice when they change. */
+static const char *unindexable_properties[] = {
+    "expression", "mode", "muted", "rate", "status", "synced", "user_data",
+    "version", 0
+};
+
+static void *index_list(mapper_database db, int type)
+{
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:    return db->devices;
+        case MAPPER_OBJ_SIGNALS:    return db->signals;
+        case MAPPER_OBJ_MAPS:       return db->maps;
+        default:                    return 0;
+    }
+}
+
+/* Signals may also be indexed by the id of their parent device. */
+static int index_property(int type, void *record, const char *name,
+                          int *length, char *vtype, const void **value)
+{
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:
+            return mapper_device_property((mapper_device)record, name, length,
+                                          vtype, value);
+        case MAPPER_OBJ_SIGNALS:
+            if (strcmp(name, "device") == 0) {
+                *length = 1;
+                *vtype = 'h';
+                *value = &((mapper_signal)record)->device->id;
+                return 0;
+            }
+            return mapper_signal_property((mapper_signal)record, name, length,
+                                          vtype, value);
+        case MAPPER_OBJ_MAPS:
+            return mapper_map_property((mapper_map)record, name, length, vtype,
+                                       value);
+        default:
+            return 1;
+    }
+}
+
+static uint32_t hash_value(int length, char type, const void *value)
+{
+    // FNV-1a hash of the value type, length and contents
+    uint32_t hash = 2166136261u;
+    const unsigned char *bytes;
+    int i, size;
+    hash = (hash ^ (unsigned char)type) * 16777619u;
+    hash = (hash ^ (uint32_t)length) * 16777619u;
+    for (i = 0; i < length; i++) {
+        if (type == 's' || type == 'S') {
+            bytes = (const unsigned char*)(length == 1 ? value
+                                           : ((const char**)value)[i]);
+            if (!bytes)
+                continue;
+            while (*bytes)
+                hash = (hash ^ *bytes++) * 16777619u;
+            hash = (hash ^ 0) * 16777619u;
+            continue;
+        }
+        size = (type == 'v') ? sizeof(void*) : mapper_type_size(type);
+        bytes = (const unsigned char*)value + i * size;
+        while (size--)
+            hash = (hash ^ *bytes++) * 16777619u;
+    }
+    return hash;
+}
+
+static mapper_table record_props(int type, void *record)
+{
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:    return ((mapper_device)record)->props;
+        case MAPPER_OBJ_SIGNALS:    return ((mapper_signal)record)->props;
+        case MAPPER_OBJ_MAPS:       return ((mapper_map)record)->props;
+        default:                    return 0;
+    }
+}
+
+static int revision_slot(int type)
+{
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:    return 0;
+        case MAPPER_OBJ_SIGNALS:    return 1;
+        case MAPPER_OBJ_LINKS:      return 2;
+        default:                    return 3;
+    }
+}
+
+const uint32_t *mapper_database_revision(mapper_database db, int type)
+{
+    return &db->revisions[revision_slot(type)];
+}
+
+/* Find the position of a serial number in a group, which is kept in
+ * descending order since newer records come first in the database. */
+static int group_position(mapper_index_group_t *group, uint32_t serial)
+{
+    int lo = 0, hi = group->num_records, mid;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (group->serials[mid] > serial)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int record_group(mapper_index idx, void *record)
+{
+    int length;
+    char type;
+    const void *value;
+    if (index_property(idx->type, record, idx->name, &length, &type, &value)
+        || !value)
+        return -1;
+    return hash_value(length, type, value) & (idx->size - 1);
+}
+
+static void index_record(mapper_index idx, void *record)
+{
+    int i = record_group(idx, record);
+    if (i < 0)
+        return;
+    if (idx->num_records >= idx->size * 2) {
+        // rebuild with more groups when next used
+        idx->built = 0;
+        return;
+    }
+    mapper_index_group_t *group = &idx->groups[i];
+    if (group->num_records >= group->alloced) {
+        group->alloced = group->alloced ? group->alloced * 2 : 4;
+        group->records = realloc(group->records,
+                                 sizeof(void*) * group->alloced);
+        group->serials = realloc(group->serials,
+                                 sizeof(uint32_t) * group->alloced);
+    }
+    uint32_t serial = record_props(idx->type, record)->serial;
+    int pos = group_position(group, serial), num = group->num_records - pos;
+    if (num && group->records[pos] == record)
+        return;
+    memmove(&group->records[pos + 1], &group->records[pos],
+            sizeof(void*) * num);
+    memmove(&group->serials[pos + 1], &group->serials[pos],
+            sizeof(uint32_t) * num);
+    group->records[pos] = record;
+    group->serials[pos] = serial;
+    ++group->num_records;
+    ++idx->num_records;
+}
+
+static void unindex_record(mapper_index idx, void *record)
+{
+    int i = record_group(idx, record);
+    if (i < 0)
+        return;
+    mapper_index_group_t *group = &idx->groups[i];
+    int pos = group_position(group, record_props(idx->type, record)->serial);
+    if (pos >= group->num_records || group->records[pos] != record)
+        return;
+    int num = group->num_records - pos - 1;
+    memmove(&group->records[pos], &group->records[pos + 1],
+            sizeof(void*) * num);
+    memmove(&group->serials[pos], &group->serials[pos + 1],
+            sizeof(uint32_t) * num);
+    --group->num_records;
+    --idx->num_records;
+}
+
+static void free_index_groups(mapper_index idx)
+{
+    int i;
+    for (i = 0; i < idx->size; i++) {
+        if (idx->groups[i].records) {
+            free(idx->groups[i].records);
+            free(idx->groups[i].serials);
+        }
+    }
+    if (idx->groups)
+        free(idx->groups);
+    idx->groups = 0;
+    idx->size = idx->num_records = 0;
+}
+
+static void build_index(mapper_database db, mapper_index idx)
+{
+    int count = 0;
+    void *record, *list = index_list(db, idx->type);
+    for (record = list; record; record = mapper_list_next(record))
+        ++count;
+
+    free_index_groups(idx);
+    idx->size = 16;
+    while (idx->size < count)
+        idx->size <<= 1;
+    idx->groups = calloc(idx->size, sizeof(mapper_index_group_t));
+
+    // records are added in database order, so each is appended to its group
+    for (record = list; record; record = mapper_list_next(record))
+        index_record(idx, record);
+    idx->built = 1;
+}
+
+static mapper_index find_index(mapper_database db, int type, const char *name)
+{
+    mapper_index idx = db->indexes;
+    while (idx) {
+        if (idx->type == type && strcmp(idx->name, name) == 0)
+            return idx;
+        idx = idx->next;
+    }
+    return 0;
+}
+
+void mapper_database_add_record(mapper_database db, int type, void *record,
+                                mapper_table props)
+{
+    props->db = db;
+    props->owner = record;
+    props->owner_type = type;
+    props->serial = ++db->serial;
+    ++db->revisions[revision_slot(type)];
+
+    mapper_index idx;
+    for (idx = db->indexes; idx; idx = idx->next) {
+        if (idx->built && idx->type == type)
+            index_record(idx, record);
+    }
+}
+
+void mapper_database_remove_record(mapper_table props)
+{
+    mapper_database db = props->db;
+    if (!db)
+        return;
+    ++db->revisions[revision_slot(props->owner_type)];
+
+    mapper_index idx;
+    for (idx = db->indexes; idx; idx = idx->next) {
+        if (idx->built && idx->type == props->owner_type)
+            unindex_record(idx, props->owner);
+    }
+    props->db = 0;
+}
+
+static int index_matches(mapper_index idx, mapper_property_t index,
+                         const char *key)
+{
+    index = MASK_PROP_BITFLAGS(index);
+    if (idx->property != AT_EXTRA || index != AT_EXTRA)
+        return index == idx->property;
+    if (!key)
+        return 0;
+    const char *name = idx->name;
+    if (key[0] == '@')
+        ++key;
+    if (name[0] == '@')
+        ++name;
+    return strcmp(key, name) == 0;
+}
+
+static void update_indexes(mapper_table props, mapper_property_t index,
+                           const char *key, int add)
+{
+    mapper_database db = props->db;
+    mapper_index idx;
+    mapper_signal sig;
+    for (idx = db->indexes; idx; idx = idx->next) {
+        if (!idx->built)
+            continue;
+        if (idx->type == props->owner_type && index_matches(idx, index, key)) {
+            if (add)
+                index_record(idx, props->owner);
+            else
+                unindex_record(idx, props->owner);
+        }
+        else if (   props->owner_type == MAPPER_OBJ_DEVICES
+                 && idx->type == MAPPER_OBJ_SIGNALS
+                 && MASK_PROP_BITFLAGS(index) == AT_ID
+                 && strcmp(idx->name, "device") == 0) {
+            // signals are also indexed by the id of their device
+            for (sig = db->signals; sig; sig = mapper_list_next(sig)) {
+                if (sig->device != props->owner)
+                    continue;
+                if (add)
+                    index_record(idx, sig);
+                else
+                    unindex_record(idx, sig);
+            }
+        }
+    }
+}
+
+void mapper_database_unindex_property(mapper_table props,
+                                      mapper_property_t index, const char *key)
+{
+    if (props->db)
+        update_indexes(props, index, key, 0);
+}
+
+void mapper_database_index_property(mapper_table props,
+                                    mapper_property_t index, const char *key)
+{
+    if (!props->db)
+        return;
+    update_indexes(props, index, key, 1);
+    ++props->db->revisions[revision_slot(props->owner_type)];
+}
+
+int mapper_database_index_lookup(mapper_database db, int type,
+                                 const char *name, int length, char vtype,
+                                 const void *value, void ***candidates)
+{
+    mapper_index idx = find_index(db, type, name);
+    if (!idx)
+        return -1;
+    if (!idx->built)
+        build_index(db, idx);
+    mapper_index_group_t *group;
+    group = &idx->groups[hash_value(length, vtype, value) & (idx->size - 1)];
+    *candidates = group->records;
+    return group->num_records;
+}
+
+int mapper_database_add_index(mapper_database db, mapper_object_type type,
+                              const char *name)
+{
+    int i;
+    if (!db || !name)
+        return 1;
+    if (   type != MAPPER_OBJ_DEVICES && type != MAPPER_OBJ_SIGNALS
+        && type != MAPPER_OBJ_MAPS)
+        return 1;
+    if (strncmp(name, "num_", 4) == 0)
+        return 1;
+    for (i = 0; unindexable_properties[i]; i++) {
+        if (strcmp(name, unindexable_properties[i]) == 0)
+            return 1;
+    }
+    if (find_index(db, type, name))
+        return 0;
+    mapper_index idx = (mapper_index)calloc(1, sizeof(mapper_index_t));
+    idx->name = strdup(name);
+    idx->property = mapper_property_from_string(name);
+    idx->type = type;
+    idx->next = db->indexes;
+    db->indexes = idx;
+    return 0;
+}
+
+void mapper_database_remove_index(mapper_database db, mapper_object_type type,
+                                  const char *name)
+{
+    if (!db || !name)
+        return;
+    mapper_index *idx = &db->indexes;
+    while (*idx) {
+        if ((*idx)->type == type && strcmp((*idx)->name, name) == 0) {
+            mapper_index temp = *idx;
+            *idx = temp->next;
+            free(temp->name);
+            free_index_groups(temp);
+            free(temp);
+            return;
+        }
+        idx = &(*idx)->next;
+    }
+}
+
 static int cmp_query_devices_by_property(const void *context_data,
                                          mapper_device dev)
 {
@@ -420,7 +804,7 @@ static int cmp_query_devices_by_property(const void *context_data,
         return 0;
     if (_type != type || _length != length)
         return 0;
-    return compare_value(op, length, type, _value, value);
+    return mapper_compare_value(op, length, type, _value, value);
 }
 
 mapper_device *mapper_database_devices_by_property(mapper_database db,
@@ -432,6 +816,21 @@ mapper_device *mapper_database_devices_by_property(mapper_database db,
         return 0;
     if (op <= MAPPER_OP_UNDEFINED || op >= NUM_MAPPER_OPS)
         return 0;
+    if (op == MAPPER_OP_EQUAL) {
+        void **candidates;
+        int num = mapper_database_index_lookup(db, MAPPER_OBJ_DEVICES, name,
+                                               length, type, value,
+                                               &candidates);
+        if (num >= 0)
+            return ((mapper_device *)
+                    mapper_list_new_indexed_query(db->devices,
+                                                  mapper_database_revision(
+                                                      db, MAPPER_OBJ_DEVICES),
+                                                  candidates, num,
+                                                  cmp_query_devices_by_property,
+                                                  "iicvs", op, length, type,
+                                                  &value, name));
+    }
     return ((mapper_device *)
             mapper_list_new_query(db->devices, cmp_query_devices_by_property,
                                   "iicvs", op, length, type, &value, name));
@@ -451,6 +850,14 @@ void mapper_database_remove_device_callback(mapper_database db,
     remove_callback(&db->device_callbacks, h, user);
 }
 
+/* Devices announcing /sync less often than the default are given longer to
+ * check in before they are considered unresponsive. */
+static uint32_t sync_grace(mapper_device dev)
+{
+    int mean = SYNC_INTERVAL_SEC + SYNC_JITTER_SEC / 2;
+    return dev->sync_interval > mean ? dev->sync_interval - mean : 0;
+}
+
 void mapper_database_check_device_status(mapper_database db, uint32_t time_sec)
 {
     time_sec -= db->timeout_sec;
@@ -458,7 +865,9 @@ void mapper_database_check_device_status(mapper_database db, uint32_t time_sec)
     while (dev) {
         // check if device has "checked in" recently
         // this could be /sync ping or any sent metadata
-        if (dev->synced.sec && (dev->synced.sec < time_sec)) {
+        if (dev->synced.sec && (dev->synced.sec + sync_grace(dev) < time_sec)) {
+            mapper_database_log_change(db, MAPPER_OBJ_DEVICES, dev->id,
+                                       MAPPER_EXPIRED);
             fptr_list cb = db->device_callbacks;
             while (cb) {
                 mapper_database_device_handler *h = cb->f;
@@ -475,7 +884,8 @@ mapper_device mapper_database_expired_device(mapper_database db,
 {
     mapper_device dev = db->devices;
     while (dev) {
-        if (dev->synced.sec && (dev->synced.sec < last_ping)) {
+        if (dev->synced.sec
+            && (dev->synced.sec + sync_grace(dev) < last_ping)) {
             return dev;
         }
         dev = mapper_list_next(dev);
@@ -525,6 +935,8 @@ mapper_signal mapper_database_add_or_update_signal(mapper_database db,
                      device_name, name);
 
         if (sig_rc || updated) {
+            mapper_database_log_change(db, MAPPER_OBJ_SIGNALS, sig->id,
+                                       sig_rc ? MAPPER_ADDED : MAPPER_MODIFIED);
             // TODO: Should we really allow callbacks to free themselves?
             fptr_list cb = db->signal_callbacks, temp;
             while (cb) {
@@ -574,6 +986,19 @@ mapper_signal *mapper_database_signals(mapper_database db, mapper_direction dir)
 {
     if (dir == MAPPER_DIR_ANY)
         return mapper_list_from_data(db->signals);
+    if (dir == MAPPER_DIR_INCOMING || dir == MAPPER_DIR_OUTGOING) {
+        void **candidates;
+        int num = mapper_database_index_lookup(db, MAPPER_OBJ_SIGNALS,
+                                               "direction", 1, 'i', &dir,
+                                               &candidates);
+        if (num >= 0)
+            return ((mapper_signal *)
+                    mapper_list_new_indexed_query(db->signals,
+                                                  mapper_database_revision(
+                                                      db, MAPPER_OBJ_SIGNALS),
+                                                  candidates, num,
+                                                  cmp_query_signals, "i", dir));
+    }
     return ((mapper_signal *)
             mapper_list_new_query(db->signals, cmp_query_signals, "i", dir));
 }
@@ -597,7 +1022,7 @@ static int cmp_query_signals_by_name(const void *context_data,
 {
     int dir = *(int*)context_data;
     const char *name = (const char*)(context_data + sizeof(int));
-    return ((dir & sig->direction) && (match_pattern(sig->name, name)));
+    return ((dir & sig->direction) && (mapper_match_pattern(sig->name, name)));
 }
 
 mapper_signal *mapper_database_signals_by_name(mapper_database db,
@@ -628,7 +1053,7 @@ static int cmp_query_signals_by_property(const void *context_data,
         return 0;
     if (_type != type || _length != length)
         return 0;
-    return compare_value(op, length, type, _value, value);
+    return mapper_compare_value(op, length, type, _value, value);
 }
 
 mapper_signal *mapper_database_signals_by_property(mapper_database db,
@@ -640,6 +1065,22 @@ mapper_signal *mapper_database_signals_by_property(mapper_database db,
         return 0;
     if (op <= MAPPER_OP_UNDEFINED || op >= NUM_MAPPER_OPS)
         return 0;
+    // the "device" index holds device ids rather than property values
+    if (op == MAPPER_OP_EQUAL && strcmp(name, "device")) {
+        void **candidates;
+        int num = mapper_database_index_lookup(db, MAPPER_OBJ_SIGNALS, name,
+                                               length, type, value,
+                                               &candidates);
+        if (num >= 0)
+            return ((mapper_signal *)
+                    mapper_list_new_indexed_query(db->signals,
+                                                  mapper_database_revision(
+                                                      db, MAPPER_OBJ_SIGNALS),
+                                                  candidates, num,
+                                                  cmp_query_signals_by_property,
+                                                  "iicvs", op, length, type,
+                                                  &value, name));
+    }
     return ((mapper_signal *)
             mapper_list_new_query(db->signals, cmp_query_signals_by_property,
                                   "iicvs", op, length, type, &value, name));
@@ -648,13 +1089,18 @@ mapper_signal *mapper_database_signals_by_property(mapper_database db,
 void mapper_database_remove_signal(mapper_database db, mapper_signal sig,
                                    mapper_record_event event)
 {
+    if (sig->local)
+        mapper_network_forget_object(db->network, sig);
+
     // remove any stored maps using this signal
     mapper_database_remove_maps_by_query(db,
                                          mapper_signal_maps(sig, MAPPER_DIR_ANY),
                                          event);
 
+    mapper_database_remove_record(sig->props);
     mapper_list_remove_item((void**)&db->signals, sig);
 
+    mapper_database_log_change(db, MAPPER_OBJ_SIGNALS, sig->id, event);
     fptr_list cb = db->signal_callbacks;
     while (cb) {
         mapper_database_signal_handler *h = cb->f;
@@ -692,6 +1138,7 @@ static void mapper_database_call_link_handlers(mapper_database db,
     if (!db || !link)
         return;
 
+    mapper_database_log_change(db, MAPPER_OBJ_LINKS, link->id, event);
     fptr_list cb = db->link_callbacks, temp;
     while (cb) {
         temp = cb->next;
@@ -818,7 +1265,7 @@ static int cmp_query_links_by_property(const void *context_data, mapper_link lin
         return 0;
     if (_type != type || _length != length)
         return 0;
-    return compare_value(op, length, type, _value, value);
+    return mapper_compare_value(op, length, type, _value, value);
 }
 
 mapper_link *mapper_database_links_by_property(mapper_database db,
@@ -854,8 +1301,10 @@ void mapper_database_remove_link(mapper_database db, mapper_link link,
 
     mapper_database_remove_maps_by_query(db, mapper_link_maps(link), event);
 
+    mapper_database_remove_record(link->props);
     mapper_list_remove_item((void**)&db->links, link);
 
+    mapper_database_log_change(db, MAPPER_OBJ_LINKS, link->id, event);
     fptr_list cb = db->link_callbacks;
     while (cb) {
         mapper_database_link_handler *h = cb->f;
@@ -969,6 +1418,7 @@ mapper_map mapper_database_add_or_update_map(mapper_database db, int num_sources
                                                sizeof(mapper_map_t));
         map->database = db;
         map->id = id;
+        mapper_database_index_map(db, map);
         map->num_sources = num_sources;
         map->sources = (mapper_slot*) malloc(sizeof(mapper_slot) * num_sources);
         for (i = 0; i < num_sources; i++) {
@@ -1064,6 +1514,8 @@ mapper_map mapper_database_add_or_update_map(mapper_database db, int num_sources
         if (map->status < STATUS_ACTIVE)
             return map;
         if (rc || updated) {
+            mapper_database_log_change(db, MAPPER_OBJ_MAPS, map->id,
+                                       rc ? MAPPER_ADDED : MAPPER_MODIFIED);
             fptr_list cb = db->map_callbacks;
             while (cb) {
                 mapper_database_map_handler *h = cb->f;
@@ -1106,13 +1558,79 @@ mapper_map *mapper_database_maps(mapper_database db)
     return mapper_list_from_data(db->maps);
 }
 
+/* Maps are also kept in a hash table keyed by id, since most map messages
+ * refer to maps by id. */
+#define MAP_INDEX_MIN_SIZE 64
+
+static int map_id_bucket(mapper_database db, mapper_id id)
+{
+    uint64_t hash = id * 0x9E3779B97F4A7C15ULL;
+    return (int)(hash >> 32) & (db->map_index_size - 1);
+}
+
+static void unindex_map(mapper_database db, mapper_map map)
+{
+    if (!map->is_indexed || !db->map_index)
+        return;
+    mapper_map *m = &db->map_index[map_id_bucket(db, map->indexed_id)];
+    while (*m && *m != map)
+        m = &(*m)->next_by_id;
+    if (*m)
+        *m = map->next_by_id;
+    map->next_by_id = 0;
+    map->is_indexed = 0;
+    if (--db->num_indexed_maps <= 0) {
+        free(db->map_index);
+        db->map_index = 0;
+        db->map_index_size = db->num_indexed_maps = 0;
+    }
+}
+
+static void insert_map_id(mapper_database db, mapper_map map)
+{
+    int bucket = map_id_bucket(db, map->id);
+    map->next_by_id = db->map_index[bucket];
+    db->map_index[bucket] = map;
+    map->indexed_id = map->id;
+    map->is_indexed = 1;
+}
+
+void mapper_database_index_map(mapper_database db, mapper_map map)
+{
+    if (map->is_indexed) {
+        if (map->indexed_id == map->id)
+            return;
+        unindex_map(db, map);
+    }
+    if (db->num_indexed_maps >= db->map_index_size) {
+        // grow the table and rehash the indexed maps
+        int i, size = db->map_index_size;
+        mapper_map *old = db->map_index, next;
+        db->map_index_size = size ? size * 2 : MAP_INDEX_MIN_SIZE;
+        db->map_index = calloc(db->map_index_size, sizeof(mapper_map));
+        for (i = 0; i < size; i++) {
+            while (old[i]) {
+                next = old[i]->next_by_id;
+                insert_map_id(db, old[i]);
+                old[i] = next;
+            }
+        }
+        if (old)
+            free(old);
+    }
+    insert_map_id(db, map);
+    ++db->num_indexed_maps;
+}
+
 mapper_map mapper_database_map_by_id(mapper_database db, mapper_id id)
 {
-    mapper_map map = db->maps;
+    if (!db->map_index)
+        return 0;
+    mapper_map map = db->map_index[map_id_bucket(db, id)];
     while (map) {
         if (map->id == id)
             return map;
-        map = mapper_list_next(map);
+        map = map->next_by_id;
     }
     return 0;
 }
@@ -1157,7 +1675,7 @@ static int cmp_query_maps_by_property(const void *context_data, mapper_map map)
         return 0;
     if (_type != type || _length != length)
         return 0;
-    return compare_value(op, length, type, _value, value);
+    return mapper_compare_value(op, length, type, _value, value);
 }
 
 mapper_map *mapper_database_maps_by_property(mapper_database db,
@@ -1169,6 +1687,21 @@ mapper_map *mapper_database_maps_by_property(mapper_database db,
         return 0;
     if (op <= MAPPER_OP_UNDEFINED || op >= NUM_MAPPER_OPS)
         return 0;
+    if (op == MAPPER_OP_EQUAL) {
+        void **candidates;
+        int num = mapper_database_index_lookup(db, MAPPER_OBJ_MAPS, name,
+                                               length, type, value,
+                                               &candidates);
+        if (num >= 0)
+            return ((mapper_map *)
+                    mapper_list_new_indexed_query(db->maps,
+                                                  mapper_database_revision(
+                                                      db, MAPPER_OBJ_MAPS),
+                                                  candidates, num,
+                                                  cmp_query_maps_by_property,
+                                                  "iicvs", op, length, type,
+                                                  &value, name));
+    }
     return ((mapper_map *)
             mapper_list_new_query(db->maps, cmp_query_maps_by_property,
                                   "iicvs", op, length, type, &value, name));
@@ -1186,14 +1719,14 @@ static int cmp_query_maps_by_slot_property(const void *context_data,
     // check destination slot
     if (!mapper_slot_property(&map->destination, name, &length2, &type2, &value2)
         && type1 == type2 && length1 == length2
-        && compare_value(op, length1, type1, value2, value1)) {
+        && mapper_compare_value(op, length1, type1, value2, value1)) {
         return 1;
     }
     // check source slots
     for (i = 0; i < map->num_sources; i++) {
         if (!mapper_slot_property(map->sources[i], name, &length2, &type2, &value2)
             && type1 == type2 && length1 == length2
-            && compare_value(op, length1, type1, value2, value1))
+            && mapper_compare_value(op, length1, type1, value2, value1))
             return 1;
     }
     return 0;
@@ -1213,6 +1746,25 @@ mapper_map *mapper_database_maps_by_slot_property(mapper_database db,
                                   "iicvs", op, length, type, &value, name));
 }
 
+void mapper_database_begin_transaction(mapper_database db)
+{
+    if (!db)
+        return;
+    if (!db->transaction_depth++)
+        db->transaction_count = 0;
+    mapper_network_begin_batch(db->network);
+}
+
+int mapper_database_commit_transaction(mapper_database db)
+{
+    if (!db || !db->transaction_depth)
+        return 0;
+    mapper_network_end_batch(db->network);
+    if (--db->transaction_depth)
+        return 0;
+    return db->transaction_count;
+}
+
 void mapper_database_remove_maps_by_query(mapper_database db, mapper_map *maps,
                                           mapper_record_event event)
 {
@@ -1228,9 +1780,14 @@ void mapper_database_remove_map(mapper_database db, mapper_map map,
 {
     if (!map)
         return;
+    if (map->local)
+        mapper_network_forget_object(db->network, map);
 
+    mapper_database_remove_record(map->props);
     mapper_list_remove_item((void**)&db->maps, map);
+    unindex_map(db, map);
 
+    mapper_database_log_change(db, MAPPER_OBJ_MAPS, map->id, event);
     fptr_list cb = db->map_callbacks;
     while (cb) {
         mapper_database_map_handler *h = cb->f;
@@ -1316,7 +1873,7 @@ static void set_network_dest(mapper_database db, mapper_device dev)
 }
 
 static void subscribe_internal(mapper_database db, mapper_device dev, int flags,
-                               int timeout)
+                               int timeout, mapper_subscription_filter filter)
 {
     char cmd[1024];
     snprintf(cmd, 1024, "/%s/subscribe", dev->name);
@@ -1360,6 +1917,8 @@ static void subscribe_internal(mapper_database db, mapper_device dev, int flags,
         lo_message_add_string(msg, "@version");
         lo_message_add_int32(msg, dev->version);
 
+        mapper_subscription_filter_add_to_message(filter, msg);
+
         mapper_network_add_message(db->network, cmd, 0, msg);
         mapper_network_send(db->network);
     }
@@ -1388,6 +1947,7 @@ static void unsubscribe_internal(mapper_database db, mapper_device dev,
             (*s)->device->subscribed = 0;
             mapper_subscription temp = *s;
             *s = temp->next;
+            mapper_subscription_filter_free(temp->filter);
             free(temp);
             return;
         }
@@ -1404,7 +1964,8 @@ static void renew_subscriptions(mapper_database db, uint32_t time_sec)
             trace_db("automatically renewing subscription to %s for %d "
                      "seconds.\n", mapper_device_name(s->device),
                      AUTOSUBSCRIBE_INTERVAL);
-            subscribe_internal(db, s->device, s->flags, AUTOSUBSCRIBE_INTERVAL);
+            subscribe_internal(db, s->device, s->flags, AUTOSUBSCRIBE_INTERVAL,
+                               s->filter);
             // leave 10-second buffer for subscription renewal
             s->lease_expiration_sec = (time_sec + AUTOSUBSCRIBE_INTERVAL - 10);
         }
@@ -1421,6 +1982,7 @@ int mapper_database_poll(mapper_database db, int block_ms)
     if (!block_ms) {
         count = mapper_network_poll(net, 1);
         net->msgs_recvd += count;
+        mapper_database_publish_snapshot(db);
         return count;
     }
 
@@ -1485,6 +2047,7 @@ int mapper_database_poll(mapper_database db, int block_ms)
     }
 
     net->msgs_recvd += count;
+    mapper_database_publish_snapshot(db);
     return count;
 }
 
@@ -1509,7 +2072,8 @@ static void mapper_database_autosubscribe(mapper_database db, int flags)
             trace_db("adjusting flags for existing autorenewing subscription "
                      "to %s.\n", mapper_device_name(s->device));
             if (flags & ~s->flags) {
-                subscribe_internal(db, s->device, flags, AUTOSUBSCRIBE_INTERVAL);
+                subscribe_internal(db, s->device, flags, AUTOSUBSCRIBE_INTERVAL,
+                                   s->filter);
                 // leave 10-second buffer for subscription renewal
                 s->lease_expiration_sec = (tt.sec + AUTOSUBSCRIBE_INTERVAL - 10);
             }
@@ -1541,8 +2105,20 @@ static mapper_subscription subscription(mapper_database db, mapper_device dev)
 
 void mapper_database_subscribe(mapper_database db, mapper_device dev, int flags,
                                int timeout)
+{
+    mapper_database_subscribe_filtered(db, dev, flags, timeout, 0);
+}
+
+void mapper_database_subscribe_filtered(mapper_database db, mapper_device dev,
+                                        int flags, int timeout,
+                                        mapper_subscription_filter filter)
 {
     if (!dev) {
+        if (filter) {
+            trace_db("aborting subscription, filters cannot be used when "
+                     "autosubscribing.\n");
+            return;
+        }
         mapper_database_autosubscribe(db, flags);
         return;
     }
@@ -1564,13 +2140,19 @@ void mapper_database_subscribe(mapper_database db, mapper_device dev, int flags,
             s = malloc(sizeof(struct _mapper_subscription));
             s->device = dev;
             s->device->version = -1;
+            s->filter = 0;
             s->next = db->subscriptions;
             db->subscriptions = s;
         }
-        else if (s->flags != flags)
+        else if (s->flags != flags
+                 || !mapper_subscription_filter_equal(s->filter, filter))
             s->device->version = -1;
 
         s->flags = flags;
+        if (s->filter != filter) {
+            mapper_subscription_filter_free(s->filter);
+            s->filter = mapper_subscription_filter_copy(filter);
+        }
 
         mapper_timetag_t tt;
         mapper_timetag_now(&tt);
@@ -1584,7 +2166,7 @@ void mapper_database_subscribe(mapper_database db, mapper_device dev, int flags,
                  "with flags %d.\n", timeout, mapper_device_name(dev), flags);
     }
 
-    subscribe_internal(db, dev, flags, timeout);
+    subscribe_internal(db, dev, flags, timeout, filter);
 }
 
 void mapper_database_unsubscribe(mapper_database db, mapper_device dev)
@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h>
+#include <math.h>
 #include <unistd.h>
 #include <assert.h>
 #include <sys/time.h>
@@ -20,6 +21,22 @@
 
 extern const char* network_message_strings[NUM_MSG_STRINGS];
 
+static void close_queue(mapper_queue queue, int send);
+
+/* Local devices in this process, used for direct delivery of updates. Since
+ * devices may be polled from different threads, the list, the peers of local
+ * links and the direct delivery queues are protected by a single lock. */
+static mapper_device devices_in_process = 0;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t direct_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lock_direct() pthread_mutex_lock(&direct_lock)
+#define unlock_direct() pthread_mutex_unlock(&direct_lock)
+#else
+#define lock_direct()
+#define unlock_direct()
+#endif
+
 void init_device_prop_table(mapper_device dev)
 {
     dev->props = mapper_table_new();
@@ -66,6 +83,9 @@ void init_device_prop_table(mapper_device dev)
     }
     mapper_table_set_record(dev->props, AT_IS_LOCAL, NULL, 1, 'b', &dev->local,
                             LOCAL_ACCESS_ONLY | NON_MODIFIABLE);
+
+    mapper_database_add_record(dev->database, MAPPER_OBJ_DEVICES, dev,
+                               dev->props);
 }
 
 /*! Allocate and initialize a mapper device. This function is called to create
@@ -88,6 +108,7 @@ mapper_device mapper_device_new(const char *name_prefix, int port,
     dev->database = db;
     dev->local = (mapper_local_device)calloc(1, sizeof(mapper_local_device_t));
     dev->local->own_network = 1 - net->own_network;
+    dev->local->streams.fd = -1;
 
     init_device_prop_table(dev);
 
@@ -118,13 +139,36 @@ mapper_device mapper_device_new(const char *name_prefix, int port,
     dev->local->active_id_maps[0] = 0;
     dev->local->num_signal_groups = 1;
 
+    dev->local->direct_delivery = 1;
+
     mapper_network_add_device(net, dev);
 
+    lock_direct();
+    dev->local->next_in_process = devices_in_process;
+    devices_in_process = dev;
+    unlock_direct();
+
     dev->status = STATUS_STAGED;
 
     return dev;
 }
 
+/* Stop other local devices passing updates directly to a device that is
+ * being freed. Their links may still refer to it, so the list is checked
+ * before each delivery. */
+static void remove_from_process(mapper_device dev)
+{
+    mapper_device *prev;
+    lock_direct();
+    prev = &devices_in_process;
+    while (*prev && *prev != dev)
+        prev = &(*prev)->local->next_in_process;
+    if (*prev)
+        *prev = dev->local->next_in_process;
+    mapper_direct_queue_free(&dev->local->direct);
+    unlock_direct();
+}
+
 //! Free resources used by a mapper device.
 void mapper_device_free(mapper_device dev)
 {
@@ -138,15 +182,22 @@ void mapper_device_free(mapper_device dev)
     mapper_database db = dev->database;
     mapper_network net = dev->database->network;
 
+    remove_from_process(dev);
+
     // free any queued outgoing messages without sending
     mapper_network_free_messages(net);
 
+    // discard any open queues
+    while (dev->local->queues)
+        close_queue(dev->local->queues, 0);
+
     // remove subscribers
     mapper_subscriber s;
     while (dev->local->subscribers) {
         s = dev->local->subscribers;
         if (s->address)
             lo_address_free(s->address);
+        mapper_subscription_filter_free(s->filter);
         dev->local->subscribers = s->next;
         free(s);
     }
@@ -214,6 +265,14 @@ void mapper_device_free(mapper_device dev)
 
     int own_network = dev->local->own_network;
 
+    mapper_scheduler_free(&dev->local->scheduler);
+
+    if (dev->local->shm)
+        mapper_shm_free(dev->local->shm);
+    mapper_stream_server_free(&dev->local->streams);
+    if (dev->local->aliases)
+        free(dev->local->aliases);
+
     if (dev->local->server)
         lo_server_free(dev->local->server);
     free(dev->local);
@@ -292,6 +351,10 @@ void mapper_device_registered(mapper_device dev)
     }
     dev->local->registered = 1;
     dev->status = STATUS_READY;
+
+    // devices on the same host can send updates through shared memory
+    if (!dev->local->shm)
+        dev->local->shm = mapper_shm_create(mapper_device_port(dev), dev->id);
 }
 
 static void mapper_device_increment_version(mapper_device dev)
@@ -320,6 +383,329 @@ static int check_types(const char *types, int len, char type, int vector_len)
     return len / vector_len;
 }
 
+/* Update receive statistics for the map and link an update arrived through. */
+static void record_received(mapper_device dev, mapper_map map, mapper_link link,
+                            const char *path, lo_message msg)
+{
+    mapper_local_stats map_stats = map ? map->local->stats : 0;
+    mapper_local_stats link_stats = (link && link->local) ? link->local->stats : 0;
+    if (!map_stats && !link_stats)
+        return;
+    size_t len = lo_message_length(msg, path);
+    mapper_stats_count(map_stats, received, 1);
+    mapper_stats_count(map_stats, bytes_received, len);
+    mapper_stats_count(link_stats, received, 1);
+    mapper_stats_count(link_stats, bytes_received, len);
+    mapper_direct_update direct = dev->local->direct.dispatching;
+    mapper_stats_record_latency(map_stats, link,
+                                direct ? direct->timetag
+                                : lo_message_get_timestamp(msg));
+}
+
+/* If scheduling is enabled, hold updates with future timetags until they are
+ * due. The timetag is converted to local time using the clock offset of the
+ * link the update arrived through; if the link cannot be determined (e.g. an
+ * input with several incoming maps) the timetag is used as-is.
+ * Returns non-zero if the update has been scheduled. */
+static int schedule_update(mapper_device dev, mapper_signal sig,
+                           int alias_slot, const char *path, lo_message msg,
+                           mapper_timetag_t tt, mapper_link link,
+                           mapper_local_stats stats)
+{
+    mapper_local_stats link_stats = (link && link->local) ? link->local->stats : 0;
+
+    if (tt.sec == 0 && tt.frac == 1) {
+        // MAPPER_NOW carries no timing information
+        return 0;
+    }
+
+    mapper_timetag_t due = tt, now;
+    if (link && link->local && link->remote_device != link->local_device
+        && !link->local->clock.new) {
+        mapper_timetag_add_double(&due, mapper_sync_clock_offset(&link->local->clock,
+                                                                 0));
+    }
+    mapper_timetag_now(&now);
+    double lead = mapper_timetag_difference(due, now);
+    if (lead <= SCHEDULER_TOLERANCE) {
+        if (lead < -SCHEDULER_TOLERANCE) {
+            mapper_stats_count(stats, late, 1);
+            mapper_stats_count(link_stats, late, 1);
+        }
+        return 0;
+    }
+
+    // copy the message since liblo will free it after dispatch
+    size_t size;
+    void *data = lo_message_serialise(msg, path, 0, &size);
+    if (!data)
+        return 0;
+    lo_message copy = lo_message_deserialise(data, size, 0);
+    free(data);
+    if (!copy)
+        return 0;
+    if (mapper_scheduler_push(&dev->local->scheduler, due, tt, sig, alias_slot,
+                              copy)) {
+        lo_message_free(copy);
+        return 0;
+    }
+    mapper_stats_count(stats, scheduled, 1);
+    mapper_stats_count(link_stats, scheduled, 1);
+    return 1;
+}
+
+/* Record how far from its due time a scheduled update was delivered. */
+static void record_schedule_error(mapper_local_stats stats, mapper_link link,
+                                  mapper_timetag_t due)
+{
+    mapper_local_stats link_stats = (link && link->local) ? link->local->stats : 0;
+    if (!stats && !link_stats)
+        return;
+    mapper_timetag_t now;
+    mapper_timetag_now(&now);
+    double error = fabs(mapper_timetag_difference(now, due));
+    mapper_stats_record(stats, MAPPER_STAT_SCHEDULE_ERROR, error * 1e9);
+    mapper_stats_record(link_stats, MAPPER_STAT_SCHEDULE_ERROR, error * 1e9);
+}
+
+/* Pass a received value to the update handler of a signal. If the signal
+ * coalesces its callbacks, the value is already stored in the instance, so
+ * the instance is only marked until the device is next polled. */
+static void call_update_handler(mapper_device dev, mapper_signal sig,
+                                mapper_signal_instance si, mapper_id id,
+                                const void *value, int count,
+                                mapper_timetag_t *tt)
+{
+    mapper_signal_update_handler *h = sig->local->update_handler;
+    if (sig->local->callback_mode == MAPPER_CALLBACK_COALESCE) {
+        if (value) {
+            si->is_dirty = 1;
+            if (!sig->local->is_dirty) {
+                sig->local->is_dirty = 1;
+                sig->local->next_dirty = dev->local->dirty_signals;
+                dev->local->dirty_signals = sig;
+            }
+            return;
+        }
+        // a release supersedes any value that is still waiting
+        si->is_dirty = 0;
+    }
+    if (h)
+        h(sig, id, value, count, tt);
+}
+
+/* Call the update handlers for instances with coalesced values. Returns the
+ * number of instances delivered. */
+static int dispatch_dirty(mapper_device dev)
+{
+    mapper_signal sig;
+    int i, num, count = 0;
+
+    while ((sig = dev->local->dirty_signals)) {
+        dev->local->dirty_signals = sig->local->next_dirty;
+        sig->local->next_dirty = 0;
+        sig->local->is_dirty = 0;
+
+        mapper_signal_update_handler *update_h = sig->local->update_handler;
+        mapper_signal_batch_handler *batch_h = sig->local->batch_handler;
+        mapper_id ids[sig->local->id_map_length];
+        for (i = 0, num = 0; i < sig->local->id_map_length; i++) {
+            mapper_signal_id_map_t *smap = &sig->local->id_maps[i];
+            mapper_signal_instance si = smap->instance;
+            if (!si || !si->is_dirty || !smap->map)
+                continue;
+            si->is_dirty = 0;
+            if (batch_h)
+                ids[num++] = smap->map->local;
+            else if (update_h) {
+                update_h(sig, smap->map->local, si->value, 1, &si->timetag);
+                ++num;
+            }
+        }
+        if (batch_h && num)
+            batch_h(sig, num, ids);
+        count += num;
+    }
+    return count;
+}
+
+/* Evaluate a map for one destination instance and copy the result into the
+ * instance value. Returns the number of elements updated, which is zero if the
+ * expression released the instance, or -1 if there is no output. */
+static int evaluate_map(mapper_map map, mapper_signal sig,
+                        mapper_signal_instance si, mapper_timetag_t *tt,
+                        mapper_local_stats stats)
+{
+    int j, vals = 0, id = si->index, size = mapper_type_size(sig->type);
+    char typestring[map->destination.signal->length];
+    uint64_t start = stats ? mapper_stats_now() : 0;
+    if (!mapper_map_evaluate(map, id, tt, typestring))
+        return -1;
+    // TODO: check if expression has triggered instance-release
+    if (mapper_boundary_perform(&map->destination.local->history[id],
+                                &map->destination, typestring)) {
+        mapper_stats_count(stats, dropped_muted, 1);
+        return -1;
+    }
+    if (stats)
+        mapper_stats_record(stats, MAPPER_STAT_EVAL_TIME,
+                            mapper_stats_now() - start);
+    void *result = mapper_history_value_ptr(map->destination.local->history[id]);
+    for (j = 0; j < map->destination.signal->length; j++) {
+        if (typestring[j] == 'N')
+            continue;
+        memcpy(si->value + j * size, result + j * size, size);
+        si->has_value_flags[j / 8] |= 1 << (j % 8);
+        ++vals;
+    }
+    return vals;
+}
+
+/* Get the convergence state of a map for a destination instance, or zero if
+ * source updates should be evaluated immediately. */
+static mapper_converge_state converge_state(mapper_map map, int id)
+{
+    mapper_local_map lmap = map->local;
+    if (lmap->convergence != MAPPER_CONVERGE_ALL || map->num_sources < 2)
+        return 0;
+    if (id >= lmap->num_converge_states) {
+        mapper_converge_state states = realloc(lmap->converge_states,
+                                               sizeof(mapper_converge_state_t)
+                                               * (id + 1));
+        if (!states)
+            return 0;
+        memset(states + lmap->num_converge_states, 0,
+               sizeof(mapper_converge_state_t)
+               * (id + 1 - lmap->num_converge_states));
+        lmap->converge_states = states;
+        lmap->num_converge_states = id + 1;
+    }
+    return &lmap->converge_states[id];
+}
+
+/* Hold a source update of a convergent map until the remaining sources have
+ * arrived. Returns 1 if the update is held, or 0 if every source has arrived
+ * and the map should be evaluated now. */
+static int converge(mapper_device dev, mapper_map map, mapper_slot slot,
+                    mapper_converge_state cs, int id_map_index,
+                    mapper_id global_id, mapper_timetag_t *tt)
+{
+    int i, first = !cs->arrived;
+    unsigned int expected = 0;
+    for (i = 0; i < map->num_sources; i++) {
+        if (map->sources[i] == slot)
+            cs->arrived |= 1 << i;
+        if (map->sources[i]->causes_update)
+            expected |= 1 << i;
+    }
+    if ((cs->arrived & expected) == expected) {
+        cs->arrived = 0;
+        return 0;
+    }
+    if (first) {
+        mapper_timetag_now(&cs->deadline);
+        mapper_timetag_add_double(&cs->deadline,
+                                  map->local->convergence_timeout);
+    }
+    memcpy(&cs->timetag, tt, sizeof(mapper_timetag_t));
+    cs->id_map_index = id_map_index;
+    cs->global_id = global_id;
+    mapper_stats_count(map->local->stats, converged, 1);
+    if (!map->local->is_converging) {
+        map->local->is_converging = 1;
+        map->local->next_converging = dev->local->converging_maps;
+        dev->local->converging_maps = map;
+    }
+    return 1;
+}
+
+/* Evaluate a convergent map with the source values that have arrived so far
+ * and deliver the result to the destination instance. */
+static void evaluate_converged(mapper_device dev, mapper_map map, int id,
+                               mapper_converge_state cs)
+{
+    mapper_signal sig = map->destination.signal;
+    cs->arrived = 0;
+    if (cs->id_map_index >= sig->local->id_map_length)
+        return;
+    mapper_signal_id_map_t *smap = &sig->local->id_maps[cs->id_map_index];
+    mapper_signal_instance si = smap->instance;
+    if (!si || si->index != id || !smap->map
+        || (smap->status & RELEASED_REMOTELY))
+        return;
+
+    int vals = evaluate_map(map, sig, si, &cs->timetag, map->local->stats);
+    if (vals < 0)
+        return;
+    if (vals == 0) {
+        if (cs->global_id) {
+            mapper_instance_event_handler *event_h;
+            event_h = sig->local->instance_event_handler;
+            smap->status |= RELEASED_REMOTELY;
+            --smap->map->refcount_global;
+            if (event_h && (sig->local->instance_event_flags
+                            & MAPPER_UPSTREAM_RELEASE)) {
+                event_h(sig, smap->map->local, MAPPER_UPSTREAM_RELEASE,
+                        &cs->timetag);
+            }
+        }
+        call_update_handler(dev, sig, si, smap->map->local, 0, 1, &cs->timetag);
+        return;
+    }
+    if (memcmp(si->has_value_flags, sig->local->has_complete_value,
+               sig->length / 8 + 1)==0) {
+        si->has_value = 1;
+    }
+    if (!si->has_value)
+        return;
+    memcpy(&si->timetag, &cs->timetag, sizeof(mapper_timetag_t));
+    if (!(sig->direction & MAPPER_DIR_OUTGOING))
+        mapper_device_route_signal(dev, sig, cs->id_map_index, si->value, 1,
+                                   cs->timetag);
+    call_update_handler(dev, sig, si, smap->map->local, si->value, 1,
+                        &cs->timetag);
+}
+
+/* Evaluate convergent maps that are still waiting for sources once their
+ * timeout has expired. At the end of a poll, maps without a timeout are also
+ * evaluated. Returns the number of evaluations. */
+static int dispatch_converging(mapper_device dev, int end_of_poll)
+{
+    mapper_map map, *prev = &dev->local->converging_maps;
+    mapper_timetag_t now;
+    int i, count = 0, waiting;
+
+    if (!*prev)
+        return 0;
+    mapper_timetag_now(&now);
+    while ((map = *prev)) {
+        mapper_local_map lmap = map->local;
+        for (i = 0, waiting = 0; i < lmap->num_converge_states; i++) {
+            mapper_converge_state cs = &lmap->converge_states[i];
+            if (!cs->arrived)
+                continue;
+            if (lmap->convergence == MAPPER_CONVERGE_ALL
+                && (lmap->convergence_timeout
+                    ? mapper_timetag_difference(cs->deadline, now) > 0
+                    : !end_of_poll)) {
+                ++waiting;
+                continue;
+            }
+            evaluate_converged(dev, map, i, cs);
+            ++count;
+        }
+        if (waiting) {
+            prev = &lmap->next_converging;
+        }
+        else {
+            *prev = lmap->next_converging;
+            lmap->next_converging = 0;
+            lmap->is_converging = 0;
+        }
+    }
+    return count;
+}
+
 /* Notes:
  * - Incoming signal values may be scalars or vectors, but much match the
  *   length of the target signal or mapping slot.
@@ -333,19 +719,84 @@ static int check_types(const char *types, int len, char type, int vector_len)
  * - Updates to specific "slots" of a convergent (i.e. multi-source) mapping
  *   are indicated using the label "@slot" followed by a single integer slot #
  * - Multiple "samples" of a signal value may be packed into a single message
+ * - Updates too long for a single message are split into fragments, labelled
+ *   "@fragment" followed by the offset of the first element and the length of
+ *   the complete update; fragments are reassembled before processing
+ * - Updates from a map source may instead be sent to the path "/@", with the
+ *   alias assigned by this device as the first argument in place of the
+ *   signal path and slot, and the short keys "@i" and "@f"
  * - In future updates, instance release may be triggered by expression eval
  */
-static int handler_signal(const char *path, const char *types, lo_arg **argv,
-                          int argc, lo_message msg, void *user_data)
+enum {
+    UPDATE_PROP_UNKNOWN,
+    UPDATE_PROP_INSTANCE,
+    UPDATE_PROP_SLOT,
+    UPDATE_PROP_FRAGMENT
+};
+
+/* Identify a property key attached to a value update. Aliased updates use the
+ * short forms "@i" and "@f". */
+static int update_property(const char *key)
+{
+    if (key[0] != '@')
+        return UPDATE_PROP_UNKNOWN;
+    switch (key[1]) {
+        case 'i':
+            if (!key[2] || strcmp(key + 2, "nstance") == 0)
+                return UPDATE_PROP_INSTANCE;
+            break;
+        case 's':
+            if (strcmp(key + 2, "lot") == 0)
+                return UPDATE_PROP_SLOT;
+            break;
+        case 'f':
+            if (!key[2] || strcmp(key + 2, "ragment") == 0)
+                return UPDATE_PROP_FRAGMENT;
+            break;
+        default:
+            break;
+    }
+    return UPDATE_PROP_UNKNOWN;
+}
+
+/* Find the link whose remote device sent a message through the network, by
+ * comparing the message's source with the link's data address. */
+static mapper_link link_by_source(mapper_device dev, lo_message msg)
+{
+    lo_address a = lo_message_get_source(msg);
+    const char *host, *port;
+    if (!a || !(host = lo_address_get_hostname(a))
+        || !(port = lo_address_get_port(a)))
+        return 0;
+    mapper_link link = dev->database->links;
+    while (link) {
+        if (link->local && link->local->data_addr && link->local_device == dev
+            && strcmp(port, lo_address_get_port(link->local->data_addr)) == 0
+            && strcmp(host,
+                      lo_address_get_hostname(link->local->data_addr)) == 0)
+            return link;
+        link = mapper_list_next(link);
+    }
+    return 0;
+}
+
+/* Handle a value update for a local signal. For updates addressed by an alias
+ * alias_slot is the slot the alias stands for and the alias argument has
+ * already been removed, otherwise it is -1. */
+static int handle_update(mapper_signal sig, int alias_slot, const char *path,
+                         const char *types, lo_arg **argv, int argc,
+                         lo_message msg)
 {
-    mapper_signal sig = (mapper_signal)user_data;
     mapper_device dev;
-    int i = 0, j, k, count = 1, nulls = 0;
-    int id_map_index, slot_index = -1;
+    int i = 0, j, k, count = 1, nulls = 0, fragment_offset = -1;
+    int id_map_index, slot_index = alias_slot, fragment_length = 0;
     mapper_id global_id = 0;
     mapper_id_map id_map;
     mapper_map map = 0;
     mapper_slot slot = 0;
+    mapper_link link = 0;
+    mapper_local_stats stats = 0;
+    mapper_scheduler scheduler;
 
     if (!sig || !(dev = sig->device)) {
 #ifdef DEBUG
@@ -364,7 +815,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
     if (!argc)
         return 0;
 
-    mapper_signal_update_handler *update_h = sig->local->update_handler;
+    scheduler = &dev->local->scheduler;
+
     mapper_instance_event_handler *event_h = sig->local->instance_event_handler;
 
     // We need to consider that there may be properties appended to the msg
@@ -386,8 +838,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
 #endif
             return 0;
         }
-        if (strcmp(&argv[argnum]->s, mapper_protocol_string(AT_INSTANCE)) == 0
-            && argc >= argnum + 2) {
+        int prop = update_property(&argv[argnum]->s);
+        if (prop == UPDATE_PROP_INSTANCE && argc >= argnum + 2) {
             if (types[argnum+1] != 'h') {
 #ifdef DEBUG
                 printf("error in handler_signal: bad arguments "
@@ -398,8 +850,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             global_id = argv[argnum+1]->i64;
             argnum += 2;
         }
-        else if (strcmp(&argv[argnum]->s, mapper_protocol_string(AT_SLOT)) == 0
-                 && argc >= argnum + 2) {
+        else if (prop == UPDATE_PROP_SLOT && argc >= argnum + 2) {
             if (types[argnum+1] != 'i') {
 #ifdef DEBUG
                 printf("error in handler_signal: bad arguments "
@@ -410,6 +861,18 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             slot_index = argv[argnum+1]->i32;
             argnum += 2;
         }
+        else if (prop == UPDATE_PROP_FRAGMENT && argc >= argnum + 3) {
+            if (types[argnum+1] != 'i' || types[argnum+2] != 'i') {
+#ifdef DEBUG
+                printf("error in handler_signal: bad arguments "
+                       "for 'fragment' property.\n");
+#endif
+                return 0;
+            }
+            fragment_offset = argv[argnum+1]->i32;
+            fragment_length = argv[argnum+2]->i32;
+            argnum += 3;
+        }
         else {
 #ifdef DEBUG
             printf("error in handler_signal: unknown property name '%s'.\n",
@@ -429,10 +892,17 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             return 0;
         }
         map = slot->map;
+        link = slot->link;
+        if (dev->local->stats_flags) {
+            if (!scheduler->dispatching && !dev->local->reassembled)
+                record_received(dev, map, link, path, msg);
+            stats = map->local->stats;
+        }
         if (map->status < STATUS_READY) {
 #ifdef DEBUG
             printf("error in handler_signal: mapping not yet ready.\n");
 #endif
+            mapper_stats_count(stats, dropped_not_ready, 1);
             return 0;
         }
         if (!map->local->expr) {
@@ -453,6 +923,39 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
     }
     else {
         count = check_types(types, value_len, sig->type, sig->length);
+        if (dev->local->stats_flags || scheduler->enabled) {
+            mapper_map sole = mapper_router_sole_incoming_map(dev->local->router,
+                                                              sig);
+            if (sole) {
+                link = sole->sources[0]->link;
+                stats = sole->local->stats;
+                if (dev->local->stats_flags && !scheduler->dispatching
+                    && !dev->local->reassembled)
+                    record_received(dev, sole, link, path, msg);
+            }
+        }
+    }
+
+    if (fragment_offset >= 0) {
+        /* Hold fragments until the complete update has arrived. Updates
+         * without a slot are told apart by the link they arrived on. */
+        mapper_link sender = slot ? slot->link : link_by_source(dev, msg);
+        mapper_fragment f = mapper_fragment_add(sig, lo_message_get_timestamp(msg),
+                                                sender, global_id, slot_index,
+                                                fragment_offset, fragment_length,
+                                                types, argv, value_len);
+        if (!f)
+            return 0;
+        lo_message m = mapper_fragment_message(f);
+        if (m) {
+            dev->local->reassembled = f;
+            handle_update(sig, -1, path, lo_message_get_types(m),
+                          lo_message_get_argv(m), lo_message_get_argc(m), m);
+            dev->local->reassembled = 0;
+            lo_message_free(m);
+        }
+        mapper_fragment_free(f);
+        return 0;
     }
 
     if (!count)
@@ -462,7 +965,22 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
     // requires timebase sync for many-to-one mappings or local updates
     //    if (sig->discard_out_of_order && out_of_order(si->timetag, tt))
     //        return 0;
-    lo_timetag tt = lo_message_get_timestamp(msg);
+    lo_timetag tt;
+    if (scheduler->dispatching) {
+        tt = scheduler->dispatching->timetag;
+        record_schedule_error(stats, link, scheduler->dispatching->due);
+    }
+    else {
+        if (dev->local->reassembled)
+            tt = dev->local->reassembled->timetag;
+        else if (dev->local->direct.dispatching)
+            tt = dev->local->direct.dispatching->timetag;
+        else
+            tt = lo_message_get_timestamp(msg);
+        if (scheduler->enabled && schedule_update(dev, sig, alias_slot, path,
+                                                  msg, tt, link, stats))
+            return 0;
+    }
 
     if (global_id) {
         id_map_index = mapper_signal_find_instance_with_global_id(sig, global_id,
@@ -526,7 +1044,10 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
 
     int size = (slot ? mapper_type_size(slot->signal->type)
                 : mapper_type_size(sig->type));
-    void *out_buffer = alloca(count * value_len * size);
+    // allocated on the heap since vectors may be large
+    void *out_buffer = count > 1 ? malloc(count * value_len * size) : 0;
+    if (count > 1 && !out_buffer)
+        return 0;
     int vals, out_count = 0, active = 1;
 
     if (map) {
@@ -545,7 +1066,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                     printf("error in handler_signal: instance release cannot "
                            "be embedded in multi-count update");
 #endif
-                    return 0;
+                    goto done;
                 }
                 if (global_id) {
                     // TODO: mark SLOT status as remotely released rather than map
@@ -563,17 +1084,11 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 }
                 /* Do not call mapper_device_route_signal() here, since we don't know if
                  * the local signal instance will actually be released. */
-                if (update_h) {
-                    update_h(sig, id_map->local, 0, 1, &tt);
-                }
+                call_update_handler(dev, sig, si, id_map->local, 0, 1, &tt);
                 if (map->process_location != MAPPER_LOC_DESTINATION)
                     continue;
                 /* Reset memory for corresponding source slot. */
-                memset(slot_loc->history[id].value, 0, slot_loc->history_size
-                       * slot->signal->length * size);
-                memset(slot_loc->history[id].timetag, 0,
-                       slot_loc->history_size * sizeof(mapper_timetag_t));
-                slot_loc->history[id].position = -1;
+                mapper_history_reset(&slot_loc->history[id]);
                 continue;
             }
             else if (vals != slot->signal->length) {
@@ -581,7 +1096,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 printf("error in handler_signal: partial vector update applied "
                        "to convergent mapping slot.");
 #endif
-                return 0;
+                goto done;
             }
             else if (global_id && !active) {
                 // may need to activate instance
@@ -592,7 +1107,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                     // no instance found with this map
                     if (nulls == value_len * count) {
                         // Don't activate instance just to release it again
-                        return 0;
+                        goto done;
                     }
                     // otherwise try to init reserved/stolen instance with device map
                     id_map_index = mapper_signal_instance_with_global_id(sig,
@@ -603,41 +1118,32 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                         printf("no local instances available for global"
                                " instance id %"PR_MAPPER_ID"\n", global_id);
 #endif
-                        return 0;
+                        goto done;
                     }
                 }
             }
-            slot_loc->history[id].position = ((slot_loc->history[id].position + 1)
-                                              % slot_loc->history[id].size);
+            mapper_converge_state cs = 0;
+            if (count == 1 && slot->causes_update
+                && (cs = converge_state(map, id))) {
+                /* If this source already arrived, evaluate the waiting update
+                 * before its value is replaced. */
+                for (j = 0; j < map->num_sources; j++) {
+                    if (map->sources[j] == slot && (cs->arrived & (1 << j)))
+                        evaluate_converged(dev, map, id, cs);
+                }
+            }
+            mapper_history_advance(&slot_loc->history[id]);
             memcpy(mapper_history_value_ptr(slot_loc->history[id]),
                    argv[i*count], size * slot->signal->length);
             memcpy(mapper_history_tt_ptr(slot_loc->history[id]), &tt,
                    sizeof(mapper_timetag_t));
             if (slot->causes_update) {
-                char typestring[map->destination.signal->length];
-                mapper_history sources[map->num_sources];
-                for (j = 0; j < map->num_sources; j++)
-                    sources[j] = &map->sources[j]->local->history[id];
-                if (!mapper_expr_evaluate(map->local->expr, sources,
-                                          &map->local->expr_vars[id],
-                                          &map->destination.local->history[id],
-                                          &tt, typestring)) {
+                if (cs && converge(dev, map, slot, cs, id_map_index, global_id,
+                                   &tt))
                     continue;
-                }
-                // TODO: check if expression has triggered instance-release
-                if (mapper_boundary_perform(&map->destination.local->history[id],
-                                            &map->destination, typestring)) {
+                vals = evaluate_map(map, sig, si, &tt, stats);
+                if (vals < 0)
                     continue;
-                }
-                void *result = mapper_history_value_ptr(map->destination.local->history[id]);
-                vals = 0;
-                for (j = 0; j < map->destination.signal->length; j++) {
-                    if (typestring[j] == 'N')
-                        continue;
-                    memcpy(si->value + j * size, result + j * size, size);
-                    si->has_value_flags[j / 8] |= 1 << (j % 8);
-                    ++vals;
-                }
                 if (vals == 0) {
                     // try to release instance
                     // first call handler with value buffer
@@ -645,8 +1151,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                         if (!(sig->direction & MAPPER_DIR_OUTGOING))
                             mapper_device_route_signal(dev, sig, id_map_index,
                                                        out_buffer, out_count, tt);
-                        if (update_h)
-                            update_h(sig, id_map->local, out_buffer, out_count, &tt);
+                        call_update_handler(dev, sig, si, id_map->local,
+                                            out_buffer, out_count, &tt);
                         out_count = 0;
                     }
                     // next call handler with release
@@ -661,8 +1167,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                     /* Do not call mapper_device_route_signal() here, since we
                      * don't know if the local signal instance will actually be
                      * released. */
-                    if (update_h)
-                        update_h(sig, id_map->local, 0, 1, &tt);
+                    call_update_handler(dev, sig, si, id_map->local, 0, 1, &tt);
                     // mark instance as possibly released
                     active = 0;
                     continue;
@@ -682,8 +1187,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                         if (!(sig->direction & MAPPER_DIR_OUTGOING))
                             mapper_device_route_signal(dev, sig, id_map_index,
                                                        si->value, 1, tt);
-                        if (update_h)
-                            update_h(sig, id_map->local, si->value, 1, &tt);
+                        call_update_handler(dev, sig, si, id_map->local,
+                                            si->value, 1, &tt);
                     }
                 }
             }
@@ -695,8 +1200,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             if (!(sig->direction & MAPPER_DIR_OUTGOING))
                 mapper_device_route_signal(dev, sig, id_map_index, out_buffer,
                                            out_count, tt);
-            if (update_h)
-                update_h(sig, id_map->local, out_buffer, out_count, &tt);
+            call_update_handler(dev, sig, si, id_map->local,
+                                out_buffer, out_count, &tt);
         }
     }
     else {
@@ -715,7 +1220,7 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                     printf("error in handler_signal: instance release cannot "
                            "be embedded in multi-count update");
 #endif
-                    return 0;
+                    goto done;
                 }
                 if (global_id) {
                     sig->local->id_maps[id_map_index].status |= RELEASED_REMOTELY;
@@ -727,9 +1232,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                 }
                 /* Do not call mapper_device_route_signal() here, since we don't
                  * know if the local signal instance will actually be released. */
-                if (update_h)
-                    update_h(sig, id_map->local, 0, 1, &tt);
-                return 0;
+                call_update_handler(dev, sig, si, id_map->local, 0, 1, &tt);
+                goto done;
             }
             if (memcmp(si->has_value_flags, sig->local->has_complete_value,
                        sig->length / 8 + 1)==0) {
@@ -746,8 +1250,8 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
                     if (!(sig->direction & MAPPER_DIR_OUTGOING))
                         mapper_device_route_signal(dev, sig, id_map_index,
                                                    si->value, 1, tt);
-                    if (update_h)
-                        update_h(sig, id_map->local, si->value, 1, &tt);
+                    call_update_handler(dev, sig, si, id_map->local,
+                                        si->value, 1, &tt);
                 }
             }
         }
@@ -755,14 +1259,48 @@ static int handler_signal(const char *path, const char *types, lo_arg **argv,
             if (!(sig->direction & MAPPER_DIR_OUTGOING))
                 mapper_device_route_signal(dev, sig, id_map_index, out_buffer,
                                            out_count, tt);
-            if (update_h)
-                update_h(sig, id_map->local, out_buffer, out_count, &tt);
+            call_update_handler(dev, sig, si, id_map->local,
+                                out_buffer, out_count, &tt);
         }
     }
 
+  done:
+    if (out_buffer)
+        free(out_buffer);
     return 0;
 }
 
+static int handler_signal(const char *path, const char *types, lo_arg **argv,
+                          int argc, lo_message msg, void *user_data)
+{
+    return handle_update((mapper_signal)user_data, -1, path, types, argv, argc,
+                         msg);
+}
+
+/* Handle a value update addressed by an alias this device assigned. The
+ * alias stands for the destination signal and map slot, and is passed as
+ * the first argument so that the remaining arguments are the same as for a
+ * signal update. */
+static int handler_alias(const char *path, const char *types, lo_arg **argv,
+                         int argc, lo_message msg, void *user_data)
+{
+    mapper_device dev = (mapper_device)user_data;
+    mapper_alias alias;
+    int index;
+
+    if (!argc || types[0] != 'i')
+        return 0;
+    index = argv[0]->i32 - 1;
+    if (index < 0 || index >= dev->local->num_aliases
+        || !dev->local->aliases[index].map) {
+        trace_dev(dev, "received update with unknown alias %d\n", index + 1);
+        return 0;
+    }
+    alias = &dev->local->aliases[index];
+    return handle_update(alias->signal, alias->slot, alias->signal->path,
+                         types + 1, argv + 1, argc - 1, msg);
+}
+
 //static int handler_instance_release_request(const char *path, const char *types,
 //                                            lo_arg **argv, int argc, lo_message msg,
 //                                            const void *user_data)
@@ -1029,6 +1567,15 @@ void mapper_device_remove_signal(mapper_device dev, mapper_signal sig)
 
     mapper_direction dir = sig->direction;
     mapper_device_remove_signal_methods(dev, sig);
+    mapper_scheduler_remove_signal(&dev->local->scheduler, sig);
+
+    if (sig->local->is_dirty) {
+        mapper_signal *prev = &dev->local->dirty_signals;
+        while (*prev && *prev != sig)
+            prev = &(*prev)->local->next_dirty;
+        if (*prev)
+            *prev = sig->local->next_dirty;
+    }
 
     mapper_router_signal rs = dev->local->router->signals;
     while (rs && rs->signal != sig)
@@ -1054,6 +1601,11 @@ void mapper_device_remove_signal(mapper_device dev, mapper_signal sig)
         mapper_signal_send_removed(sig);
     }
 
+    // queued direct updates must not be delivered to the removed signal
+    lock_direct();
+    mapper_direct_queue_remove_signal(&dev->local->direct, sig);
+    unlock_direct();
+
     mapper_database_remove_signal(dev->database, sig, MAPPER_REMOVED);
     mapper_device_increment_version(dev);
 }
@@ -1077,6 +1629,19 @@ mapper_signal *mapper_device_signals(mapper_device dev, mapper_direction dir)
 {
     if (!dev || !dev->database->signals)
         return 0;
+    void **candidates;
+    int num = mapper_database_index_lookup(dev->database, MAPPER_OBJ_SIGNALS,
+                                           "device", 1, 'h', &dev->id,
+                                           &candidates);
+    if (num >= 0)
+        return ((mapper_signal *)
+                mapper_list_new_indexed_query(dev->database->signals,
+                                              mapper_database_revision(
+                                                  dev->database,
+                                                  MAPPER_OBJ_SIGNALS),
+                                              candidates, num,
+                                              cmp_query_device_signals, "hi",
+                                              dev->id, dir));
     return ((mapper_signal *)
             mapper_list_new_query(dev->database->signals,
                                   cmp_query_device_signals, "hi", dev->id, dir));
@@ -1250,6 +1815,325 @@ mapper_link mapper_device_link_by_remote_device(mapper_device dev,
     return 0;
 }
 
+/* Deliver scheduled updates that are due, or all of them if flush is set.
+ * Returns the number of updates delivered. */
+static int dispatch_scheduled(mapper_device dev, int flush)
+{
+    mapper_scheduler s = &dev->local->scheduler;
+    mapper_scheduled_update next;
+    mapper_scheduled_update_t u;
+    mapper_timetag_t now;
+    int i, count = 0;
+
+    if (!s->size || s->dispatching)
+        return 0;
+
+    mapper_timetag_now(&now);
+    while ((next = mapper_scheduler_peek(s))) {
+        if (!flush && mapper_timetag_difference(next->due, now) > SCHEDULER_TOLERANCE)
+            break;
+        mapper_scheduler_pop(s, &u);
+        s->dispatching = &u;
+        // the message of an aliased update starts with the alias
+        i = u.slot >= 0 ? 1 : 0;
+        handle_update(u.signal, u.slot, u.signal->path,
+                      lo_message_get_types(u.msg) + i,
+                      lo_message_get_argv(u.msg) + i,
+                      lo_message_get_argc(u.msg) - i, u.msg);
+        s->dispatching = 0;
+        lo_message_free(u.msg);
+        ++count;
+    }
+    return count;
+}
+
+/* Deliver the updates passed directly from other devices in this process.
+ * Updates queued while dispatching, e.g. through self-maps, wait for the next
+ * call. Returns the number of updates delivered. */
+static int dispatch_direct(mapper_device dev)
+{
+    mapper_direct_queue q = &dev->local->direct;
+    mapper_direct_update u;
+    int count = 0, num;
+
+    if (q->dispatching)
+        return 0;
+
+    // updates are taken from the queue in batches under a single lock
+    lock_direct();
+    num = q->size;
+    num -= mapper_direct_queue_take_batch(q, num);
+    unlock_direct();
+    while (q->batch_size) {
+        while (q->batch_head < q->batch_size) {
+            u = &q->batch[q->batch_head];
+            if (u->signal) {
+                q->dispatching = u;
+                handler_signal(u->signal->path, lo_message_get_types(u->msg),
+                               lo_message_get_argv(u->msg),
+                               lo_message_get_argc(u->msg), u->msg, u->signal);
+                q->dispatching = 0;
+                ++count;
+            }
+            lo_message_free(u->msg);
+            ++q->batch_head;
+        }
+        lock_direct();
+        num -= mapper_direct_queue_take_batch(q, num);
+        unlock_direct();
+    }
+    return count;
+}
+
+/* Dispatch the updates written to shared memory by devices on this host. */
+static int dispatch_shm(mapper_device dev)
+{
+    if (!dev->local->shm)
+        return 0;
+    return mapper_shm_dispatch(dev->local->shm, dev->local->server);
+}
+
+/* Dispatch the updates received on stream connections. */
+static int dispatch_streams(mapper_device dev)
+{
+    return mapper_stream_server_recv(&dev->local->streams, dev->local->server);
+}
+
+void mapper_device_listen_streams(mapper_device dev)
+{
+    if (!dev->local || !dev->local->server || dev->local->streams.fd >= 0)
+        return;
+    // links using the stream transport connect to the data port over TCP
+    int port = lo_server_get_port(dev->local->server);
+    if (mapper_stream_server_listen(&dev->local->streams,
+                                    dev->database->network->interface_ip,
+                                    port))
+        trace_dev(dev, "could not accept stream connections on port %d\n",
+                  port);
+}
+
+/* Write the updates waiting in the stream connections of this device's
+ * links, or waiting for space in the shared memory of their devices. */
+static void flush_streams(mapper_device dev)
+{
+    mapper_link link = dev->database->links;
+    while (link) {
+        if (link->local && link->local->stream)
+            mapper_link_flush_stream(link);
+        if (link->local && link->local->shm)
+            mapper_link_flush_shm(link);
+        link = mapper_list_next(link);
+    }
+}
+
+void mapper_device_find_peer(mapper_link link)
+{
+    mapper_device dev;
+    if (!link->local)
+        return;
+    lock_direct();
+    if (link->remote_device == link->local_device)
+        dev = link->local_device;
+    else {
+        for (dev = devices_in_process; dev; dev = dev->local->next_in_process) {
+            if (dev->local->registered && dev->name
+                && link->remote_device->name
+                && strcmp(dev->name, link->remote_device->name) == 0)
+                break;
+        }
+    }
+    link->local->peer = dev;
+    link->local->peer_id = dev ? dev->id : 0;
+    unlock_direct();
+}
+
+/* Get the peer of a link, which must be called with the direct lock held.
+ * The peer may have been freed and its memory reused by another device, so it
+ * is looked up by id rather than by address. */
+static mapper_device locked_peer(mapper_link link)
+{
+    mapper_device dev = devices_in_process;
+    while (dev && !(dev->local->registered && dev->id == link->local->peer_id))
+        dev = dev->local->next_in_process;
+    link->local->peer = dev;
+    if (!dev)
+        link->local->peer_id = 0;
+    return dev;
+}
+
+int mapper_device_send_direct(mapper_link link, const char *path,
+                              lo_message msg, mapper_timetag_t tt)
+{
+    mapper_device dev;
+    mapper_signal sig;
+    int result = 1;
+    if (!link->local->peer || !link->local_device->local->direct_delivery)
+        return 1;
+    lock_direct();
+    if ((dev = locked_peer(link))) {
+        // updates for unknown signals are dropped, as the peer would drop them
+        sig = mapper_device_signal_by_name(dev, path);
+        if (!sig || !sig->local) {
+            lo_message_free(msg);
+            result = 0;
+        }
+        else
+            result = mapper_direct_queue_push(&dev->local->direct, tt, sig,
+                                              msg);
+    }
+    unlock_direct();
+    return result;
+}
+
+int mapper_device_send_direct_bundle(mapper_link link, lo_bundle b,
+                                     mapper_timetag_t tt)
+{
+    mapper_device dev;
+    mapper_signal sig;
+    const char *path;
+    size_t size;
+    void *data;
+    lo_message msg;
+    int i, count = lo_bundle_count(b), result = 1;
+    if (!link->local->peer || !link->local_device->local->direct_delivery)
+        return 1;
+    /* The messages are pushed together while holding the lock, so the peer
+     * dispatches all of them in the same poll. */
+    lock_direct();
+    dev = locked_peer(link);
+    if (dev && dev->local->direct.size + count <= MAPPER_DIRECT_QUEUE_SIZE) {
+        for (i = 0; i < count; i++) {
+            msg = lo_bundle_get_message(b, i, &path);
+            sig = mapper_device_signal_by_name(dev, path);
+            if (!sig || !sig->local)
+                continue;
+            // copy the message since the bundle is freed by the caller
+            data = lo_message_serialise(msg, path, 0, &size);
+            msg = data ? lo_message_deserialise(data, size, 0) : 0;
+            if (data)
+                free(data);
+            if (!msg || mapper_direct_queue_push(&dev->local->direct, tt, sig,
+                                                 msg)) {
+                if (msg)
+                    lo_message_free(msg);
+                break;
+            }
+        }
+        result = 0;
+    }
+    unlock_direct();
+    return result;
+}
+
+int mapper_device_add_alias(mapper_device dev, mapper_map map,
+                            mapper_slot slot)
+{
+    mapper_alias alias;
+    int i, num;
+
+    if (!dev->local)
+        return 0;
+    i = slot->alias - 1;
+    if (i >= 0 && i < dev->local->num_aliases
+        && dev->local->aliases[i].map == map
+        && dev->local->aliases[i].slot == slot->id)
+        return slot->alias;
+
+    // reuse the first alias released by a removed map
+    for (i = 0; i < dev->local->num_aliases; i++) {
+        if (!dev->local->aliases[i].map)
+            break;
+    }
+    if (i == dev->local->num_aliases) {
+        num = i ? i * 2 : 8;
+        alias = realloc(dev->local->aliases, num * sizeof(mapper_alias_t));
+        if (!alias)
+            return 0;
+        memset(alias + i, 0, (num - i) * sizeof(mapper_alias_t));
+        dev->local->aliases = alias;
+        dev->local->num_aliases = num;
+    }
+    alias = &dev->local->aliases[i];
+    alias->map = map;
+    alias->signal = map->destination.signal;
+    alias->slot = slot->id;
+    slot->alias = i + 1;
+    return slot->alias;
+}
+
+void mapper_device_remove_aliases(mapper_device dev, mapper_map map)
+{
+    int i;
+    if (!dev->local)
+        return;
+    for (i = 0; i < dev->local->num_aliases; i++) {
+        if (dev->local->aliases[i].map == map)
+            dev->local->aliases[i].map = 0;
+    }
+}
+
+void mapper_device_set_direct_delivery(mapper_device dev, int enable)
+{
+    if (dev && dev->local)
+        dev->local->direct_delivery = enable ? 1 : 0;
+}
+
+int mapper_device_direct_delivery(mapper_device dev)
+{
+    return (dev && dev->local) ? dev->local->direct_delivery : 0;
+}
+
+/* Get the time in seconds until the next scheduled update is due, or -1 if
+ * there are none. */
+static double next_scheduled(mapper_device dev)
+{
+    mapper_scheduled_update next;
+    next = mapper_scheduler_peek(&dev->local->scheduler);
+    if (!next)
+        return -1;
+    mapper_timetag_t now;
+    mapper_timetag_now(&now);
+    double wait = mapper_timetag_difference(next->due, now);
+    return wait > 0 ? wait : 0;
+}
+
+void mapper_device_set_scheduling(mapper_device dev, int enable)
+{
+    if (!dev || !dev->local)
+        return;
+    dev->local->scheduler.enabled = enable ? 1 : 0;
+    if (!enable) {
+        // deliver anything still waiting rather than dropping it
+        dispatch_scheduled(dev, 1);
+    }
+}
+
+int mapper_device_scheduling(mapper_device dev)
+{
+    return (dev && dev->local) ? dev->local->scheduler.enabled : 0;
+}
+
+/*! Work done at the end of each poll, and after servicing a descriptor. */
+static void finish_poll(mapper_device dev)
+{
+    dispatch_converging(dev, 1);
+    mapper_router_send_pending(dev->local->router);
+    flush_streams(dev);
+
+    // coalesced updates are passed to their handlers once per poll
+    dispatch_dirty(dev);
+
+    if (dev->props->dirty && mapper_device_ready(dev)
+        && dev->local->subscribers) {
+        // inform device subscribers of change props
+        mapper_network_set_dest_subscribers(dev->database->network,
+                                            MAPPER_OBJ_DEVICES);
+        mapper_device_send_state(dev, MSG_DEVICE);
+    }
+
+    mapper_database_publish_snapshot(dev->database);
+}
+
 int mapper_device_poll(mapper_device dev, int block_ms)
 {
     if (!dev || !dev->local)
@@ -1260,8 +2144,13 @@ int mapper_device_poll(mapper_device dev, int block_ms)
 
     if (!block_ms) {
         device_count = lo_server_recv_noblock(dev->local->server, 0);
+        device_count += dispatch_direct(dev);
+        device_count += dispatch_shm(dev);
+        device_count += dispatch_streams(dev);
+        device_count += dispatch_scheduled(dev, 0);
         admin_count = mapper_network_poll(net, 1);
         net->msgs_recvd += admin_count;
+        finish_poll(dev);
         return admin_count + device_count;
     }
 
@@ -1277,7 +2166,8 @@ int mapper_device_poll(mapper_device dev, int block_ms)
     mapper_network_poll(net, 0);
 
     fd_set fdr;
-    int nfds, bus_fd, mesh_fd, dev_fd;
+    int nfds, bus_fd, mesh_fd, dev_fd, i, num_stream_fds;
+    int stream_fds[MAPPER_STREAM_MAX_INPUTS + 1];
 
     while (timercmp(&now, &end, <)) {
         FD_ZERO(&fdr);
@@ -1296,12 +2186,45 @@ int mapper_device_poll(mapper_device dev, int block_ms)
         if (dev_fd >= nfds)
             nfds = dev_fd + 1;
 
+        num_stream_fds = mapper_stream_server_fds(&dev->local->streams,
+                                                  stream_fds,
+                                                  MAPPER_STREAM_MAX_INPUTS + 1);
+        for (i = 0; i < num_stream_fds; i++) {
+            FD_SET(stream_fds[i], &fdr);
+            if (stream_fds[i] >= nfds)
+                nfds = stream_fds[i] + 1;
+        }
+
         timersub(&end, &now, &wait);
         // set timeout to a maximum of 100ms
         if (wait.tv_sec || wait.tv_usec > 100000) {
             wait.tv_sec = 0;
             wait.tv_usec = 100000;
         }
+        // wake up in time for the next scheduled update
+        double due = next_scheduled(dev);
+        if (due >= 0 && due < wait.tv_usec * 0.000001) {
+            wait.tv_sec = 0;
+            wait.tv_usec = due * 1000000;
+        }
+        // values held back by a maximum send rate are sent as soon as allowed
+        if (dev->local->router->num_pending && wait.tv_usec > 1000) {
+            wait.tv_sec = 0;
+            wait.tv_usec = 1000;
+        }
+        // convergent maps waiting for sources are evaluated once they time out
+        if (dev->local->converging_maps && wait.tv_usec > 1000) {
+            wait.tv_sec = 0;
+            wait.tv_usec = 1000;
+        }
+        // don't wait for the network while direct updates are queued
+        lock_direct();
+        int direct_pending = dev->local->direct.size;
+        unlock_direct();
+        if (direct_pending) {
+            wait.tv_sec = 0;
+            wait.tv_usec = 0;
+        }
 
         timersub(&now, &start, &elapsed);
         if (elapsed.tv_sec || elapsed.tv_usec >= 100000) {
@@ -1324,6 +2247,13 @@ int mapper_device_poll(mapper_device dev, int block_ms)
                 ++admin_count;
             }
         }
+        device_count += dispatch_direct(dev);
+        device_count += dispatch_shm(dev);
+        device_count += dispatch_streams(dev);
+        device_count += dispatch_scheduled(dev, 0);
+        dispatch_converging(dev, 0);
+        mapper_router_send_pending(dev->local->router);
+        flush_streams(dev);
         gettimeofday(&now, NULL);
     }
 
@@ -1337,21 +2267,21 @@ int mapper_device_poll(mapper_device dev, int block_ms)
     }
 
     net->msgs_recvd += admin_count;
-
-    if (dev->props->dirty && mapper_device_ready(dev)
-        && dev->local->subscribers) {
-        // inform device subscribers of change props
-        mapper_network_set_dest_subscribers(net, MAPPER_OBJ_DEVICES);
-        mapper_device_send_state(dev, MSG_DEVICE);
-    }
-
+    finish_poll(dev);
     return admin_count + device_count;
 }
 
 int mapper_device_num_fds(mapper_device dev)
 {
-    // Two for the admin inputs (bus and mesh), and one for the signal input.
-    return 3;
+    /* Two for the admin inputs (bus and mesh), one for the signal input, and
+     * any used for stream connections. */
+    int num = 3;
+    if (dev && dev->local) {
+        if (dev->local->streams.fd >= 0)
+            ++num;
+        num += dev->local->streams.num_inputs;
+    }
+    return num;
 }
 
 int mapper_device_fds(mapper_device dev, int *fds, int num)
@@ -1369,7 +2299,8 @@ int mapper_device_fds(mapper_device dev, int *fds, int num)
     }
     else
         return 1;
-    return 3;
+    return 3 + mapper_stream_server_fds(&dev->local->streams, fds + 3,
+                                        num - 3);
 }
 
 void mapper_device_service_fd(mapper_device dev, int fd)
@@ -1388,6 +2319,11 @@ void mapper_device_service_fd(mapper_device dev, int fd)
     else if (dev->local->server
              && fd == lo_server_get_socket_fd(dev->local->server))
         lo_server_recv_noblock(dev->local->server, 0);
+    dispatch_direct(dev);
+    dispatch_shm(dev);
+    dispatch_streams(dev);
+    dispatch_scheduled(dev, 0);
+    finish_poll(dev);
 }
 
 void mapper_device_num_instances_changed(mapper_device dev, mapper_signal sig,
@@ -1406,34 +2342,80 @@ void mapper_device_route_signal(mapper_device dev, mapper_signal sig,
                                  value, count, timetag);
 }
 
+static mapper_queue find_queue(mapper_device dev, mapper_timetag_t tt)
+{
+    mapper_queue q = dev->local->queues;
+    while (q && memcmp(&q->tt, &tt, sizeof(mapper_timetag_t)))
+        q = q->next;
+    return q;
+}
+
 // Function to start a signal update queue
-void mapper_device_start_queue(mapper_device dev, mapper_timetag_t tt)
+mapper_queue mapper_device_start_queue(mapper_device dev, mapper_timetag_t tt)
 {
-    if (!dev)
-        return;
+    if (!dev || !dev->local)
+        return 0;
 
-    mapper_link link = dev->database->links;
-    while (link) {
-        if (link->local)
-            mapper_link_start_queue(link, tt);
-        link = mapper_list_next(link);
+    // check if queue already exists
+    mapper_queue q = find_queue(dev, tt);
+    if (q)
+        return q;
+
+    // need to create a new queue
+    q = (mapper_queue) calloc(1, sizeof(mapper_queue_t));
+    if (!q)
+        return 0;
+    memcpy(&q->tt, &tt, sizeof(mapper_timetag_t));
+    q->device = dev;
+    q->next = dev->local->queues;
+    dev->local->queues = q;
+    return q;
+}
+
+/* Remove a queue from the device, then send or discard its bundles. */
+static void close_queue(mapper_queue queue, int send)
+{
+    mapper_device dev = queue->device;
+    mapper_queue *q = &dev->local->queues;
+    while (*q && *q != queue)
+        q = &(*q)->next;
+    if (*q)
+        *q = queue->next;
+
+    // only links that received messages while the queue was open are touched
+    while (queue->bundles) {
+        mapper_link_bundle b = queue->bundles;
+        queue->bundles = b->next_in_queue;
+        mapper_link_close_bundle(b, send);
     }
+    free(queue);
 }
 
 // Function to send a signal update queue
 void mapper_device_send_queue(mapper_device dev, mapper_timetag_t tt)
 {
-    if (!dev)
+    if (!dev || !dev->local)
         return;
+    mapper_queue q = find_queue(dev, tt);
+    if (q)
+        close_queue(q, 1);
+    flush_streams(dev);
+}
 
-    mapper_link link = dev->database->links;
-    while (link) {
-        if (link->local)
-            mapper_link_send_queue(link, tt);
-        link = mapper_list_next(link);
+void mapper_queue_send(mapper_queue queue)
+{
+    if (queue) {
+        mapper_device dev = queue->device;
+        close_queue(queue, 1);
+        flush_streams(dev);
     }
 }
 
+mapper_timetag_t mapper_queue_timetag(mapper_queue queue)
+{
+    return queue ? queue->tt : MAPPER_NOW;
+}
+
 int mapper_device_route_query(mapper_device dev, mapper_signal sig,
                               mapper_timetag_t tt)
 {
@@ -1543,9 +2525,14 @@ void mapper_device_start_server(mapper_device dev, int starting_port)
     // Disable liblo message queueing
     lo_server_enable_queue(dev->local->server, 0, 1);
 
+    // updates addressed by aliases assigned by this device
+    lo_server_add_method(dev->local->server, MAPPER_ALIAS_PATH, NULL,
+                         handler_alias, dev);
+
     int portnum = lo_server_get_port(dev->local->server);
     mapper_table_set_record(dev->props, AT_PORT, NULL, 1, 'i', &portnum,
                             NON_MODIFIABLE);
+
     char *url = lo_server_get_url(dev->local->server);
     char *host = lo_url_get_hostname(url);
     mapper_table_set_record(dev->props, AT_HOST, NULL, 1, 's', host,
@@ -1580,9 +2567,11 @@ const char *mapper_device_name(mapper_device dev)
         return dev->name;
 
     unsigned int len = strlen(dev->identifier) + 6;
+    mapper_database_unindex_property(dev->props, AT_NAME, 0);
     dev->name = (char*)malloc(len);
     dev->name[0] = 0;
     snprintf(dev->name, len, "%s.%d", dev->identifier, dev->local->ordinal.value);
+    mapper_database_index_property(dev->props, AT_NAME, 0);
     return dev->name;
 }
 
@@ -1640,6 +2629,27 @@ void mapper_device_synced(mapper_device dev, mapper_timetag_t *tt)
         mapper_timetag_copy(tt, dev->synced);
 }
 
+void mapper_device_now(mapper_device dev, mapper_timetag_t *tt)
+{
+    mapper_timetag_now(tt);
+    if (!dev->local || (!dev->local->clock_adjust_offset
+                        && !dev->local->clock_adjust_skew))
+        return;
+    double elapsed = mapper_get_monotonic_time() - dev->local->clock_adjust_ref;
+    mapper_timetag_add_double(tt, dev->local->clock_adjust_offset
+                              + elapsed * dev->local->clock_adjust_skew);
+}
+
+void mapper_device_set_clock_adjustment(mapper_device dev, double offset,
+                                        double skew)
+{
+    if (!dev || !dev->local)
+        return;
+    dev->local->clock_adjust_offset = offset;
+    dev->local->clock_adjust_skew = skew;
+    dev->local->clock_adjust_ref = mapper_get_monotonic_time();
+}
+
 int mapper_device_version(mapper_device dev)
 {
     return dev ? dev->version : 0;
@@ -1825,8 +2835,11 @@ int mapper_device_set_from_message(mapper_device dev, mapper_message msg)
     return mapper_table_set_from_message(dev->props, msg, REMOTE_MODIFY);
 }
 
+/* Signals and maps skipped by a subscription filter are not counted when
+ * sending batches. */
 static int mapper_device_send_signals(mapper_device dev, mapper_direction dir,
-                                      int min, int max)
+                                      int min, int max,
+                                      mapper_subscription_filter filter)
 {
     int i = 0;
     mapper_signal *sig = mapper_device_signals(dev, dir);
@@ -1835,9 +2848,11 @@ static int mapper_device_send_signals(mapper_device dev, mapper_direction dir,
             mapper_signal_query_done(sig);
             return 1;
         }
-        if (i >= min)
-            mapper_signal_send_state(*sig, MSG_SIGNAL);
-        ++i;
+        if (mapper_subscription_filter_match_signal(filter, *sig)) {
+            if (i >= min)
+                mapper_signal_send_state(*sig, MSG_SIGNAL);
+            ++i;
+        }
         sig = mapper_signal_query_next(sig);
     }
     return 0;
@@ -1853,7 +2868,8 @@ static void mapper_device_send_links(mapper_device dev, mapper_direction dir)
 }
 
 static int mapper_device_send_maps(mapper_device dev, mapper_direction dir,
-                                    int min, int max)
+                                    int min, int max,
+                                    mapper_subscription_filter filter)
 {
     int i = 0;
     mapper_map *maps = mapper_device_maps(dev, dir);
@@ -1862,19 +2878,22 @@ static int mapper_device_send_maps(mapper_device dev, mapper_direction dir,
             mapper_map_query_done(maps);
             return 1;
         }
-        if (i >= min) {
-            mapper_map_send_state(*maps, -1, MSG_MAPPED);
+        if (mapper_subscription_filter_match_map(filter, *maps, dev)) {
+            if (i >= min) {
+                mapper_map_send_state(*maps, -1, MSG_MAPPED);
+            }
+            ++i;
         }
-        ++i;
         maps = mapper_map_query_next(maps);
     }
     return 0;
 }
 
-// Add/renew/remove a subscription.
+// Add/renew/remove a subscription. The device takes ownership of the filter.
 void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
                                      int flags, int timeout_seconds,
-                                     int revision)
+                                     int revision,
+                                     mapper_subscription_filter filter)
 {
     mapper_subscriber *s = &dev->local->subscribers;
     const char *ip = lo_address_get_hostname(address);
@@ -1882,11 +2901,13 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
     if (!ip || !port) {
         trace_dev(dev, "error managing subscription: %s not found\n",
                   ip ? "port" : "ip");
+        mapper_subscription_filter_free(filter);
         return;
     }
 
     mapper_timetag_t tt;
     mapper_timetag_now(&tt);
+    mapper_subscription_filter stored = 0;
 
     while (*s) {
         const char *s_ip = lo_address_get_hostname((*s)->address);
@@ -1901,9 +2922,10 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
                 *s = temp->next;
                 if (temp->address)
                     lo_address_free(temp->address);
+                mapper_subscription_filter_free(temp->filter);
                 free(temp);
-                if (!flags || !(flags &= ~prev_flags))
-                    return;
+                if (flags)
+                    flags &= ~prev_flags;
             }
             else {
                 // reset timeout
@@ -1911,7 +2933,15 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
                           s_ip, s_port, timeout_seconds);
                 (*s)->lease_expiration_sec = tt.sec + timeout_seconds;
                 int temp = flags;
-                flags &= ~(*s)->flags;
+                if (mapper_subscription_filter_equal((*s)->filter, filter)) {
+                    // only send information that was not subscribed before
+                    flags &= ~(*s)->flags;
+                }
+                else {
+                    // resend everything that passes the new filter
+                    mapper_subscription_filter_free((*s)->filter);
+                    (*s)->filter = stored = filter;
+                }
                 (*s)->flags = temp;
             }
             break;
@@ -1919,8 +2949,11 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
         s = &(*s)->next;
     }
 
-    if (!flags)
+    if (!flags) {
+        if (filter != stored)
+            mapper_subscription_filter_free(filter);
         return;
+    }
 
     if (!(*s) && timeout_seconds) {
         // add new subscriber
@@ -1930,6 +2963,7 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
         sub->address = lo_address_new(ip, port);
         sub->lease_expiration_sec = tt.sec + timeout_seconds;
         sub->flags = flags;
+        sub->filter = stored = filter;
         sub->next = dev->local->subscribers;
         dev->local->subscribers = sub;
         s = &sub;
@@ -1949,7 +2983,8 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
         int batch = 0, done = 0;
         while (!done) {
             mapper_network_set_dest_mesh(dev->database->network, address);
-            if (!mapper_device_send_signals(dev, dir, batch, batch + 9))
+            if (!mapper_device_send_signals(dev, dir, batch, batch + 9,
+                                            filter))
                 done = 1;
             mapper_network_send(dev->database->network);
             batch += 10;
@@ -1976,12 +3011,15 @@ void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
         int batch = 0, done = 0;
         while (!done) {
             mapper_network_set_dest_mesh(dev->database->network, address);
-            if (!mapper_device_send_maps(dev, dir, batch, batch + 9))
+            if (!mapper_device_send_maps(dev, dir, batch, batch + 9, filter))
                 done = 1;
             mapper_network_send(dev->database->network);
             batch += 10;
         }
     }
+
+    if (filter != stored)
+        mapper_subscription_filter_free(filter);
 }
 
 mapper_signal_group mapper_device_add_signal_group(mapper_device dev)
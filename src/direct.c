@@ -0,0 +1,92 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lo/lo.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* Updates passed between devices in the same process are kept in a ring
+ * buffer which grows on demand up to MAPPER_DIRECT_QUEUE_SIZE entries. The
+ * caller is responsible for locking. */
+
+static int grow(mapper_direct_queue q)
+{
+    int i, capacity = q->capacity ? q->capacity * 2 : 16;
+    if (capacity > MAPPER_DIRECT_QUEUE_SIZE)
+        return 1;
+    mapper_direct_update_t *updates = malloc(capacity
+                                             * sizeof(mapper_direct_update_t));
+    if (!updates)
+        return 1;
+    // unwrap the existing updates to the start of the new buffer
+    for (i = 0; i < q->size; i++)
+        updates[i] = q->updates[(q->head + i) % q->capacity];
+    if (q->updates)
+        free(q->updates);
+    q->updates = updates;
+    q->capacity = capacity;
+    q->head = 0;
+    return 0;
+}
+
+int mapper_direct_queue_push(mapper_direct_queue q, mapper_timetag_t tt,
+                             mapper_signal sig, lo_message msg)
+{
+    if (q->size >= q->capacity && grow(q))
+        return 1;
+    mapper_direct_update u = &q->updates[(q->head + q->size) % q->capacity];
+    u->timetag = tt;
+    u->signal = sig;
+    u->msg = msg;
+    ++q->size;
+    return 0;
+}
+
+int mapper_direct_queue_take_batch(mapper_direct_queue q, int max)
+{
+    int i;
+    if (max > q->size)
+        max = q->size;
+    if (max > MAPPER_DIRECT_BATCH_SIZE)
+        max = MAPPER_DIRECT_BATCH_SIZE;
+    for (i = 0; i < max; i++) {
+        q->batch[i] = q->updates[q->head];
+        q->head = (q->head + 1) % q->capacity;
+    }
+    q->size -= max;
+    q->batch_head = 0;
+    q->batch_size = max;
+    return max;
+}
+
+void mapper_direct_queue_remove_signal(mapper_direct_queue q,
+                                       mapper_signal sig)
+{
+    int i;
+    for (i = 0; i < q->size; i++) {
+        mapper_direct_update u = &q->updates[(q->head + i) % q->capacity];
+        if (u->signal == sig)
+            u->signal = 0;
+    }
+    for (i = q->batch_head; i < q->batch_size; i++) {
+        if (q->batch[i].signal == sig)
+            q->batch[i].signal = 0;
+    }
+}
+
+void mapper_direct_queue_free(mapper_direct_queue q)
+{
+    int i;
+    for (i = 0; i < q->size; i++)
+        lo_message_free(q->updates[(q->head + i) % q->capacity].msg);
+    for (i = q->batch_head; i < q->batch_size; i++)
+        lo_message_free(q->batch[i].msg);
+    if (q->updates)
+        free(q->updates);
+    q->updates = 0;
+    q->head = q->size = q->capacity = 0;
+    q->batch_head = q->batch_size = 0;
+}
@@ -6,7 +6,7 @@
 
 #include "mapper_internal.h"
 
-#define MAX_HISTORY -100
+#define MAX_HISTORY -4096
 #define STACK_SIZE 128
 #define N_USER_VARS 8
 #ifdef DEBUG
@@ -475,7 +475,7 @@ static struct {
     { "|",      2, 3,  GET_OPER | GET_OPER <<4 | GET_ONE  <<8 | GET_ONE  <<12 },
     { "&&",     2, 2,  GET_ZERO | GET_ZERO <<4 | NONE     <<8 | NONE     <<12 },
     { "||",     2, 1,  GET_OPER | GET_OPER <<4 | GET_ONE  <<8 | GET_ONE  <<12 },
-    // TODO: handle optimization of ternary operator
+    // ternary operators with constant conditions are folded in optimize()
     { "IFTHEN",      2, 0, NONE | NONE     <<4 | NONE     <<8 | NONE     <<12 },
     { "IFELSE",      2, 0, NONE | NONE     <<4 | NONE     <<8 | NONE     <<12 },
     { "IFTHENELSE",  3, 0, NONE | NONE     <<4 | NONE     <<8 | NONE     <<12 },
@@ -518,6 +518,8 @@ typedef struct _token {
         TOK_VECTORIZE       = 0x4000,
         TOK_ASSIGNMENT      = 0x8000,
         TOK_ASSIGN_USE,
+        TOK_CACHE,          // keep a copy of the value on top of the stack
+        TOK_CACHED,         // push a value kept by TOK_CACHE
         TOK_END,
     } toktype;
     union {
@@ -537,8 +539,12 @@ typedef struct _token {
     union {
         int vector_index;
         int arity;
+        int cache_index;
     };
-    char history_index;
+    int history_index;
+    int window;             // size of a windowed input reduction, or 0
+    char window_func;
+    char window_index;
     char vector_length_locked;
     char datatype;
 } mapper_token_t, *mapper_token;
@@ -548,7 +554,7 @@ typedef struct _variable {
     int vector_length;
     char datatype;
     char casttype;
-    char history_size;
+    int history_size;
     char vector_length_locked;
     char assigned;
 } mapper_variable_t, *mapper_variable;
@@ -663,6 +669,7 @@ static int expr_lex(const char *str, int index, mapper_token_t *tok)
     tok->vector_length = 1;
     tok->vector_index = 0;
     tok->vector_length_locked = 0;
+    tok->window = 0;
     int n=index, i=index;
     char c = str[index];
     int integer_found = 0;
@@ -923,7 +930,17 @@ struct _mapper_expr
     int input_history_size;
     int output_history_size;
     int num_variables;
+    int num_windows;
     int constant_output;
+
+    /* Evaluation stack, allocated with the expression rather than on the C
+     * stack since its size grows with the vector length. */
+    mapper_value_t *stack;
+    int *dims;
+
+    /* Values of common subexpressions, kept by TOK_CACHE tokens. */
+    mapper_value_t *cache;
+    int num_cached;
 };
 
 void mapper_expr_free(mapper_expr expr)
@@ -931,6 +948,12 @@ void mapper_expr_free(mapper_expr expr)
     int i;
     if (expr->tokens)
         free(expr->tokens);
+    if (expr->stack)
+        free(expr->stack);
+    if (expr->dims)
+        free(expr->dims);
+    if (expr->cache)
+        free(expr->cache);
     if (expr->num_variables && expr->variables) {
         for (i = 0; i < expr->num_variables; i++) {
             free(expr->variables[i].name);
@@ -962,7 +985,11 @@ void printtoken(mapper_token_t tok)
         case TOK_CLOSE_PAREN:   snprintf(tokstr, 32, ")");      break;
         case TOK_CLOSE_SQUARE:  snprintf(tokstr, 32, "]");      break;
         case TOK_VAR:
-            if (tok.var == VAR_Y)
+            if (tok.var >= VAR_X && tok.window && tok.window_func >= 0)
+                snprintf(tokstr, 32, "%s(x%d{%d:0}[%d])",
+                         vfunction_table[tok.window_func].name,
+                         tok.var - VAR_X, tok.history_index, tok.vector_index);
+            else if (tok.var == VAR_Y)
                 snprintf(tokstr, 32, "y{%d}[%d]", tok.history_index,
                          tok.vector_index);
             else if (tok.var == VAR_X)
@@ -998,6 +1025,12 @@ void printtoken(mapper_token_t tok)
                          tok.var, tok.history_index,
                          tok.assignment_offset, tok.vector_index);
             break;
+        case TOK_CACHE:
+            snprintf(tokstr, 32, "CACHE[%d]", tok.cache_index);
+            break;
+        case TOK_CACHED:
+            snprintf(tokstr, 32, "CACHED[%d]", tok.cache_index);
+            break;
         case TOK_END:       printf("END\n");                    return;
         default:            printf("(unknown token)\n");        return;
     }
@@ -1138,6 +1171,11 @@ static int precompute(mapper_token_t *stack, int length, int vector_length)
     e.vector_size = vector_length;
     e.variables = 0;
     e.num_variables = 0;
+    e.num_windows = 0;
+    e.stack = malloc(sizeof(mapper_value_t) * length * vector_length);
+    e.dims = malloc(sizeof(int) * length);
+    e.cache = 0;
+    e.num_cached = 0;
     mapper_history_t h;
 
     void *v = malloc(mapper_type_size(stack[length-1].datatype) * vector_length);
@@ -1147,7 +1185,10 @@ static int precompute(mapper_token_t *stack, int length, int vector_length)
     h.length = vector_length;
     h.size = 1;
 
-    if (!mapper_expr_evaluate(&e, 0, 0, &h, 0, 0)) {
+    int result = mapper_expr_evaluate(&e, 0, 0, &h, 0, 0);
+    free(e.stack);
+    free(e.dims);
+    if (!result) {
         free(v);
         return 0;
     }
@@ -1504,6 +1545,431 @@ static int find_variable_by_name(mapper_variable_t *variables, int num_variables
     return -1;
 }
 
+/**** Optimization of parsed expressions ****/
+
+static int optimization_enabled = 1;
+
+void mapper_expr_set_optimization(int enable)
+{
+    optimization_enabled = enable;
+}
+
+/* Number of operands consumed by a token, including assignments embedded in
+ * expressions by functions with memory. */
+static int operand_count(mapper_token_t *tok)
+{
+    switch (tok->toktype) {
+        case TOK_ASSIGN_USE:
+        case TOK_CACHE:
+            return 1;
+        default:
+            return tok_arity(*tok);
+    }
+}
+
+/* Find the first token of the subexpression that ends at stack[top]. */
+static int subexpr_start(mapper_token_t *stack, int top)
+{
+    int i = top, needed = 1;
+    while (needed && i >= 0) {
+        needed += operand_count(&stack[i]) - 1;
+        --i;
+    }
+    return i + 1;
+}
+
+/* Find the last token of each operand of stack[top]. */
+static int operand_ends(mapper_token_t *stack, int top, int *ends)
+{
+    int i, n = operand_count(&stack[top]), end = top - 1;
+    for (i = n - 1; i >= 0; i--) {
+        ends[i] = end;
+        end = subexpr_start(stack, end) - 1;
+    }
+    return n;
+}
+
+static int tokens_equal(mapper_token_t *a, mapper_token_t *b)
+{
+    if (a->toktype != b->toktype || a->datatype != b->datatype
+        || a->casttype != b->casttype || a->vector_length != b->vector_length)
+        return 0;
+    switch (a->toktype) {
+        case TOK_CONST:
+            switch (a->datatype) {
+                case 'i':   return a->i == b->i;
+                case 'f':   return a->f == b->f;
+                case 'd':   return a->d == b->d;
+                default:    return 0;
+            }
+        case TOK_VAR:
+            return (a->var == b->var && a->history_index == b->history_index
+                    && a->vector_index == b->vector_index
+                    && a->window == b->window
+                    && a->window_func == b->window_func);
+        case TOK_OP:
+            return a->op == b->op;
+        case TOK_FUNC:
+            return a->func == b->func;
+        case TOK_VFUNC:
+            return a->vfunc == b->vfunc;
+        case TOK_VECTORIZE:
+            return a->arity == b->arity;
+        case TOK_CACHE:
+        case TOK_CACHED:
+            return a->cache_index == b->cache_index;
+        default:
+            return 0;
+    }
+}
+
+static int subexprs_equal(mapper_token_t *stack, int a, int b, int length)
+{
+    int i;
+    for (i = 0; i < length; i++) {
+        if (!tokens_equal(&stack[a - i], &stack[b - i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Check that a subexpression always has the same value within a single
+ * evaluation and has no side effects, so that it can be evaluated once. */
+static int subexpr_is_pure(mapper_token_t *stack, int start, int end)
+{
+    int i;
+    for (i = start; i <= end; i++) {
+        mapper_token_t *tok = &stack[i];
+        switch (tok->toktype) {
+            case TOK_CONST:
+            case TOK_VFUNC:
+            case TOK_VECTORIZE:
+            case TOK_CACHED:
+                break;
+            case TOK_VAR:
+                // inputs do not change during evaluation, unlike variables
+                if (tok->var < VAR_X || tok->window)
+                    return 0;
+                break;
+            case TOK_OP:
+                if (tok->op == OP_CONDITIONAL_IF_THEN)
+                    return 0;
+                break;
+            case TOK_FUNC:
+                if (tok->func >= FUNC_UNIFORM || function_table[tok->func].memory)
+                    return 0;
+                break;
+            default:
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static char effective_type(mapper_token_t *tok)
+{
+    return tok->casttype ? tok->casttype : tok->datatype;
+}
+
+/* Append a token, failing if the output stack is full. */
+#define EMIT(tok)                                                   \
+{                                                                   \
+    if (len >= STACK_SIZE)                                          \
+        return -1;                                                  \
+    memcpy(&out[len++], tok, sizeof(mapper_token_t));               \
+}
+
+/* Copy an operand in place of the operation at stack[top], which must still
+ * produce the same type, vector length and cast. */
+static int replace_with_operand(mapper_token_t *stack, int top, int operand,
+                                mapper_token_t *out, int len, int *num_cached);
+
+/* Copy the subexpression ending at stack[top] to out, folding conditionals
+ * with constant conditions and replacing pow() with a small constant exponent
+ * and division by a power of two with multiplication. Returns the new length
+ * of out, or -1 if it does not fit. */
+static int rewrite_subexpr(mapper_token_t *stack, int top, mapper_token_t *out,
+                           int len, int *num_cached)
+{
+    mapper_token_t *tok = &stack[top], newtok;
+    int i, n = operand_count(tok), ends[n ? n : 1];
+    operand_ends(stack, top, ends);
+
+    if (tok->toktype == TOK_OP && tok->op == OP_CONDITIONAL_IF_THEN_ELSE) {
+        int cond = ends[0];
+        if (stack[cond].toktype == TOK_CONST) {
+            i = replace_with_operand(stack, top,
+                                     const_tok_is_zero(stack[cond])
+                                     ? ends[2] : ends[1], out, len, num_cached);
+            if (i >= 0)
+                return i;
+        }
+        else {
+            int size = ends[1] - subexpr_start(stack, ends[1]) + 1;
+            if (ends[2] - ends[1] == size
+                && subexprs_equal(stack, ends[1], ends[2], size)
+                && subexpr_is_pure(stack, subexpr_start(stack, cond), ends[1])) {
+                // both branches are the same
+                i = replace_with_operand(stack, top, ends[1], out, len,
+                                         num_cached);
+                if (i >= 0)
+                    return i;
+            }
+        }
+    }
+    else if (tok->toktype == TOK_OP && tok->op == OP_CONDITIONAL_IF_ELSE
+             && stack[ends[0]].toktype == TOK_CONST) {
+        i = replace_with_operand(stack, top, const_tok_is_zero(stack[ends[0]])
+                                 ? ends[1] : ends[0], out, len, num_cached);
+        if (i >= 0)
+            return i;
+    }
+    else if (tok->toktype == TOK_FUNC && tok->func == FUNC_POW
+             && stack[ends[1]].toktype == TOK_CONST
+             && stack[ends[1]].datatype == tok->datatype
+             && !stack[ends[1]].casttype
+             && effective_type(&stack[ends[0]]) == tok->datatype) {
+        double exponent = (stack[ends[1]].datatype == 'f' ? stack[ends[1]].f
+                           : stack[ends[1]].d);
+        if (exponent == 1
+            && (i = replace_with_operand(stack, top, ends[0], out, len,
+                                         num_cached)) >= 0)
+            return i;
+        if (exponent == 0.5) {
+            if ((len = rewrite_subexpr(stack, ends[0], out, len,
+                                       num_cached)) < 0)
+                return -1;
+            newtok = *tok;
+            newtok.func = FUNC_SQRT;
+            EMIT(&newtok);
+            return len;
+        }
+        if (exponent == 2 || exponent == 3 || exponent == 4) {
+            int start = len;
+            if ((len = rewrite_subexpr(stack, ends[0], out, len,
+                                       num_cached)) < 0)
+                return -1;
+            mapper_token_t base = out[len - 1];
+            if (len - start > 1) {
+                // evaluate the base once and reuse its value
+                newtok = base;
+                newtok.toktype = TOK_CACHE;
+                newtok.datatype = effective_type(&base);
+                newtok.casttype = 0;
+                newtok.cache_index = (*num_cached)++;
+                EMIT(&newtok);
+                newtok.toktype = TOK_CACHED;
+                base = newtok;
+            }
+            for (i = 1; i < exponent; i++) {
+                EMIT(&base);
+                newtok = *tok;
+                newtok.toktype = TOK_OP;
+                newtok.op = OP_MULTIPLY;
+                if (i < exponent - 1)
+                    newtok.casttype = 0;
+                EMIT(&newtok);
+            }
+            return len;
+        }
+    }
+    else if (tok->toktype == TOK_OP && tok->op == OP_DIVIDE
+             && tok->datatype != 'i' && stack[ends[1]].toktype == TOK_CONST
+             && stack[ends[1]].datatype == tok->datatype
+             && !stack[ends[1]].casttype) {
+        // multiplying by the inverse is exact for powers of two
+        int exp;
+        double divisor = (stack[ends[1]].datatype == 'f' ? stack[ends[1]].f
+                          : stack[ends[1]].d);
+        if (divisor != 0 && fabs(frexp(divisor, &exp)) == 0.5) {
+            if ((len = rewrite_subexpr(stack, ends[0], out, len,
+                                       num_cached)) < 0)
+                return -1;
+            newtok = stack[ends[1]];
+            if (newtok.datatype == 'f')
+                newtok.f = 1.f / newtok.f;
+            else
+                newtok.d = 1.0 / newtok.d;
+            EMIT(&newtok);
+            newtok = *tok;
+            newtok.op = OP_MULTIPLY;
+            EMIT(&newtok);
+            return len;
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if ((len = rewrite_subexpr(stack, ends[i], out, len, num_cached)) < 0)
+            return -1;
+    }
+    EMIT(tok);
+    return len;
+}
+
+static int replace_with_operand(mapper_token_t *stack, int top, int operand,
+                                mapper_token_t *out, int len, int *num_cached)
+{
+    mapper_token_t *tok = &stack[top];
+    if (stack[operand].vector_length != tok->vector_length
+        || effective_type(&stack[operand]) != tok->datatype
+        || (tok->casttype && stack[operand].casttype))
+        return -1;
+    if ((len = rewrite_subexpr(stack, operand, out, len, num_cached)) < 0)
+        return -1;
+    if (tok->casttype)
+        out[len - 1].casttype = tok->casttype;
+    return len;
+}
+
+/* Evaluate repeated subexpressions once: the first occurrence is followed by
+ * a TOK_CACHE token, and later occurrences are replaced by TOK_CACHED. The
+ * largest repeated subexpressions are replaced first. Returns the new length
+ * of the stack. */
+static int eliminate_common_subexprs(mapper_token_t *stack, int length,
+                                     int *num_cached)
+{
+    int i, j, k, start[length], found;
+    mapper_token_t out[STACK_SIZE];
+
+    do {
+        int best = -1, best_size = 1, count = 0;
+        for (i = 0; i < length; i++)
+            start[i] = subexpr_start(stack, i);
+
+        for (i = 0; i < length; i++) {
+            int size = i - start[i] + 1;
+            if (size <= best_size || !subexpr_is_pure(stack, start[i], i))
+                continue;
+            for (j = i + size; j < length; j++) {
+                if (j - start[j] + 1 == size
+                    && subexprs_equal(stack, i, j, size)) {
+                    best = i;
+                    best_size = size;
+                    break;
+                }
+            }
+        }
+        if (best < 0)
+            break;
+
+        // count the occurrences that will be replaced
+        for (j = best + best_size; j < length; j++) {
+            if (j - start[j] + 1 == best_size
+                && subexprs_equal(stack, best, j, best_size))
+                ++count;
+        }
+        if (length + 1 - count * (best_size - 1) > STACK_SIZE)
+            break;
+
+        k = 0;
+        for (i = 0; i < length; i++) {
+            found = (i > best && i - start[i] + 1 == best_size
+                     && subexprs_equal(stack, best, i, best_size));
+            if (found) {
+                // drop the copy of the subexpression
+                k -= best_size - 1;
+                out[k] = stack[best];
+                out[k].toktype = TOK_CACHED;
+                out[k].datatype = effective_type(&stack[best]);
+                out[k].casttype = 0;
+                out[k].cache_index = *num_cached;
+                ++k;
+                continue;
+            }
+            out[k++] = stack[i];
+            if (i == best) {
+                out[k] = out[k - 1];
+                out[k].toktype = TOK_CACHE;
+                out[k].datatype = effective_type(&stack[best]);
+                out[k].casttype = 0;
+                out[k].cache_index = *num_cached;
+                ++k;
+            }
+        }
+        ++(*num_cached);
+        memcpy(stack, out, sizeof(mapper_token_t) * k);
+        length = k;
+    } while (1);
+
+    return length;
+}
+
+/* Remove statements assigning to user-defined variables whose values are
+ * never read. */
+static int remove_unused_assignments(mapper_token_t *stack, int length)
+{
+    int i, j, start = 0, end, used;
+    for (i = 0; i < length; i++) {
+        if (stack[i].toktype != TOK_ASSIGNMENT)
+            continue;
+        end = i;
+        while (end + 1 < length && stack[end + 1].toktype == TOK_ASSIGNMENT)
+            ++end;
+        if (stack[i].var < VAR_Y) {
+            used = 0;
+            for (j = 0; j < length && !used; j++) {
+                if ((j < start || j > end) && stack[j].toktype == TOK_VAR
+                    && stack[j].var == stack[i].var)
+                    used = 1;
+            }
+            if (!used) {
+                memmove(stack + start, stack + end + 1,
+                        sizeof(mapper_token_t) * (length - end - 1));
+                length -= end - start + 1;
+                // removing this statement may leave others unused
+                i = -1;
+                start = 0;
+                continue;
+            }
+        }
+        i = end;
+        start = end + 1;
+    }
+    return length;
+}
+
+/* Optimize each statement of a parsed expression. Returns the new length of
+ * the stack. */
+static int optimize(mapper_token_t *stack, int length, int *num_cached)
+{
+    mapper_token_t out[STACK_SIZE], rewritten[STACK_SIZE];
+    int i, start = 0, end, len = 0, n;
+
+    length = remove_unused_assignments(stack, length);
+
+    for (i = 0; i < length; i++) {
+        if (stack[i].toktype != TOK_ASSIGNMENT)
+            continue;
+        end = i;
+        while (end + 1 < length && stack[end + 1].toktype == TOK_ASSIGNMENT)
+            ++end;
+
+        // rewrite the expression, then share its repeated subexpressions
+        n = -1;
+        if (i > start && subexpr_start(stack, i - 1) == start)
+            n = rewrite_subexpr(stack, i - 1, rewritten, 0, num_cached);
+        if (n < 0) {
+            n = i - start;
+            memcpy(rewritten, stack + start, sizeof(mapper_token_t) * n);
+        }
+        n = eliminate_common_subexprs(rewritten, n, num_cached);
+        if (len + n + end - i + 1 > STACK_SIZE)
+            return length;
+        memcpy(out + len, rewritten, sizeof(mapper_token_t) * n);
+        len += n;
+        memcpy(out + len, stack + i, sizeof(mapper_token_t) * (end - i + 1));
+        len += end - i + 1;
+
+        i = end;
+        start = end + 1;
+    }
+    if (start != length)
+        return length;
+
+    memcpy(stack, out, sizeof(mapper_token_t) * len);
+    return len;
+}
+
 /* Macros to help express stack operations in parser. */
 #define FAIL(msg) {                                                 \
     parse_error("%s\n", msg);                                       \
@@ -1736,6 +2202,41 @@ mapper_expr mapper_expr_new_from_string(const char *str, int num_inputs,
                 allow_toktype = OBJECT_TOKENS;
                 break;
             case TOK_CLOSE_PAREN:
+                if (outstack_index >= 0
+                    && outstack[outstack_index].toktype == TOK_VAR
+                    && outstack[outstack_index].var >= VAR_X
+                    && outstack[outstack_index].window
+                    && outstack[outstack_index].window_func == VFUNC_UNKNOWN) {
+                    /* Replace the enclosing reduction with an incremental
+                     * computation over the history window. */
+                    int vfunc = VFUNC_UNKNOWN;
+                    if (opstack_index < 1
+                        || opstack[opstack_index].toktype != TOK_OPEN_PAREN
+                        || opstack[opstack_index].arity != 1)
+                        {FAIL("Misplaced history window.");}
+                    mapper_token_t *f = &opstack[opstack_index-1];
+                    if (f->toktype == TOK_VFUNC)
+                        vfunc = f->vfunc;
+                    else if (f->toktype == TOK_FUNC && f->func == FUNC_MIN)
+                        vfunc = VFUNC_MIN;
+                    else if (f->toktype == TOK_FUNC && f->func == FUNC_MAX)
+                        vfunc = VFUNC_MAX;
+                    if (vfunc != VFUNC_SUM && vfunc != VFUNC_MEAN
+                        && vfunc != VFUNC_MIN && vfunc != VFUNC_MAX)
+                        {FAIL("History windows require sum, mean, min or max.");}
+                    outstack[outstack_index].window_func = vfunc;
+                    if (vfunc == VFUNC_MEAN && outstack[outstack_index].datatype == 'i')
+                        outstack[outstack_index].datatype = 'f';
+                    // remove left parenthesis and function from operator stack
+                    POP_OPERATOR();
+                    POP_OPERATOR();
+                    if (opstack_index >= 0
+                        && opstack[opstack_index].toktype == TOK_ASSIGN_USE)
+                        POP_OPERATOR_TO_OUTPUT();
+                    allow_toktype = (TOK_OP | TOK_COLON | TOK_SEMICOLON | TOK_COMMA
+                                     | TOK_CLOSE_PAREN | TOK_CLOSE_SQUARE);
+                    break;
+                }
                 // pop from operator stack to output until left parenthesis found
                 while (opstack_index >= 0 && opstack[opstack_index].toktype != TOK_OPEN_PAREN) {
                     POP_OPERATOR_TO_OUTPUT();
@@ -1930,13 +2431,13 @@ mapper_expr mapper_expr_new_from_string(const char *str, int num_inputs,
                     if (outstack[outstack_index].history_index > -1)
                         {FAIL("Output history index cannot be > -1.");}
                     else if (outstack[outstack_index].history_index < MAX_HISTORY)
-                        {FAIL("Output history index cannot be < -100.");}
+                        {FAIL("Output history index cannot be < -4096.");}
                 }
                 else {
                     if (outstack[outstack_index].history_index > 0)
                     {FAIL("Input history index cannot be > 0.");}
                     else if (outstack[outstack_index].history_index < MAX_HISTORY)
-                    {FAIL("Input history index cannot be < -100.");}
+                    {FAIL("Input history index cannot be < -4096.");}
                 }
                 if (outstack[outstack_index].var == VAR_X) {
                     if (outstack[outstack_index].history_index < oldest_input)
@@ -1954,9 +2455,29 @@ mapper_expr mapper_expr_new_from_string(const char *str, int num_inputs,
                         variables[var_idx].history_size = hist_idx * -1 + 1;
                 }
                 GET_NEXT_TOKEN(tok);
+                if (tok.toktype == TOK_COLON) {
+                    // history window x{-N:0} covering the last N+1 samples
+                    if (outstack[outstack_index].var < VAR_X)
+                        {FAIL("History windows are only supported for inputs.");}
+                    if (outstack[outstack_index].history_index >= 0)
+                        {FAIL("Malformed history window.");}
+                    GET_NEXT_TOKEN(tok);
+                    if (tok.toktype != TOK_CONST || tok.datatype != 'i' || tok.i)
+                        {FAIL("History window must end at index 0.");}
+                    outstack[outstack_index].window =
+                        1 - outstack[outstack_index].history_index;
+                    outstack[outstack_index].window_func = VFUNC_UNKNOWN;
+                    outstack[outstack_index].vector_length_locked = 1;
+                    GET_NEXT_TOKEN(tok);
+                }
                 if (tok.toktype != TOK_CLOSE_CURLY)
                     {FAIL("Unmatched brace.");}
                 variable &= ~TOK_OPEN_CURLY;
+                if (outstack[outstack_index].window) {
+                    // windows must be the sole argument of a reduction
+                    allow_toktype = TOK_CLOSE_PAREN;
+                    break;
+                }
                 allow_toktype = (TOK_OP | TOK_COMMA | TOK_CLOSE_PAREN
                                  | TOK_CLOSE_SQUARE | TOK_COLON | TOK_SEMICOLON
                                  | variable | (assigning ? TOK_ASSIGNMENT : 0));
@@ -2088,6 +2609,10 @@ mapper_expr mapper_expr_new_from_string(const char *str, int num_inputs,
     printstack("--->OPERATOR STACK:", opstack, opstack_index);
 #endif
 
+    int num_cached = 0;
+    if (optimization_enabled)
+        outstack_index = optimize(outstack, outstack_index + 1, &num_cached) - 1;
+
     // Check for maximum vector length used in stack
     for (i = 0; i < outstack_index; i++) {
         if (outstack[i].vector_length > max_vector)
@@ -2104,6 +2629,19 @@ mapper_expr mapper_expr_new_from_string(const char *str, int num_inputs,
     expr->start = expr->tokens;
     expr->vector_size = max_vector;
     expr->output_history_size = -oldest_output+1;
+    expr->stack = malloc(sizeof(mapper_value_t) * expr->length * max_vector);
+    expr->dims = malloc(sizeof(int) * expr->length);
+    expr->num_cached = num_cached;
+    expr->cache = (num_cached ? malloc(sizeof(mapper_value_t) * num_cached
+                                       * max_vector) : 0);
+
+    // number history windows so that their state can be found when evaluating
+    expr->num_windows = 0;
+    for (i = 0; i < expr->length; i++) {
+        if (expr->tokens[i].toktype == TOK_VAR && expr->tokens[i].var >= VAR_X
+            && expr->tokens[i].window)
+            expr->tokens[i].window_index = expr->num_windows++;
+    }
     expr->constant_output = constant_output;
 
     if (num_variables) {
@@ -2122,8 +2660,10 @@ int mapper_expr_input_history_size(mapper_expr expr, int index)
     mapper_token_t *tok = expr->tokens;
     for (i = 0; i < expr->length; i++) {
         if (tok[i].toktype == TOK_VAR && tok[i].var == var) {
-            if (tok[i].history_index > size)
-                size = tok[i].history_index;
+            // windows also need the sample that is leaving the window
+            int oldest = -tok[i].history_index + (tok[i].window ? 1 : 0);
+            if (oldest > size)
+                size = oldest;
         }
     }
     return size + 1;
@@ -2221,6 +2761,135 @@ static const char *type_name(const char type)
 }
 #endif
 
+/* Read element 'el' of the sample numbered 'count' from an input history. */
+static double window_sample(mapper_history h, uint32_t count, int el)
+{
+    int idx = (h->position - (int)(h->count - count)) & (h->size - 1);
+    void *v = h->value + idx * h->length * mapper_type_size(h->type);
+    switch (h->type) {
+        case 'i':
+            return ((int*)v)[el];
+        case 'f':
+            return ((float*)v)[el];
+        default:
+            return ((double*)v)[el];
+    }
+}
+
+static void free_window(mapper_history_window w)
+{
+    if (w->sum)
+        free(w->sum);
+    if (w->deque)
+        free(w->deque);
+    if (w->head)
+        free(w->head);
+    if (w->tail)
+        free(w->tail);
+    memset(w, 0, sizeof(mapper_history_window_t));
+}
+
+/* Restart accumulation from the oldest sample still inside the window. */
+static void reset_window(mapper_history_window w, uint32_t count)
+{
+    w->count = w->base = count > w->size ? count - w->size : 0;
+    if (w->sum)
+        memset(w->sum, 0, sizeof(double) * w->length);
+    else {
+        memset(w->head, 0, sizeof(uint32_t) * w->length);
+        memset(w->tail, 0, sizeof(uint32_t) * w->length);
+    }
+}
+
+static void init_window(mapper_history_window w, mapper_token tok,
+                        uint32_t count)
+{
+    free_window(w);
+    w->size = tok->window;
+    w->offset = tok->vector_index;
+    w->length = tok->vector_length;
+    w->func = tok->window_func;
+    if (w->func == VFUNC_SUM || w->func == VFUNC_MEAN)
+        w->sum = calloc(1, sizeof(double) * w->length);
+    else {
+        // the deque briefly holds one sample more than the window
+        w->capacity = mapper_history_capacity(w->size + 1);
+        w->deque = malloc(sizeof(uint32_t) * w->capacity * w->length);
+        w->head = calloc(1, sizeof(uint32_t) * w->length);
+        w->tail = calloc(1, sizeof(uint32_t) * w->length);
+    }
+    reset_window(w, count);
+}
+
+/* Bring a window up to date with the samples written to its history since
+ * it was last evaluated. Each sample is added and removed exactly once, so
+ * the cost per update does not depend on the window size. */
+static void update_window(mapper_history h, mapper_history_window w)
+{
+    uint32_t c, mask = w->capacity - 1;
+    int e;
+
+    if (h->count < w->count || h->count - w->count > h->size - w->size) {
+        // history was reset, or samples leaving the window were overwritten
+        reset_window(w, h->count);
+    }
+    for (c = w->count + 1; w->count != h->count; c++, w->count++) {
+        for (e = 0; e < w->length; e++) {
+            int el = e + w->offset;
+            double v = window_sample(h, c, el);
+            if (w->sum) {
+                w->sum[e] += v;
+                if (c > w->size && c - w->size > w->base)
+                    w->sum[e] -= window_sample(h, c - w->size, el);
+                continue;
+            }
+            uint32_t *d = w->deque + e * w->capacity;
+            while (w->tail[e] != w->head[e]) {
+                double last = window_sample(h, d[(w->tail[e] - 1) & mask], el);
+                if (w->func == VFUNC_MAX ? last > v : last < v)
+                    break;
+                --w->tail[e];
+            }
+            d[w->tail[e]++ & mask] = c;
+            while (d[w->head[e] & mask] + w->size <= c)
+                ++w->head[e];
+        }
+    }
+}
+
+/* Compute element 'e' of a windowed reduction. */
+static double window_value(mapper_history h, mapper_history_window w, int e)
+{
+    uint32_t first;
+    switch (w->func) {
+        case VFUNC_SUM:
+            return w->sum[e];
+        case VFUNC_MEAN:
+            first = h->count > w->size ? h->count - w->size : 0;
+            if (first < w->base)
+                first = w->base;
+            return h->count > first ? w->sum[e] / (h->count - first) : 0;
+        default:
+            if (w->head[e] == w->tail[e])
+                return 0;
+            return window_sample(h, w->deque[e * w->capacity
+                                             + (w->head[e] & (w->capacity - 1))],
+                                 e + w->offset);
+    }
+}
+
+void mapper_expr_free_history_windows(mapper_history h)
+{
+    int i;
+    if (!h->windows)
+        return;
+    for (i = 0; i < h->num_windows; i++)
+        free_window(&h->windows[i]);
+    free(h->windows);
+    h->windows = 0;
+    h->num_windows = 0;
+}
+
 int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                          mapper_history *expr_vars, mapper_history output,
                          mapper_timetag_t *tt, char *typestring)
@@ -2237,8 +2906,9 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
         tok += expr->start_offset;
         length -= expr->start_offset;
     }
-    mapper_value_t stack[length][expr->vector_size];
-    int dims[length];
+    mapper_value_t (*stack)[expr->vector_size] = (void*)expr->stack;
+    mapper_value_t (*cache)[expr->vector_size] = (void*)expr->cache;
+    int *dims = expr->dims;
 
     int i, j, k, top = -1, count = 0, found, updated = 0;
 
@@ -2247,7 +2917,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
         memset(typestring, 'N', output->length);
 
     /* Increment index position of output data structure. */
-    output->position = (output->position + 1) % output->size;
+    output->position = (output->position + 1) & (output->size - 1);
 
     for (i = 0; i < expr->num_variables; i++)
         expr->variables[i].assigned = 0;
@@ -2287,8 +2957,8 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
             if (tok->var == VAR_Y) {
                 ++top;
                 dims[top] = tok->vector_length;
-                idx = ((tok->history_index + output->position
-                        + output->size) % output->size);
+                idx = ((tok->history_index + output->position)
+                       & (output->size - 1));
                 switch (output->type) {
                 case 'f': {
                     float *v = (output->value + idx * output->length
@@ -2319,13 +2989,57 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                        tok->vector_index);
                 print_stack_vector(stack[top], tok->datatype, tok->vector_length);
                 printf(" \n");
+#endif
+            }
+            else if (tok->var >= VAR_X && tok->window) {
+                ++top;
+                dims[top] = tok->vector_length;
+                mapper_history h = input[tok->var-VAR_X];
+                if (h->size <= tok->window)
+                    goto error;
+                if (h->num_windows < expr->num_windows) {
+                    h->windows = realloc(h->windows, sizeof(mapper_history_window_t)
+                                         * expr->num_windows);
+                    memset(h->windows + h->num_windows, 0,
+                           sizeof(mapper_history_window_t)
+                           * (expr->num_windows - h->num_windows));
+                    h->num_windows = expr->num_windows;
+                }
+                mapper_history_window w = &h->windows[(int)tok->window_index];
+                if (w->size != tok->window || w->func != tok->window_func
+                    || w->offset != tok->vector_index
+                    || w->length != tok->vector_length)
+                    init_window(w, tok, h->count);
+                update_window(h, w);
+                switch (tok->datatype) {
+                case 'f':
+                    for (i = 0; i < tok->vector_length; i++)
+                        stack[top][i].f = window_value(h, w, i);
+                    break;
+                case 'i':
+                    for (i = 0; i < tok->vector_length; i++)
+                        stack[top][i].i32 = window_value(h, w, i);
+                    break;
+                case 'd':
+                    for (i = 0; i < tok->vector_length; i++)
+                        stack[top][i].d = window_value(h, w, i);
+                    break;
+                default:
+                    goto error;
+                }
+#if TRACING
+                printf("loading %s of window x%d{%d:0}[%d] ",
+                       vfunction_table[(int)tok->window_func].name,
+                       tok->var-VAR_X, tok->history_index, tok->vector_index);
+                print_stack_vector(stack[top], tok->datatype, tok->vector_length);
+                printf(" \n");
 #endif
             }
             else if (tok->var >= VAR_X) {
                 ++top;
                 dims[top] = tok->vector_length;
                 mapper_history h = input[tok->var-VAR_X];
-                idx = ((tok->history_index + h->position + h->size) % h->size);
+                idx = ((tok->history_index + h->position) & (h->size - 1));
                 switch (h->type) {
                 case 'f': {
                     float *v = (h->value + idx * h->length
@@ -2364,8 +3078,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                 dims[top] = tok->vector_length;
                 mapper_variable var = &expr->variables[tok->var];
                 mapper_history h = *expr_vars + (tok->var);
-                idx = ((tok->history_index + h->position
-                        + var->history_size) % var->history_size);
+                idx = ((tok->history_index + h->position) & (h->size - 1));
                 double *v = h->value + idx * var->vector_length * mapper_type_size(var->datatype);
                 for (i = 0; i < tok->vector_length; i++)
                     stack[top][i].d = v[i+tok->vector_index];
@@ -2934,6 +3647,21 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
             printf("built %i-element vector: ", tok->vector_length);
             print_stack_vector(stack[top], tok->datatype, tok->vector_length);
             printf(" \n");
+#endif
+            break;
+        case TOK_CACHE:
+            memcpy(cache[tok->cache_index], stack[top],
+                   sizeof(mapper_value_t) * tok->vector_length);
+            break;
+        case TOK_CACHED:
+            ++top;
+            dims[top] = tok->vector_length;
+            memcpy(stack[top], cache[tok->cache_index],
+                   sizeof(mapper_value_t) * tok->vector_length);
+#if TRACING
+            printf("loading cached value %d ", tok->cache_index);
+            print_stack_vector(stack[top], tok->datatype, tok->vector_length);
+            printf(" \n");
 #endif
             break;
         case TOK_ASSIGNMENT:
@@ -2951,11 +3679,8 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
 #endif
             updated++;
             if (tok->var == VAR_Y) {
-                int idx = (tok->history_index + output->position + output->size);
-                if (idx < 0)
-                    idx = output->size - idx;
-                else
-                    idx %= output->size;
+                int idx = ((tok->history_index + output->position)
+                           & (output->size - 1));
 
                 switch (output->type) {
                 case 'f': {
@@ -2996,11 +3721,11 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
                 mapper_history h = *expr_vars + tok->var;
 
                 // increment position
-                h->position = (h->position + 1) % h->size;
+                h->position = (h->position + 1) & (h->size - 1);
 
                 mapper_variable var = &expr->variables[tok->var];
-                int idx = (tok->history_index + h->position
-                           + var->history_size) % var->history_size;
+                int idx = ((tok->history_index + h->position)
+                           & (h->size - 1));
                 double *v = h->value + idx * var->vector_length * mapper_type_size(var->datatype);
                 for (i = 0; i < tok->vector_length; i++)
                     v[i + tok->vector_index] = stack[top][i + tok->assignment_offset].d;
@@ -3092,7 +3817,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
          * so we need to copy to output here. */
 
         /* Increment index position of output data structure. */
-        output->position = (output->position + 1) % output->size;
+        output->position = (output->position + 1) & (output->size - 1);
 
         switch (output->type) {
         case 'f': {
@@ -3121,9 +3846,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
 
     /* Undo position increment if nothing was updated. */
     if (!updated) {
-        --output->position;
-        if (output->position < 0)
-            output->position = output->size - 1;
+        output->position = (output->position - 1) & (output->size - 1);
         return 0;
     }
     else if (tt) {
@@ -3140,7 +3863,7 @@ int mapper_expr_evaluate(mapper_expr expr, mapper_history *input,
 #endif
             // increment position
             mapper_history h = *expr_vars + i;
-            h->position = (h->position + 1) % h->size;
+            h->position = (h->position + 1) & (h->size - 1);
         }
     }
 
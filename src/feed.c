@@ -0,0 +1,184 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* A change feed logs the changes to database records so that they can be
+ * read in batches rather than handled one at a time by callbacks. While a
+ * change is waiting to be read, later changes to the same record are merged
+ * into it: a record that is added and then modified is reported once as
+ * added, and a record that is added and then removed is not reported at all.
+ * Pending changes are found using a hash table of log positions, which is
+ * kept at twice the size of the log and uses linear probing. Changes to
+ * records whose id is zero are never merged. If the log fills up, pending
+ * changes are discarded and the consumer is told to read all records
+ * again. */
+
+#define MIN_FEED_CAPACITY 16
+
+static uint32_t hash_change(mapper_object_type type, mapper_id id)
+{
+    uint64_t h = (id ^ (id >> 29) ^ type) * 0x9E3779B97F4A7C15ULL;
+    return (uint32_t)(h >> 32);
+}
+
+/* Find the index slot holding the pending change for a record, or the empty
+ * slot where it would be stored. */
+static uint32_t find_slot(mapper_change_feed feed, mapper_object_type type,
+                          mapper_id id)
+{
+    uint32_t mask = feed->capacity * 2 - 1;
+    uint32_t i = hash_change(type, id) & mask;
+    while (feed->index[i]) {
+        mapper_change_t *c = &feed->log[feed->index[i] - 1];
+        if (c->id == id && c->type == type)
+            break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+/* Empty an index slot, moving later slots back so that no probe sequence is
+ * broken. */
+static void remove_slot(mapper_change_feed feed, uint32_t i)
+{
+    uint32_t mask = feed->capacity * 2 - 1, j = i, k;
+    while (1) {
+        j = (j + 1) & mask;
+        if (!feed->index[j])
+            break;
+        mapper_change_t *c = &feed->log[feed->index[j] - 1];
+        k = hash_change(c->type, c->id) & mask;
+        // move the slot unless its home lies cyclically within (i, j]
+        if (j > i ? (k <= i || k > j) : (k <= i && k > j)) {
+            feed->index[i] = feed->index[j];
+            i = j;
+        }
+    }
+    feed->index[i] = 0;
+}
+
+static void feed_change(mapper_change_feed feed, mapper_object_type type,
+                        mapper_id id, mapper_record_event event)
+{
+    uint32_t slot = find_slot(feed, type, id), pos;
+    // records whose id is not yet known cannot be told apart
+    if (feed->index[slot] && id) {
+        mapper_change_t *c = &feed->log[feed->index[slot] - 1];
+        switch (c->event) {
+            case MAPPER_ADDED:
+                if (event == MAPPER_MODIFIED)
+                    return;
+                if (event == MAPPER_REMOVED) {
+                    // the consumer never needs to see this record
+                    remove_slot(feed, slot);
+                    c->type = MAPPER_OBJ_NONE;
+                    return;
+                }
+                // log an expiry separately, since it may not be a removal
+                break;
+            case MAPPER_MODIFIED:
+                if (event != MAPPER_ADDED)
+                    c->event = event;
+                return;
+            default:
+                // a removed record has been added again
+                if (event == MAPPER_ADDED)
+                    event = MAPPER_MODIFIED;
+                c->event = event;
+                return;
+        }
+    }
+    if (feed->tail - feed->head >= feed->capacity) {
+        // discard all pending changes and ask the consumer to resync
+        memset(feed->index, 0, feed->capacity * 2 * sizeof(uint32_t));
+        feed->head = feed->tail;
+        feed->resync = 1;
+        slot = find_slot(feed, type, id);
+    }
+    pos = feed->tail++ & (feed->capacity - 1);
+    feed->log[pos].id = id;
+    feed->log[pos].type = type;
+    feed->log[pos].event = event;
+    if (id)
+        feed->index[slot] = pos + 1;
+}
+
+void mapper_database_log_change(mapper_database db, mapper_object_type type,
+                                mapper_id id, mapper_record_event event)
+{
+    mapper_change_feed feed = db->change_feeds;
+    while (feed) {
+        if (feed->flags & type)
+            feed_change(feed, type, id, event);
+        feed = feed->next;
+    }
+}
+
+mapper_change_feed mapper_database_add_change_feed(mapper_database db,
+                                                   int flags, int capacity)
+{
+    int size = MIN_FEED_CAPACITY;
+    while (size < capacity)
+        size <<= 1;
+
+    mapper_change_feed feed = ((mapper_change_feed)
+                               calloc(1, sizeof(mapper_change_feed_t)));
+    feed->log = (mapper_change_t*) malloc(size * sizeof(mapper_change_t));
+    feed->index = (uint32_t*) calloc(size * 2, sizeof(uint32_t));
+    feed->capacity = size;
+    feed->flags = flags;
+    feed->next = db->change_feeds;
+    db->change_feeds = feed;
+    return feed;
+}
+
+void mapper_database_remove_change_feed(mapper_database db,
+                                        mapper_change_feed feed)
+{
+    mapper_change_feed *prev = &db->change_feeds;
+    while (*prev && *prev != feed)
+        prev = &(*prev)->next;
+    if (!*prev)
+        return;
+    *prev = feed->next;
+    free(feed->log);
+    free(feed->index);
+    free(feed);
+}
+
+int mapper_change_feed_read(mapper_change_feed feed, mapper_change_t *changes,
+                            int num)
+{
+    int count = 0;
+    uint32_t pos, slot;
+    mapper_change_t *c;
+
+    if (feed->resync && num > 0) {
+        changes[count].id = 0;
+        changes[count].type = MAPPER_OBJ_ALL;
+        changes[count].event = MAPPER_MODIFIED;
+        ++count;
+        feed->resync = 0;
+    }
+    while (count < num && feed->head != feed->tail) {
+        pos = feed->head++ & (feed->capacity - 1);
+        c = &feed->log[pos];
+        if (c->type == MAPPER_OBJ_NONE)
+            continue;
+        // later changes to the record may have been logged separately
+        slot = find_slot(feed, c->type, c->id);
+        if (feed->index[slot] == pos + 1)
+            remove_slot(feed, slot);
+        changes[count++] = *c;
+    }
+    return count;
+}
+
+int mapper_change_feed_num_pending(mapper_change_feed feed)
+{
+    return feed->tail - feed->head + (feed->resync ? 1 : 0);
+}
@@ -0,0 +1,299 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* A subscription filter is sent along with a /subscribe message and stored
+ * with the subscriber by the device, which then only sends the subscriber
+ * messages about signals that match the filter, and about maps which connect
+ * a matching signal. Filters are encoded as extra subscription arguments:
+ *
+ *   @name <pattern>
+ *   @where <property> <op> <length> <values...>
+ */
+
+static int supported_type(char type)
+{
+    return strchr("ifdsh", type) != 0;
+}
+
+static void *copy_value(int length, char type, const void *value)
+{
+    int i;
+    if (type != 's') {
+        void *copy = malloc(mapper_type_size(type) * length);
+        memcpy(copy, value, mapper_type_size(type) * length);
+        return copy;
+    }
+    if (length == 1)
+        return strdup((const char*)value);
+    char **from = (char**)value, **to = malloc(sizeof(char*) * length);
+    for (i = 0; i < length; i++)
+        to[i] = strdup(from[i]);
+    return to;
+}
+
+static void free_value(int length, char type, void *value)
+{
+    int i;
+    if (!value)
+        return;
+    if (type == 's' && length > 1) {
+        for (i = 0; i < length; i++)
+            free(((char**)value)[i]);
+    }
+    free(value);
+}
+
+mapper_subscription_filter mapper_subscription_filter_new(const char *pattern)
+{
+    mapper_subscription_filter filter;
+    filter = (mapper_subscription_filter) calloc(1,
+        sizeof(mapper_subscription_filter_t));
+    if (pattern)
+        filter->pattern = strdup(pattern);
+    return filter;
+}
+
+int mapper_subscription_filter_add_predicate(mapper_subscription_filter filter,
+                                             const char *property,
+                                             mapper_op op, int length,
+                                             char type, const void *value)
+{
+    if (!filter || !property || op <= MAPPER_OP_UNDEFINED
+        || op >= NUM_MAPPER_OPS)
+        return 1;
+    if (op == MAPPER_OP_EXISTS || op == MAPPER_OP_DOES_NOT_EXIST) {
+        length = 0;
+        type = 0;
+    }
+    else if (length < 1 || !value || !supported_type(type))
+        return 1;
+
+    filter->predicates = realloc(filter->predicates,
+                                 sizeof(mapper_subscription_predicate_t)
+                                 * (filter->num_predicates + 1));
+    mapper_subscription_predicate_t *p;
+    p = &filter->predicates[filter->num_predicates++];
+    p->property = strdup(property);
+    p->op = op;
+    p->length = length;
+    p->type = type;
+    p->value = length ? copy_value(length, type, value) : 0;
+    return 0;
+}
+
+void mapper_subscription_filter_free(mapper_subscription_filter filter)
+{
+    int i;
+    if (!filter)
+        return;
+    for (i = 0; i < filter->num_predicates; i++) {
+        mapper_subscription_predicate_t *p = &filter->predicates[i];
+        free(p->property);
+        free_value(p->length, p->type, p->value);
+    }
+    if (filter->predicates)
+        free(filter->predicates);
+    if (filter->pattern)
+        free(filter->pattern);
+    free(filter);
+}
+
+mapper_subscription_filter mapper_subscription_filter_copy(
+    mapper_subscription_filter filter)
+{
+    int i;
+    if (!filter)
+        return 0;
+    mapper_subscription_filter copy;
+    copy = mapper_subscription_filter_new(filter->pattern);
+    for (i = 0; i < filter->num_predicates; i++) {
+        mapper_subscription_predicate_t *p = &filter->predicates[i];
+        mapper_subscription_filter_add_predicate(copy, p->property, p->op,
+                                                 p->length, p->type, p->value);
+    }
+    return copy;
+}
+
+int mapper_subscription_filter_equal(mapper_subscription_filter l,
+                                     mapper_subscription_filter r)
+{
+    int i;
+    if (!l || !r)
+        return l == r;
+    if (l->num_predicates != r->num_predicates)
+        return 0;
+    if (l->pattern ? !r->pattern || strcmp(l->pattern, r->pattern)
+        : r->pattern != 0)
+        return 0;
+    for (i = 0; i < l->num_predicates; i++) {
+        mapper_subscription_predicate_t *lp = &l->predicates[i];
+        mapper_subscription_predicate_t *rp = &r->predicates[i];
+        if (strcmp(lp->property, rp->property) || lp->op != rp->op
+            || lp->length != rp->length || lp->type != rp->type)
+            return 0;
+        if (lp->length && !mapper_compare_value(MAPPER_OP_EQUAL, lp->length,
+                                                lp->type, lp->value,
+                                                rp->value))
+            return 0;
+    }
+    return 1;
+}
+
+void mapper_subscription_filter_add_to_message(
+    mapper_subscription_filter filter, lo_message msg)
+{
+    int i, j;
+    if (!filter)
+        return;
+    if (filter->pattern) {
+        lo_message_add_string(msg, "@name");
+        lo_message_add_string(msg, filter->pattern);
+    }
+    for (i = 0; i < filter->num_predicates; i++) {
+        mapper_subscription_predicate_t *p = &filter->predicates[i];
+        lo_message_add_string(msg, "@where");
+        lo_message_add_string(msg, p->property);
+        lo_message_add_int32(msg, p->op);
+        lo_message_add_int32(msg, p->length);
+        for (j = 0; j < p->length; j++) {
+            switch (p->type) {
+                case 'i':
+                    lo_message_add_int32(msg, ((int*)p->value)[j]);
+                    break;
+                case 'f':
+                    lo_message_add_float(msg, ((float*)p->value)[j]);
+                    break;
+                case 'd':
+                    lo_message_add_double(msg, ((double*)p->value)[j]);
+                    break;
+                case 'h':
+                    lo_message_add_int64(msg, ((int64_t*)p->value)[j]);
+                    break;
+                case 's':
+                    lo_message_add_string(msg, p->length == 1
+                                          ? (const char*)p->value
+                                          : ((const char**)p->value)[j]);
+                    break;
+            }
+        }
+    }
+}
+
+int mapper_subscription_filter_parse(mapper_subscription_filter *filter,
+                                     const char *types, lo_arg **argv,
+                                     int argc)
+{
+    int i, length;
+    if (argc < 2 || (types[0] != 's' && types[0] != 'S'))
+        return 0;
+    if (strcmp(&argv[0]->s, "@name") == 0) {
+        if (types[1] != 's' && types[1] != 'S')
+            return 1;
+        if (!*filter)
+            *filter = mapper_subscription_filter_new(&argv[1]->s);
+        else {
+            if ((*filter)->pattern)
+                free((*filter)->pattern);
+            (*filter)->pattern = strdup(&argv[1]->s);
+        }
+        return 2;
+    }
+    if (strcmp(&argv[0]->s, "@where") != 0)
+        return 0;
+
+    // @where <property> <op> <length> <values...>
+    if (argc < 4 || (types[1] != 's' && types[1] != 'S') || types[2] != 'i'
+        || types[3] != 'i')
+        return 1;
+    length = argv[3]->i;
+    if (length < 0 || length > argc - 4)
+        return 4;
+    char type = length ? types[4] : 0;
+    for (i = 1; i < length; i++) {
+        if (types[4 + i] != type)
+            return 4 + length;
+    }
+    if (type == 'S')
+        type = 's';
+    if (length && !supported_type(type))
+        return 4 + length;
+
+    void *value = 0;
+    if (length) {
+        value = malloc(mapper_type_size(type) * length);
+        for (i = 0; i < length; i++) {
+            switch (type) {
+                case 'i': ((int*)value)[i] = argv[4 + i]->i;            break;
+                case 'f': ((float*)value)[i] = argv[4 + i]->f;          break;
+                case 'd': ((double*)value)[i] = argv[4 + i]->d;         break;
+                case 'h': ((int64_t*)value)[i] = argv[4 + i]->h;        break;
+                case 's': ((const char**)value)[i] = &argv[4 + i]->s;   break;
+            }
+        }
+    }
+    if (!*filter)
+        *filter = mapper_subscription_filter_new(0);
+    mapper_subscription_filter_add_predicate(*filter, &argv[1]->s,
+                                             argv[2]->i, length, type,
+                                             (type == 's' && length == 1)
+                                             ? *(const char**)value : value);
+    if (value)
+        free(value);
+    return 4 + length;
+}
+
+static int match_predicate(mapper_subscription_predicate_t *p,
+                           mapper_signal sig)
+{
+    int length;
+    char type;
+    const void *value;
+    if (mapper_signal_property(sig, p->property, &length, &type, &value))
+        return p->op == MAPPER_OP_DOES_NOT_EXIST;
+    if (p->op == MAPPER_OP_EXISTS)
+        return 1;
+    if (p->op == MAPPER_OP_DOES_NOT_EXIST)
+        return 0;
+    if (type != p->type || length != p->length)
+        return 0;
+    return mapper_compare_value(p->op, length, type, value, p->value);
+}
+
+int mapper_subscription_filter_match_signal(mapper_subscription_filter filter,
+                                            mapper_signal sig)
+{
+    int i;
+    if (!filter)
+        return 1;
+    if (filter->pattern && !mapper_match_pattern(sig->name, filter->pattern))
+        return 0;
+    for (i = 0; i < filter->num_predicates; i++) {
+        if (!match_predicate(&filter->predicates[i], sig))
+            return 0;
+    }
+    return 1;
+}
+
+int mapper_subscription_filter_match_map(mapper_subscription_filter filter,
+                                         mapper_map map, mapper_device dev)
+{
+    int i;
+    if (!filter)
+        return 1;
+    mapper_signal sig = map->destination.signal;
+    if (sig->device == dev && mapper_subscription_filter_match_signal(filter,
+                                                                      sig))
+        return 1;
+    for (i = 0; i < map->num_sources; i++) {
+        sig = map->sources[i]->signal;
+        if (sig->device == dev
+            && mapper_subscription_filter_match_signal(filter, sig))
+            return 1;
+    }
+    return 0;
+}
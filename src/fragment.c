@@ -0,0 +1,159 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lo/lo.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* Updates with more elements than MAPPER_FRAGMENT_LEN are sent as several
+ * messages, each tagged with "@fragment" followed by the offset of its first
+ * element and the length of the complete update. Fragments are collected
+ * per signal until every element has arrived. Only one update is kept for
+ * each link, instance and slot, so a fragment with a different timetag
+ * discards any earlier update from the same sender that is still
+ * incomplete. */
+
+void mapper_fragment_free(mapper_fragment f)
+{
+    if (f->types)
+        free(f->types);
+    if (f->values)
+        free(f->values);
+    free(f);
+}
+
+static mapper_fragment fragment_new(mapper_timetag_t tt, mapper_link link,
+                                    mapper_id global_id, int slot, int length)
+{
+    mapper_fragment f = (mapper_fragment) calloc(1, sizeof(mapper_fragment_t));
+    if (!f)
+        return 0;
+    f->types = calloc(1, length);
+    f->values = malloc(sizeof(lo_arg) * length);
+    if (!f->types || !f->values) {
+        mapper_fragment_free(f);
+        return 0;
+    }
+    f->timetag = tt;
+    f->link = link;
+    f->global_id = global_id;
+    f->slot = slot;
+    f->length = length;
+    return f;
+}
+
+mapper_fragment mapper_fragment_add(mapper_signal sig, mapper_timetag_t tt,
+                                    mapper_link link, mapper_id global_id,
+                                    int slot, int offset, int length,
+                                    const char *types, lo_arg **argv,
+                                    int count)
+{
+    int i;
+
+    if (offset < 0 || count < 1 || offset + count > length
+        || length > MAPPER_MAX_FRAGMENTED_LEN) {
+#ifdef DEBUG
+        printf("error in mapper_fragment_add: bad fragment bounds.\n");
+#endif
+        return 0;
+    }
+
+    mapper_fragment *prev = &sig->local->fragments, f = *prev;
+    while (f && (f->link != link || f->global_id != global_id
+                 || f->slot != slot)) {
+        prev = &f->next;
+        f = f->next;
+    }
+    if (f && (memcmp(&f->timetag, &tt, sizeof(mapper_timetag_t))
+              || f->length != length)) {
+        // a newer update has started, so drop the incomplete one
+        *prev = f->next;
+        mapper_fragment_free(f);
+        f = 0;
+    }
+    if (!f) {
+        if (!(f = fragment_new(tt, link, global_id, slot, length)))
+            return 0;
+        f->next = sig->local->fragments;
+        sig->local->fragments = f;
+        prev = &sig->local->fragments;
+    }
+
+    for (i = 0; i < count; i++) {
+        switch (types[i]) {
+            case 'i':
+            case 'f':
+                memcpy(&f->values[offset + i], argv[i], 4);
+                break;
+            case 'd':
+                memcpy(&f->values[offset + i], argv[i], 8);
+                break;
+            case 'N':
+                break;
+            default:
+#ifdef DEBUG
+                printf("error in mapper_fragment_add: unexpected type '%c'.\n",
+                       types[i]);
+#endif
+                return 0;
+        }
+        // duplicated fragments are only counted once
+        if (!f->types[offset + i])
+            ++f->received;
+        f->types[offset + i] = types[i];
+    }
+
+    if (f->received < f->length)
+        return 0;
+
+    // complete: remove from the list of pending updates
+    *prev = f->next;
+    f->next = 0;
+    return f;
+}
+
+lo_message mapper_fragment_message(mapper_fragment f)
+{
+    int i;
+    lo_message msg = lo_message_new();
+    if (!msg)
+        return 0;
+
+    for (i = 0; i < f->length; i++) {
+        switch (f->types[i]) {
+            case 'i':
+                lo_message_add_int32(msg, f->values[i].i);
+                break;
+            case 'f':
+                lo_message_add_float(msg, f->values[i].f);
+                break;
+            case 'd':
+                lo_message_add_double(msg, f->values[i].d);
+                break;
+            default:
+                lo_message_add_nil(msg);
+                break;
+        }
+    }
+    if (f->global_id) {
+        lo_message_add_string(msg, "@instance");
+        lo_message_add_int64(msg, f->global_id);
+    }
+    if (f->slot >= 0) {
+        lo_message_add_string(msg, "@slot");
+        lo_message_add_int32(msg, f->slot);
+    }
+    return msg;
+}
+
+void mapper_fragment_free_all(mapper_signal sig)
+{
+    while (sig->local->fragments) {
+        mapper_fragment f = sig->local->fragments;
+        sig->local->fragments = f->next;
+        mapper_fragment_free(f);
+    }
+}
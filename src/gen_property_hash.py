@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+"""Generate the perfect hash tables used by mapper_property_from_string().
+
+The names are read from static_properties in properties.c. Each name is
+hashed from its length and the values of its first, fifth and last
+characters, and this script searches for character values that give every
+name a distinct slot. Paste the printed tables over property_hash_values and
+property_hash_table in properties.c after adding or renaming a static
+property; testparser checks that every name is found again.
+
+usage: gen_property_hash.py [path/to/properties.c]
+"""
+
+import os
+import random
+import re
+import sys
+
+HASH_SIZE = 64
+MAX_ROUNDS = 1000000
+
+
+def read_names(path):
+    source = open(path).read()
+    table = re.search(r'static_properties\[\]\s*=\s*{(.*?)\n};', source,
+                      re.S).group(1)
+    names = re.findall(r'{\s*"@(\w+)"', table)
+    # the last entry is AT_EXTRA, which is not looked up by name
+    return names[:-1]
+
+
+def hash_chars(name):
+    chars = [name[0], name[-1]]
+    if len(name) > 4:
+        chars.append(name[4])
+    return chars
+
+
+def slot(name, values):
+    return (len(name) + sum(values[c] for c in hash_chars(name))) % HASH_SIZE
+
+
+def collisions(names, values):
+    slots = {}
+    for name in names:
+        slots.setdefault(slot(name, values), []).append(name)
+    return [n for group in slots.values() if len(group) > 1 for n in group]
+
+
+def search(names):
+    rng = random.Random(0)
+    chars = sorted(set(c for name in names for c in hash_chars(name)))
+    values = dict((c, rng.randrange(HASH_SIZE)) for c in chars)
+    clashing = collisions(names, values)
+    for i in range(MAX_ROUNDS):
+        if not clashing:
+            return values
+        c = rng.choice(hash_chars(rng.choice(clashing)))
+        old = values[c]
+        values[c] = rng.randrange(HASH_SIZE)
+        attempt = collisions(names, values)
+        if len(attempt) <= len(clashing):
+            clashing = attempt
+        else:
+            values[c] = old
+    sys.exit('no perfect hash found, try a larger HASH_SIZE')
+
+
+def print_rows(items, indent='    '):
+    line = indent
+    for item in items:
+        if len(line) + len(item) + 1 > 79:
+            print(line.rstrip())
+            line = indent
+        line += item + ' '
+    print(line.rstrip())
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else \
+        os.path.join(os.path.dirname(sys.argv[0]), 'properties.c')
+    names = read_names(path)
+    values = search(names)
+
+    table = [-1] * HASH_SIZE
+    for i, name in enumerate(names):
+        table[slot(name, values)] = i
+
+    print('static const unsigned char property_hash_values[256] = {')
+    print_rows(["['%s'] = %d," % (c, values[c]) for c in sorted(values)])
+    print('};\n')
+    print('static const signed char property_hash_table[PROPERTY_HASH_SIZE] = {')
+    print_rows(['%d,' % i for i in table])
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
@@ -25,6 +25,8 @@ void mapper_link_init(mapper_link link, int is_local)
                                 MODIFIABLE | INDIRECT | LOCAL_ACCESS_ONLY);
         mapper_table_set_record(link->props, AT_IS_LOCAL, NULL, 1, 'b',
                                 &is_local, LOCAL_ACCESS_ONLY | NON_MODIFIABLE);
+        mapper_database_add_record(link->local_device->database,
+                                   MAPPER_OBJ_LINKS, link, link->props);
     }
     if (!link->staged_props)
         link->staged_props = mapper_table_new();
@@ -38,24 +40,27 @@ void mapper_link_init(mapper_link link, int is_local)
         link->id = mapper_device_generate_unique_id(link->local_device);
 
     if (link->local_device == link->remote_device) {
-        /* Add data_addr for use by self-connections. In the future we may
-         * decide to call local handlers directly, however this could result in
-         * unfortunate loops/stack overflow. Sending data for self-connections
-         * to localhost adds the messages to liblo's stack and imposes a delay
-         * since the receiving handler will not be called until
-         * mapper_device_poll(). */
+        /* Add data_addr for use by self-connections. Updates are normally
+         * passed to the device's direct delivery queue instead; calling the
+         * handlers immediately could result in unfortunate loops/stack
+         * overflow, so in both cases the receiving handler is not called
+         * until mapper_device_poll(). */
         char str[16];
         snprintf(str, 16, "%d", mapper_device_port(link->local_device));
         link->local->data_addr = lo_address_new("localhost", str);
+        mapper_device_find_peer(link);
     }
 
     link->local->clock.new = 1;
+    link->local->clock.burst = SYNC_BURST;
     link->local->clock.sent.message_id = 0;
     link->local->clock.response.message_id = -1;
     mapper_timetag_t tt;
     mapper_timetag_now(&tt);
     link->local->clock.response.timetag.sec = tt.sec + 10;
 
+    mapper_link_init_stats(link);
+
     // request missing metadata
     char cmd[256];
     snprintf(cmd, 256, "/%s/subscribe", link->remote_device->name);
@@ -71,6 +76,13 @@ void mapper_link_init(mapper_link link, int is_local)
     ++link->local_device->num_links;
 }
 
+static int is_same_host(mapper_link link, const char *host)
+{
+    mapper_network net = link->local_device->database->network;
+    return (   strcmp(host, "127.0.0.1") == 0 || strcmp(host, "localhost") == 0
+            || strcmp(host, inet_ntoa(net->interface_ip)) == 0);
+}
+
 void mapper_link_connect(mapper_link link, const char *host, int admin_port,
                          int data_port)
 {
@@ -83,6 +95,143 @@ void mapper_link_connect(mapper_link link, const char *host, int admin_port,
     link->local->data_addr = lo_address_new(host, str);
     sprintf(str, "%d", admin_port);
     link->local->admin_addr = lo_address_new(host, str);
+    mapper_device_find_peer(link);
+    if (!link->local->peer && is_same_host(link, host)) {
+        link->local->shm = mapper_shm_open(data_port,
+                                           link->remote_device->id);
+    }
+    mapper_link_update_transport(link);
+}
+
+static void open_stream(mapper_link link)
+{
+    mapper_local_link llink = link->local;
+    mapper_timetag_t tt;
+    mapper_timetag_now(&tt);
+    double now = mapper_timetag_double(tt);
+    if (now < llink->stream_retry)
+        return;
+    // the remote device accepts stream connections on its data port
+    const char *host = lo_address_get_hostname(llink->data_addr);
+    const char *port = lo_address_get_port(llink->data_addr);
+    llink->stream = mapper_stream_open(host, port);
+    if (!llink->stream)
+        llink->stream_retry = now + MAPPER_STREAM_RETRY_SEC;
+    trace_dev(link->local_device, "%s stream to '%s'\n",
+              llink->stream ? "opened" : "failed to open",
+              link->remote_device->name);
+}
+
+void mapper_link_update_transport(mapper_link link)
+{
+    mapper_local_link llink = link->local;
+    const void *value;
+    char type;
+    int length;
+
+    if (!llink || !llink->data_addr)
+        return;
+    llink->use_stream = (!mapper_table_property(link->props, "transport",
+                                                &length, &type, &value)
+                         && type == 's' && length == 1
+                         && strcmp((const char*)value, "tcp") == 0);
+    if (llink->use_stream) {
+        /* Both ends of the link see the property, so the local device starts
+         * accepting stream connections in case the remote device opens one
+         * in return. */
+        mapper_device_listen_streams(link->local_device);
+        if (!llink->stream) {
+            llink->stream_retry = 0;
+            open_stream(link);
+        }
+    }
+    else if (llink->stream) {
+        mapper_stream_flush(llink->stream);
+        mapper_stream_free(llink->stream);
+        llink->stream = 0;
+    }
+}
+
+int mapper_link_send_stream_bundle(mapper_link link, lo_bundle b,
+                                   mapper_map map)
+{
+    mapper_local_link llink = link->local;
+    if (!llink->stream)
+        return 1;
+
+    if (mapper_stream_send_bundle(llink->stream, b)) {
+        // the connection is not keeping up
+        int count = lo_bundle_count(b);
+        mapper_stats_count(llink->stats, dropped_backpressure, count);
+        if (map && map->local)
+            mapper_stats_count(map->local->stats, dropped_backpressure, count);
+        return 1;
+    }
+    if (llink->stream->backlog >= MAPPER_STREAM_BATCH_SIZE)
+        mapper_link_flush_stream(link);
+    return 0;
+}
+
+int mapper_link_uses_stream(mapper_link link)
+{
+    mapper_local_link llink = link->local;
+    if (!llink || !llink->use_stream)
+        return 0;
+    // reopen a connection that failed, e.g. before the remote device listened
+    if (!llink->stream && llink->data_addr)
+        open_stream(link);
+    return llink->stream != 0;
+}
+
+void mapper_link_flush_stream(mapper_link link)
+{
+    mapper_local_link llink = link->local;
+    if (!llink || !llink->stream || !llink->stream->head)
+        return;
+    if (mapper_stream_flush(llink->stream)) {
+        trace_dev(link->local_device, "stream to '%s' failed, falling back to "
+                  "UDP\n", link->remote_device->name);
+        mapper_stream_free(llink->stream);
+        llink->stream = 0;
+        mapper_timetag_t tt;
+        mapper_timetag_now(&tt);
+        llink->stream_retry = (mapper_timetag_double(tt)
+                               + MAPPER_STREAM_RETRY_SEC);
+    }
+}
+
+int mapper_link_stream_backlog(mapper_link link)
+{
+    if (!link || !link->local || !link->local->stream)
+        return 0;
+    return link->local->stream->backlog;
+}
+
+static void wake_shm_reader(mapper_link link)
+{
+    if (mapper_shm_wakeup(link->local->shm)) {
+        // wake the receiving device with an empty bundle
+        lo_bundle w = lo_bundle_new(LO_TT_IMMEDIATE);
+        lo_send_bundle_from(link->local->data_addr,
+                            link->local_device->local->server, w);
+        lo_bundle_free(w);
+    }
+}
+
+int mapper_link_send_shm(mapper_link link, lo_bundle b)
+{
+    if (!link->local->shm || !link->local_device->local->direct_delivery)
+        return 1;
+    if (mapper_shm_send_bundle(link->local->shm, b))
+        return 1;
+    wake_shm_reader(link);
+    return 0;
+}
+
+void mapper_link_flush_shm(mapper_link link)
+{
+    if (link->local->shm && mapper_shm_flush(link->local->shm))
+        wake_shm_reader(link);
 }
 
 void mapper_link_free(mapper_link link)
@@ -94,62 +243,215 @@ void mapper_link_free(mapper_link link)
     if (link->num_maps)
         free(link->num_maps);
     if (link->local) {
-        if (link->local->admin_addr)
+        if (link->local->admin_addr) {
+            mapper_network_forget_dest(link->local_device->database->network,
+                                       link->local->admin_addr);
             lo_address_free(link->local->admin_addr);
+        }
         if (link->local->data_addr)
             lo_address_free(link->local->data_addr);
-        while (link->local->queues) {
-            mapper_queue queue = link->local->queues;
-            lo_bundle_free_recursive(queue->bundle);
-            link->local->queues = queue->next;
-            free(queue);
+        if (link->local->shm)
+            mapper_shm_free(link->local->shm);
+        if (link->local->stream) {
+            mapper_stream_flush(link->local->stream);
+            mapper_stream_free(link->local->stream);
         }
+        while (link->local->bundles) {
+            // remove the bundle from its queue before freeing it
+            mapper_link_bundle b = link->local->bundles;
+            mapper_link_bundle *prev = &b->queue->bundles;
+            while (*prev && *prev != b)
+                prev = &(*prev)->next_in_queue;
+            if (*prev)
+                *prev = b->next_in_queue;
+            link->local->bundles = b->next;
+            lo_bundle_free_recursive(b->bundle);
+            free(b);
+        }
+        if (link->local->stats)
+            free(link->local->stats);
         --link->local_device->num_links;
         free(link->local);
     }
 }
 
-void mapper_link_start_queue(mapper_link link, mapper_timetag_t tt)
+lo_bundle mapper_link_queue_bundle(mapper_link link, mapper_queue queue)
 {
-    if (!link || !link->local)
-        return;
-    // check if queue already exists
-    mapper_queue queue = link->local->queues;
-    while (queue) {
-        if (memcmp(&queue->tt, &tt, sizeof(mapper_timetag_t))==0)
-            return;
-        queue = queue->next;
-    }
-    // need to create a new queue
-    queue = malloc(sizeof(struct _mapper_queue));
-    memcpy(&queue->tt, &tt, sizeof(mapper_timetag_t));
-    queue->bundle = lo_bundle_new(tt);
-    queue->next = link->local->queues;
-    link->local->queues = queue;
+    /* Bundles are added at the head of the list and there is usually only
+     * one open queue, so this lookup rarely needs to iterate. */
+    mapper_link_bundle b = link->local->bundles;
+    while (b && b->queue != queue)
+        b = b->next;
+    if (b)
+        return b->bundle;
+
+    // first message for this link in this queue
+    b = (mapper_link_bundle) malloc(sizeof(mapper_link_bundle_t));
+    if (!b)
+        return 0;
+    b->bundle = lo_bundle_new(queue->tt);
+    b->queue = queue;
+    b->link = link;
+    b->next = link->local->bundles;
+    link->local->bundles = b;
+    b->next_in_queue = queue->bundles;
+    queue->bundles = b;
+    return b->bundle;
 }
 
-void mapper_link_send_queue(mapper_link link, mapper_timetag_t tt)
+/* Send a queued bundle through the same transport that its updates would
+ * have used if no queue was open, so that they arrive together. */
+static void send_queued_bundle(mapper_link link, lo_bundle b,
+                               mapper_timetag_t tt)
 {
-    if (!link || !link->local)
+    if (mapper_link_uses_stream(link)) {
+        // updates dropped because of backpressure are counted by the link
+        mapper_link_send_stream_bundle(link, b, 0);
         return;
-    mapper_queue *queue = &link->local->queues;
-    while (*queue) {
-        if (memcmp(&(*queue)->tt, &tt, sizeof(mapper_timetag_t))==0)
-            break;
-        queue = &(*queue)->next;
     }
-    if (*queue) {
+    if (!mapper_device_send_direct_bundle(link, b, tt))
+        return;
+    if (!mapper_link_send_shm(link, b))
+        return;
+    lo_send_bundle_from(link->local->data_addr,
+                        link->local_device->local->server, b);
+}
+
+void mapper_link_close_bundle(mapper_link_bundle bundle, int send)
+{
+    mapper_link link = bundle->link;
 #ifdef HAVE_LIBLO_BUNDLE_COUNT
-        if (lo_bundle_count((*queue)->bundle))
+    if (send && lo_bundle_count(bundle->bundle))
+#else
+    if (send)
 #endif
-            lo_send_bundle_from(link->local->data_addr,
-                                link->local_device->local->server,
-                                (*queue)->bundle);
-        lo_bundle_free_recursive((*queue)->bundle);
-        mapper_queue temp = *queue;
-        *queue = (*queue)->next;
-        free(temp);
+        send_queued_bundle(link, bundle->bundle, bundle->queue->tt);
+    lo_bundle_free_recursive(bundle->bundle);
+
+    mapper_link_bundle *prev = &link->local->bundles;
+    while (*prev && *prev != bundle)
+        prev = &(*prev)->next;
+    if (*prev)
+        *prev = bundle->next;
+    free(bundle);
+}
+
+/* The clock estimator follows the NTP clock filter: the offset is taken from
+ * the sample with the smallest round-trip delay in a sliding window, since it
+ * is least affected by queueing. Skew is estimated by a least-squares fit of
+ * offset against time over the samples whose delay is close to the minimum. */
+static void update_clock_estimate(mapper_sync_clock clock)
+{
+    int i, best = 0, n = 0;
+    mapper_sync_sample_t *samples = clock->samples;
+
+    for (i = 1; i < clock->num_samples; i++) {
+        if (samples[i].delay < samples[best].delay)
+            best = i;
+    }
+    double threshold = samples[best].delay * 2 + 0.001;
+
+    // regression of offset over time using filtered samples
+    double mean_t = 0, mean_o = 0, min_t = samples[best].time;
+    double max_t = min_t;
+    for (i = 0; i < clock->num_samples; i++) {
+        if (samples[i].delay > threshold)
+            continue;
+        mean_t += samples[i].time;
+        mean_o += samples[i].offset;
+        if (samples[i].time < min_t)
+            min_t = samples[i].time;
+        if (samples[i].time > max_t)
+            max_t = samples[i].time;
+        ++n;
+    }
+    mean_t /= n;
+    mean_o /= n;
+    if (n >= 3 && (max_t - min_t) >= 1.0) {
+        double sxx = 0, sxy = 0;
+        for (i = 0; i < clock->num_samples; i++) {
+            if (samples[i].delay > threshold)
+                continue;
+            sxx += (samples[i].time - mean_t) * (samples[i].time - mean_t);
+            sxy += (samples[i].time - mean_t) * (samples[i].offset - mean_o);
+        }
+        clock->skew = sxy / sxx;
+        if (clock->skew > SYNC_MAX_SKEW)
+            clock->skew = SYNC_MAX_SKEW;
+        else if (clock->skew < -SYNC_MAX_SKEW)
+            clock->skew = -SYNC_MAX_SKEW;
+    }
+
+    clock->ref = samples[best].time;
+    clock->offset = samples[best].offset;
+    clock->latency = samples[best].delay * 0.5;
+
+    // jitter is the RMS residual of the filtered samples around the estimate
+    double sum = 0, residual;
+    for (i = 0; i < clock->num_samples; i++) {
+        if (samples[i].delay > threshold)
+            continue;
+        residual = (samples[i].offset - clock->offset
+                    - clock->skew * (samples[i].time - clock->ref));
+        sum += residual * residual;
+    }
+    clock->jitter = sqrt(sum / n);
+}
+
+void mapper_sync_clock_add_sample(mapper_sync_clock clock, double time,
+                                  double offset, double delay)
+{
+    if (delay < 0)
+        delay = 0;
+    mapper_sync_sample_t *sample = &clock->samples[clock->next_sample];
+    sample->time = time;
+    sample->offset = offset;
+    sample->delay = delay;
+    clock->next_sample = (clock->next_sample + 1) % SYNC_NUM_SAMPLES;
+    if (clock->num_samples < SYNC_NUM_SAMPLES)
+        ++clock->num_samples;
+    update_clock_estimate(clock);
+    clock->new = 0;
+}
+
+double mapper_sync_clock_offset(mapper_sync_clock clock, double *error)
+{
+    if (clock->new) {
+        if (error)
+            *error = -1;
+        return 0;
+    }
+    double age = mapper_get_monotonic_time() - clock->ref;
+    if (error)
+        *error = clock->latency + clock->jitter + SYNC_DISPERSION * age;
+    return clock->offset + clock->skew * age;
+}
+
+int mapper_link_clock_offset(mapper_link link, double *offset, double *error)
+{
+    if (!link || !link->local)
+        return 1;
+    if (link->local_device == link->remote_device) {
+        // self-links share a clock
+        if (offset)
+            *offset = 0;
+        if (error)
+            *error = 0;
+        return 0;
     }
+    if (link->local->clock.new)
+        return 1;
+    double o = mapper_sync_clock_offset(&link->local->clock, error);
+    if (offset)
+        *offset = o;
+    return 0;
+}
+
+double mapper_link_clock_skew(mapper_link link)
+{
+    if (!link || !link->local)
+        return 0;
+    return link->local->clock.skew;
 }
 
 mapper_device mapper_link_device(mapper_link link, int idx)
@@ -275,6 +577,8 @@ int mapper_link_set_from_message(mapper_link link, mapper_message msg,
                                                          REMOTE_MODIFY);
         }
     }
+    if (updated && link->local)
+        mapper_link_update_transport(link);
     return updated;
 }
 
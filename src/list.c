@@ -7,6 +7,11 @@
 #include <zlib.h>
 
 #include "mapper_internal.h"
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 /* Some useful local list functions. */
 
@@ -60,13 +65,307 @@ static int cmp_compound_query(const void *context_data, const void *dev);
 /*! Contains some function pointers and data for handling query context. */
 typedef struct _query_info {
     unsigned int size;
+    unsigned int capacity;      //!< Allocated size.
     query_compare_func_t *query_compare;
     query_free_func_t *query_free;
+    void **candidates;          //!< Items to test instead of the whole list.
+    int num_candidates;
+    int cursor;                 //!< Index of the current candidate.
+    const uint32_t *revision;   //!< Counter of changes to the list records.
+    uint32_t found_revision;    //!< Its value when candidates were found.
     int data[0]; // stub
 } query_info_t;
 
 #define LIST_HEADER_SIZE (sizeof(mapper_list_header_t)-sizeof(int[1]))
 
+/*
+ *   List items and query headers are carved from slabs, with a separate pool
+ * for each block size so that devices, signals, links and maps each reuse
+ * the records freed by their own type. Freed blocks go back on the free list
+ * of their slab rather than to the system, which avoids heap fragmentation
+ * in long-running processes where records come and go. A slab whose blocks
+ * have all been freed is released, except for one kept by each pool so that
+ * records which come and go in small numbers do not allocate a new slab each
+ * time. Databases may be used from different threads, so the pools are
+ * protected by a lock.
+ *   Each block starts with a word holding its slab while in use, or the next
+ * free block while on the free list. Query contexts vary in size, so a few
+ * freed contexts are cached instead. Queries are created and freed far more
+ * often than records, so each thread keeps its own cache where the compiler
+ * supports thread-local storage, and a shared cache protected by the lock is
+ * used otherwise.
+ */
+
+#define SLAB_BLOCKS         64  // number of blocks allocated at once
+#define NUM_POOLS           8
+#define NO_POOL             -1  // blocks too large or too many sizes
+#define QUERY_CACHE_SIZE    8
+#define MIN_QUERY_CONTEXT   128
+
+#if defined(__GNUC__) || defined(__clang__)
+#define THREAD_LOCAL __thread
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#endif
+
+struct _slab;
+
+typedef union _block {
+    union _block *next_free;
+    struct _slab *slab;         //!< The slab holding the block, or zero.
+    double align;
+} block_t;
+
+/*! The header of a slab, followed by its blocks. */
+typedef struct _slab {
+    struct _slab *next;         //!< Next slab of the pool with free blocks.
+    struct _slab *prev;
+    block_t *free;
+    int pool;
+    int num_free;
+} slab_t;
+
+#define SLAB_HEADER_SIZE ((sizeof(slab_t) + 15) & ~(size_t)15)
+
+typedef struct {
+    size_t size;                //!< Block size, including the prefix.
+    slab_t *partial;            //!< Slabs with free blocks.
+    int num_empty;              //!< Slabs with every block free.
+} pool_t;
+
+static pool_t pools[NUM_POOLS];
+static mapper_list_allocation_counts_t counts;
+
+#ifdef THREAD_LOCAL
+static THREAD_LOCAL query_info_t *query_cache[QUERY_CACHE_SIZE];
+static THREAD_LOCAL int num_cached_queries = 0;
+#else
+static query_info_t *query_cache[QUERY_CACHE_SIZE];
+static int num_cached_queries = 0;
+#endif
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lock_pools() pthread_mutex_lock(&pool_lock)
+#define unlock_pools() pthread_mutex_unlock(&pool_lock)
+#else
+#define lock_pools()
+#define unlock_pools()
+#endif
+
+#ifdef THREAD_LOCAL
+#define lock_query_cache()
+#define unlock_query_cache()
+#else
+#define lock_query_cache() lock_pools()
+#define unlock_query_cache() unlock_pools()
+#endif
+
+/*! Find or create the pool for a block size, or return NO_POOL. Must be
+ *  called with the lock held. */
+static int find_pool(size_t size)
+{
+    int i;
+    for (i = 0; i < NUM_POOLS; i++) {
+        if (pools[i].size == size)
+            return i;
+        if (!pools[i].size) {
+            pools[i].size = size;
+            return i;
+        }
+    }
+    return NO_POOL;
+}
+
+static void link_slab(pool_t *p, slab_t *s)
+{
+    s->prev = 0;
+    s->next = p->partial;
+    if (s->next)
+        s->next->prev = s;
+    p->partial = s;
+}
+
+static void unlink_slab(pool_t *p, slab_t *s)
+{
+    if (s->prev)
+        s->prev->next = s->next;
+    else
+        p->partial = s->next;
+    if (s->next)
+        s->next->prev = s->prev;
+}
+
+/*! Allocate a new slab for a pool. Must be called with the lock held. */
+static slab_t *new_slab(int pool)
+{
+    pool_t *p = &pools[pool];
+    int i;
+    slab_t *s = malloc(SLAB_HEADER_SIZE + p->size * SLAB_BLOCKS);
+    if (!s)
+        return 0;
+    ++counts.allocations;
+    s->pool = pool;
+    s->free = 0;
+    for (i = SLAB_BLOCKS - 1; i >= 0; i--) {
+        block_t *b = (block_t*)((char*)s + SLAB_HEADER_SIZE + p->size * i);
+        b->next_free = s->free;
+        s->free = b;
+    }
+    s->num_free = SLAB_BLOCKS;
+    link_slab(p, s);
+    ++p->num_empty;
+    return s;
+}
+
+/*! Allocate a zeroed block of at least size bytes, returning the memory
+ *  following its prefix. */
+static void *alloc_block(size_t size)
+{
+    block_t *b;
+    slab_t *s;
+    int pool;
+
+    // keep blocks aligned as the system allocator would
+    size = (size + sizeof(block_t) + 15) & ~(size_t)15;
+
+    lock_pools();
+    ++counts.blocks;
+    pool = find_pool(size);
+    if (pool == NO_POOL) {
+        ++counts.allocations;
+        unlock_pools();
+        b = calloc(1, size);
+        if (!b)
+            return 0;
+        b->slab = 0;
+        return b + 1;
+    }
+    s = pools[pool].partial;
+    if (!s && !(s = new_slab(pool))) {
+        unlock_pools();
+        return 0;
+    }
+    if (s->num_free == SLAB_BLOCKS)
+        --pools[pool].num_empty;
+    b = s->free;
+    s->free = b->next_free;
+    if (!--s->num_free)
+        unlink_slab(&pools[pool], s);
+    unlock_pools();
+
+    memset(b, 0, size);
+    b->slab = s;
+    return b + 1;
+}
+
+static void free_block(void *mem)
+{
+    block_t *b = (block_t*)mem - 1;
+    slab_t *s = b->slab;
+    pool_t *p;
+    if (!s) {
+        free(b);
+        return;
+    }
+    lock_pools();
+    p = &pools[s->pool];
+    b->next_free = s->free;
+    s->free = b;
+    if (++s->num_free == 1)
+        link_slab(p, s);
+    if (s->num_free == SLAB_BLOCKS) {
+        if (p->num_empty) {
+            // the pool already keeps an empty slab
+            unlink_slab(p, s);
+            free(s);
+            ++counts.releases;
+        }
+        else
+            ++p->num_empty;
+    }
+    unlock_pools();
+}
+
+#if defined(THREAD_LOCAL) && defined(HAVE_PTHREAD)
+/* Free the query contexts cached by a thread when it exits. */
+static pthread_key_t query_cache_key;
+static pthread_once_t query_cache_once = PTHREAD_ONCE_INIT;
+
+static void free_query_cache(void *unused)
+{
+    while (num_cached_queries)
+        free(query_cache[--num_cached_queries]);
+}
+
+static void create_query_cache_key()
+{
+    pthread_key_create(&query_cache_key, free_query_cache);
+}
+
+static void register_query_cache()
+{
+    pthread_once(&query_cache_once, create_query_cache_key);
+    if (!pthread_getspecific(query_cache_key))
+        pthread_setspecific(query_cache_key, query_cache);
+}
+#else
+#define register_query_cache()
+#endif
+
+/*! Allocate a query context with room for size bytes of data, reusing a
+ *  cached context if one is large enough. */
+static query_info_t *alloc_query_context(size_t size)
+{
+    query_info_t *qi = 0;
+    int i;
+    size += sizeof(query_info_t);
+
+    __sync_fetch_and_add(&counts.query_contexts, 1);
+    lock_query_cache();
+    for (i = 0; i < num_cached_queries; i++) {
+        if (query_cache[i]->capacity >= size) {
+            qi = query_cache[i];
+            query_cache[i] = query_cache[--num_cached_queries];
+            break;
+        }
+    }
+    unlock_query_cache();
+
+    if (!qi) {
+        __sync_fetch_and_add(&counts.query_allocations, 1);
+        size_t capacity = size < MIN_QUERY_CONTEXT ? MIN_QUERY_CONTEXT : size;
+        qi = (query_info_t*)malloc(capacity);
+        if (!qi)
+            return 0;
+        qi->capacity = capacity;
+    }
+    qi->size = size;
+    return qi;
+}
+
+static void free_query_context(query_info_t *qi)
+{
+    if (qi->candidates)
+        free(qi->candidates);
+    lock_query_cache();
+    if (num_cached_queries < QUERY_CACHE_SIZE) {
+        register_query_cache();
+        query_cache[num_cached_queries++] = qi;
+        qi = 0;
+    }
+    unlock_query_cache();
+    if (qi)
+        free(qi);
+}
+
+void mapper_list_allocation_counts(mapper_list_allocation_counts_t *c)
+{
+    lock_pools();
+    *c = counts;
+    unlock_pools();
+}
+
 /*! Reserve memory for a list item.  Reserves an extra pointer at the
  *  beginning of the structure to allow for a list pointer. */
 static mapper_list_header_t* mapper_list_new_item(size_t size)
@@ -81,7 +380,7 @@ static mapper_list_header_t* mapper_list_new_item(size_t size)
                "unexpected offset for data in mapper_list_header_t");
 
     size += LIST_HEADER_SIZE;
-    lh = calloc(1, size);
+    lh = alloc_block(size);
     if (!lh)
         return 0;
 
@@ -164,7 +463,7 @@ void mapper_list_remove_item(void **head, void *item)
 void mapper_list_free_item(void *item)
 {
     if (item)
-        free(mapper_list_header_by_data(item));
+        free_block(mapper_list_header_by_data(item));
 }
 
 /** Structures and functions for performing dynamic queries **/
@@ -175,7 +474,35 @@ void mapper_list_free_item(void *item)
 
 void **mapper_list_query_continuation(mapper_list_header_t *lh)
 {
-    void *item = mapper_list_header_by_data(lh->self)->next;
+    query_info_t *qi = lh->query_context;
+    void *item;
+    if (qi->candidates) {
+        if (*qi->revision == qi->found_revision) {
+            while (++qi->cursor < qi->num_candidates) {
+                item = qi->candidates[qi->cursor];
+                if (qi->query_compare(&qi->data, item)) {
+                    lh->self = item;
+                    return &lh->self;
+                }
+            }
+            if (qi->query_free)
+                qi->query_free(lh);
+            return 0;
+        }
+        /* Records have changed since the candidates were found, so continue
+         * by walking the list instead. The candidates are in list order, so
+         * the walk resumes after the last item returned, or at the start of
+         * the list if none has been returned yet. */
+        free(qi->candidates);
+        qi->candidates = 0;
+        if (qi->cursor < 0) {
+            lh->self = lh->start;
+            if (qi->query_compare(&qi->data, lh->start))
+                return &lh->self;
+        }
+    }
+
+    item = mapper_list_header_by_data(lh->self)->next;
     while (item) {
         if (lh->query_context->query_compare(&lh->query_context->data, item))
             break;
@@ -203,24 +530,24 @@ static void free_query_single_context(mapper_list_header_t *lh)
         free_query_single_context(lh1);
         free_query_single_context(lh2);
     }
-    free(lh->query_context);
-    free(lh);
+    free_query_context(lh->query_context);
+    free_block(lh);
 }
 
 /* We need to be careful of memory alignment here - for now we will just ensure
  * that string arguments are always passed last. */
-void **mapper_list_new_query(const void *list, const void *compare_func,
-                             const char *types, ...)
+static mapper_list_header_t *new_query_header(const void *list,
+                                              const void *compare_func,
+                                              const char *types, va_list args)
 {
-    if (!list || !compare_func || !types)
+    mapper_list_header_t *lh = alloc_block(LIST_HEADER_SIZE);
+    if (!lh)
         return 0;
-
-    mapper_list_header_t *lh = (mapper_list_header_t*)malloc(LIST_HEADER_SIZE);
     lh->next = mapper_list_query_continuation;
     lh->query_type = QUERY_DYNAMIC;
 
     va_list aq;
-    va_start(aq, types);
+    va_copy(aq, args);
 
     int i = 0, j, size = 0, num_args;
     while (types[i]) {
@@ -278,18 +605,22 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
                 break;
             default:
                 va_end(aq);
-                free(lh);
+                free_block(lh);
                 return 0;
         }
         i++;
     };
     va_end(aq);
 
-    lh->query_context = (query_info_t*)malloc(sizeof(query_info_t)+size);
+    lh->query_context = alloc_query_context(size);
+    if (!lh->query_context) {
+        free_block(lh);
+        return 0;
+    }
 
     char *d = (char*)&lh->query_context->data;
     int offset = 0;
-    va_start(aq, types);
+    va_copy(aq, args);
     i = 0;
     while (types[i]) {
         switch (types[i]) {
@@ -358,19 +689,36 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
             }
             default:
                 va_end(aq);
-                free(lh->query_context);
-                free(lh);
+                free_query_context(lh->query_context);
+                free_block(lh);
                 return 0;
         }
         i++;
     }
     va_end(aq);
 
-    lh->query_context->size = sizeof(query_info_t)+size;
     lh->query_context->query_compare = (query_compare_func_t*)compare_func;
     lh->query_context->query_free = (query_free_func_t*)free_query_single_context;
+    lh->query_context->candidates = 0;
+    lh->query_context->num_candidates = 0;
+    lh->query_context->cursor = -1;
 
     lh->self = lh->start = (void*)list;
+    return lh;
+}
+
+void **mapper_list_new_query(const void *list, const void *compare_func,
+                             const char *types, ...)
+{
+    if (!list || !compare_func || !types)
+        return 0;
+
+    va_list aq;
+    va_start(aq, types);
+    mapper_list_header_t *lh = new_query_header(list, compare_func, types, aq);
+    va_end(aq);
+    if (!lh)
+        return 0;
 
     // try evaluating the first item
     if (lh->query_context->query_compare(&lh->query_context->data, list))
@@ -379,6 +727,32 @@ void **mapper_list_new_query(const void *list, const void *compare_func,
     return mapper_list_query_continuation(lh);
 }
 
+void **mapper_list_new_indexed_query(const void *list,
+                                     const uint32_t *revision,
+                                     void **candidates, int num_candidates,
+                                     const void *compare_func,
+                                     const char *types, ...)
+{
+    if (   !list || !revision || !candidates || num_candidates <= 0
+        || !compare_func || !types)
+        return 0;
+
+    va_list aq;
+    va_start(aq, types);
+    mapper_list_header_t *lh = new_query_header(list, compare_func, types, aq);
+    va_end(aq);
+    if (!lh)
+        return 0;
+
+    query_info_t *qi = lh->query_context;
+    qi->candidates = malloc(sizeof(void*) * num_candidates);
+    memcpy(qi->candidates, candidates, sizeof(void*) * num_candidates);
+    qi->num_candidates = num_candidates;
+    qi->revision = revision;
+    qi->found_revision = *revision;
+    return mapper_list_query_continuation(lh);
+}
+
 void **mapper_list_query_next(void **query)
 {
     if (!query) {
@@ -426,6 +800,36 @@ void *mapper_list_query_index(void **query, int index)
 
     mapper_list_header_t *lh = mapper_list_header_by_self(query);
 
+    if (lh->query_type == QUERY_DYNAMIC) {
+        query_info_t *qi = lh->query_context;
+        if (qi->candidates && *qi->revision != qi->found_revision) {
+            // records have changed, so the candidates may be stale
+            free(qi->candidates);
+            qi->candidates = 0;
+        }
+        if (qi->candidates) {
+            // restart from the first candidate
+            qi->cursor = -1;
+            query = mapper_list_query_continuation(lh);
+        }
+        else {
+            // restart from the beginning of the list
+            lh->self = lh->start;
+            if (qi->query_compare(&qi->data, lh->start))
+                query = &lh->self;
+            else
+                query = mapper_list_query_continuation(lh);
+        }
+        int i = 0;
+        while (query) {
+            if (i == index)
+                return *query;
+            ++i;
+            query = mapper_list_query_next(query);
+        }
+        return 0;
+    }
+
     if (index == 0)
         return lh->start;
 
@@ -467,14 +871,23 @@ static int cmp_compound_query(const void *context_data, const void *dev)
 
 static mapper_list_header_t *mapper_list_header_copy(mapper_list_header_t *lh)
 {
-    mapper_list_header_t *copy = (mapper_list_header_t*)malloc(LIST_HEADER_SIZE);
+    mapper_list_header_t *copy = alloc_block(LIST_HEADER_SIZE);
     memcpy(copy, lh, LIST_HEADER_SIZE);
 
     if (!lh->query_context)
         return copy;
 
-    copy->query_context = (query_info_t*)malloc(lh->query_context->size);
+    size_t size = lh->query_context->size - sizeof(query_info_t);
+    copy->query_context = alloc_query_context(size);
+    unsigned int capacity = copy->query_context->capacity;
     memcpy(copy->query_context, lh->query_context, lh->query_context->size);
+    copy->query_context->capacity = capacity;
+    if (lh->query_context->candidates) {
+        size_t size = sizeof(void*) * lh->query_context->num_candidates;
+        copy->query_context->candidates = malloc(size);
+        memcpy(copy->query_context->candidates, lh->query_context->candidates,
+               size);
+    }
 
     if (copy->query_context->query_compare == cmp_compound_query) {
         // this is a compound query – we need to copy components
@@ -501,6 +914,29 @@ void **mapper_list_query_copy(void **query)
     return &copy->self;
 }
 
+/* If a subquery was answered using an index, a compound query only needs to
+ * test its candidates: those of either side for an intersection, or of the
+ * first query for a difference. Unions still walk the whole list. */
+static void **new_compound_query(mapper_list_header_t *lh1,
+                                 mapper_list_header_t *lh2, binary_op_t op)
+{
+    query_info_t *c1 = lh1->query_context, *c2 = lh2->query_context, *c = 0;
+    if (   op != OP_UNION && c1->candidates
+        && *c1->revision == c1->found_revision)
+        c = c1;
+    if (   op == OP_INTERSECTION && c2->candidates
+        && *c2->revision == c2->found_revision
+        && (!c || c2->num_candidates < c->num_candidates))
+        c = c2;
+    if (c)
+        return mapper_list_new_indexed_query(lh1->start, c->revision,
+                                             c->candidates, c->num_candidates,
+                                             cmp_compound_query, "vvi", &lh1,
+                                             &lh2, op);
+    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
+                                 &lh2, op);
+}
+
 void **mapper_list_query_union(void **query1, void **query2)
 {
     if (!query1)
@@ -510,8 +946,7 @@ void **mapper_list_query_union(void **query1, void **query2)
 
     mapper_list_header_t *lh1 = mapper_list_header_by_self(query1);
     mapper_list_header_t *lh2 = mapper_list_header_by_self(query2);
-    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
-                                 &lh2, OP_UNION);
+    return new_compound_query(lh1, lh2, OP_UNION);
 }
 
 void **mapper_list_query_intersection(void **query1, void **query2)
@@ -521,8 +956,7 @@ void **mapper_list_query_intersection(void **query1, void **query2)
 
     mapper_list_header_t *lh1 = mapper_list_header_by_self(query1);
     mapper_list_header_t *lh2 = mapper_list_header_by_self(query2);
-    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
-                                 &lh2, OP_INTERSECTION);
+    return new_compound_query(lh1, lh2, OP_INTERSECTION);
 }
 
 void **mapper_list_query_difference(void **query1, void **query2)
@@ -534,6 +968,5 @@ void **mapper_list_query_difference(void **query1, void **query2)
 
     mapper_list_header_t *lh1 = mapper_list_header_by_self(query1);
     mapper_list_header_t *lh2 = mapper_list_header_by_self(query2);
-    return mapper_list_new_query(lh1->start, cmp_compound_query, "vvi", &lh1,
-                                 &lh2, OP_DIFFERENCE);
+    return new_compound_query(lh1, lh2, OP_DIFFERENCE);
 }
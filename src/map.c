@@ -13,6 +13,8 @@
 /*! Function prototypes. */
 static void reallocate_map_histories(mapper_map map);
 static int mapper_map_set_mode_linear(mapper_map map);
+static int compute_linear_scaling(mapper_map map);
+static void refresh_linear_expression(mapper_map map);
 
 #define METADATA_OK (STATUS_TYPE_KNOWN | STATUS_LENGTH_KNOWN | STATUS_LINK_KNOWN)
 
@@ -85,6 +87,7 @@ void mapper_map_init(mapper_map map)
     }
     mapper_table_set_record(map->props, AT_IS_LOCAL, NULL, 1, 'b', &is_local,
                             LOCAL_ACCESS_ONLY | NON_MODIFIABLE);
+    mapper_database_add_record(map->database, MAPPER_OBJ_MAPS, map, map->props);
 
     for (i = 0; i < map->num_sources; i++)
         mapper_slot_init(map->sources[i]);
@@ -161,11 +164,18 @@ mapper_map mapper_map_new(int num_sources, mapper_signal *sources,
             sig = mapper_database_add_or_update_signal(db, sources[order[i]]->name,
                                                        sources[order[i]]->device->name, 0);
             if (!sig->id) {
+                mapper_database_unindex_property(sig->props, AT_ID, 0);
                 sig->id = sources[order[i]]->id;
+                mapper_database_index_property(sig->props, AT_ID, 0);
+                mapper_database_unindex_property(sig->props, AT_DIRECTION, 0);
                 sig->direction = sources[order[i]]->direction;
+                mapper_database_index_property(sig->props, AT_DIRECTION, 0);
             }
             if (!sig->device->id) {
+                mapper_table props = sig->device->props;
+                mapper_database_unindex_property(props, AT_ID, 0);
                 sig->device->id = sources[order[i]]->device->id;
+                mapper_database_index_property(props, AT_ID, 0);
             }
         }
         map->sources[i]->signal = sig;
@@ -179,6 +189,7 @@ mapper_map mapper_map_new(int num_sources, mapper_signal *sources,
     // we need to give the map a temporary id – this may be overwritten later
     if (destination->device->local)
         map->id = mapper_device_generate_unique_id(destination->device);
+    mapper_database_index_map(db, map);
 
     mapper_map_init(map);
 
@@ -187,9 +198,25 @@ mapper_map mapper_map_new(int num_sources, mapper_signal *sources,
     return map;
 }
 
+/* Within a transaction, map creations and removals are bundled per
+ * destination device, since the destination handles both. */
+static void set_dest_transaction(mapper_map map, int cmd)
+{
+    mapper_database db = map->database;
+    if (db->transaction_depth) {
+        ++db->transaction_count;
+        if (cmd != MSG_MAP_MODIFY) {
+            mapper_network_set_dest_device(db->network,
+                                           map->destination.signal->device);
+            return;
+        }
+    }
+    mapper_network_set_dest_bus(db->network);
+}
+
 void mapper_map_release(mapper_map map)
 {
-    mapper_network_set_dest_bus(map->database->network);
+    set_dest_transaction(map, MSG_UNMAP);
     mapper_map_send_state(map, -1, MSG_UNMAP);
 }
 
@@ -222,7 +249,7 @@ void mapper_map_push(mapper_map map)
     else
         cmd = MSG_MAP;
 
-    mapper_network_set_dest_bus(map->database->network);
+    set_dest_transaction(map, cmd);
     mapper_map_send_state(map, -1, cmd);
 
     // clear the staged properties
@@ -322,6 +349,7 @@ mapper_mode mapper_map_mode(mapper_map map)
 
 const char *mapper_map_expression(mapper_map map)
 {
+    refresh_linear_expression(map);
     return map->expression;
 }
 
@@ -424,6 +452,44 @@ void mapper_map_set_process_location(mapper_map map, mapper_location location)
                             'i', &location, REMOTE_MODIFY);
 }
 
+void mapper_map_set_send_policy(mapper_map map,
+                                const mapper_send_policy_t *policy)
+{
+    if (!map || !map->local)
+        return;
+    if (policy)
+        map->local->send_policy = *policy;
+    map->local->has_send_policy = (policy != 0);
+}
+
+int mapper_map_send_policy(mapper_map map, mapper_send_policy_t *policy)
+{
+    if (!map || !map->local || !map->local->has_send_policy)
+        return 1;
+    if (policy)
+        *policy = map->local->send_policy;
+    return 0;
+}
+
+void mapper_map_set_convergence(mapper_map map, mapper_convergence_mode mode,
+                                double timeout)
+{
+    if (!map || !map->local)
+        return;
+    // updates that are already waiting are evaluated when the device is polled
+    map->local->convergence = mode;
+    map->local->convergence_timeout = timeout > 0 ? timeout : 0;
+}
+
+mapper_convergence_mode mapper_map_convergence(mapper_map map, double *timeout)
+{
+    if (timeout)
+        *timeout = (map && map->local) ? map->local->convergence_timeout : 0;
+    if (!map || !map->local)
+        return MAPPER_CONVERGE_EACH;
+    return map->local->convergence;
+}
+
 void mapper_map_add_scope(mapper_map map, mapper_device device)
 {
     if (!map || !device)
@@ -714,8 +780,17 @@ int mapper_map_perform(mapper_map map, mapper_slot slot, int instance,
                 break;
         }
 
-        if (changed && map->mode == MAPPER_MODE_LINEAR)
-            mapper_map_set_mode_linear(map);
+        if (changed)
+            slot->local->boundary.compiled = 0;
+        if (changed && map->mode == MAPPER_MODE_LINEAR) {
+            if (!map->local->linear_length)
+                mapper_map_set_mode_linear(map);
+            else if (!compute_linear_scaling(map)) {
+                /* Scaling was updated in place; the expression string will be
+                 * regenerated when it is next needed. */
+                map->local->linear_stale = 1;
+            }
+        }
     }
 
     if (map->status != STATUS_ACTIVE || map->muted) {
@@ -736,6 +811,69 @@ int mapper_map_perform(mapper_map map, mapper_slot slot, int instance,
         return 1;
     }
 
+    return mapper_map_evaluate(map, instance,
+                               mapper_history_tt_ptr(from[instance]),
+                               typestring);
+}
+
+#define LINEAR_KERNEL(SRC_TYPE, DST_TYPE)                           \
+{                                                                   \
+    SRC_TYPE *s = src;                                              \
+    DST_TYPE *d = dst;                                              \
+    for (i = 0; i < length; i++)                                    \
+        d[i] = s[i] * scale[i] + offset[i];                         \
+}
+
+#define LINEAR_KERNELS(SRC_TYPE)                                    \
+{                                                                   \
+    switch (to->type) {                                             \
+        case 'i':   LINEAR_KERNEL(SRC_TYPE, int);       break;      \
+        case 'f':   LINEAR_KERNEL(SRC_TYPE, float);     break;      \
+        case 'd':   LINEAR_KERNEL(SRC_TYPE, double);    break;      \
+        default:    return 0;                                       \
+    }                                                               \
+}
+
+/* Apply the native linear scaling of a map without evaluating an expression.
+ * Elements of the destination beyond the scaled length are left unassigned,
+ * matching the generated linear expression. */
+static int perform_linear(mapper_map map, mapper_history from,
+                          mapper_history to, mapper_timetag_t *tt,
+                          char *typestring)
+{
+    int i, length = map->local->linear_length;
+    double *scale = map->local->scale, *offset = map->local->offset;
+
+    to->position = (to->position + 1) & (to->size - 1);
+    void *src = mapper_history_value_ptr(*from);
+    void *dst = mapper_history_value_ptr(*to);
+
+    switch (from->type) {
+        case 'i':   LINEAR_KERNELS(int);    break;
+        case 'f':   LINEAR_KERNELS(float);  break;
+        case 'd':   LINEAR_KERNELS(double); break;
+        default:    return 0;
+    }
+
+    if (tt)
+        memcpy(mapper_history_tt_ptr(*to), tt, sizeof(mapper_timetag_t));
+    if (typestring) {
+        memset(typestring, to->type, length);
+        memset(typestring + length, 'N', to->length - length);
+    }
+    return 1;
+}
+
+int mapper_map_evaluate(mapper_map map, int instance, mapper_timetag_t *tt,
+                        char *typestring)
+{
+    int i;
+    mapper_history to = &map->destination.local->history[instance];
+
+    if (map->mode == MAPPER_MODE_LINEAR && map->local->linear_length)
+        return perform_linear(map, &map->sources[0]->local->history[instance],
+                              to, tt, typestring);
+
     if (!map->local->expr) {
         trace("error: missing expression.\n");
         return 0;
@@ -744,204 +882,335 @@ int mapper_map_perform(mapper_map map, mapper_slot slot, int instance,
     mapper_history sources[map->num_sources];
     for (i = 0; i < map->num_sources; i++)
         sources[i] = &map->sources[i]->local->history[instance];
-    return (mapper_expr_evaluate(map->local->expr, sources,
-                                 &map->local->expr_vars[instance],
-                                 &to[instance],
-                                 mapper_history_tt_ptr(from[instance]),
-                                 typestring));
+    return mapper_expr_evaluate(map->local->expr, sources,
+                                &map->local->expr_vars[instance], to, tt,
+                                typestring);
 }
 
-int mapper_boundary_perform(mapper_history history, mapper_slot slot,
-                            char *typestring)
+/* Apply boundary actions to one element, whose bounds have been ordered so
+ * that lo <= hi. Sets *mute if the element should not be sent. */
+static double bound_element(double value, double lo, double hi,
+                            mapper_boundary_action bound_min,
+                            mapper_boundary_action bound_max, int *mute)
+{
+    double total_range = fabs(hi - lo), difference, modulo_difference;
+    if (value < lo) {
+        switch (bound_min) {
+            case MAPPER_BOUND_MUTE:
+                // need to prevent value from being sent at all
+                *mute = 1;
+                break;
+            case MAPPER_BOUND_CLAMP:
+                // clamp value to range minimum
+                value = lo;
+                break;
+            case MAPPER_BOUND_FOLD:
+                // fold value around range minimum
+                difference = fabs(value - lo);
+                value = lo + difference;
+                if (value > hi) {
+                    // value now exceeds range maximum!
+                    switch (bound_max) {
+                        case MAPPER_BOUND_MUTE:
+                            // need to prevent value from being sent at all
+                            *mute = 1;
+                            break;
+                        case MAPPER_BOUND_CLAMP:
+                            // clamp value to range minimum
+                            value = hi;
+                            break;
+                        case MAPPER_BOUND_FOLD:
+                            // both boundary actions are set to fold!
+                            difference = fabs(value - hi);
+                            modulo_difference = difference
+                                - ((int)(difference / total_range)
+                                   * total_range);
+                            if ((int)(difference / total_range) % 2 == 0) {
+                                value = hi - modulo_difference;
+                            }
+                            else
+                                value = lo + modulo_difference;
+                            break;
+                        case MAPPER_BOUND_WRAP:
+                            // wrap value back from range minimum
+                            difference = fabs(value - hi);
+                            modulo_difference = difference
+                                - ((int)(difference / total_range)
+                                   * total_range);
+                            value = lo + modulo_difference;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                break;
+            case MAPPER_BOUND_WRAP:
+                // wrap value back from range maximum
+                difference = fabs(value - lo);
+                modulo_difference = difference
+                    - (int)(difference / total_range) * total_range;
+                value = hi - modulo_difference;
+                break;
+            default:
+                // leave the value unchanged
+                break;
+        }
+    }
+    else if (value > hi) {
+        switch (bound_max) {
+            case MAPPER_BOUND_MUTE:
+                // need to prevent value from being sent at all
+                *mute = 1;
+                break;
+            case MAPPER_BOUND_CLAMP:
+                // clamp value to range maximum
+                value = hi;
+                break;
+            case MAPPER_BOUND_FOLD:
+                // fold value around range maximum
+                difference = fabs(value - hi);
+                value = hi - difference;
+                if (value < lo) {
+                    // value now exceeds range minimum!
+                    switch (bound_min) {
+                        case MAPPER_BOUND_MUTE:
+                            // need to prevent value from being sent at all
+                            *mute = 1;
+                            break;
+                        case MAPPER_BOUND_CLAMP:
+                            // clamp value to range minimum
+                            value = lo;
+                            break;
+                        case MAPPER_BOUND_FOLD:
+                            // both boundary actions are set to fold!
+                            difference = fabs(value - lo);
+                            modulo_difference = difference
+                                - ((int)(difference / total_range)
+                                   * total_range);
+                            if ((int)(difference / total_range) % 2 == 0) {
+                                value = hi + modulo_difference;
+                            }
+                            else
+                                value = lo - modulo_difference;
+                            break;
+                        case MAPPER_BOUND_WRAP:
+                            // wrap value back from range maximum
+                            difference = fabs(value - lo);
+                            modulo_difference = difference
+                                - ((int)(difference / total_range)
+                                   * total_range);
+                            value = hi - modulo_difference;
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                break;
+            case MAPPER_BOUND_WRAP:
+                // wrap value back from range minimum
+                difference = fabs(value - hi);
+                modulo_difference = difference
+                    - (int)(difference / total_range) * total_range;
+                value = lo + modulo_difference;
+                break;
+            default:
+                break;
+        }
+    }
+    return value;
+}
+
+void mapper_boundary_free(mapper_boundary b)
 {
-    int i, muted = 0;
+    if (b->lo)
+        free(b->lo);
+    if (b->hi)
+        free(b->hi);
+    if (b->typed_lo)
+        free(b->typed_lo);
+    if (b->typed_hi)
+        free(b->typed_hi);
+    if (b->action_lo)
+        free(b->action_lo);
+    if (b->action_hi)
+        free(b->action_hi);
+    memset(b, 0, sizeof(mapper_boundary_t));
+}
+
+/* Compile the boundary processing of a slot from its range, boundary actions
+ * and signal type. Elements whose minimum exceeds their maximum have their
+ * bounds and actions swapped here rather than for every update. */
+static void compile_boundary(mapper_slot slot)
+{
+    mapper_boundary b = &slot->local->boundary;
+    int i, length = slot->signal->length;
+    char type = slot->signal->type;
 
-    double value;
-    double dest_min, dest_max, swap, total_range, difference, modulo_difference;
-    mapper_boundary_action bound_min, bound_max;
+    b->compiled = 1;
+    b->kernel = BOUNDARY_NONE;
 
     if (   slot->bound_min == MAPPER_BOUND_NONE
         && slot->bound_max == MAPPER_BOUND_NONE) {
-        return 0;
+        return;
     }
     if (!slot->minimum && (   slot->bound_min != MAPPER_BOUND_NONE
                            || slot->bound_max == MAPPER_BOUND_WRAP)) {
-        return 0;
+        return;
     }
     if (!slot->maximum && (   slot->bound_max != MAPPER_BOUND_NONE
                            || slot->bound_min == MAPPER_BOUND_WRAP)) {
-        return 0;
+        return;
     }
+    if (check_signal_type(type) || length < 1)
+        return;
 
-    for (i = 0; i < history->length; i++) {
-        if (typestring[i] == 'N') {
-            ++muted;
-            continue;
-        }
-        value = propval_double(mapper_history_value_ptr(*history),
-                               slot->signal->type, i);
-        dest_min = propval_double(slot->minimum, slot->signal->type, i);
-        dest_max = propval_double(slot->maximum, slot->signal->type, i);
-        if (dest_min < dest_max) {
-            bound_min = slot->bound_min;
-            bound_max = slot->bound_max;
+    if (length != b->length || type != b->type) {
+        b->lo = realloc(b->lo, sizeof(double) * length);
+        b->hi = realloc(b->hi, sizeof(double) * length);
+        b->typed_lo = realloc(b->typed_lo, mapper_type_size(type) * length);
+        b->typed_hi = realloc(b->typed_hi, mapper_type_size(type) * length);
+        b->action_lo = realloc(b->action_lo, length);
+        b->action_hi = realloc(b->action_hi, length);
+        b->length = length;
+        b->type = type;
+    }
+
+    b->kernel = BOUNDARY_CLAMP;
+    for (i = 0; i < length; i++) {
+        double lo = (slot->minimum ? propval_double(slot->minimum, type, i)
+                     : -HUGE_VAL);
+        double hi = (slot->maximum ? propval_double(slot->maximum, type, i)
+                     : HUGE_VAL);
+        if (lo < hi) {
+            b->lo[i] = lo;
+            b->hi[i] = hi;
+            b->action_lo[i] = slot->bound_min;
+            b->action_hi[i] = slot->bound_max;
         }
         else {
-            bound_min = slot->bound_max;
-            bound_max = slot->bound_min;
-            swap = dest_max;
-            dest_max = dest_min;
-            dest_min = swap;
+            b->lo[i] = hi;
+            b->hi[i] = lo;
+            b->action_lo[i] = slot->bound_max;
+            b->action_hi[i] = slot->bound_min;
         }
-        total_range = fabs(dest_max - dest_min);
-        if (value < dest_min) {
-            switch (bound_min) {
-                case MAPPER_BOUND_MUTE:
-                    // need to prevent value from being sent at all
-                    typestring[i] = 'N';
-                    ++muted;
-                    break;
-                case MAPPER_BOUND_CLAMP:
-                    // clamp value to range minimum
-                    value = dest_min;
-                    break;
-                case MAPPER_BOUND_FOLD:
-                    // fold value around range minimum
-                    difference = fabs(value - dest_min);
-                    value = dest_min + difference;
-                    if (value > dest_max) {
-                        // value now exceeds range maximum!
-                        switch (bound_max) {
-                            case MAPPER_BOUND_MUTE:
-                                // need to prevent value from being sent at all
-                                typestring[i] = 'N';
-                                ++muted;
-                                break;
-                            case MAPPER_BOUND_CLAMP:
-                                // clamp value to range minimum
-                                value = dest_max;
-                                break;
-                            case MAPPER_BOUND_FOLD:
-                                // both boundary actions are set to fold!
-                                difference = fabs(value - dest_max);
-                                modulo_difference = difference
-                                    - ((int)(difference / total_range)
-                                       * total_range);
-                                if ((int)(difference / total_range) % 2 == 0) {
-                                    value = dest_max - modulo_difference;
-                                }
-                                else
-                                    value = dest_min + modulo_difference;
-                                break;
-                            case MAPPER_BOUND_WRAP:
-                                // wrap value back from range minimum
-                                difference = fabs(value - dest_max);
-                                modulo_difference = difference
-                                    - ((int)(difference / total_range)
-                                       * total_range);
-                                value = dest_min + modulo_difference;
-                                break;
-                            default:
-                                break;
-                        }
-                    }
-                    break;
-                case MAPPER_BOUND_WRAP:
-                    // wrap value back from range maximum
-                    difference = fabs(value - dest_min);
-                    modulo_difference = difference
-                        - (int)(difference / total_range) * total_range;
-                    value = dest_max - modulo_difference;
-                    break;
-                default:
-                    // leave the value unchanged
-                    break;
-            }
+        if (   (   b->action_lo[i] != MAPPER_BOUND_NONE
+                && b->action_lo[i] != MAPPER_BOUND_CLAMP)
+            || (   b->action_hi[i] != MAPPER_BOUND_NONE
+                && b->action_hi[i] != MAPPER_BOUND_CLAMP))
+            b->kernel = BOUNDARY_GENERIC;
+
+        // clamping to the type's extremes leaves unbounded elements unchanged
+        switch (type) {
+            case 'i':
+                ((int*)b->typed_lo)[i] = (b->action_lo[i] == MAPPER_BOUND_CLAMP
+                                          ? (int)b->lo[i] : INT_MIN);
+                ((int*)b->typed_hi)[i] = (b->action_hi[i] == MAPPER_BOUND_CLAMP
+                                          ? (int)b->hi[i] : INT_MAX);
+                break;
+            case 'f':
+                ((float*)b->typed_lo)[i] = (b->action_lo[i] == MAPPER_BOUND_CLAMP
+                                            ? (float)b->lo[i] : -HUGE_VALF);
+                ((float*)b->typed_hi)[i] = (b->action_hi[i] == MAPPER_BOUND_CLAMP
+                                            ? (float)b->hi[i] : HUGE_VALF);
+                break;
+            case 'd':
+                ((double*)b->typed_lo)[i] = (b->action_lo[i] == MAPPER_BOUND_CLAMP
+                                             ? b->lo[i] : -HUGE_VAL);
+                ((double*)b->typed_hi)[i] = (b->action_hi[i] == MAPPER_BOUND_CLAMP
+                                             ? b->hi[i] : HUGE_VAL);
+                break;
         }
-        else if (value > dest_max) {
-            switch (bound_max) {
-                case MAPPER_BOUND_MUTE:
-                    // need to prevent value from being sent at all
-                    typestring[i] = 'N';
-                    ++muted;
-                    break;
-                case MAPPER_BOUND_CLAMP:
-                    // clamp value to range maximum
-                    value = dest_max;
-                    break;
-                case MAPPER_BOUND_FOLD:
-                    // fold value around range maximum
-                    difference = fabs(value - dest_max);
-                    value = dest_max - difference;
-                    if (value < dest_min) {
-                        // value now exceeds range minimum!
-                        switch (bound_min) {
-                            case MAPPER_BOUND_MUTE:
-                                // need to prevent value from being sent at all
-                                typestring[i] = 'N';
-                                ++muted;
-                                break;
-                            case MAPPER_BOUND_CLAMP:
-                                // clamp value to range minimum
-                                value = dest_min;
-                                break;
-                            case MAPPER_BOUND_FOLD:
-                                // both boundary actions are set to fold!
-                                difference = fabs(value - dest_min);
-                                modulo_difference = difference
-                                    - ((int)(difference / total_range)
-                                       * total_range);
-                                if ((int)(difference / total_range) % 2 == 0) {
-                                    value = dest_max + modulo_difference;
-                                }
-                                else
-                                    value = dest_min - modulo_difference;
-                                break;
-                            case MAPPER_BOUND_WRAP:
-                                // wrap value back from range maximum
-                                difference = fabs(value - dest_min);
-                                modulo_difference = difference
-                                    - ((int)(difference / total_range)
-                                       * total_range);
-                                value = dest_max - modulo_difference;
-                                break;
-                            default:
-                                break;
-                        }
-                    }
-                    break;
-                case MAPPER_BOUND_WRAP:
-                    // wrap value back from range minimum
-                    difference = fabs(value - dest_max);
-                    modulo_difference = difference
-                        - (int)(difference / total_range) * total_range;
-                    value = dest_min + modulo_difference;
-                    break;
-                default:
-                    break;
-            }
+    }
+}
+
+/* Branch-free clamping loops which the compiler can vectorize. Muted elements
+ * are clamped too since their values are never sent. */
+#define CLAMP_KERNEL(TYPE)                                          \
+{                                                                   \
+    TYPE *v = value, *lo = b->typed_lo, *hi = b->typed_hi;          \
+    for (i = 0; i < length; i++) {                                  \
+        TYPE x = v[i] < lo[i] ? lo[i] : v[i];                       \
+        v[i] = x > hi[i] ? hi[i] : x;                               \
+    }                                                               \
+}
+
+#define GENERIC_KERNEL(TYPE)                                        \
+{                                                                   \
+    TYPE *v = value;                                                \
+    for (i = 0; i < length; i++) {                                  \
+        int mute = 0;                                               \
+        if (typestring[i] == 'N') {                                 \
+            ++muted;                                                \
+            continue;                                               \
+        }                                                           \
+        v[i] = bound_element(v[i], b->lo[i], b->hi[i],              \
+                             b->action_lo[i], b->action_hi[i],      \
+                             &mute);                                \
+        if (mute) {                                                 \
+            typestring[i] = 'N';                                    \
+            ++muted;                                                \
+        }                                                           \
+    }                                                               \
+}
+
+int mapper_boundary_perform(mapper_history history, mapper_slot slot,
+                            char *typestring)
+{
+    int i, muted = 0, length = history->length;
+    mapper_boundary b = &slot->local->boundary;
+
+    if (!b->compiled)
+        compile_boundary(slot);
+    if (b->kernel == BOUNDARY_NONE || length != b->length
+        || history->type != b->type)
+        return 0;
+
+    void *value = mapper_history_value_ptr(*history);
+    if (b->kernel == BOUNDARY_CLAMP) {
+        switch (b->type) {
+            case 'i':   CLAMP_KERNEL(int);      break;
+            case 'f':   CLAMP_KERNEL(float);    break;
+            case 'd':   CLAMP_KERNEL(double);   break;
+        }
+        for (i = 0; i < length; i++) {
+            if (typestring[i] == 'N')
+                ++muted;
+        }
+    }
+    else {
+        switch (b->type) {
+            case 'i':   GENERIC_KERNEL(int);    break;
+            case 'f':   GENERIC_KERNEL(float);  break;
+            case 'd':   GENERIC_KERNEL(double); break;
         }
-        propval_set_double(mapper_history_value_ptr(*history),
-                           slot->signal->type, i, value);
     }
-    return (muted == history->length);
+    return (muted == length);
 }
 
-/*! Build a value update message for a given map. */
-lo_message mapper_map_build_message(mapper_map map, mapper_slot slot,
-                                    const void *value, int count,
-                                    char *typestring, mapper_id_map id_map)
+int mapper_map_message_length(mapper_map map, mapper_slot slot, int count)
+{
+    return ((map->process_location == MAPPER_LOC_SOURCE)
+            ? map->destination.signal->length * count
+            : slot->signal->length * count);
+}
+
+static lo_message build_message(mapper_map map, mapper_slot slot,
+                                const void *value, char *typestring,
+                                mapper_id_map id_map, int alias, int offset,
+                                int length)
 {
     int i;
-    int length = ((map->process_location == MAPPER_LOC_SOURCE)
-                  ? map->destination.signal->length * count : slot->signal->length * count);
 
     lo_message msg = lo_message_new();
     if (!msg)
         return 0;
 
+    // the alias also identifies the slot
+    if (alias)
+        lo_message_add_int32(msg, alias);
+
     if (value && typestring) {
-        for (i = 0; i < length; i++) {
+        for (i = offset; i < offset + length; i++) {
             switch (typestring[i]) {
                 case 'i':
                     lo_message_add_int32(msg, ((int*)value)[i]);
@@ -966,11 +1235,11 @@ lo_message mapper_map_build_message(mapper_map map, mapper_slot slot,
     }
 
     if (id_map) {
-        lo_message_add_string(msg, "@instance");
+        lo_message_add_string(msg, alias ? MAPPER_ALIAS_INSTANCE : "@instance");
         lo_message_add_int64(msg, id_map->global);
     }
 
-    if (map->process_location == MAPPER_LOC_DESTINATION) {
+    if (!alias && map->process_location == MAPPER_LOC_DESTINATION) {
         // add slot
         lo_message_add_string(msg, "@slot");
         lo_message_add_int32(msg, slot->id);
@@ -979,6 +1248,38 @@ lo_message mapper_map_build_message(mapper_map map, mapper_slot slot,
     return msg;
 }
 
+/*! Build a value update message for a given map. */
+lo_message mapper_map_build_message(mapper_map map, mapper_slot slot,
+                                    const void *value, int count,
+                                    char *typestring, mapper_id_map id_map,
+                                    int alias)
+{
+    return build_message(map, slot, value, typestring, id_map, alias, 0,
+                         mapper_map_message_length(map, slot, count));
+}
+
+lo_message mapper_map_build_fragment(mapper_map map, mapper_slot slot,
+                                     const void *value, int count,
+                                     char *typestring, mapper_id_map id_map,
+                                     int alias, int offset)
+{
+    int total = mapper_map_message_length(map, slot, count);
+    if (offset < 0 || offset >= total)
+        return 0;
+    int length = total - offset;
+    if (length > MAPPER_FRAGMENT_LEN)
+        length = MAPPER_FRAGMENT_LEN;
+
+    lo_message msg = build_message(map, slot, value, typestring, id_map,
+                                   alias, offset, length);
+    if (!msg)
+        return 0;
+    lo_message_add_string(msg, alias ? MAPPER_ALIAS_FRAGMENT : "@fragment");
+    lo_message_add_int32(msg, offset);
+    lo_message_add_int32(msg, total);
+    return msg;
+}
+
 /* Helper to replace a map's expression only if the given string
  * parses successfully. Returns 0 on success, non-zero on error. */
 static int replace_expression_string(mapper_map map, const char *expr_str)
@@ -1041,6 +1342,107 @@ static void mapper_map_set_mode_raw(mapper_map map)
     reallocate_map_histories(map);
 }
 
+/* Compute the per-element scale and offset of a linear map from the source
+ * and destination ranges. Returns 0 on success, non-zero if the ranges are
+ * not known. */
+static int compute_linear_scaling(mapper_map map)
+{
+    mapper_local_map lmap = map->local;
+    mapper_slot src = map->sources[0], dst = &map->destination;
+    int i, length;
+    double src_min, src_max, dst_min, dst_max;
+
+    if (!src->minimum || !src->maximum || !dst->minimum || !dst->maximum)
+        return 1;
+
+    length = (src->signal->length < dst->signal->length
+              ? src->signal->length : dst->signal->length);
+    if (length != lmap->linear_length) {
+        lmap->scale = realloc(lmap->scale, sizeof(double) * length);
+        lmap->offset = realloc(lmap->offset, sizeof(double) * length);
+        lmap->linear_length = length;
+    }
+
+    for (i = 0; i < length; i++) {
+        src_min = propval_double(src->minimum, src->signal->type, i);
+        src_max = propval_double(src->maximum, src->signal->type, i);
+        dst_min = propval_double(dst->minimum, dst->signal->type, i);
+        dst_max = propval_double(dst->maximum, dst->signal->type, i);
+        if (src_min == src_max) {
+            lmap->scale[i] = 0;
+            lmap->offset[i] = dst_min;
+        }
+        else if ((src_min == dst_min) && (src_max == dst_max)) {
+            lmap->scale[i] = 1;
+            lmap->offset[i] = 0;
+        }
+        else {
+            lmap->scale[i] = (dst_min - dst_max) / (src_min - src_max);
+            lmap->offset[i] = ((dst_max * src_min - dst_min * src_max)
+                               / (src_min - src_max));
+        }
+    }
+    return 0;
+}
+
+/* Build the expression string equivalent to a map's linear scaling. The
+ * caller is responsible for freeing the returned string. */
+static char *linear_expression_string(mapper_map map)
+{
+    mapper_local_map lmap = map->local;
+    int i, len, length = lmap->linear_length;
+    int src_len = map->sources[0]->signal->length;
+    int dst_len = map->destination.signal->length;
+    // each coefficient needs at most 14 characters and a separator
+    size_t size = 64 + length * 30;
+    char *str = malloc(size);
+
+    if (dst_len == src_len)
+        len = snprintf(str, size, "y=x*");
+    else if (dst_len > src_len) {
+        if (length == 1)
+            len = snprintf(str, size, "y[0]=x*");
+        else
+            len = snprintf(str, size, "y[0:%i]=x*", length-1);
+    }
+    else {
+        if (length == 1)
+            len = snprintf(str, size, "y=x[0]*");
+        else
+            len = snprintf(str, size, "y=x[0:%i]*", length-1);
+    }
+
+    if (length > 1)
+        str[len++] = '[';
+    for (i = 0; i < length; i++)
+        len += snprintf(str+len, size-len, "%g,", lmap->scale[i]);
+    // overwrite the trailing comma
+    --len;
+    len += snprintf(str+len, size-len, length > 1 ? "]+[" : "+");
+    for (i = 0; i < length; i++)
+        len += snprintf(str+len, size-len, "%g,", lmap->offset[i]);
+    --len;
+    if (length > 1)
+        snprintf(str+len, size-len, "]");
+    else
+        str[len] = '\0';
+    return str;
+}
+
+/* Regenerate the expression string of a linear map if calibration has
+ * updated its scaling since the string was last built. */
+static void refresh_linear_expression(mapper_map map)
+{
+    if (!map->local || !map->local->linear_stale
+        || map->mode != MAPPER_MODE_LINEAR)
+        return;
+    char *expr = linear_expression_string(map);
+    mapper_table_set_record(map->props, AT_EXPRESSION, NULL, 1, 's', expr,
+                            REMOTE_MODIFY);
+    free(expr);
+    map->local->linear_stale = 0;
+}
+
 static int mapper_map_set_mode_linear(mapper_map map)
 {
     if (map->num_sources > 1)
@@ -1049,126 +1451,37 @@ static int mapper_map_set_mode_linear(mapper_map map)
     if (map->status < (STATUS_TYPE_KNOWN | STATUS_LENGTH_KNOWN))
         return 1;
 
-    int i, len;
-    char expr[256] = "";
-    const char *e = expr;
-
-    if (   !map->sources[0]->minimum  || !map->sources[0]->maximum
-        || !map->destination.minimum || !map->destination.maximum)
+    if (compute_linear_scaling(map))
         return 1;
 
-    int min_length = map->sources[0]->signal->length < map->destination.signal->length ?
-                     map->sources[0]->signal->length : map->destination.signal->length;
-    double src_min=0, src_max=0, dest_min=0, dest_max=0;
+    int i, should_compile = 0;
+    char *expr = linear_expression_string(map);
 
-    if (map->destination.signal->length == map->sources[0]->signal->length)
-        snprintf(expr, 256, "y=x*");
-    else if (map->destination.signal->length > map->sources[0]->signal->length) {
-        if (min_length == 1)
-            snprintf(expr, 256, "y[0]=x*");
-        else
-            snprintf(expr, 256, "y[0:%i]=x*", min_length-1);
+    if (map->local->is_local_only)
+        should_compile = 1;
+    else if (map->process_location == MAPPER_LOC_DESTINATION) {
+        // check if destination is local
+        if (map->destination.local->router_sig)
+            should_compile = 1;
     }
     else {
-        if (min_length == 1)
-            snprintf(expr, 256, "y=x[0]*");
-        else
-            snprintf(expr, 256, "y=x[0:%i]*", min_length-1);
-    }
-
-    if (min_length > 1) {
-        len = strlen(expr);
-        snprintf(expr+len, 256-len, "[");
-    }
-
-    for (i = 0; i < min_length; i++) {
-        // get multiplier
-        src_min = propval_double(map->sources[0]->minimum,
-                                 map->sources[0]->signal->type, i);
-        src_max = propval_double(map->sources[0]->maximum,
-                                 map->sources[0]->signal->type, i);
-        len = strlen(expr);
-        if (src_min == src_max)
-            snprintf(expr+len, 256-len, "0,");
-        else {
-            dest_min = propval_double(map->destination.minimum,
-                                      map->destination.signal->type, i);
-            dest_max = propval_double(map->destination.maximum,
-                                      map->destination.signal->type, i);
-            if ((src_min == dest_min) && (src_max == dest_max)) {
-                snprintf(expr+len, 256-len, "1,");
-            }
-            else {
-                double scale = ((dest_min - dest_max) / (src_min - src_max));
-                snprintf(expr+len, 256-len, "%g,", scale);
-            }
+        for (i = 0; i < map->num_sources; i++) {
+            if (map->sources[i]->local->router_sig)
+                should_compile = 1;
         }
     }
-    len = strlen(expr);
-    if (min_length > 1)
-        snprintf(expr+len-1, 256-len+1, "]+[");
-    else
-        snprintf(expr+len-1, 256-len+1, "+");
-
-    // add offset
-    for (i = 0; i < min_length; i++) {
-        src_min = propval_double(map->sources[0]->minimum,
-                                 map->sources[0]->signal->type, i);
-        src_max = propval_double(map->sources[0]->maximum,
-                                 map->sources[0]->signal->type, i);
-
-        len = strlen(expr);
-        if (src_min == src_max)
-            snprintf(expr+len, 256-len, "%g,", dest_min);
-        else {
-            dest_min = propval_double(map->destination.minimum,
-                                      map->destination.signal->type, i);
-            dest_max = propval_double(map->destination.maximum,
-                                      map->destination.signal->type, i);
-            if ((src_min == dest_min) && (src_max == dest_max)) {
-                snprintf(expr+len, 256-len, "0,");
-            }
-            else {
-                double offset = ((dest_max * src_min - dest_min * src_max)
-                                 / (src_min - src_max));
-                snprintf(expr+len, 256-len, "%g,", offset);
-            }
-        }
+    if (should_compile) {
+        if (!replace_expression_string(map, expr))
+            reallocate_map_histories(map);
     }
-    len = strlen(expr);
-    if (min_length > 1)
-        snprintf(expr+len-1, 256-len+1, "]");
-    else
-        expr[len-1] = '\0';
-
-    // If everything is successful, replace the map's expression.
-    if (e) {
-        int should_compile = 0;
-        if (map->local->is_local_only)
-            should_compile = 1;
-        else if (map->process_location == MAPPER_LOC_DESTINATION) {
-            // check if destination is local
-            if (map->destination.local->router_sig)
-                should_compile = 1;
-        }
-        else {
-            for (i = 0; i < map->num_sources; i++) {
-                if (map->sources[i]->local->router_sig)
-                    should_compile = 1;
-            }
-        }
-        if (should_compile) {
-            if (!replace_expression_string(map, e))
-                reallocate_map_histories(map);
-        }
-        else {
-            mapper_table_set_record(map->props, AT_EXPRESSION, NULL, 1, 's',
-                                    e, REMOTE_MODIFY);
-        }
-        map->mode = MAPPER_MODE_LINEAR;
-        return 0;
+    else {
+        mapper_table_set_record(map->props, AT_EXPRESSION, NULL, 1, 's',
+                                expr, REMOTE_MODIFY);
     }
-    return 1;
+    free(expr);
+    map->local->linear_stale = 0;
+    map->mode = MAPPER_MODE_LINEAR;
+    return 0;
 }
 
 static void mapper_map_set_mode_expression(mapper_map map, const char *expr)
@@ -1253,6 +1566,9 @@ static void init_slot_history(mapper_slot slot)
                                                * slot->signal->length);
         slot->local->history[i].timetag = calloc(1, sizeof(mapper_timetag_t));
         slot->local->history[i].position = -1;
+        slot->local->history[i].count = 0;
+        slot->local->history[i].windows = 0;
+        slot->local->history[i].num_windows = 0;
     }
 }
 
@@ -1567,10 +1883,14 @@ int mapper_map_set_from_message(mapper_map map, mapper_message msg, int override
                                                    1, 'i', &mode, REMOTE_MODIFY);
                 break;
             }
+            case AT_ID:
+                updated += mapper_table_set_record_from_atom(map->props, atom,
+                                                             REMOTE_MODIFY);
+                mapper_database_index_map(map->database, map);
+                break;
             case AT_EXTRA:
                 if (!atom->key)
                     break;
-            case AT_ID:
             case AT_DESCRIPTION:
             case AT_MUTED:
             case AT_VERSION:
@@ -1612,6 +1932,7 @@ void reallocate_map_histories(mapper_map map)
         slot_loc = slot->local;
 
         history_size = mapper_expr_input_history_size(map->local->expr, i);
+        history_size = mapper_history_capacity(history_size);
         if (history_size > slot_loc->history_size) {
             size_t sample_size = mapper_type_size(slot->signal->type) * slot->signal->length;;
             for (j = 0; j < slot->num_instances; j++) {
@@ -1625,6 +1946,7 @@ void reallocate_map_histories(mapper_map map)
     }
 
     history_size = mapper_expr_output_history_size(map->local->expr);
+    history_size = mapper_history_capacity(history_size);
     slot = &map->destination;
     slot_loc = slot->local;
 
@@ -1653,6 +1975,9 @@ void reallocate_map_histories(mapper_map map)
                 map->local->expr_vars[i][j].length = 0;
                 map->local->expr_vars[i][j].size = 0;
                 map->local->expr_vars[i][j].position = -1;
+                map->local->expr_vars[i][j].count = 0;
+                map->local->expr_vars[i][j].value = 0;
+                map->local->expr_vars[i][j].timetag = 0;
             }
             for (j = 0; j < new_num_vars; j++) {
                 int history_size = mapper_expr_variable_history_size(map->local->expr, j);
@@ -1660,7 +1985,6 @@ void reallocate_map_histories(mapper_map map)
                 mhist_realloc(map->local->expr_vars[i]+j, history_size,
                               vector_length * sizeof(double), 0);
                 (map->local->expr_vars[i]+j)->length = vector_length;
-                (map->local->expr_vars[i]+j)->size = history_size;
                 (map->local->expr_vars[i]+j)->position = -1;
             }
         }
@@ -1678,6 +2002,8 @@ void mhist_realloc(mapper_history history,
 {
     if (!history || !history_size || !sample_size)
         return;
+    // history buffers are indexed using a mask
+    history_size = mapper_history_capacity(history_size);
     if (history_size == history->size)
         return;
     if (!is_input || (history_size > history->size) || (history->position == 0)) {
@@ -1687,22 +2013,26 @@ void mhist_realloc(mapper_history history,
         if (!is_input) {
             // Initialize entire history to 0
             memset(history->value, 0, history_size * sample_size);
+            memset(history->timetag, 0, history_size * sizeof(mapper_timetag_t));
             history->position = -1;
         }
-        else if (history->position == 0) {
-            memset(history->value + sample_size * history->size, 0,
-                   sample_size * (history_size - history->size));
-        }
         else {
-            int new_position = history_size - history->size + history->position;
-            memcpy(history->value + sample_size * new_position,
-                   history->value + sample_size * history->position,
-                   sample_size * (history->size - history->position));
-            memcpy(&history->timetag[new_position],
-                   &history->timetag[history->position], sizeof(mapper_timetag_t)
-                   * (history->size - history->position));
-            memset(history->value + sample_size * history->position, 0,
-                   sample_size * (history_size - history->size));
+            /* Move the samples older than the current position to the end of
+             * the new buffer and zero the gap. */
+            int older = history->size - history->position - 1;
+            int gap = history_size - history->size;
+            if (older > 0) {
+                memmove(history->value + sample_size * (history_size - older),
+                        history->value + sample_size * (history->position + 1),
+                        sample_size * older);
+                memmove(&history->timetag[history_size - older],
+                        &history->timetag[history->position + 1],
+                        sizeof(mapper_timetag_t) * older);
+            }
+            memset(history->value + sample_size * (history->position + 1), 0,
+                   sample_size * gap);
+            memset(&history->timetag[history->position + 1], 0,
+                   sizeof(mapper_timetag_t) * gap);
         }
     }
     else {
@@ -1810,6 +2140,8 @@ int mapper_map_send_state(mapper_map map, int slot, network_message_t cmd)
         lo_message_add_int64(msg, *((int64_t*)&map->id));
     }
 
+    mapper_network_set_dest_object(map->database->network, map);
+
     if (cmd == MSG_UNMAP || cmd == MSG_UNMAPPED) {
         mapper_network_add_message(map->database->network, 0, cmd, msg);
         return i-1;
@@ -1817,6 +2149,8 @@ int mapper_map_send_state(mapper_map map, int slot, network_message_t cmd)
 
     // add other properties
     int staged = (cmd == MSG_MAP) || (cmd == MSG_MAP_MODIFY);
+    if (!staged)
+        refresh_linear_expression(map);
     mapper_table_add_to_message(0, staged ? map->staged_props : map->props, msg);
 
     if (!staged) {
@@ -1851,6 +2185,12 @@ int mapper_map_send_state(mapper_map map, int slot, network_message_t cmd)
     for (; i < map->num_sources; i++) {
         if ((slot >= 0) && link && (link != map->sources[i]->link))
             break;
+        /* The destination device assigns each source an alias for
+         * addressing its updates. */
+        if (cmd == MSG_MAPPED
+            && map->destination.direction == MAPPER_DIR_INCOMING)
+            mapper_device_add_alias(map->destination.signal->device, map,
+                                    map->sources[i]);
         mapper_slot_add_props_to_message(msg, map->sources[i], 0, staged);
     }
 
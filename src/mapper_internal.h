@@ -11,7 +11,7 @@
 
 /**** Signals ****/
 
-#define MAPPER_MAX_VECTOR_LEN 128
+#define MAPPER_MAX_VECTOR_LEN 16384
 
 /*! Get the full OSC name of a signal, including device name prefix.
  *  \param sig  The signal value to query.
@@ -29,7 +29,35 @@ int mapper_device_set_from_message(mapper_device dev, mapper_message msg);
 
 void mapper_device_manage_subscriber(mapper_device dev, lo_address address,
                                      int flags, int timeout_seconds,
-                                     int revision);
+                                     int revision,
+                                     mapper_subscription_filter filter);
+
+/**** Subscription filters ****/
+
+mapper_subscription_filter mapper_subscription_filter_copy(
+    mapper_subscription_filter filter);
+
+/*! Add a filter to a /subscribe message. */
+void mapper_subscription_filter_add_to_message(
+    mapper_subscription_filter filter, lo_message msg);
+
+int mapper_subscription_filter_equal(mapper_subscription_filter l,
+                                     mapper_subscription_filter r);
+
+/*! Parse a filter argument of a /subscribe message, starting with its "@name"
+ *  or "@where" key, and add it to a filter which is created if necessary.
+ *  \return     The number of arguments used. */
+int mapper_subscription_filter_parse(mapper_subscription_filter *filter,
+                                     const char *types, lo_arg **argv,
+                                     int argc);
+
+int mapper_subscription_filter_match_signal(mapper_subscription_filter filter,
+                                            mapper_signal sig);
+
+/*! Check whether any of a map's signals belonging to a device passes a
+ *  filter. */
+int mapper_subscription_filter_match_map(mapper_subscription_filter filter,
+                                         mapper_map map, mapper_device dev);
 
 /**** Networking ****/
 
@@ -51,6 +79,22 @@ void mapper_network_set_dest_mesh(mapper_network net, lo_address address);
 
 void mapper_network_set_dest_subscribers(mapper_network net, int type);
 
+/*! Note the signal or map described by the next messages for subscribers, so
+ *  that they can be withheld from subscribers whose filters it fails. */
+void mapper_network_set_dest_object(mapper_network net, void *object);
+
+/*! Send any messages waiting for subscribers which describe a signal or map
+ *  that is about to be freed. */
+void mapper_network_forget_object(mapper_network net, void *object);
+
+void mapper_network_set_dest_device(mapper_network net, mapper_device dev);
+
+void mapper_network_forget_dest(mapper_network net, lo_address address);
+
+void mapper_network_begin_batch(mapper_network net);
+
+void mapper_network_end_batch(mapper_network net);
+
 void mapper_network_add_message(mapper_network net, const char *str,
                                 network_message_t cmd, lo_message msg);
 
@@ -105,6 +149,49 @@ const char *mapper_device_name(mapper_device dev);
 
 void mapper_device_send_state(mapper_device dev, network_message_t cmd);
 
+/*! Get the current time as seen by a device, including any clock adjustment
+ *  set using mapper_device_set_clock_adjustment(). */
+void mapper_device_now(mapper_device dev, mapper_timetag_t *tt);
+
+/*! Offset and skew a local device's clock, for testing clock synchronisation
+ *  between devices in a single process. */
+void mapper_device_set_clock_adjustment(mapper_device dev, double offset,
+                                        double skew);
+
+/*! Start accepting stream connections on a device's data port, if it is not
+ *  already doing so. Called when one of its links selects the stream
+ *  transport. */
+void mapper_device_listen_streams(mapper_device dev);
+
+/*! Check whether the remote device of a link belongs to this process, so
+ *  that updates can be passed to it directly. */
+void mapper_device_find_peer(mapper_link link);
+
+/*! Queue a signal update for the remote device of a link if it belongs to
+ *  this process. The update is delivered by the remote device's next call to
+ *  mapper_device_poll(). Takes ownership of the message if successful.
+ *  \return             Zero on success, non-zero if the update must be sent
+ *                      through the network instead. */
+int mapper_device_send_direct(mapper_link link, const char *path,
+                              lo_message msg, mapper_timetag_t tt);
+
+/*! Queue the updates in a bundle for the remote device of a link if it
+ *  belongs to this process. The updates are delivered together by the remote
+ *  device's next call to mapper_device_poll(). The bundle is not modified.
+ *  \return             Zero on success, non-zero if the bundle must be sent
+ *                      through the network instead. */
+int mapper_device_send_direct_bundle(mapper_link link, lo_bundle b,
+                                     mapper_timetag_t tt);
+
+/*! Assign an alias for updates from a source slot of a map with a local
+ *  destination, if it does not already have one.
+ *  \return             The alias, or zero if memory is exhausted. */
+int mapper_device_add_alias(mapper_device dev, mapper_map map,
+                            mapper_slot slot);
+
+/*! Release the aliases assigned for a map's source slots. */
+void mapper_device_remove_aliases(mapper_device dev, mapper_map map);
+
 /***** Router *****/
 
 void mapper_router_remove_signal(mapper_router router, mapper_router_signal rs);
@@ -119,6 +206,9 @@ void mapper_router_process_signal(mapper_router r, mapper_signal sig,
                                   int instance_index, const void *value,
                                   int count, mapper_timetag_t timetag);
 
+/*! Send values held back by send policies, if their maximum rate allows. */
+void mapper_router_send_pending(mapper_router r);
+
 int mapper_router_send_query(mapper_router router,
                              mapper_signal sig,
                              mapper_timetag_t tt);
@@ -144,6 +234,11 @@ mapper_map mapper_router_incoming_map(mapper_router router,
 mapper_map mapper_router_map_by_id(mapper_router router, mapper_signal local_sig,
                                    mapper_id id, mapper_direction dir);
 
+/*! Find the incoming map for a local destination signal if there is exactly
+ *  one, otherwise return 0. */
+mapper_map mapper_router_sole_incoming_map(mapper_router router,
+                                           mapper_signal local_dst);
+
 mapper_slot mapper_router_slot(mapper_router router, mapper_signal signal,
                                int slot_number);
 
@@ -234,10 +329,64 @@ void mapper_link_init(mapper_link link, int is_local);
 void mapper_link_connect(mapper_link link, const char *host, int admin_port,
                       int data_port);
 void mapper_link_free(mapper_link link);
+
+/*! Write a bundle to the shared memory of a link's remote device.
+ *  \return             Zero on success, non-zero if the bundle must be sent
+ *                      through the network instead. */
+int mapper_link_send_shm(mapper_link link, lo_bundle b);
+
+/*! Write the updates waiting for space in the shared memory of a link's
+ *  remote device. */
+void mapper_link_flush_shm(mapper_link link);
+
+/*! Open or close a link's stream connection to match its "transport"
+ *  property. */
+void mapper_link_update_transport(mapper_link link);
+
+/*! Check whether a link's updates should be sent through its stream
+ *  connection, reopening the connection if it failed earlier.
+ *  \return             Non-zero if the link has an open stream. */
+int mapper_link_uses_stream(mapper_link link);
+
+/*! Send a bundle of map updates through a link's stream connection. Dropped
+ *  updates are counted in the statistics of the link and of the map, which
+ *  may be zero.
+ *  \return             Zero if the bundle was added to the stream, non-zero
+ *                      if it was dropped because of backpressure or the link
+ *                      has no stream. */
+int mapper_link_send_stream_bundle(mapper_link link, lo_bundle b,
+                                   mapper_map map);
+
+/*! Write the frames waiting in a link's stream connection, closing it if the
+ *  connection has failed. */
+void mapper_link_flush_stream(mapper_link link);
+
 int mapper_link_set_from_message(mapper_link link, mapper_message msg, int rev);
 void mapper_link_send_state(mapper_link link, network_message_t cmd, int staged);
-void mapper_link_start_queue(mapper_link link, mapper_timetag_t tt);
-void mapper_link_send_queue(mapper_link link, mapper_timetag_t tt);
+
+/*! Get the bundle collecting messages for a link in an open queue, creating
+ *  it if this is the first message for the link. */
+lo_bundle mapper_link_queue_bundle(mapper_link link, mapper_queue queue);
+
+/*! Send a link bundle belonging to a queue if requested, then free it. The
+ *  caller is responsible for removing it from the queue. */
+void mapper_link_close_bundle(mapper_link_bundle bundle, int send);
+
+/*! Add a round-trip measurement to a link clock and update the estimated
+ *  offset, skew and error bound.
+ *  \param clock        The link clock to update.
+ *  \param time         Local monotonic time of the measurement.
+ *  \param offset       Measured offset, local minus remote time.
+ *  \param delay        Round-trip delay excluding the remote hold time. */
+void mapper_sync_clock_add_sample(mapper_sync_clock clock, double time,
+                                  double offset, double delay);
+
+/*! Get the estimated offset of a link clock (local minus remote) at the
+ *  current time, extrapolated using the estimated skew.
+ *  \param clock        The link clock to query.
+ *  \param error        A pointer to receive the error bound, or 0.
+ *  \return             The estimated offset in seconds. */
+double mapper_sync_clock_offset(mapper_sync_clock clock, double *error);
 
 mapper_link mapper_database_add_or_update_link(mapper_database db,
                                                mapper_device dev1,
@@ -262,12 +411,33 @@ void mhist_realloc(mapper_history history, int history_size,
 int mapper_map_perform(mapper_map map, mapper_slot slot, int instance,
                        char *typestring);
 
+/*! Evaluate a map for one instance, using the native linear scaling in
+ *  linear mode and the map's expression otherwise. */
+int mapper_map_evaluate(mapper_map map, int instance, mapper_timetag_t *tt,
+                        char *typestring);
+
 int mapper_boundary_perform(mapper_history history, mapper_slot slot,
                             char *typestring);
 
+/*! Free the compiled boundary processing of a local slot. */
+void mapper_boundary_free(mapper_boundary boundary);
+
+/*! Build a value update message for a given map. If alias is non-zero the
+ *  message is addressed by the alias, using the short property keys. */
 lo_message mapper_map_build_message(mapper_map map, mapper_slot slot,
                                     const void *value, int length,
-                                    char *typestring, mapper_id_map id_map);
+                                    char *typestring, mapper_id_map id_map,
+                                    int alias);
+
+/*! Get the number of elements in a value update message for a given map. */
+int mapper_map_message_length(mapper_map map, mapper_slot slot, int count);
+
+/*! Build one fragment of a value update message that is too long to be sent
+ *  as a single message, starting at the element offset. */
+lo_message mapper_map_build_fragment(mapper_map map, mapper_slot slot,
+                                     const void *value, int count,
+                                     char *typestring, mapper_id_map id_map,
+                                     int alias, int offset);
 
 /*! Set a mapping's properties based on message parameters. */
 int mapper_map_set_from_message(mapper_map map, mapper_message msg,
@@ -397,6 +567,44 @@ void mapper_database_remove_maps_by_query(mapper_database db,
 void mapper_database_remove_map(mapper_database db, mapper_map map,
                                 mapper_record_event event);
 
+/*! Find the records which may have a property value using a secondary index.
+ *  \param candidates  Set to the candidate records, in database order.
+ *  \return            The number of candidates, or -1 if the property is not
+ *                     indexed. */
+int mapper_database_index_lookup(mapper_database db, int type,
+                                 const char *name, int length, char vtype,
+                                 const void *value, void ***candidates);
+
+/*! Return the counter of changes to records of one type in a database. It is
+ *  incremented whenever a record is added or removed, or has a property set
+ *  or removed through its table. */
+const uint32_t *mapper_database_revision(mapper_database db, int type);
+
+/*! Start tracking the changes to a new database record, and add it to the
+ *  secondary indexes for its type.
+ *  \param props    The property table of the record. */
+void mapper_database_add_record(mapper_database db, int type, void *record,
+                                mapper_table props);
+
+/*! Stop tracking a database record before it is removed, and remove it from
+ *  the secondary indexes. */
+void mapper_database_remove_record(mapper_table props);
+
+/*! Remove a record from the indexes of a property which is about to change.
+ *  This is called by the property table, and by code which writes a linked
+ *  value directly; mapper_database_index_property() must follow. */
+void mapper_database_unindex_property(mapper_table props,
+                                      mapper_property_t index,
+                                      const char *key);
+
+/*! Return a record to the indexes of a property after it has changed. */
+void mapper_database_index_property(mapper_table props,
+                                    mapper_property_t index, const char *key);
+
+/*! Add a map to the database index of map ids, or move it if its id has
+ *  changed since it was indexed. */
+void mapper_database_index_map(mapper_database db, mapper_map map);
+
 /*! Print device information database to the screen.  Useful for debugging, only
  *  works when compiled in debug mode. */
 void mapper_database_print(mapper_database db);
@@ -416,6 +624,21 @@ int mapper_database_subscribed_by_device_name(mapper_database db,
 int mapper_database_subscribed_by_signal_name(mapper_database db,
                                               const char *name);
 
+/*! Test a property value using a query operator. */
+int mapper_compare_value(mapper_op op, int length, char type, const void *val1,
+                         const void *val2);
+
+/*! Match a string against a pattern which may contain '*' wildcards. */
+int mapper_match_pattern(const char* string, const char* pattern);
+
+/*! Append a record change to the database's change feeds. */
+void mapper_database_log_change(mapper_database db, mapper_object_type type,
+                                mapper_id id, mapper_record_event event);
+
+/*! Replace the database's latest snapshot if snapshots are enabled and the
+ *  database has changed since the last one was published. */
+void mapper_database_publish_snapshot(mapper_database db);
+
 /**** Messages ****/
 /*! Parse the device and signal names from an OSC path. */
 int mapper_parse_names(const char *string, char **devnameptr, char **signameptr);
@@ -474,6 +697,10 @@ mapper_expr mapper_expr_new_from_string(const char *str, int num_inputs,
                                         char output_type,
                                         int output_vector_length);
 
+/*! Enable or disable optimization of expressions parsed afterwards, so that
+ *  the optimizer can be tested.  Enabled by default. */
+void mapper_expr_set_optimization(int enable);
+
 int mapper_expr_input_history_size(mapper_expr expr, int index);
 
 int mapper_expr_output_history_size(mapper_expr expr);
@@ -498,6 +725,9 @@ int mapper_expr_num_input_slots(mapper_expr expr);
 
 void mapper_expr_free(mapper_expr expr);
 
+/*! Free the windowed reduction state attached to an input history. */
+void mapper_expr_free_history_windows(mapper_history history);
+
 /**** String tables ****/
 
 /*! Create a new string table. */
@@ -591,6 +821,15 @@ void mapper_list_free_item(void *item);
 void **mapper_list_new_query(const void *list, const void *f,
                              const char *types, ...);
 
+/*! Create a query which only tests the given candidate items instead of
+ *  walking the whole list. The candidates must be in list order, and are
+ *  copied. If the counter at revision changes before the query is finished,
+ *  it continues by walking the list from its current item. */
+void **mapper_list_new_indexed_query(const void *list,
+                                     const uint32_t *revision,
+                                     void **candidates, int num_candidates,
+                                     const void *f, const char *types, ...);
+
 void **mapper_list_query_union(void **query1, void **query2);
 
 void **mapper_list_query_intersection(void **query1, void **query2);
@@ -607,11 +846,192 @@ void **mapper_list_query_copy(void **query);
 
 void mapper_list_query_done(void **query);
 
+/*! Get the number of list items and queries created so far, and the number
+ *  of allocations made for them. */
+void mapper_list_allocation_counts(mapper_list_allocation_counts_t *counts);
+
+/**** Scheduler ****/
+
+/*! Add an update to the scheduler, taking ownership of the message. The
+ *  slot is given for updates addressed by an alias, otherwise -1.
+ *  \return             Zero on success, non-zero if memory is exhausted. */
+int mapper_scheduler_push(mapper_scheduler s, mapper_timetag_t due,
+                          mapper_timetag_t tt, mapper_signal sig, int slot,
+                          lo_message msg);
+
+/*! Get the update that is due first without removing it, or zero if empty. */
+mapper_scheduled_update mapper_scheduler_peek(mapper_scheduler s);
+
+/*! Remove the update that is due first, copying it to u.
+ *  \return             Zero on success, non-zero if the scheduler is empty. */
+int mapper_scheduler_pop(mapper_scheduler s, mapper_scheduled_update u);
+
+/*! Discard any updates scheduled for a signal that is being removed. */
+void mapper_scheduler_remove_signal(mapper_scheduler s, mapper_signal sig);
+
+/*! Discard all scheduled updates and free the heap. */
+void mapper_scheduler_free(mapper_scheduler s);
+
+/**** Direct delivery ****/
+
+/*! Add an update to a direct delivery queue, taking ownership of the message.
+ *  \return             Zero on success, non-zero if the queue is full. */
+int mapper_direct_queue_push(mapper_direct_queue q, mapper_timetag_t tt,
+                             mapper_signal sig, lo_message msg);
+
+/*! Move up to max of the oldest updates to the batch of the queue, replacing
+ *  the previous batch, which must have been delivered.
+ *  \return             The number of updates in the batch. */
+int mapper_direct_queue_take_batch(mapper_direct_queue q, int max);
+
+/*! Stop delivering queued updates to a signal that is being removed. */
+void mapper_direct_queue_remove_signal(mapper_direct_queue q,
+                                       mapper_signal sig);
+
+/*! Discard all queued updates and free the queue. */
+void mapper_direct_queue_free(mapper_direct_queue q);
+
+/**** Shared memory ****/
+
+/*! Create the shared memory ring buffer a local device receives updates
+ *  through, named after its port.
+ *  \return             The new mapping, or zero if shared memory is not
+ *                      available. */
+mapper_shm mapper_shm_create(int port, mapper_id id);
+
+/*! Open the shared memory ring buffer of a device on the same host.
+ *  \return             The mapping, or zero if it does not exist or belongs
+ *                      to a different device. */
+mapper_shm mapper_shm_open(int port, mapper_id id);
+
+/*! Unmap shared memory, removing the object if this mapping created it. */
+void mapper_shm_free(mapper_shm shm);
+
+/*! Write a bundle to a shared memory ring buffer. If the ring is full or
+ *  busy while it still holds unread records, the bundle is kept until
+ *  mapper_shm_flush() can write it, so that it cannot overtake them.
+ *  \return             Zero on success, non-zero if the bundle must be sent
+ *                      through the network instead. */
+int mapper_shm_send_bundle(mapper_shm shm, lo_bundle b);
+
+/*! Write the bundles kept while a shared memory ring buffer was full.
+ *  \return             Non-zero if any were written. */
+int mapper_shm_flush(mapper_shm shm);
+
+/*! Check whether the reader should be woken after a write, clearing the
+ *  request. */
+int mapper_shm_wakeup(mapper_shm shm);
+
+/*! Dispatch the bundles waiting in a shared memory ring buffer to a server.
+ *  \return             The number of bundles dispatched. */
+int mapper_shm_dispatch(mapper_shm shm, lo_server server);
+
+/**** Stream transport ****/
+
+/*! Start accepting stream connections on a TCP port of a network interface.
+ *  \return             Zero on success, non-zero if the port is unavailable. */
+int mapper_stream_server_listen(mapper_stream_server srv,
+                                struct in_addr iface, int port);
+
+/*! Get the sockets of a stream server for use with select().
+ *  \return             The number of sockets written to fds. */
+int mapper_stream_server_fds(mapper_stream_server srv, int *fds, int num);
+
+/*! Accept waiting connections and dispatch the bundles received on them to a
+ *  server.
+ *  \return             The number of bundles dispatched. */
+int mapper_stream_server_recv(mapper_stream_server srv, lo_server server);
+
+/*! Close the listening socket and all accepted connections. */
+void mapper_stream_server_free(mapper_stream_server srv);
+
+/*! Start connecting a stream to a remote device.
+ *  \return             The new stream, or zero if it could not be opened. */
+mapper_stream mapper_stream_open(const char *host, const char *port);
+
+/*! Add a bundle to the frames waiting to be written to a stream.
+ *  \return             Zero on success, non-zero if the backlog is full. */
+int mapper_stream_send_bundle(mapper_stream s, lo_bundle b);
+
+/*! Write as many waiting frames as the socket accepts.
+ *  \return             Zero on success, non-zero if the connection failed. */
+int mapper_stream_flush(mapper_stream s);
+
+/*! Close a stream, discarding any waiting frames. */
+void mapper_stream_free(mapper_stream s);
+
+/**** Fragmentation ****/
+
+/*! Store a fragment of a large update for a signal.
+ *  \param sig          The signal receiving the update.
+ *  \param tt           The timetag of the fragment.
+ *  \param link         The link the fragment arrived on, or zero if unknown.
+ *  \param global_id    The global instance id, or zero.
+ *  \param slot         The slot index, or -1 if none.
+ *  \param offset       Index of the first element in this fragment.
+ *  \param length       Number of elements in the complete update.
+ *  \param types        Types of the elements in this fragment.
+ *  \param argv         Values of the elements in this fragment.
+ *  \param count        Number of elements in this fragment.
+ *  \return             The completed update, which must be freed using
+ *                      mapper_fragment_free(), or zero if fragments are still
+ *                      missing. */
+mapper_fragment mapper_fragment_add(mapper_signal sig, mapper_timetag_t tt,
+                                    mapper_link link, mapper_id global_id,
+                                    int slot, int offset, int length,
+                                    const char *types, lo_arg **argv,
+                                    int count);
+
+/*! Build a message containing a reassembled update. */
+lo_message mapper_fragment_message(mapper_fragment f);
+
+void mapper_fragment_free(mapper_fragment f);
+
+/*! Discard any partially received updates for a signal. */
+void mapper_fragment_free_all(mapper_signal sig);
+
+/**** Statistics ****/
+
+/*! Allocate zeroed statistics for a map or link. */
+mapper_local_stats mapper_stats_new(void);
+
+/*! Get a monotonic timestamp in nanoseconds for measuring durations. */
+uint64_t mapper_stats_now(void);
+
+/*! Add a duration in nanoseconds to one of the timing histograms. */
+void mapper_stats_record(mapper_local_stats stats, mapper_stat_timer timer,
+                         uint64_t ns);
+
+/*! Increment a counter field of mapper_stats_t if statistics are enabled. */
+#define mapper_stats_count(STATS, FIELD, N)                             \
+{                                                                       \
+    if (STATS)                                                          \
+        mapper_stats_add(&(STATS)->counters.FIELD, N);                  \
+}
+
+void mapper_stats_add(uint64_t *counter, uint64_t n);
+
+/*! Record the end-to-end latency of a message received over a link. */
+void mapper_stats_record_latency(mapper_local_stats map_stats, mapper_link link,
+                                 mapper_timetag_t tt);
+
+/*! Allocate or free statistics for a new local map or link according to the
+ *  device's current statistics flags. */
+void mapper_map_init_stats(mapper_map map);
+void mapper_link_init_stats(mapper_link link);
+
+/*! Copy current statistics into read-only properties and inform subscribers
+ *  if publishing is enabled. */
+void mapper_device_publish_stats(mapper_device dev);
+
 /**** Time ****/
 
 /*! Get the current time. */
 double mapper_get_current_time();
 
+/*! Get the current time from a monotonic clock, for measuring intervals. */
+double mapper_get_monotonic_time();
+
 /**** Debug macros ****/
 
 /*! Debug tracer */
@@ -691,6 +1111,39 @@ inline static void* mapper_history_tt_ptr(mapper_history_t h)
     return &h.timetag[h.position];
 }
 
+/*! Helper to round a history size up to the next power of two, so that
+ *  positions in the circular buffer can be wrapped with a mask. */
+inline static int mapper_history_capacity(int size)
+{
+    int capacity = 1;
+    while (capacity < size)
+        capacity <<= 1;
+    return capacity;
+}
+
+/*! Helper to move a mapper_history_t to the position of a new sample. */
+inline static void mapper_history_advance(mapper_history h)
+{
+    h->position = (h->position + 1) & (h->size - 1);
+    ++h->count;
+}
+
+/*! Helper to undo mapper_history_advance() for a discarded sample. */
+inline static void mapper_history_retreat(mapper_history h)
+{
+    h->position = (h->position - 1) & (h->size - 1);
+    --h->count;
+}
+
+/*! Helper to clear the samples stored in a mapper_history_t. */
+inline static void mapper_history_reset(mapper_history h)
+{
+    memset(h->value, 0, h->size * h->length * mapper_type_size(h->type));
+    memset(h->timetag, 0, h->size * sizeof(mapper_timetag_t));
+    h->position = -1;
+    h->count = 0;
+}
+
 /*! Helper to check if a type character is valid. */
 inline static int check_signal_type(char type)
 {
@@ -40,6 +40,9 @@ extern const char* prop_message_strings[NUM_AT_PROPERTIES];
 
 #define MAX_BUNDLE_COUNT 10
 
+// larger bundles are used while messages are being batched
+#define MAX_BATCH_BUNDLE_COUNT 32
+
 /* Note: any call to liblo where get_liblo_error will be called afterwards must
  * lock this mutex, otherwise there is a race condition on receiving this
  * information.  Could be fixed by the liblo error handler having a user context
@@ -117,6 +120,7 @@ static int handler_unmap(HANDLER_ARGS);
 static int handler_unmapped(HANDLER_ARGS);
 static int handler_unsubscribe(HANDLER_ARGS);
 static int handler_who(HANDLER_ARGS);
+static int handler_count(HANDLER_ARGS);
 
 /* Handler <-> Message relationships */
 struct handler_method_assoc {
@@ -167,6 +171,20 @@ static void handler_error(int num, const char *msg, const char *where)
     trace_net("[libmapper] liblo server error %d in path %s: %s\n", num, where, msg);
 }
 
+#ifdef HAVE_LIBLO_BUNDLE_HANDLERS
+static int handler_bundle_start(lo_timetag tt, void *user_data)
+{
+    mapper_network_begin_batch((mapper_network)user_data);
+    return 0;
+}
+
+static int handler_bundle_end(void *user_data)
+{
+    mapper_network_end_batch((mapper_network)user_data);
+    return 0;
+}
+#endif
+
 /* Functions for handling the resource allocation scheme.  If check_collisions()
  * returns 1, the resource in question should be probed on the libmapper bus. */
 static int check_collisions(mapper_network net, mapper_allocated resource);
@@ -414,6 +432,65 @@ void mapper_network_remove_database(mapper_network net)
     net->database_methods_added = 0;
 }
 
+/* Administrative messages are found by a hash of their path, or of the part
+ * following the device name for messages addressed to a device, so that
+ * counting each message needs a single comparison in most cases. */
+static uint32_t hash_path(const char *path)
+{
+    // FNV-1a hash of the path
+    uint32_t hash = 2166136261u;
+    while (*path)
+        hash = (hash ^ (unsigned char)*path++) * 16777619u;
+    return hash & (MSG_TABLE_SIZE - 1);
+}
+
+/* Return the part of a message string that is hashed, and whether the
+ * message is addressed to a device. */
+static const char *message_key(int type, int *to_device)
+{
+    const char *str = network_message_strings[type];
+    *to_device = strncmp(str, "/%s", 3) == 0;
+    return *to_device ? str + 3 : str;
+}
+
+static void init_message_table(mapper_network net)
+{
+    int i, to_device;
+    uint32_t slot;
+    memset(net->message_table, -1, sizeof(net->message_table));
+    for (i = 0; i < NUM_MSG_STRINGS; i++) {
+        slot = hash_path(message_key(i, &to_device));
+        while (net->message_table[slot] >= 0)
+            slot = (slot + 1) & (MSG_TABLE_SIZE - 1);
+        net->message_table[slot] = i;
+    }
+}
+
+static network_message_t find_message(mapper_network net, const char *key,
+                                      int to_device)
+{
+    int type, is_to_device;
+    uint32_t slot = hash_path(key);
+    while ((type = net->message_table[slot]) >= 0) {
+        if (strcmp(message_key(type, &is_to_device), key) == 0
+            && is_to_device == to_device)
+            return type;
+        slot = (slot + 1) & (MSG_TABLE_SIZE - 1);
+    }
+    return NUM_MSG_STRINGS;
+}
+
+/* Find the type of an administrative message from its path. Paths that start
+ * with a device name are only compared after the name. */
+static network_message_t message_type(mapper_network net, const char *path)
+{
+    const char *suffix;
+    network_message_t type = find_message(net, path, 0);
+    if (type < NUM_MSG_STRINGS || !(suffix = strchr(path + 1, '/')))
+        return type;
+    return find_message(net, suffix, 1);
+}
+
 mapper_network mapper_network_new(const char *iface, const char *group, int port)
 {
     mapper_network net = (mapper_network) calloc(1, sizeof(mapper_network_t));
@@ -424,6 +501,9 @@ mapper_network mapper_network_new(const char *iface, const char *group, int port
     net->database.network = net;
     net->database.timeout_sec = TIMEOUT_SEC;
     net->interface_name = 0;
+    net->sync_interval = SYNC_INTERVAL_SEC;
+    net->max_sync_rate = MAX_SYNC_RATE;
+    init_message_table(net);
 
     /* Default standard ip and port is group 224.0.1.3, port 7570 */
     char port_str[10], *s_port = port_str;
@@ -479,6 +559,20 @@ mapper_network mapper_network_new(const char *iface, const char *group, int port
     lo_server_enable_queue(net->bus_server, 0, 1);
     lo_server_enable_queue(net->mesh_server, 0, 1);
 
+    /* Count messages before any other handler sees them. This must be the
+     * first method added since liblo tries methods in order. */
+    lo_server_add_method(net->bus_server, NULL, NULL, handler_count, net);
+    lo_server_add_method(net->mesh_server, NULL, NULL, handler_count, net);
+
+#ifdef HAVE_LIBLO_BUNDLE_HANDLERS
+    /* Batch the replies to each received bundle so that every peer receives
+     * them in as few bundles as possible. */
+    lo_server_add_bundle_handlers(net->bus_server, handler_bundle_start,
+                                  handler_bundle_end, net);
+    lo_server_add_bundle_handlers(net->mesh_server, handler_bundle_start,
+                                  handler_bundle_end, net);
+#endif
+
     return net;
 }
 
@@ -492,6 +586,22 @@ mapper_database mapper_network_database(mapper_network net)
     return &net->database;
 }
 
+/* Check a subscriber's filter against the signal or map described by the
+ * bundle. Bundles holding messages about several objects are always sent. */
+static int subscriber_wants_object(mapper_network net, mapper_subscriber s)
+{
+    if (!net->message_object)
+        return 1;
+    if (net->message_type & MAPPER_OBJ_SIGNALS)
+        return mapper_subscription_filter_match_signal(s->filter,
+                                                       net->message_object);
+    if (net->message_type & MAPPER_OBJ_MAPS)
+        return mapper_subscription_filter_match_map(s->filter,
+                                                    net->message_object,
+                                                    net->device);
+    return 1;
+}
+
 void mapper_network_send(mapper_network net)
 {
     if (!net->bundle)
@@ -516,10 +626,12 @@ void mapper_network_send(mapper_network net)
                 *s = temp->next;
                 if (temp->address)
                     lo_address_free(temp->address);
+                mapper_subscription_filter_free(temp->filter);
                 free(temp);
                 continue;
             }
-            if ((*s)->flags & net->message_type) {
+            if (((*s)->flags & net->message_type)
+                && (!(*s)->filter || subscriber_wants_object(net, *s))) {
                 lo_send_bundle_from((*s)->address, net->mesh_server, net->bundle);
             }
             s = &(*s)->next;
@@ -532,6 +644,14 @@ void mapper_network_send(mapper_network net)
         lo_send_bundle_from(net->bundle_dest, net->mesh_server, net->bundle);
     }
 #endif
+    if (net->batch_depth) {
+        // the bundle is no longer held back for its destination
+        int i;
+        for (i = 0; i < net->num_queued; i++) {
+            if (net->queued[i].bundle == net->bundle)
+                net->queued[i].bundle = 0;
+        }
+    }
     lo_bundle_free_recursive(net->bundle);
     net->bundle = 0;
 }
@@ -552,8 +672,45 @@ int mapper_network_init(mapper_network net)
     return 0;
 }
 
+/* While batching, messages for each destination are collected in their own
+ * bundle, which is only sent when it fills up or the batch ends. */
+static void select_queued_bundle(mapper_network net, lo_address dest, int type)
+{
+    int i;
+    mapper_queued_bundle_t *q = 0;
+    for (i = 0; i < net->num_queued; i++) {
+        if (net->queued[i].dest == dest && net->queued[i].message_type == type) {
+            q = &net->queued[i];
+            break;
+        }
+    }
+    if (!q) {
+        net->queued = realloc(net->queued, sizeof(mapper_queued_bundle_t)
+                              * (net->num_queued + 1));
+        q = &net->queued[net->num_queued++];
+        q->bundle = 0;
+        q->dest = dest;
+        q->message_type = type;
+        q->message_object = 0;
+    }
+    net->bundle = q->bundle;
+    net->bundle_dest = dest;
+    net->message_type = type;
+    net->message_object = q->message_object;
+    if (net->bundle && lo_bundle_count(net->bundle) >= MAX_BATCH_BUNDLE_COUNT)
+        mapper_network_send(net);
+    if (!net->bundle) {
+        mapper_network_init(net);
+        q->bundle = net->bundle;
+    }
+}
+
 void mapper_network_set_dest_bus(mapper_network net)
 {
+    if (net->batch_depth) {
+        select_queued_bundle(net, BUNDLE_DEST_BUS, 0);
+        return;
+    }
     if (net->bundle && (   net->bundle_dest != BUNDLE_DEST_BUS
                         || lo_bundle_count(net->bundle) >= MAX_BUNDLE_COUNT))
         mapper_network_send(net);
@@ -564,6 +721,10 @@ void mapper_network_set_dest_bus(mapper_network net)
 
 void mapper_network_set_dest_mesh(mapper_network net, lo_address address)
 {
+    if (net->batch_depth) {
+        select_queued_bundle(net, address, 0);
+        return;
+    }
     if (net->bundle && (   net->bundle_dest != address
                         || lo_bundle_count(net->bundle) >= MAX_BUNDLE_COUNT))
         mapper_network_send(net);
@@ -574,6 +735,11 @@ void mapper_network_set_dest_mesh(mapper_network net, lo_address address)
 
 void mapper_network_set_dest_subscribers(mapper_network net, int type)
 {
+    if (net->batch_depth) {
+        select_queued_bundle(net, BUNDLE_DEST_SUBSCRIBERS, type);
+        mapper_network_set_dest_object(net, 0);
+        return;
+    }
     if (net->bundle && (   net->bundle_dest != BUNDLE_DEST_SUBSCRIBERS
                         || net->message_type != type
                         || lo_bundle_count(net->bundle) >= MAX_BUNDLE_COUNT))
@@ -582,16 +748,157 @@ void mapper_network_set_dest_subscribers(mapper_network net, int type)
     net->message_type = type;
     if (!net->bundle)
         mapper_network_init(net);
+    mapper_network_set_dest_object(net, 0);
+}
+
+static int filtered_subscribers(mapper_network net)
+{
+    if (!net->device || !net->device->local)
+        return 0;
+    mapper_subscriber s = net->device->local->subscribers;
+    while (s) {
+        if (s->filter)
+            return 1;
+        s = s->next;
+    }
+    return 0;
+}
+
+/* While any subscriber has a filter, each bundle for subscribers only holds
+ * messages about one signal or map so that it can be checked against the
+ * filters before it is sent. */
+void mapper_network_set_dest_object(mapper_network net, void *object)
+{
+    int i;
+    mapper_queued_bundle_t *q = 0;
+    if (net->bundle_dest != BUNDLE_DEST_SUBSCRIBERS)
+        return;
+    if (object && !filtered_subscribers(net))
+        object = 0;
+    if (object == net->message_object)
+        return;
+    for (i = 0; i < net->num_queued && net->batch_depth; i++) {
+        if (net->queued[i].bundle == net->bundle) {
+            q = &net->queued[i];
+            break;
+        }
+    }
+    if (net->bundle && lo_bundle_count(net->bundle)) {
+        mapper_network_send(net);
+        mapper_network_init(net);
+        if (q)
+            q->bundle = net->bundle;
+    }
+    net->message_object = object;
+    if (q)
+        q->message_object = object;
+}
+
+void mapper_network_forget_object(mapper_network net, void *object)
+{
+    int i;
+    if (!object)
+        return;
+    if (net->bundle && net->message_object == object
+        && net->bundle_dest == BUNDLE_DEST_SUBSCRIBERS)
+        mapper_network_send(net);
+    if (net->message_object == object)
+        net->message_object = 0;
+    for (i = 0; i < net->num_queued; i++) {
+        mapper_queued_bundle_t *q = &net->queued[i];
+        if (q->message_object != object)
+            continue;
+        if (q->bundle) {
+            net->bundle = q->bundle;
+            net->bundle_dest = q->dest;
+            net->message_type = q->message_type;
+            net->message_object = object;
+            mapper_network_send(net);
+            net->message_object = 0;
+        }
+        q->message_object = 0;
+    }
+}
+
+/* Messages for a device are sent directly to its admin port if it is linked
+ * to our own device, and over the multicast bus otherwise. */
+void mapper_network_set_dest_device(mapper_network net, mapper_device dev)
+{
+    mapper_link link = 0;
+    if (net->device && dev && dev != net->device)
+        link = mapper_device_link_by_remote_device(net->device, dev);
+    if (link && link->local && link->local->admin_addr)
+        mapper_network_set_dest_mesh(net, link->local->admin_addr);
+    else
+        mapper_network_set_dest_bus(net);
+}
+
+/* Send any messages waiting for an address that is about to be freed. */
+void mapper_network_forget_dest(mapper_network net, lo_address address)
+{
+    int i;
+    if (net->bundle && net->bundle_dest == address)
+        mapper_network_send(net);
+    for (i = 0; i < net->num_queued; i++) {
+        if (net->queued[i].dest == address)
+            break;
+    }
+    if (i == net->num_queued)
+        return;
+    if (net->queued[i].bundle) {
+        net->bundle = net->queued[i].bundle;
+        net->bundle_dest = address;
+        mapper_network_send(net);
+    }
+    --net->num_queued;
+    memmove(&net->queued[i], &net->queued[i+1],
+            sizeof(mapper_queued_bundle_t) * (net->num_queued - i));
+}
+
+void mapper_network_begin_batch(mapper_network net)
+{
+    if (!net->batch_depth++)
+        mapper_network_send(net);
+}
+
+void mapper_network_end_batch(mapper_network net)
+{
+    int i;
+    if (!net->batch_depth || --net->batch_depth)
+        return;
+    for (i = 0; i < net->num_queued; i++) {
+        if (!net->queued[i].bundle)
+            continue;
+        net->bundle = net->queued[i].bundle;
+        net->bundle_dest = net->queued[i].dest;
+        net->message_type = net->queued[i].message_type;
+        net->message_object = net->queued[i].message_object;
+        mapper_network_send(net);
+    }
+    free(net->queued);
+    net->queued = 0;
+    net->num_queued = 0;
 }
 
 void mapper_network_add_message(mapper_network net, const char *str,
                                 network_message_t cmd, lo_message msg)
 {
+    ++net->msgs_sent[str ? message_type(net, str) : cmd];
     lo_bundle_add_message(net->bundle, str ?: network_message_strings[cmd], msg);
 }
 
 void mapper_network_free_messages(mapper_network net)
 {
+    int i;
+    for (i = 0; i < net->num_queued; i++) {
+        if (net->queued[i].bundle && net->queued[i].bundle != net->bundle)
+            lo_bundle_free_recursive(net->queued[i].bundle);
+    }
+    if (net->queued)
+        free(net->queued);
+    net->queued = 0;
+    net->num_queued = 0;
+    net->batch_depth = 0;
     if (net->bundle)
         lo_bundle_free_recursive(net->bundle);
     net->bundle = 0;
@@ -609,6 +916,10 @@ void mapper_network_free(mapper_network net)
         mapper_database_free(&net->database);
 
     // send out any cached messages
+    if (net->batch_depth) {
+        net->batch_depth = 1;
+        mapper_network_end_batch(net);
+    }
     mapper_network_send(net);
 
     if (net->interface_name)
@@ -641,11 +952,14 @@ static void mapper_network_probe_device_name(mapper_network net,
     snprintf(name, 256, "%s.%d", dev->identifier, dev->local->ordinal.value);
 
     /* Calculate an id from the name and store it in id.value */
+    mapper_database_unindex_property(dev->props, AT_ID, 0);
     dev->id = (mapper_id)crc32(0L, (const Bytef *)name, strlen(name)) << 32;
+    mapper_database_index_property(dev->props, AT_ID, 0);
 
     /* For the same reason, we can't use mapper_network_send() here. */
     lo_send(net->bus_addr, network_message_strings[MSG_NAME_PROBE], "si",
             name, net->random_id);
+    ++net->msgs_sent[MSG_NAME_PROBE];
 }
 
 /*! Add an uninitialized device to this network. */
@@ -686,6 +1000,101 @@ void mapper_network_remove_device(mapper_network net, mapper_device dev)
     }
 }
 
+/*! Send a clock synchronisation ping over a link. The ping carries the id
+ *  of the last ping received from the remote device and the time it was held
+ *  locally so that the remote device can calculate the round-trip delay. */
+static void mapper_network_send_ping(mapper_network net, mapper_link link)
+{
+    mapper_device dev = net->device;
+    mapper_sync_clock sync = &link->local->clock;
+
+    mapper_timetag_t now;
+    mapper_device_now(dev, &now);
+    double time = mapper_get_monotonic_time();
+
+    lo_bundle b = lo_bundle_new(now);
+    lo_message m = lo_message_new();
+    lo_message_add_int64(m, mapper_device_id(dev));
+    ++sync->sent.message_id;
+    if (sync->sent.message_id < 0)
+        sync->sent.message_id = 0;
+    lo_message_add_int32(m, sync->sent.message_id);
+    lo_message_add_int32(m, sync->response.message_id);
+    if (sync->response.message_id >= 0)
+        lo_message_add_double(m, time - sync->response_time);
+    else
+        lo_message_add_double(m, 0.);
+    // need to send immediately
+    lo_bundle_add_message(b, network_message_strings[MSG_PING], m);
+    ++net->msgs_sent[MSG_PING];
+#if FORCE_COMMS_TO_BUS
+    lo_send_bundle_from(net->bus_addr, net->mesh_server, b);
+#else
+    lo_send_bundle_from(link->local->admin_addr, net->mesh_server, b);
+#endif
+    mapper_timetag_copy(&sync->sent.timetag, now);
+    sync->sent_times[sync->sent.message_id % SYNC_NUM_SAMPLES] = time;
+    if (sync->burst > 0)
+        --sync->burst;
+    lo_bundle_free_recursive(b);
+}
+
+/*! Send burst pings to newly-created links so that their clocks can be
+ *  synchronised before the regular ping interval. */
+static void mapper_network_send_burst_pings(mapper_network net)
+{
+    mapper_device dev = net->device;
+    double time = mapper_get_monotonic_time();
+    mapper_link link = dev->database->links;
+    while (link) {
+        if (link->local && link->local->clock.burst > 0
+            && link->local->admin_addr && link->remote_device != dev) {
+            mapper_sync_clock sync = &link->local->clock;
+            int last = sync->sent.message_id % SYNC_NUM_SAMPLES;
+            if (time - sync->sent_times[last] >= SYNC_BURST_INTERVAL)
+                mapper_network_send_ping(net, link);
+        }
+        link = mapper_list_next(link);
+    }
+}
+
+/* Scale the interval between /sync announcements with the number of peers,
+ * so that the bus carries about max_sync_rate announcements per second in
+ * total. Each /sync heard from a peer adds the peer's own interval to the
+ * weight, so the weight accumulated over some time divided by that time
+ * estimates the number of peers whatever their intervals are.
+ *
+ * Peers that do not announce an interval come from older versions, whose
+ * databases expire a device after TIMEOUT_SEC without a /sync, so the default
+ * interval is kept while any of them have been heard recently. */
+static void update_sync_interval(mapper_network net, double time)
+{
+    double elapsed = time - net->peer_time;
+    if (!net->peer_time) {
+        net->peer_time = time;
+        net->peer_weight = 0;
+        return;
+    }
+    if (elapsed < SYNC_INTERVAL_SEC)
+        return;
+    float peers = net->peer_weight / elapsed;
+    net->num_peers = net->num_peers ? (net->num_peers + peers) * 0.5 : peers;
+    net->peer_weight = 0;
+    net->peer_time = time;
+
+    int interval = (int)((net->num_peers + 1) / net->max_sync_rate);
+    if (interval < SYNC_INTERVAL_SEC)
+        interval = SYNC_INTERVAL_SEC;
+    else if (interval > MAX_SYNC_INTERVAL_SEC)
+        interval = MAX_SYNC_INTERVAL_SEC;
+    if (net->legacy_peer_time && time - net->legacy_peer_time < TIMEOUT_SEC * 2)
+        interval = SYNC_INTERVAL_SEC;
+    if (interval != net->sync_interval)
+        trace_net("estimated %.1f peers, announcing every %d seconds\n",
+                  net->num_peers, interval);
+    net->sync_interval = interval;
+}
+
 // TODO: rename to mapper_device...?
 static void mapper_network_maybe_send_ping(mapper_network net, int force)
 {
@@ -696,21 +1105,40 @@ static void mapper_network_maybe_send_ping(mapper_network net, int force)
     mapper_timetag_now(&now);
     if (force || (now.sec >= net->next_ping)) {
         go = 1;
-        net->next_ping = now.sec + 5 + (rand() % 4);
+        net->next_ping = (now.sec + SYNC_INTERVAL_SEC
+                          + (rand() % SYNC_JITTER_SEC));
     }
 
-    if (!dev || !go)
+    if (!dev)
         return;
-
-    mapper_network_set_dest_bus(net);
-    lo_message msg = lo_message_new();
-    if (!msg) {
-        trace_net("couldn't allocate lo_message\n");
+    if (!go) {
+        mapper_network_send_burst_pings(net);
         return;
     }
-    lo_message_add_string(msg, mapper_device_name(dev));
-    lo_message_add_int32(msg, dev->version);
-    mapper_network_add_message(net, 0, MSG_SYNC, msg);
+
+    /* Links are checked at the default interval, but announcements on the
+     * bus are spread out as more peers join. */
+    if (force || now.sec >= net->next_sync) {
+        double time = mapper_get_current_time();
+        update_sync_interval(net, time);
+        /* Announcements are only sent when links are checked, which already
+         * adds the jitter, so at the default interval every check announces
+         * and the gap never exceeds SYNC_INTERVAL_SEC + SYNC_JITTER_SEC. */
+        net->next_sync = now.sec + net->sync_interval - SYNC_INTERVAL_SEC;
+        net->who_deadline = 0;
+
+        mapper_network_set_dest_bus(net);
+        lo_message msg = lo_message_new();
+        if (!msg) {
+            trace_net("couldn't allocate lo_message\n");
+            return;
+        }
+        lo_message_add_string(msg, mapper_device_name(dev));
+        lo_message_add_int32(msg, dev->version);
+        // announce the mean interval including jitter
+        lo_message_add_int32(msg, net->sync_interval + SYNC_JITTER_SEC / 2);
+        mapper_network_add_message(net, 0, MSG_SYNC, msg);
+    }
 
     int elapsed, num_maps;
     // some housekeeping: periodically check if our links are still active
@@ -767,31 +1195,13 @@ static void mapper_network_maybe_send_ping(mapper_network net, int force)
         else if (mapper_device_host(link->remote_device) && num_maps) {
             /* Only send pings if this link has associated maps, ensuring empty
              * links are removed after the ping timeout. */
-            lo_bundle b = lo_bundle_new(now);
-            lo_message m = lo_message_new();
-            lo_message_add_int64(m, mapper_device_id(dev));
-            ++sync->sent.message_id;
-            if (sync->sent.message_id < 0)
-                sync->sent.message_id = 0;
-            lo_message_add_int32(m, sync->sent.message_id);
-            lo_message_add_int32(m, sync->response.message_id);
-            if (sync->response.timetag.sec)
-                lo_message_add_double(m, mapper_timetag_difference(now,
-                                                                   sync->response.timetag));
-            else
-                lo_message_add_double(m, 0.);
-            // need to send immediately
-            lo_bundle_add_message(b, network_message_strings[MSG_PING], m);
-#if FORCE_COMMS_TO_BUS
-            lo_send_bundle_from(net->bus_addr, net->mesh_server, b);
-#else
-            lo_send_bundle_from(link->local->admin_addr, net->mesh_server, b);
-#endif
-            mapper_timetag_copy(&sync->sent.timetag, lo_bundle_get_timestamp(b));
-            lo_bundle_free_recursive(b);
+            mapper_network_send_ping(net, link);
         }
         link = mapper_list_next(link);
     }
+
+    // refresh published statistics at the same interval as /sync
+    mapper_device_publish_stats(dev);
 }
 
 /*! This is the main function to be called once in a while from a program so
@@ -801,8 +1211,9 @@ int mapper_network_poll(mapper_network net, int read_socket)
     int count = 0, status;
     mapper_device dev = net->device;
 
-    // send out any cached messages
-    mapper_network_send(net);
+    // send out any cached messages unless they are being batched
+    if (!net->batch_depth)
+        mapper_network_send(net);
 
     if (read_socket) {
         while (count < 10 && (lo_server_recv_noblock(net->bus_server, 0)
@@ -834,6 +1245,7 @@ int mapper_network_poll(mapper_network net, int read_socket)
             /* Send registered msg. */
             lo_send(net->bus_addr, network_message_strings[MSG_NAME_REG],
                     "s", mapper_device_name(dev));
+            ++net->msgs_sent[MSG_NAME_REG];
 
             mapper_network_add_device_methods(net, dev);
             mapper_network_maybe_send_ping(net, 1);
@@ -841,6 +1253,11 @@ int mapper_network_poll(mapper_network net, int read_socket)
             trace_dev(dev, "registered.\n");
         }
     }
+    else if (net->who_deadline
+             && mapper_get_current_time() >= net->who_deadline) {
+        // answer a /who request after backing off
+        mapper_network_maybe_send_ping(net, 1);
+    }
     else {
         // Send out clock sync messages occasionally
         mapper_network_maybe_send_ping(net, 0);
@@ -868,6 +1285,41 @@ int mapper_network_port(mapper_network net)
     return lo_server_get_port(net->bus_server);
 }
 
+int mapper_network_message_counts(mapper_network net, const char *path,
+                                  int *sent, int *received)
+{
+    int i, num_sent = 0, num_received = 0;
+    const char *str;
+    for (i = 0; i <= NUM_MSG_STRINGS; i++) {
+        if (path) {
+            if (i == NUM_MSG_STRINGS)
+                return 1;
+            str = network_message_strings[i];
+            if (strcmp(path, strncmp(str, "/%s", 3) ? str : str + 3))
+                continue;
+        }
+        num_sent += net->msgs_sent[i];
+        num_received += net->msgs_received[i];
+        if (path)
+            break;
+    }
+    if (sent)
+        *sent = num_sent;
+    if (received)
+        *received = num_received;
+    return 0;
+}
+
+void mapper_network_set_max_sync_rate(mapper_network net, float rate)
+{
+    net->max_sync_rate = rate > 0 ? rate : MAX_SYNC_RATE;
+}
+
+int mapper_network_sync_interval(mapper_network net)
+{
+    return net->sync_interval;
+}
+
 /*! Algorithm for checking collisions and allocating resources. */
 static int check_collisions(mapper_network net, mapper_allocated resource)
 {
@@ -911,18 +1363,69 @@ static int check_collisions(mapper_network net, mapper_allocated resource)
 /* Internal OSC message handlers. */
 /**********************************/
 
-/*! Respond to /who by announcing the basic device information. */
+/*! Respond to /who by announcing the basic device information. On a busy bus
+ *  each device waits a random time before responding, so that the responses
+ *  are spread out, and requests arriving in the meantime share the response.
+ *  Announcements sent before a request arrived are not counted, since the
+ *  requester may not have been listening yet. */
 static int handler_who(const char *path, const char *types, lo_arg **argv,
                        int argc, lo_message msg, void *user_data)
 {
     mapper_network net = (mapper_network) user_data;
-    mapper_network_maybe_send_ping(net, 1);
 
     trace_dev(net->device, "received /who\n");
 
+    if (net->who_deadline)
+        return 0;
+    double time = mapper_get_current_time();
+    double window = net->num_peers * WHO_BACKOFF_PER_PEER_SEC;
+    if (window > MAX_WHO_BACKOFF_SEC)
+        window = MAX_WHO_BACKOFF_SEC;
+    if (window < 0.01)
+        mapper_network_maybe_send_ping(net, 1);
+    else
+        net->who_deadline = time + window * rand() / RAND_MAX;
+
     return 0;
 }
 
+/* Limit the interval announced by a peer, which could otherwise overflow the
+ * time at which its record expires. */
+static int announced_interval(int interval)
+{
+    if (interval < 0)
+        return 0;
+    return interval > MAX_ANNOUNCED_SYNC_SEC ? MAX_ANNOUNCED_SYNC_SEC : interval;
+}
+
+/*! Count all messages received, and note the /sync announcements of other
+ *  devices for estimating the number of peers. Returns 1 so that liblo
+ *  passes the message on to the handlers that follow. */
+static int handler_count(const char *path, const char *types, lo_arg **argv,
+                         int argc, lo_message msg, void *user_data)
+{
+    mapper_network net = (mapper_network) user_data;
+    network_message_t type = message_type(net, path);
+    ++net->msgs_received[type];
+    if (type != MSG_SYNC || !argc || (types[0] != 's' && types[0] != 'S'))
+        return 1;
+    if (net->device && strcmp(&argv[0]->s, mapper_device_name(net->device))==0)
+        return 1;
+    // peers that do not announce their interval use the default
+    if (argc > 2 && types[2] == 'i' && argv[2]->i > 0)
+        net->peer_weight += announced_interval(argv[2]->i);
+    else {
+        net->peer_weight += SYNC_INTERVAL_SEC + SYNC_JITTER_SEC / 2;
+        net->legacy_peer_time = mapper_get_current_time();
+        if (net->sync_interval > SYNC_INTERVAL_SEC) {
+            // fall back to the default interval straight away
+            net->sync_interval = SYNC_INTERVAL_SEC;
+            net->next_sync = 0;
+        }
+    }
+    return 1;
+}
+
 /*! Register information about port and host for the device. */
 static int handler_device(const char *path, const char *types,
                           lo_arg **argv, int argc, lo_message msg,
@@ -1174,10 +1677,15 @@ static int handler_subscribe(const char *path, const char *types, lo_arg **argv,
         return 0;
     }
 
-    int i, flags = 0, timeout_seconds = 0;
+    int i, flags = 0, timeout_seconds = 0, used;
+    mapper_subscription_filter filter = 0;
     for (i = 0; i < argc; i++) {
         if (types[i] != 's' && types[i] != 'S')
             break;
+        else if ((used = mapper_subscription_filter_parse(&filter, &types[i],
+                                                          &argv[i],
+                                                          argc - i)))
+            i += used - 1;
         else if (strcmp(&argv[i]->s, "all")==0)
             flags = MAPPER_OBJ_ALL;
         else if (strcmp(&argv[i]->s, "device")==0)
@@ -1222,7 +1730,8 @@ static int handler_subscribe(const char *path, const char *types, lo_arg **argv,
     }
 
     // add or renew subscription
-    mapper_device_manage_subscriber(dev, a, flags, timeout_seconds, version);
+    mapper_device_manage_subscriber(dev, a, flags, timeout_seconds, version,
+                                    filter);
     return 0;
 }
 
@@ -1239,7 +1748,7 @@ static int handler_unsubscribe(const char *path, const char *types,
     if (!a) return 0;
 
     // remove subscription
-    mapper_device_manage_subscriber(net->device, a, 0, 0, 0);
+    mapper_device_manage_subscriber(net->device, a, 0, 0, 0, 0);
 
     return 0;
 }
@@ -1485,6 +1994,7 @@ static int handler_probe(const char *path, const char *types, lo_arg **argv,
             lo_send(net->bus_addr, network_message_strings[MSG_NAME_REG],
                     "sii", name, temp_id,
                     (dev->local->ordinal.value+i+1));
+            ++net->msgs_sent[MSG_NAME_REG];
         }
         else {
             dev->local->ordinal.collision_count++;
@@ -2551,52 +3061,40 @@ static int handler_ping(const char *path, const char *types, lo_arg **argv,
         return 0;
 
     mapper_timetag_t now;
-    mapper_timetag_now(&now);
+    mapper_device_now(dev, &now);
+    double time = mapper_get_monotonic_time();
     lo_timetag then = lo_message_get_timestamp(msg);
 
     remote = mapper_database_device_by_id(dev->database, argv[0]->h);
     link = remote ? mapper_device_link_by_remote_device(dev, remote) : 0;
-    if (link) {
+    if (link && link->local) {
         mapper_sync_clock clock = &link->local->clock;
         trace_dev(dev, "ping received from linked device '%s'\n",
                   link->remote_device->name);
-        if (argv[2]->i == clock->sent.message_id) {
-            // total elapsed time since ping sent
-            double elapsed = mapper_timetag_difference(now, clock->sent.timetag);
-            // assume symmetrical latency
-            double latency = (elapsed - argv[3]->d) * 0.5;
-            // difference between remote and local clocks (latency compensated)
-            double offset = mapper_timetag_difference(now, then) - latency;
-
-            if (latency < 0) {
-                trace_dev(dev, "error: latency %f cannot be < 0.\n", latency);
-                latency = 0;
-            }
-
-            if (clock->new == 1) {
-                clock->offset = offset;
-                clock->latency = latency;
-                clock->jitter = 0;
-                clock->new = 0;
-            }
-            else {
-                clock->jitter = (clock->jitter * 0.9
-                                 + fabs(clock->latency - latency) * 0.1);
-                if (offset > clock->offset) {
-                    // remote timetag is in the future
-                    clock->offset = offset;
-                }
-                else if (latency < clock->latency + clock->jitter
-                         && latency > clock->latency - clock->jitter) {
-                    clock->offset = clock->offset * 0.9 + offset * 0.1;
-                    clock->latency = clock->latency * 0.9 + latency * 0.1;
-                }
+        int id = argv[2]->i;
+        if (id >= 0 && id <= clock->sent.message_id
+            && id > clock->sent.message_id - SYNC_NUM_SAMPLES) {
+            // round-trip time minus the time the ping was held remotely
+            double delay = (time - clock->sent_times[id % SYNC_NUM_SAMPLES]
+                            - argv[3]->d);
+            if (delay < 0) {
+                trace_dev(dev, "error: delay %f cannot be < 0.\n", delay);
+                delay = 0;
             }
+            /* Difference between local and remote clocks, assuming symmetrical
+             * latency. */
+            double offset = mapper_timetag_difference(now, then) - delay * 0.5;
+            mapper_sync_clock_add_sample(clock, time, offset, delay);
         }
 
         // update sync status
         mapper_timetag_copy(&clock->response.timetag, now);
         clock->response.message_id = argv[1]->i;
+        clock->response_time = time;
+
+        // reply immediately while bursting so that new links converge quickly
+        if (clock->burst > 0 && link->local->admin_addr)
+            mapper_network_send_ping(net, link);
     }
     return 0;
 }
@@ -2617,6 +3115,8 @@ static int handler_sync(const char *path, const char *types, lo_arg **argv,
                 return 0;
             trace_db("updating sync record for device '%s'\n", dev->name);
             mapper_timetag_copy(&dev->synced, lo_message_get_timestamp(msg));
+            if (argc > 2 && types[2] == 'i')
+                dev->sync_interval = announced_interval(argv[2]->i);
 
             if (!dev->subscribed && net->database.autosubscribe) {
                 trace_db("autosubscribing to device '%s'.\n", &argv[0]->s);
@@ -6,6 +6,11 @@
 
 #include "types_internal.h"
 #include "mapper_internal.h"
+#include "config.h"
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
 
 #ifdef DEBUG
 #define TRACING 0 /* Set non-zero to see parsed properties. */
@@ -114,6 +119,61 @@ int mapper_parse_names(const char *string, char **devnameptr, char **signameptr)
     return (signame - devname - 1);
 }
 
+/* Parsed messages are returned to a small pool when freed, since handlers
+ * parse and free them one at a time; the next message reuses the atom array
+ * rather than allocating its own. Devices may be polled from different
+ * threads, so the pool is protected by a lock. */
+#define MESSAGE_POOL_SIZE 8
+
+static mapper_message message_pool = 0;
+static int num_pooled_messages = 0;
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lock_pool() pthread_mutex_lock(&pool_lock)
+#define unlock_pool() pthread_mutex_unlock(&pool_lock)
+#else
+#define lock_pool()
+#define unlock_pool()
+#endif
+
+static mapper_message alloc_message(int num_atoms)
+{
+    mapper_message msg;
+
+    lock_pool();
+    msg = message_pool;
+    if (msg) {
+        message_pool = msg->next;
+        --num_pooled_messages;
+    }
+    unlock_pool();
+
+    if (!msg && !(msg = (mapper_message) calloc(1, sizeof(*msg))))
+        return 0;
+    if (msg->size < num_atoms) {
+        mapper_message_atom_t *atoms;
+        atoms = realloc(msg->atoms, sizeof(mapper_message_atom_t) * num_atoms);
+        if (!atoms) {
+            if (msg->atoms)
+                free(msg->atoms);
+            free(msg);
+            return 0;
+        }
+        msg->atoms = atoms;
+        msg->size = num_atoms;
+    }
+    memset(msg->atoms, 0, sizeof(mapper_message_atom_t) * num_atoms);
+    msg->num_atoms = 0;
+    msg->next = 0;
+    return msg;
+}
+
+static int is_property_key(const char *s)
+{
+    return s[0] == '@' || ((s[0] == '-' || s[0] == '+') && s[1] == '@');
+}
+
 mapper_message mapper_message_parse_properties(int argc, const char *types,
                                                lo_arg **argv)
 {
@@ -122,17 +182,15 @@ mapper_message mapper_message_parse_properties(int argc, const char *types,
     for (i = 0; i < argc; i++) {
         if (types[i] != 's' && types[i] != 'S')
             continue;
-        if  (argv[i]->s == '@' || (strncmp(&argv[i]->s, "-@", 2)==0)
-             || (strncmp(&argv[i]->s, "+@", 2)==0))
+        if (is_property_key(&argv[i]->s))
             ++num_props;
     }
     if (!num_props)
         return 0;
 
-    mapper_message msg = ((mapper_message)
-                          calloc(1, sizeof(struct _mapper_message)));
-    msg->atoms = ((mapper_message_atom_t*)
-                  calloc(1, sizeof(struct _mapper_message_atom) * num_props));
+    mapper_message msg = alloc_message(num_props);
+    if (!msg)
+        return 0;
     mapper_message_atom atom = &msg->atoms[0];
     const char *key;
 
@@ -152,11 +210,11 @@ mapper_message mapper_message_parse_properties(int argc, const char *types,
         atom = &msg->atoms[msg->num_atoms];
 
         key = &argv[i]->s;
-        if (strncmp(&argv[i]->s, "+@", 2)==0) {
+        if (key[0] == '+' && key[1] == '@') {
             atom->index = PROPERTY_ADD;
             ++key;
         }
-        else if (strncmp(&argv[i]->s, "-@", 2)==0) {
+        else if (key[0] == '-' && key[1] == '@') {
             atom->index = PROPERTY_REMOVE;
             ++key;
         }
@@ -166,11 +224,11 @@ mapper_message mapper_message_parse_properties(int argc, const char *types,
         atom->key = key;
 
         // try to find matching index for static props
-        if (strncmp(atom->key, "@dst@", 5)==0) {
+        if (key[1] == 'd' && key[2] == 's' && key[3] == 't' && key[4] == '@') {
             atom->index |= DST_SLOT_PROPERTY;
             atom->key += 5;
         }
-        else if (strncmp(atom->key, "@src", 4)==0) {
+        else if (key[1] == 's' && key[2] == 'r' && key[3] == 'c') {
             if (atom->key[4] == '@') {
                 atom->index |= SRC_SLOT_PROPERTY(0);
                 atom->key += 5;
@@ -202,7 +260,8 @@ mapper_message mapper_message_parse_properties(int argc, const char *types,
         atom->values = &argv[i+1];
         while (++i < argc) {
             if ((types[i] == 's' || types[i] == 'S')
-                && strspn(&argv[i]->s, "+-@")) {
+                && (argv[i]->s == '@' || argv[i]->s == '+'
+                    || argv[i]->s == '-')) {
                 /* Arrived at next property index. */
                 i--;
                 break;
@@ -321,6 +380,16 @@ mapper_message mapper_message_parse_properties(int argc, const char *types,
 
 void mapper_message_free(mapper_message msg)
 {
+    if (!msg)
+        return;
+    lock_pool();
+    if (num_pooled_messages < MESSAGE_POOL_SIZE) {
+        msg->next = message_pool;
+        message_pool = msg;
+        ++num_pooled_messages;
+        msg = 0;
+    }
+    unlock_pool();
     if (msg) {
         if (msg->atoms)
             free(msg->atoms);
@@ -442,22 +511,43 @@ const char *mapper_property_string(mapper_property_t prop)
     return static_properties[prop].name + 1;
 }
 
+/* Static property names are found with a perfect hash of the name's length
+ * and its first, fifth and last characters, so that each lookup needs a
+ * single comparison. The tables are printed by gen_property_hash.py, which
+ * searches for character values that give every name in static_properties a
+ * distinct slot; run it again if a static property is added or renamed. */
+#define PROPERTY_HASH_SIZE 64
+
+static const unsigned char property_hash_values[256] = {
+    ['_'] = 12, ['a'] = 2, ['b'] = 5, ['c'] = 50, ['d'] = 37, ['e'] = 56,
+    ['g'] = 38, ['h'] = 27, ['i'] = 37, ['l'] = 23, ['m'] = 17, ['n'] = 40,
+    ['o'] = 17, ['p'] = 36, ['r'] = 49, ['s'] = 18, ['t'] = 39, ['u'] = 7,
+    ['v'] = 23, ['x'] = 42,
+};
+
+static const signed char property_hash_table[PROPERTY_HASH_SIZE] = {
+    -1, -1, -1, -1, -1, -1, 7, 28, 5, 4, -1, 34, 8, 15, -1, 25, -1, -1, -1,
+    22, 26, 10, 24, -1, -1, -1, 21, 1, 23, 0, 35, 11, 16, 12, 6, 32, 17, -1,
+    -1, 9, 2, 19, -1, 36, 20, 27, -1, 3, 18, 30, 33, -1, -1, 31, -1, -1, -1,
+    -1, -1, -1, 14, 29, 13, -1,
+};
+
 mapper_property_t mapper_property_from_string(const char *string)
 {
-    // property names are stored alphabetically so we can use a binary search
-    int beg = 0, end = NUM_AT_PROPERTIES - 2;
-    int mid = (beg + end) * 0.5, cmp;
-    while (beg <= end) {
-        cmp = strcmp(string, static_properties[mid].name + 1);
-        if (cmp > 0)
-            beg = mid + 1;
-        else if (cmp == 0)
-            return mid;
-        else
-            end = mid - 1;
-        mid = (beg + end) * 0.5;
-    }
-    return AT_EXTRA;
+    const unsigned char *s = (const unsigned char*)string;
+    size_t len = strlen(string);
+    unsigned int hash;
+    int prop;
+
+    if (!len)
+        return AT_EXTRA;
+    hash = len + property_hash_values[s[0]] + property_hash_values[s[len-1]];
+    if (len > 4)
+        hash += property_hash_values[s[4]];
+    prop = property_hash_table[hash % PROPERTY_HASH_SIZE];
+    if (prop < 0 || strcmp(string, static_properties[prop].name + 1))
+        return AT_EXTRA;
+    return prop;
 }
 
 const char *mapper_boundary_action_string(mapper_boundary_action bound)
@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <zlib.h>
 
 #include <lo/lo.h>
@@ -10,7 +11,13 @@
 #include <mapper/mapper.h>
 
 static void send_or_bundle_message(mapper_link link, const char *path,
-                                   lo_message msg, mapper_timetag_t tt);
+                                   lo_message msg, mapper_timetag_t tt,
+                                   mapper_map map);
+
+static void send_update(mapper_map map, mapper_slot slot, mapper_link link,
+                        const char *path, const void *value, int count,
+                        char *typestring, mapper_id_map id_map,
+                        mapper_timetag_t tt);
 
 static int map_in_scope(mapper_map map, mapper_id id)
 {
@@ -34,10 +41,14 @@ static void reallocate_slot_instances(mapper_slot slot, int size)
             slot->local->history[i].length = slot->signal->length;
             slot->local->history[i].size = slot->local->history_size;
             slot->local->history[i].value = calloc(1, mapper_type_size(slot->signal->type)
+                                                   * slot->signal->length
                                                    * slot->local->history_size);
             slot->local->history[i].timetag = calloc(1, sizeof(mapper_timetag_t)
                                                      * slot->local->history_size);
             slot->local->history[i].position = -1;
+            slot->local->history[i].count = 0;
+            slot->local->history[i].windows = 0;
+            slot->local->history[i].num_windows = 0;
         }
         slot->num_instances = size;
     }
@@ -111,12 +122,204 @@ void mapper_router_num_instances_changed(mapper_router rtr, mapper_signal sig,
     }
 }
 
+static mapper_send_policy_t *send_policy(mapper_map map, mapper_signal sig)
+{
+    if (map->local->has_send_policy)
+        return &map->local->send_policy;
+    if (sig->local && sig->local->has_send_policy)
+        return &sig->local->send_policy;
+    return 0;
+}
+
+static mapper_send_state send_state(mapper_map map, int idx, int length)
+{
+    mapper_local_map lmap = map->local;
+    if (idx >= lmap->num_send_states) {
+        mapper_send_state states = realloc(lmap->send_states,
+                                           sizeof(mapper_send_state_t)
+                                           * (idx + 1));
+        if (!states)
+            return 0;
+        memset(states + lmap->num_send_states, 0, sizeof(mapper_send_state_t)
+               * (idx + 1 - lmap->num_send_states));
+        lmap->send_states = states;
+        lmap->num_send_states = idx + 1;
+    }
+    mapper_send_state s = &lmap->send_states[idx];
+    if (s->length != length) {
+        s->last_value = realloc(s->last_value, sizeof(double) * length);
+        s->pending_value = realloc(s->pending_value, sizeof(double) * length);
+        s->pending_types = realloc(s->pending_types, length);
+        s->length = length;
+        s->has_sent = 0;
+    }
+    return s;
+}
+
+static void free_send_states(mapper_router rtr, mapper_local_map lmap)
+{
+    int i;
+    for (i = 0; i < lmap->num_send_states; i++) {
+        mapper_send_state s = &lmap->send_states[i];
+        if (s->pending)
+            --rtr->num_pending;
+        if (s->last_value)
+            free(s->last_value);
+        if (s->pending_value)
+            free(s->pending_value);
+        if (s->pending_types)
+            free(s->pending_types);
+    }
+    if (lmap->send_states)
+        free(lmap->send_states);
+    lmap->send_states = 0;
+    lmap->num_send_states = 0;
+}
+
+static void free_converge_states(mapper_router rtr, mapper_map map)
+{
+    mapper_local_map lmap = map->local;
+    if (lmap->is_converging) {
+        mapper_map *prev = &rtr->device->local->converging_maps;
+        while (*prev && *prev != map)
+            prev = &(*prev)->local->next_converging;
+        if (*prev)
+            *prev = lmap->next_converging;
+        lmap->is_converging = 0;
+    }
+    if (lmap->converge_states)
+        free(lmap->converge_states);
+    lmap->converge_states = 0;
+    lmap->num_converge_states = 0;
+}
+
+static void record_send_state(mapper_send_state s, const void *value,
+                              const char *types, char type,
+                              mapper_timetag_t now)
+{
+    int i;
+    for (i = 0; i < s->length; i++) {
+        if (types[i] != 'N')
+            s->last_value[i] = propval_double(value, type, i);
+    }
+    s->last_sent = now;
+    s->has_sent = 1;
+}
+
+/* Apply the send policy of a map to a single-sample update, before it is
+ * serialized. Returns non-zero if the update should be sent now; otherwise it
+ * has been suppressed or held until the device is next polled. */
+static int check_send_policy(mapper_router rtr, mapper_map map,
+                             mapper_slot slot, mapper_signal sig, int idx,
+                             mapper_id_map id_map, const void *value,
+                             char *types, mapper_timetag_t tt)
+{
+    mapper_send_policy_t *p = send_policy(map, sig);
+    if (!p || (!p->coalesce && p->max_rate <= 0 && p->deadband <= 0))
+        return 1;
+
+    mapper_signal to = (map->process_location == MAPPER_LOC_SOURCE
+                        ? map->destination.signal : slot->signal);
+    mapper_send_state s = send_state(map, idx, to->length);
+    if (!s)
+        return 1;
+    mapper_local_stats stats = map->local->stats;
+    mapper_timetag_t now;
+    int i, hold = p->coalesce;
+
+    if (p->deadband > 0 && s->has_sent) {
+        for (i = 0; i < s->length; i++) {
+            if (types[i] != 'N'
+                && fabs(propval_double(value, to->type, i) - s->last_value[i])
+                   > p->deadband)
+                break;
+        }
+        if (i == s->length) {
+            // a held value is superseded by this one, which is not sent
+            if (s->pending) {
+                s->pending = 0;
+                --rtr->num_pending;
+                mapper_stats_count(stats, coalesced, 1);
+            }
+            mapper_stats_count(stats, below_deadband, 1);
+            return 0;
+        }
+    }
+
+    mapper_timetag_now(&now);
+    if (p->max_rate > 0 && s->has_sent
+        && mapper_timetag_difference(now, s->last_sent) < 1. / p->max_rate) {
+        mapper_stats_count(stats, rate_limited, 1);
+        if (!p->coalesce)
+            return 0;
+        hold = 1;
+    }
+
+    if (hold) {
+        if (!s->pending)
+            ++rtr->num_pending;
+        else {
+            mapper_stats_count(stats, coalesced, 1);
+        }
+        memcpy(s->pending_value, value, mapper_type_size(to->type) * s->length);
+        memcpy(s->pending_types, types, s->length);
+        s->pending_tt = tt;
+        s->id_map = id_map;
+        s->pending = 1;
+        return 0;
+    }
+
+    record_send_state(s, value, types, to->type, now);
+    return 1;
+}
+
+void mapper_router_send_pending(mapper_router rtr)
+{
+    mapper_router_signal rs;
+    mapper_timetag_t now;
+    int i, j;
+
+    if (!rtr->num_pending)
+        return;
+
+    mapper_timetag_now(&now);
+    for (rs = rtr->signals; rs && rtr->num_pending; rs = rs->next) {
+        for (i = 0; i < rs->num_slots; i++) {
+            mapper_slot slot = rs->slots[i];
+            if (!slot)
+                continue;
+            mapper_map map = slot->map;
+            mapper_local_map lmap = map->local;
+            mapper_send_policy_t *p = send_policy(map, rs->signal);
+            mapper_signal to = (map->process_location == MAPPER_LOC_SOURCE
+                                ? map->destination.signal : slot->signal);
+            for (j = 0; j < lmap->num_send_states; j++) {
+                mapper_send_state s = &lmap->send_states[j];
+                if (!s->pending)
+                    continue;
+                if (p && p->max_rate > 0 && s->has_sent
+                    && (mapper_timetag_difference(now, s->last_sent)
+                        < 1. / p->max_rate))
+                    continue;
+                s->pending = 0;
+                --rtr->num_pending;
+                record_send_state(s, s->pending_value, s->pending_types,
+                                  to->type, now);
+                if (map->status >= STATUS_ACTIVE)
+                    send_update(map, slot, map->destination.link,
+                                map->destination.signal->path,
+                                s->pending_value, 1, s->pending_types,
+                                s->id_map, s->pending_tt);
+            }
+        }
+    }
+}
+
 void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                                   int instance, const void *value, int count,
                                   mapper_timetag_t tt)
 {
     mapper_id_map id_map = sig->local->id_maps[instance].map;
-    lo_message msg;
 
     // find the router signal
     mapper_router_signal rs = rtr->signals;
@@ -162,23 +365,24 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
             mapper_local_slot dst_lslot = dst_slot->local;
 
             // also need to reset associated output memory
-            dst_lslot->history[idx].position= -1;
-            memset(dst_lslot->history[idx].value, 0, dst_lslot->history_size
-                   * dst_slot->signal->length * mapper_type_size(dst_slot->signal->type));
-            memset(dst_lslot->history[idx].timetag, 0, dst_lslot->history_size
-                   * sizeof(mapper_timetag_t));
-            dst_lslot->history[idx].position = -1;
+            mapper_history_reset(&dst_lslot->history[idx]);
+
+            // a held value must not be sent after the release
+            if (idx < lmap->num_send_states) {
+                if (lmap->send_states[idx].pending)
+                    --rtr->num_pending;
+                lmap->send_states[idx].pending = 0;
+                lmap->send_states[idx].has_sent = 0;
+            }
 
             if (slot->direction == MAPPER_DIR_OUTGOING
                 && !(sig->local->id_maps[instance].status & RELEASED_REMOTELY)) {
-                msg = 0;
                 if (!slot->use_instances)
-                    msg = mapper_map_build_message(map, slot, 0, 1, 0, 0);
+                    send_update(map, slot, dst_slot->link,
+                                dst_slot->signal->path, 0, 1, 0, 0, tt);
                 else if (map_in_scope(map, id_map->global))
-                    msg = mapper_map_build_message(map, slot, 0, 1, 0, id_map);
-                if (msg)
-                    send_or_bundle_message(dst_slot->link,
-                                           dst_slot->signal->path, msg, tt);
+                    send_update(map, slot, dst_slot->link,
+                                dst_slot->signal->path, 0, 1, 0, id_map, tt);
             }
 
             for (j = 0; j < map->num_sources; j++) {
@@ -186,11 +390,7 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                 lslot = slot->local;
 
                 // also need to reset associated input memory
-                memset(lslot->history[idx].value, 0, lslot->history_size
-                       * slot->signal->length * mapper_type_size(slot->signal->type));
-                memset(lslot->history[idx].timetag, 0, lslot->history_size
-                       * sizeof(mapper_timetag_t));
-                lslot->history[idx].position = -1;
+                mapper_history_reset(&lslot->history[idx]);
 
                 if (!map->sources[j]->use_instances)
                     continue;
@@ -203,34 +403,50 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
 
                 if (slot->direction == MAPPER_DIR_INCOMING) {
                     // send release to upstream
-                    msg = mapper_map_build_message(map, slot, 0, 1, 0, id_map);
-                    if (msg)
-                        send_or_bundle_message(slot->link, slot->signal->path,
-                                               msg, tt);
+                    send_update(map, slot, slot->link, slot->signal->path, 0,
+                                1, 0, id_map, tt);
                 }
             }
         }
         return;
     }
 
-    // if count > 1, we need to allocate sufficient memory for largest output
-    // vector so that we can store calculated values before sending
-    // TODO: calculate max_output_size, cache in link_signal
-    void *out_value_p = count == 1 ? 0 : alloca(count * sig->length
-                                                * sizeof(double));
+    /* If count > 1, we need to allocate sufficient memory for the largest
+     * output vector so that we can store calculated values before sending.
+     * This is allocated on the heap since vectors may be large. */
+    void *out_value_p = 0;
+    if (count > 1) {
+        size_t out_size = sig->length * sizeof(double);
+        for (i = 0; i < rs->num_slots; i++) {
+            if (!rs->slots[i])
+                continue;
+            map = rs->slots[i]->map;
+            mapper_slot to = (map->process_location == MAPPER_LOC_SOURCE
+                              ? &map->destination : rs->slots[i]);
+            if (to->signal->length * sizeof(double) > out_size)
+                out_size = to->signal->length * sizeof(double);
+        }
+        out_value_p = malloc(count * out_size);
+        if (!out_value_p)
+            return;
+    }
     for (i = 0; i < rs->num_slots; i++) {
         if (!rs->slots[i])
             continue;
 
         mapper_slot slot = rs->slots[i];
         map = slot->map;
+        mapper_local_stats stats = map->local->stats;
 
-        if (map->status < STATUS_ACTIVE)
+        if (map->status < STATUS_ACTIVE) {
+            mapper_stats_count(stats, dropped_not_ready, count);
             continue;
+        }
 
         int in_scope = map_in_scope(map, id_map->global);
         // TODO: should we continue for out-of-scope local destination updates?
         if (slot->use_instances && !in_scope) {
+            mapper_stats_count(stats, dropped_out_of_scope, count);
             continue;
         }
 
@@ -246,19 +462,19 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
         for (j = 0; j < count; j++) {
             // copy input history
             size_t n = mapper_signal_vector_bytes(sig);
-            lslot->history[idx].position = ((lslot->history[idx].position + 1)
-                                            % lslot->history[idx].size);
+            mapper_history_advance(&lslot->history[idx]);
             memcpy(mapper_history_value_ptr(lslot->history[idx]), value + n * j, n);
             memcpy(mapper_history_tt_ptr(lslot->history[idx]),
                    &tt, sizeof(mapper_timetag_t));
 
+            uint64_t start = stats ? mapper_stats_now() : 0;
+
             // process source boundary behaviour
             if ((mapper_boundary_perform(&lslot->history[idx], slot,
                                          src_types + slot->signal->length * k))) {
                 // back up position index
-                --lslot->history[idx].position;
-                if (lslot->history[idx].position < 0)
-                    lslot->history[idx].position = lslot->history[idx].size - 1;
+                mapper_history_retreat(&lslot->history[idx]);
+                mapper_stats_count(stats, dropped_muted, 1);
                 continue;
             }
 
@@ -270,8 +486,11 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                 continue;
 
             if (!(mapper_map_perform(map, slot, idx,
-                                     dst_types + to->signal->length * k)))
+                                     dst_types + to->signal->length * k))) {
+                if (map->muted)
+                    mapper_stats_count(stats, dropped_muted, 1);
                 continue;
+            }
 
             if (map->process_location == MAPPER_LOC_SOURCE) {
                 // also process destination boundary behaviour
@@ -279,36 +498,39 @@ void mapper_router_process_signal(mapper_router rtr, mapper_signal sig,
                                              dst_slot,
                                              dst_types + to->signal->length * k))) {
                     // back up position index
-                    --map->destination.local->history[idx].position;
-                    if (map->destination.local->history[idx].position < 0)
-                        map->destination.local->history[idx].position = map->destination.local->history[idx].size - 1;
+                    mapper_history_retreat(&map->destination.local->history[idx]);
+                    mapper_stats_count(stats, dropped_muted, 1);
                     continue;
                 }
             }
 
+            if (stats)
+                mapper_stats_record(stats, MAPPER_STAT_EVAL_TIME,
+                                    mapper_stats_now() - start);
+
             void *result = mapper_history_value_ptr(map->destination.local->history[idx]);
 
             if (count > 1) {
                 memcpy((char*)out_value_p + to_size * j, result, to_size);
             }
-            else {
-                msg = mapper_map_build_message(map, slot, result, 1, dst_types,
-                                               slot->use_instances ? id_map : 0);
-                if (msg)
-                    send_or_bundle_message(map->destination.link,
-                                           dst_slot->signal->path, msg, tt);
+            else if (check_send_policy(rtr, map, slot, sig, idx,
+                                       slot->use_instances ? id_map : 0,
+                                       result, dst_types, tt)) {
+                send_update(map, slot, map->destination.link,
+                            dst_slot->signal->path, result, 1, dst_types,
+                            slot->use_instances ? id_map : 0, tt);
             }
             ++k;
         }
         if (count > 1 && slot->direction == MAPPER_DIR_OUTGOING
             && (!slot->use_instances || in_scope)) {
-            msg = mapper_map_build_message(map, slot, out_value_p, k, dst_types,
-                                           slot->use_instances ? id_map : 0);
-            if (msg)
-                send_or_bundle_message(map->destination.link,
-                                       dst_slot->signal->path, msg, tt);
+            send_update(map, slot, map->destination.link,
+                        dst_slot->signal->path, out_value_p, k, dst_types,
+                        slot->use_instances ? id_map : 0, tt);
         }
     }
+    if (out_value_p)
+        free(out_value_p);
 }
 
 int mapper_router_send_query(mapper_router rtr, mapper_signal sig,
@@ -347,12 +569,14 @@ int mapper_router_send_query(mapper_router rtr, mapper_signal sig,
 
         if (rs->slots[i]->direction == MAPPER_DIR_OUTGOING) {
             snprintf(query_string, 256, "%s/get", map->destination.signal->path);
-            send_or_bundle_message(map->destination.link, query_string, msg, tt);
+            send_or_bundle_message(map->destination.link, query_string, msg,
+                                   tt, 0);
         }
         else {
             for (j = 0; j < map->num_sources; j++) {
                 snprintf(query_string, 256, "%s/get", map->sources[j]->signal->path);
-                send_or_bundle_message(map->sources[j]->link, query_string, msg, tt);
+                send_or_bundle_message(map->sources[j]->link, query_string,
+                                       msg, tt, 0);
             }
         }
         ++count;
@@ -363,31 +587,141 @@ int mapper_router_send_query(mapper_router rtr, mapper_signal sig,
 // note on memory handling of mapper_router_bundle_message():
 // path: not owned, will not be freed (assumed is signal name, owned by signal)
 // message: will be owned, will be freed when done
-void send_or_bundle_message(mapper_link link, const char *path, lo_message msg,
-                            mapper_timetag_t tt)
+// map: used for collecting statistics, may be 0
+static void record_sent(mapper_link link, const char *path, lo_message msg,
+                        mapper_map map)
 {
     mapper_local_link llink = link->local;
-    // Check if a matching bundle exists
-    mapper_queue q = llink->queues;
-    while (q) {
-        if (memcmp(&q->tt, &tt,
-                   sizeof(mapper_timetag_t))==0)
-            break;
-        q = q->next;
+    mapper_local_stats map_stats = map ? map->local->stats : 0;
+    if (map_stats || llink->stats) {
+        size_t len = lo_message_length(msg, path);
+        mapper_stats_count(map_stats, sent, 1);
+        mapper_stats_count(map_stats, bytes_sent, len);
+        mapper_stats_count(llink->stats, sent, 1);
+        mapper_stats_count(llink->stats, bytes_sent, len);
     }
-    if (q) {
-        // Add message to existing bundle
-        lo_bundle_add_message(q->bundle, path, msg);
+}
+
+/* Send a map update, splitting it into fragments if it has too many elements
+ * to be sent as a single message. Fragments are sent immediately in their own
+ * bundles rather than added to an open queue, so that each fits in a single
+ * datagram; they carry the queue's timetag so that the receiver can
+ * reassemble them. */
+static void send_update(mapper_map map, mapper_slot slot, mapper_link link,
+                        const char *path, const void *value, int count,
+                        char *typestring, mapper_id_map id_map,
+                        mapper_timetag_t tt)
+{
+    lo_message msg;
+    int offset, alias = 0;
+
+    /* Address updates to the destination by the alias it assigned to the
+     * slot, unless they are passed directly to a device in this process. */
+    if (slot->alias && slot->direction == MAPPER_DIR_OUTGOING
+        && !(link->local->peer && link->local_device->local->direct_delivery)) {
+        alias = slot->alias;
+        path = MAPPER_ALIAS_PATH;
     }
-    else {
-        // Send message immediately
+
+    // updates sent through a stream connection are not fragmented
+    if (mapper_link_uses_stream(link)
+        || mapper_map_message_length(map, slot, count) <= MAPPER_FRAGMENT_LEN) {
+        msg = mapper_map_build_message(map, slot, value, count, typestring,
+                                       id_map, alias);
+        if (msg)
+            send_or_bundle_message(link, path, msg, tt, map);
+        return;
+    }
+
+    /* Updates passed directly to a device in this process or through shared
+     * memory are not fragmented. */
+    if (link->local->peer) {
+        msg = mapper_map_build_message(map, slot, value, count, typestring,
+                                       id_map, alias);
+        if (!msg)
+            return;
+        record_sent(link, path, msg, map);
+        if (!mapper_device_send_direct(link, path, msg, tt))
+            return;
+        lo_message_free(msg);
+    }
+    else if (link->local->shm) {
+        msg = mapper_map_build_message(map, slot, value, count, typestring,
+                                       id_map, alias);
+        if (!msg)
+            return;
+        record_sent(link, path, msg, map);
         lo_bundle b = lo_bundle_new(tt);
         lo_bundle_add_message(b, path, msg);
-        lo_send_bundle_from(llink->data_addr, link->local_device->local->server, b);
+        int sent = !mapper_link_send_shm(link, b);
+        lo_bundle_free_recursive(b);
+        if (sent)
+            return;
+    }
+
+    for (offset = 0; (msg = mapper_map_build_fragment(map, slot, value, count,
+                                                      typestring, id_map,
+                                                      alias, offset));
+         offset += MAPPER_FRAGMENT_LEN) {
+        record_sent(link, path, msg, map);
+        lo_bundle b = lo_bundle_new(tt);
+        lo_bundle_add_message(b, path, msg);
+        lo_send_bundle_from(link->local->data_addr,
+                            link->local_device->local->server, b);
         lo_bundle_free_recursive(b);
     }
 }
 
+void send_or_bundle_message(mapper_link link, const char *path, lo_message msg,
+                            mapper_timetag_t tt, mapper_map map)
+{
+    mapper_local_link llink = link->local;
+    int stream = mapper_link_uses_stream(link);
+    /* Check if a matching queue is open. The most recently started queue is
+     * checked first. Updates for a link using a stream connection, or for a
+     * device in this process or on this host, are delivered together through
+     * the same transport when the queue is sent. Queries still need a source
+     * address for the response so are always sent as datagrams. */
+    int bypass = (stream || ((llink->peer || llink->shm)
+                             && link->local_device->local->direct_delivery));
+    mapper_queue q = link->local_device->local->queues;
+    while (q && memcmp(&q->tt, &tt, sizeof(mapper_timetag_t)))
+        q = q->next;
+    lo_bundle b = 0;
+    if (q && (map || !bypass))
+        b = mapper_link_queue_bundle(link, q);
+    if (b) {
+        // Add message to the link's bundle for this queue
+        record_sent(link, path, msg, map);
+        lo_bundle_add_message(b, path, msg);
+        return;
+    }
+    /* Updates for a link using a stream connection are batched by the
+     * stream. Updates dropped because of backpressure are not counted as
+     * sent. */
+    if (map && stream) {
+        b = lo_bundle_new(tt);
+        lo_bundle_add_message(b, path, msg);
+        if (!mapper_link_send_stream_bundle(link, b, map))
+            record_sent(link, path, msg, map);
+        lo_bundle_free_recursive(b);
+        return;
+    }
+    record_sent(link, path, msg, map);
+    /* Updates for a device in this process bypass the network. */
+    if (map && !mapper_device_send_direct(link, path, msg, tt))
+        return;
+    b = lo_bundle_new(tt);
+    lo_bundle_add_message(b, path, msg);
+    // updates for a device on this host bypass the network
+    if (!map || mapper_link_send_shm(link, b)) {
+        // Send message immediately
+        lo_send_bundle_from(llink->data_addr, link->local_device->local->server,
+                            b);
+    }
+    lo_bundle_free_recursive(b);
+}
+
 static mapper_router_signal find_or_add_router_signal(mapper_router rtr,
                                                       mapper_signal sig)
 {
@@ -544,8 +878,12 @@ void mapper_router_add_map(mapper_router rtr, mapper_map map)
     lmap->num_var_instances = max_num_instances;
 
     // assign a unique id to this map if we are the destination
-    if (local_dst)
+    if (local_dst) {
+        mapper_database_unindex_property(map->props, AT_ID, 0);
         map->id = unused_map_id(rtr->device, rtr);
+        mapper_database_index_property(map->props, AT_ID, 0);
+        mapper_database_index_map(map->database, map);
+    }
 
     /* assign indices to source slots - may be overwritten later by message */
     for (i = 0; i < map->num_sources; i++) {
@@ -599,6 +937,8 @@ void mapper_router_add_map(mapper_router rtr, mapper_map map)
         lmap->is_local_only = 1;
         map->destination.link = map->sources[0]->link;
     }
+
+    mapper_map_init_stats(map);
 }
 
 static void check_link(mapper_router rtr, mapper_link link)
@@ -663,10 +1003,12 @@ static void free_slot_memory(mapper_slot slot)
             for (i = 0; i < slot->num_instances; i++) {
                 free(slot->local->history[i].value);
                 free(slot->local->history[i].timetag);
+                mapper_expr_free_history_windows(&slot->local->history[i]);
             }
             free(slot->local->history);
         }
 //    }
+    mapper_boundary_free(&slot->local->boundary);
     free(slot->local);
 }
 
@@ -680,6 +1022,7 @@ int mapper_router_remove_map(mapper_router rtr, mapper_map map)
     // remove map and slots from router_signal lists if necessary
     if (map->destination.local->router_sig) {
         mapper_router_signal rs = map->destination.local->router_sig;
+        mapper_device_remove_aliases(rtr->device, map);
         for (i = 0; i < rs->num_slots; i++) {
             if (rs->slots[i] == &map->destination) {
                 rs->slots[i] = 0;
@@ -731,6 +1074,14 @@ int mapper_router_remove_map(mapper_router rtr, mapper_map map)
     }
     if (map->local->expr)
         mapper_expr_free(map->local->expr);
+    if (map->local->stats)
+        free(map->local->stats);
+    if (map->local->scale)
+        free(map->local->scale);
+    if (map->local->offset)
+        free(map->local->offset);
+    free_send_states(rtr, map->local);
+    free_converge_states(rtr, map);
 
     free(map->local);
     return 0;
@@ -811,6 +1162,27 @@ mapper_map mapper_router_incoming_map(mapper_router rtr,
     return 0;
 }
 
+mapper_map mapper_router_sole_incoming_map(mapper_router rtr,
+                                           mapper_signal local_dst)
+{
+    mapper_router_signal rs = rtr->signals;
+    while (rs && rs->signal != local_dst)
+        rs = rs->next;
+    if (!rs)
+        return 0;
+
+    int i;
+    mapper_map found = 0;
+    for (i = 0; i < rs->num_slots; i++) {
+        if (!rs->slots[i] || rs->slots[i]->direction == MAPPER_DIR_OUTGOING)
+            continue;
+        if (found)
+            return 0;
+        found = rs->slots[i]->map;
+    }
+    return found;
+}
+
 mapper_map mapper_router_map_by_id(mapper_router router, mapper_signal local_sig,
                                    mapper_id id, mapper_direction dir)
 {
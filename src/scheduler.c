@@ -0,0 +1,121 @@
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lo/lo.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* Scheduled updates are kept in a binary min-heap ordered by due time, so
+ * that insertion and removal of the earliest update are O(log n). */
+
+static int due_before(mapper_scheduled_update a, mapper_scheduled_update b)
+{
+    if (a->due.sec != b->due.sec)
+        return a->due.sec < b->due.sec;
+    return a->due.frac < b->due.frac;
+}
+
+static void swap(mapper_scheduled_update a, mapper_scheduled_update b)
+{
+    mapper_scheduled_update_t temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+static void sift_up(mapper_scheduler s, int i)
+{
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!due_before(&s->heap[i], &s->heap[parent]))
+            break;
+        swap(&s->heap[i], &s->heap[parent]);
+        i = parent;
+    }
+}
+
+static void sift_down(mapper_scheduler s, int i)
+{
+    while (1) {
+        int child = i * 2 + 1, min = i;
+        if (child < s->size && due_before(&s->heap[child], &s->heap[min]))
+            min = child;
+        ++child;
+        if (child < s->size && due_before(&s->heap[child], &s->heap[min]))
+            min = child;
+        if (min == i)
+            break;
+        swap(&s->heap[i], &s->heap[min]);
+        i = min;
+    }
+}
+
+int mapper_scheduler_push(mapper_scheduler s, mapper_timetag_t due,
+                          mapper_timetag_t tt, mapper_signal sig, int slot,
+                          lo_message msg)
+{
+    if (s->size >= s->capacity) {
+        int capacity = s->capacity ? s->capacity * 2 : 16;
+        mapper_scheduled_update_t *heap;
+        heap = realloc(s->heap, capacity * sizeof(mapper_scheduled_update_t));
+        if (!heap)
+            return 1;
+        s->heap = heap;
+        s->capacity = capacity;
+    }
+    mapper_scheduled_update u = &s->heap[s->size];
+    u->due = due;
+    u->timetag = tt;
+    u->signal = sig;
+    u->slot = slot;
+    u->msg = msg;
+    sift_up(s, s->size++);
+    return 0;
+}
+
+mapper_scheduled_update mapper_scheduler_peek(mapper_scheduler s)
+{
+    return s->size ? &s->heap[0] : 0;
+}
+
+int mapper_scheduler_pop(mapper_scheduler s, mapper_scheduled_update u)
+{
+    if (!s->size)
+        return 1;
+    *u = s->heap[0];
+    if (--s->size) {
+        s->heap[0] = s->heap[s->size];
+        sift_down(s, 0);
+    }
+    return 0;
+}
+
+void mapper_scheduler_remove_signal(mapper_scheduler s, mapper_signal sig)
+{
+    int i, j;
+    for (i = 0, j = 0; i < s->size; i++) {
+        if (s->heap[i].signal == sig)
+            lo_message_free(s->heap[i].msg);
+        else
+            s->heap[j++] = s->heap[i];
+    }
+    if (j == s->size)
+        return;
+    s->size = j;
+    // rebuild the heap
+    for (i = s->size / 2 - 1; i >= 0; i--)
+        sift_down(s, i);
+}
+
+void mapper_scheduler_free(mapper_scheduler s)
+{
+    int i;
+    for (i = 0; i < s->size; i++)
+        lo_message_free(s->heap[i].msg);
+    if (s->heap)
+        free(s->heap);
+    s->heap = 0;
+    s->size = s->capacity = 0;
+}
@@ -0,0 +1,712 @@
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* Maps are saved as a JSON object containing an array of maps, one map per
+ * line:
+ *
+ * {"maps": [
+ *   {"sources": [{"signal": "dev.1/out", "minimum": [0], ...}],
+ *    "destination": {"signal": "dev.2/in", ...},
+ *    "mode": "expression", "expression": "y=x", ...},
+ *   ...
+ * ]}
+ *
+ * Files are read and written incrementally, so that the memory needed does
+ * not depend on the number of maps in a session. */
+
+/* Maps pushed before the bundle of /map messages is sent and progress is
+ * reported. */
+#define LOAD_BATCH_SIZE 10
+
+/**** Saving ****/
+
+static void write_string(FILE *f, const char *str)
+{
+    fputc('"', f);
+    for (; str && *str; str++) {
+        switch (*str) {
+            case '"':   fputs("\\\"", f);   break;
+            case '\\':  fputs("\\\\", f);   break;
+            case '\n':  fputs("\\n", f);    break;
+            case '\t':  fputs("\\t", f);    break;
+            default:
+                if ((unsigned char)*str < 0x20)
+                    fprintf(f, "\\u%04x", *str);
+                else
+                    fputc(*str, f);
+        }
+    }
+    fputc('"', f);
+}
+
+static void write_values(FILE *f, int length, char type, const void *value)
+{
+    int i;
+    fputc('[', f);
+    for (i = 0; i < length; i++) {
+        if (i)
+            fputs(", ", f);
+        switch (type) {
+            case 'i':   fprintf(f, "%d", ((int*)value)[i]);         break;
+            case 'f':   fprintf(f, "%.9g", ((float*)value)[i]);     break;
+            case 'd':   fprintf(f, "%.17g", ((double*)value)[i]);   break;
+            default:    fputs("null", f);                           break;
+        }
+    }
+    fputc(']', f);
+}
+
+static void write_slot(FILE *f, mapper_slot slot)
+{
+    int length;
+    char type;
+    void *value;
+    mapper_signal sig = slot->signal;
+
+    char name[strlen(sig->device->name) + strlen(sig->name) + 2];
+    snprintf(name, sizeof(name), "%s/%s", sig->device->name, sig->name);
+    fputs("{\"signal\": ", f);
+    write_string(f, name);
+
+    mapper_slot_minimum(slot, &length, &type, &value);
+    if (value) {
+        fputs(", \"minimum\": ", f);
+        write_values(f, length, type, value);
+    }
+    mapper_slot_maximum(slot, &length, &type, &value);
+    if (value) {
+        fputs(", \"maximum\": ", f);
+        write_values(f, length, type, value);
+    }
+    fprintf(f, ", \"bound_min\": \"%s\", \"bound_max\": \"%s\"",
+            mapper_boundary_action_string(slot->bound_min),
+            mapper_boundary_action_string(slot->bound_max));
+    fprintf(f, ", \"causes_update\": %s, \"use_instances\": %s, "
+            "\"calibrating\": %s}", slot->causes_update ? "true" : "false",
+            slot->use_instances ? "true" : "false",
+            slot->calibrating ? "true" : "false");
+}
+
+static void write_map(FILE *f, mapper_map map)
+{
+    int i;
+    fputs("{\"sources\": [", f);
+    for (i = 0; i < map->num_sources; i++) {
+        if (i)
+            fputs(", ", f);
+        write_slot(f, map->sources[i]);
+    }
+    fputs("], \"destination\": ", f);
+    write_slot(f, &map->destination);
+    fprintf(f, ", \"mode\": \"%s\"", mapper_mode_string(map->mode));
+    if (map->expression) {
+        fputs(", \"expression\": ", f);
+        write_string(f, map->expression);
+    }
+    const char *description = mapper_map_description(map);
+    if (description) {
+        fputs(", \"description\": ", f);
+        write_string(f, description);
+    }
+    fprintf(f, ", \"muted\": %s, \"process_location\": \"%s\"",
+            map->muted ? "true" : "false",
+            mapper_location_string(map->process_location));
+    if (map->num_scopes) {
+        fputs(", \"scopes\": [", f);
+        for (i = 0; i < map->num_scopes; i++) {
+            if (i)
+                fputs(", ", f);
+            write_string(f, map->scopes[i]->name);
+        }
+        fputc(']', f);
+    }
+    fputc('}', f);
+}
+
+int mapper_database_save_maps(mapper_database db, const char *path)
+{
+    if (!db || !path)
+        return -1;
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        trace("couldn't open '%s' for writing.\n", path);
+        return -1;
+    }
+
+    int count = 0;
+    mapper_map map = db->maps;
+    fputs("{\"maps\": [", f);
+    while (map) {
+        // staged maps have not been created yet
+        if (map->status == STATUS_ACTIVE) {
+            fputs(count ? ",\n  " : "\n  ", f);
+            write_map(f, map);
+            ++count;
+        }
+        map = mapper_list_next(map);
+    }
+    fputs(count ? "\n]}\n" : "]}\n", f);
+
+    if (ferror(f)) {
+        fclose(f);
+        return -1;
+    }
+    return fclose(f) ? -1 : count;
+}
+
+/**** Loading ****/
+
+typedef struct {
+    FILE *file;
+    int c;                  //!< The next character, or EOF.
+    int line;
+} json_reader_t, *json_reader;
+
+typedef struct {
+    char *signal;
+    double *minimum;
+    double *maximum;
+    int min_length;
+    int max_length;
+    int bound_min;          //!< Boundary action, or -1 if not set.
+    int bound_max;
+    int causes_update;      //!< Flag value, or -1 if not set.
+    int use_instances;
+    int calibrating;
+} slot_record_t, *slot_record;
+
+typedef struct {
+    slot_record_t sources[MAX_NUM_MAP_SOURCES];
+    slot_record_t destination;
+    char *expression;
+    char *description;
+    char **scopes;
+    int num_sources;
+    int num_scopes;
+    int mode;               //!< Map mode, or -1 if not set.
+    int muted;
+    int process_location;
+} map_record_t, *map_record;
+
+static void advance(json_reader r)
+{
+    if (r->c == '\n')
+        ++r->line;
+    r->c = fgetc(r->file);
+}
+
+static int peek(json_reader r)
+{
+    while (r->c != EOF && isspace(r->c))
+        advance(r);
+    return r->c;
+}
+
+static int expect(json_reader r, int c)
+{
+    if (peek(r) != c) {
+        trace("error loading maps: expected '%c' on line %d.\n", c, r->line);
+        return 1;
+    }
+    advance(r);
+    return 0;
+}
+
+/* Read a string into a newly allocated buffer, which must be freed by the
+ * caller. Returns zero on error. */
+static char *read_string(json_reader r)
+{
+    int len = 0, size = 32;
+    if (expect(r, '"'))
+        return 0;
+    char *str = malloc(size);
+    while (r->c != '"') {
+        int c = r->c;
+        if (c == EOF || c == '\n')
+            goto error;
+        if (c == '\\') {
+            advance(r);
+            switch (r->c) {
+                case 'n':   c = '\n';   break;
+                case 't':   c = '\t';   break;
+                case 'r':   c = '\r';   break;
+                case 'b':   c = '\b';   break;
+                case 'f':   c = '\f';   break;
+                case 'u': {
+                    int i, code = 0;
+                    for (i = 0; i < 4; i++) {
+                        advance(r);
+                        if (!isxdigit(r->c))
+                            goto error;
+                        code = code * 16 + (isdigit(r->c) ? r->c - '0'
+                                            : tolower(r->c) - 'a' + 10);
+                    }
+                    // only control characters are escaped when saving
+                    c = code < 0x80 ? code : '?';
+                    break;
+                }
+                case EOF:
+                    goto error;
+                default:
+                    c = r->c;
+            }
+        }
+        if (len + 1 >= size) {
+            size *= 2;
+            str = realloc(str, size);
+        }
+        str[len++] = c;
+        advance(r);
+    }
+    advance(r);
+    str[len] = 0;
+    return str;
+
+  error:
+    trace("error loading maps: bad string on line %d.\n", r->line);
+    free(str);
+    return 0;
+}
+
+static int read_number(json_reader r, double *value)
+{
+    char buf[64], *end;
+    int len = 0;
+    peek(r);
+    while (r->c != EOF && len < 63 && (isdigit(r->c) || strchr("+-.eE", r->c))) {
+        buf[len++] = r->c;
+        advance(r);
+    }
+    buf[len] = 0;
+    *value = strtod(buf, &end);
+    if (!len || *end) {
+        trace("error loading maps: bad number on line %d.\n", r->line);
+        return 1;
+    }
+    return 0;
+}
+
+/* Read a literal word such as true, false or null. */
+static int read_word(json_reader r, char *buf, int size)
+{
+    int len = 0;
+    peek(r);
+    while (r->c != EOF && isalpha(r->c) && len < size - 1) {
+        buf[len++] = r->c;
+        advance(r);
+    }
+    buf[len] = 0;
+    return len == 0;
+}
+
+static int read_bool(json_reader r, int *value)
+{
+    char word[8];
+    if (read_word(r, word, 8))
+        return 1;
+    if (strcmp(word, "true") == 0)
+        *value = 1;
+    else if (strcmp(word, "false") == 0)
+        *value = 0;
+    else {
+        trace("error loading maps: expected boolean on line %d.\n", r->line);
+        return 1;
+    }
+    return 0;
+}
+
+/* Check for the next member of an object or element of an array. Returns 1
+ * if there is another item, 0 at the closing bracket, or -1 on error. */
+static int next_item(json_reader r, int close, int *first)
+{
+    if (peek(r) == close) {
+        advance(r);
+        return 0;
+    }
+    if (!*first && expect(r, ','))
+        return -1;
+    *first = 0;
+    return 1;
+}
+
+/* Read the name of the next member of an object, or return 0 at the end of
+ * the object. Sets error to non-zero on failure. */
+static char *next_member(json_reader r, int *first, int *error)
+{
+    int more = next_item(r, '}', first);
+    if (more <= 0) {
+        *error = more < 0;
+        return 0;
+    }
+    char *name = read_string(r);
+    if (!name || expect(r, ':')) {
+        if (name)
+            free(name);
+        *error = 1;
+        return 0;
+    }
+    return name;
+}
+
+static int skip_value(json_reader r)
+{
+    int first = 1, more, error = 0;
+    double d;
+    char word[8], *str;
+    switch (peek(r)) {
+        case '"':
+            if (!(str = read_string(r)))
+                return 1;
+            free(str);
+            return 0;
+        case '[':
+            advance(r);
+            while ((more = next_item(r, ']', &first)) > 0) {
+                if (skip_value(r))
+                    return 1;
+            }
+            return more < 0;
+        case '{':
+            advance(r);
+            while ((str = next_member(r, &first, &error))) {
+                free(str);
+                if (skip_value(r))
+                    return 1;
+            }
+            return error;
+        default:
+            if (isalpha(r->c))
+                return read_word(r, word, 8);
+            return read_number(r, &d);
+    }
+}
+
+static int read_numbers(json_reader r, double **values, int *length)
+{
+    int first = 1, more, size = 0;
+    double value;
+    if (expect(r, '['))
+        return 1;
+    *length = 0;
+    while ((more = next_item(r, ']', &first)) > 0) {
+        if (read_number(r, &value))
+            return 1;
+        if (*length >= size) {
+            size = size ? size * 2 : 4;
+            *values = realloc(*values, sizeof(double) * size);
+        }
+        (*values)[(*length)++] = value;
+    }
+    return more < 0;
+}
+
+static void free_slot_record(slot_record s)
+{
+    if (s->signal)
+        free(s->signal);
+    if (s->minimum)
+        free(s->minimum);
+    if (s->maximum)
+        free(s->maximum);
+}
+
+static void clear_map_record(map_record m)
+{
+    int i;
+    for (i = 0; i < m->num_sources; i++)
+        free_slot_record(&m->sources[i]);
+    free_slot_record(&m->destination);
+    if (m->expression)
+        free(m->expression);
+    if (m->description)
+        free(m->description);
+    for (i = 0; i < m->num_scopes; i++)
+        free(m->scopes[i]);
+    if (m->scopes)
+        free(m->scopes);
+    memset(m, 0, sizeof(map_record_t));
+    m->mode = m->muted = m->process_location = -1;
+}
+
+static int read_slot(json_reader r, slot_record s)
+{
+    int first = 1, error = 0;
+    char *name, *str;
+    memset(s, 0, sizeof(slot_record_t));
+    s->bound_min = s->bound_max = -1;
+    s->causes_update = s->use_instances = s->calibrating = -1;
+
+    if (expect(r, '{'))
+        return 1;
+    while (!error && (name = next_member(r, &first, &error))) {
+        if (strcmp(name, "signal") == 0) {
+            if (s->signal)
+                free(s->signal);
+            error = !(s->signal = read_string(r));
+        }
+        else if (strcmp(name, "minimum") == 0)
+            error = read_numbers(r, &s->minimum, &s->min_length);
+        else if (strcmp(name, "maximum") == 0)
+            error = read_numbers(r, &s->maximum, &s->max_length);
+        else if (   strcmp(name, "bound_min") == 0
+                 || strcmp(name, "bound_max") == 0) {
+            if ((str = read_string(r))) {
+                int bound = mapper_boundary_action_from_string(str);
+                if (strcmp(name, "bound_min") == 0)
+                    s->bound_min = bound;
+                else
+                    s->bound_max = bound;
+                free(str);
+            }
+            else
+                error = 1;
+        }
+        else if (strcmp(name, "causes_update") == 0)
+            error = read_bool(r, &s->causes_update);
+        else if (strcmp(name, "use_instances") == 0)
+            error = read_bool(r, &s->use_instances);
+        else if (strcmp(name, "calibrating") == 0)
+            error = read_bool(r, &s->calibrating);
+        else
+            error = skip_value(r);
+        free(name);
+    }
+    return error || !s->signal;
+}
+
+static int read_map(json_reader r, map_record m)
+{
+    int first = 1, error = 0, more, first_item;
+    char *name, *str;
+
+    if (expect(r, '{'))
+        return 1;
+    while (!error && (name = next_member(r, &first, &error))) {
+        if (strcmp(name, "sources") == 0) {
+            first_item = 1;
+            if (expect(r, '['))
+                error = 1;
+            while (!error && (more = next_item(r, ']', &first_item))) {
+                if (more < 0 || m->num_sources >= MAX_NUM_MAP_SOURCES)
+                    error = 1;
+                else
+                    error = read_slot(r, &m->sources[m->num_sources++]);
+            }
+        }
+        else if (strcmp(name, "destination") == 0) {
+            free_slot_record(&m->destination);
+            error = read_slot(r, &m->destination);
+        }
+        else if (strcmp(name, "mode") == 0) {
+            if ((str = read_string(r))) {
+                m->mode = mapper_mode_from_string(str);
+                free(str);
+            }
+            else
+                error = 1;
+        }
+        else if (strcmp(name, "expression") == 0) {
+            if (m->expression)
+                free(m->expression);
+            error = !(m->expression = read_string(r));
+        }
+        else if (strcmp(name, "description") == 0) {
+            if (m->description)
+                free(m->description);
+            error = !(m->description = read_string(r));
+        }
+        else if (strcmp(name, "muted") == 0)
+            error = read_bool(r, &m->muted);
+        else if (strcmp(name, "process_location") == 0) {
+            if ((str = read_string(r))) {
+                m->process_location = mapper_location_from_string(str);
+                free(str);
+            }
+            else
+                error = 1;
+        }
+        else if (strcmp(name, "scopes") == 0) {
+            first_item = 1;
+            if (expect(r, '['))
+                error = 1;
+            while (!error && (more = next_item(r, ']', &first_item))) {
+                if (more < 0 || !(str = read_string(r))) {
+                    error = 1;
+                    break;
+                }
+                m->scopes = realloc(m->scopes, sizeof(char*)
+                                    * (m->num_scopes + 1));
+                m->scopes[m->num_scopes++] = str;
+            }
+        }
+        else
+            error = skip_value(r);
+        free(name);
+    }
+    return error || !m->num_sources || !m->destination.signal;
+}
+
+/* Find a signal using its full name "device/signal". */
+static mapper_signal find_signal(mapper_database db, const char *name)
+{
+    const char *slash = strchr(name, '/');
+    if (!slash || slash == name)
+        return 0;
+    char dev_name[slash - name + 1];
+    snprintf(dev_name, slash - name + 1, "%s", name);
+    mapper_device dev = mapper_database_device_by_name(db, dev_name);
+    return dev ? mapper_device_signal_by_name(dev, slash + 1) : 0;
+}
+
+static void set_extremum(mapper_slot slot, int is_max, int length,
+                         const double *values)
+{
+    int i;
+    char type = slot->signal->type ?: 'd';
+    void *buf = malloc(length * sizeof(double));
+    if (!buf)
+        return;
+    for (i = 0; i < length; i++) {
+        switch (type) {
+            case 'i':   ((int*)buf)[i] = (int)values[i];        break;
+            case 'f':   ((float*)buf)[i] = (float)values[i];    break;
+            default:    ((double*)buf)[i] = values[i];          break;
+        }
+    }
+    if (type != 'i' && type != 'f')
+        type = 'd';
+    if (is_max)
+        mapper_slot_set_maximum(slot, length, type, buf);
+    else
+        mapper_slot_set_minimum(slot, length, type, buf);
+    free(buf);
+}
+
+static void apply_slot(mapper_slot slot, slot_record s)
+{
+    if (s->minimum && s->min_length)
+        set_extremum(slot, 0, s->min_length, s->minimum);
+    if (s->maximum && s->max_length)
+        set_extremum(slot, 1, s->max_length, s->maximum);
+    if (s->bound_min > MAPPER_BOUND_UNDEFINED)
+        mapper_slot_set_bound_min(slot, s->bound_min);
+    if (s->bound_max > MAPPER_BOUND_UNDEFINED)
+        mapper_slot_set_bound_max(slot, s->bound_max);
+    if (s->causes_update >= 0)
+        mapper_slot_set_causes_update(slot, s->causes_update);
+    if (s->use_instances >= 0)
+        mapper_slot_set_use_instances(slot, s->use_instances);
+    if (s->calibrating >= 0)
+        mapper_slot_set_calibrating(slot, s->calibrating);
+}
+
+/* Create and push a map from a record. Returns zero on success, or non-zero
+ * if any of its signals are unknown. */
+static int push_map(mapper_database db, map_record m)
+{
+    int i;
+    mapper_signal sources[m->num_sources], destination;
+    for (i = 0; i < m->num_sources; i++) {
+        if (!(sources[i] = find_signal(db, m->sources[i].signal))) {
+            trace("error loading maps: unknown signal '%s'.\n",
+                  m->sources[i].signal);
+            return 1;
+        }
+    }
+    if (!(destination = find_signal(db, m->destination.signal))) {
+        trace("error loading maps: unknown signal '%s'.\n",
+              m->destination.signal);
+        return 1;
+    }
+
+    mapper_map map = mapper_map_new(m->num_sources, sources, 1, &destination);
+    if (!map)
+        return 1;
+    for (i = 0; i < m->num_sources; i++)
+        apply_slot(mapper_map_slot_by_signal(map, sources[i]), &m->sources[i]);
+    apply_slot(&map->destination, &m->destination);
+    if (m->mode > MAPPER_MODE_UNDEFINED && m->mode < NUM_MAPPER_MODES)
+        mapper_map_set_mode(map, m->mode);
+    if (m->expression)
+        mapper_map_set_expression(map, m->expression);
+    if (m->description)
+        mapper_map_set_description(map, m->description);
+    if (m->muted >= 0)
+        mapper_map_set_muted(map, m->muted);
+    if (m->process_location > MAPPER_LOC_UNDEFINED)
+        mapper_map_set_process_location(map, m->process_location);
+    for (i = 0; i < m->num_scopes; i++) {
+        mapper_device dev = mapper_database_device_by_name(db, m->scopes[i]);
+        if (dev)
+            mapper_map_add_scope(map, dev);
+    }
+    mapper_map_push(map);
+    return 0;
+}
+
+int mapper_database_load_maps(mapper_database db, const char *path,
+                              mapper_database_load_handler *h,
+                              const void *user)
+{
+    if (!db || !path)
+        return -1;
+    json_reader_t r = {fopen(path, "r"), 0, 1};
+    if (!r.file) {
+        trace("couldn't open '%s' for reading.\n", path);
+        return -1;
+    }
+    advance(&r);
+
+    map_record_t m;
+    memset(&m, 0, sizeof(map_record_t));
+    clear_map_record(&m);
+
+    int first = 1, error = 0, more, first_map, loaded = 0, skipped = 0;
+    char *name;
+    if (expect(&r, '{'))
+        error = 1;
+    while (!error && (name = next_member(&r, &first, &error))) {
+        if (strcmp(name, "maps") != 0) {
+            error = skip_value(&r);
+            free(name);
+            continue;
+        }
+        free(name);
+        if (expect(&r, '[')) {
+            error = 1;
+            break;
+        }
+        first_map = 1;
+        while ((more = next_item(&r, ']', &first_map)) > 0) {
+            // each map is created as soon as it has been read
+            if (read_map(&r, &m)) {
+                error = 1;
+                break;
+            }
+            if (push_map(db, &m))
+                ++skipped;
+            else if (++loaded % LOAD_BATCH_SIZE == 0) {
+                mapper_network_send(db->network);
+                if (h)
+                    h(db, loaded, skipped, user);
+            }
+            clear_map_record(&m);
+        }
+        if (more < 0)
+            error = 1;
+    }
+    clear_map_record(&m);
+    fclose(r.file);
+
+    // send any remaining /map messages
+    mapper_network_send(db->network);
+    if (h)
+        h(db, loaded, skipped, user);
+    return error ? -1 : loaded;
+}
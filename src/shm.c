@@ -0,0 +1,347 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <lo/lo.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include "config.h"
+#include <mapper/mapper.h>
+
+#ifdef HAVE_SHM_OPEN
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <sched.h>
+#endif
+
+/* Each local device owns a ring buffer in shared memory which devices in
+ * other processes on the same host write serialised bundles into. Records
+ * are a 32-bit length followed by the bundle, padded to 4 bytes; a record
+ * that would not fit before the end of the ring is preceded by a skip marker
+ * and written at the start instead. Writers are serialised with a spinlock
+ * in the header holding the writer's process id, so that a lock left by a
+ * writer that died can be broken. The head and tail count bytes written and
+ * read. */
+
+#define SHM_MAGIC 0x6d617072    // "mapr"
+#define SHM_SKIP 0xFFFFFFFF
+
+/* Writers spin for the lock, then yield the processor between attempts, and
+ * give up after this many attempts. */
+#define SHM_LOCK_SPINS 100
+#define SHM_LOCK_ATTEMPTS 1000
+
+// hint to the processor that this is a spin loop
+#if defined(__i386__) || defined(__x86_64__)
+#define spin_pause() __builtin_ia32_pause()
+#else
+#define spin_pause() __sync_synchronize()
+#endif
+
+typedef struct _mapper_shm_header {
+    uint32_t magic;
+    uint32_t capacity;          //!< Size of the ring in bytes.
+    mapper_id id;               //!< Id of the receiving device.
+    volatile uint32_t lock;     //!< Process id of the writer, or zero.
+    volatile uint32_t waiting;  /*!< Non-zero if the reader should be woken
+                                 *   by the next write. */
+    volatile uint32_t head;     //!< Total bytes written.
+    volatile uint32_t tail;     //!< Total bytes read.
+    char data[0];
+} mapper_shm_header_t;
+
+#define PAD4(x) (((x) + 3) & ~3)
+
+#ifdef HAVE_SHM_OPEN
+
+static char *shm_name(int port)
+{
+    char *name = malloc(32);
+    snprintf(name, 32, "/libmapper.%d", port);
+    return name;
+}
+
+mapper_shm mapper_shm_create(int port, mapper_id id)
+{
+    char *name = shm_name(port);
+    size_t size = sizeof(mapper_shm_header_t) + MAPPER_SHM_SIZE;
+
+    // remove any object left behind by a previous owner of the port
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        free(name);
+        return 0;
+    }
+    if (ftruncate(fd, size)) {
+        close(fd);
+        shm_unlink(name);
+        free(name);
+        return 0;
+    }
+    void *ptr = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        shm_unlink(name);
+        free(name);
+        return 0;
+    }
+
+    mapper_shm shm = (mapper_shm) calloc(1, sizeof(mapper_shm_t));
+    shm->header = (mapper_shm_header_t*)ptr;
+    shm->size = size;
+    shm->name = name;
+    shm->owner = 1;
+    shm->header->capacity = MAPPER_SHM_SIZE;
+    shm->header->id = id;
+    shm->header->waiting = 1;
+    __sync_synchronize();
+    shm->header->magic = SHM_MAGIC;
+    return shm;
+}
+
+mapper_shm mapper_shm_open(int port, mapper_id id)
+{
+    char *name = shm_name(port);
+    struct stat st;
+    int fd = shm_open(name, O_RDWR, 0);
+    free(name);
+    if (fd < 0)
+        return 0;
+    if (fstat(fd, &st) || st.st_size < sizeof(mapper_shm_header_t)) {
+        close(fd);
+        return 0;
+    }
+    void *ptr = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED)
+        return 0;
+
+    mapper_shm_header_t *header = (mapper_shm_header_t*)ptr;
+    if (   header->magic != SHM_MAGIC || header->id != id
+        || header->capacity + sizeof(mapper_shm_header_t) > st.st_size) {
+        munmap(ptr, st.st_size);
+        return 0;
+    }
+
+    mapper_shm shm = (mapper_shm) calloc(1, sizeof(mapper_shm_t));
+    shm->header = header;
+    shm->size = st.st_size;
+    return shm;
+}
+
+void mapper_shm_free(mapper_shm shm)
+{
+    if (!shm)
+        return;
+    munmap(shm->header, shm->size);
+    if (shm->owner)
+        shm_unlink(shm->name);
+    if (shm->name)
+        free(shm->name);
+    if (shm->buffer)
+        free(shm->buffer);
+    if (shm->pending)
+        free(shm->pending);
+    free(shm);
+}
+
+/* Take the writer's lock, breaking it if the process holding it has died. A
+ * dead writer never moved the head, so the ring is left consistent. */
+static int lock_ring(mapper_shm_header_t *h)
+{
+    uint32_t self = (uint32_t)getpid(), owner;
+    int i;
+    for (i = 0; (owner = __sync_val_compare_and_swap(&h->lock, 0, self)); i++) {
+        if (i < SHM_LOCK_SPINS) {
+            spin_pause();
+            continue;
+        }
+        if (i < SHM_LOCK_ATTEMPTS) {
+            sched_yield();
+            continue;
+        }
+        if (kill((pid_t)owner, 0) && errno == ESRCH
+            && __sync_bool_compare_and_swap(&h->lock, owner, self))
+            return 0;
+        return 1;
+    }
+    return 0;
+}
+
+#else // HAVE_SHM_OPEN
+
+static int lock_ring(mapper_shm_header_t *h)
+{
+    return 1;
+}
+
+mapper_shm mapper_shm_create(int port, mapper_id id)
+{
+    return 0;
+}
+
+mapper_shm mapper_shm_open(int port, mapper_id id)
+{
+    return 0;
+}
+
+void mapper_shm_free(mapper_shm shm)
+{
+}
+
+#endif // HAVE_SHM_OPEN
+
+/* Take the lock and reserve space for a record holding len bytes. Returns
+ * where the bytes should be written, or zero if the ring is busy or full. */
+static char *begin_record(mapper_shm_header_t *h, uint32_t len,
+                          uint32_t *next_head)
+{
+    uint32_t cap = h->capacity, head, offset, space, contiguous;
+    uint32_t record = 4 + PAD4(len);
+
+    if (lock_ring(h))
+        return 0;
+
+    head = h->head;
+    __sync_synchronize();
+    space = cap - (head - h->tail);
+    offset = head % cap;
+    contiguous = cap - offset;
+    if (space < record + (contiguous < record ? contiguous : 0)) {
+        __sync_lock_release(&h->lock);
+        return 0;
+    }
+    if (contiguous < record) {
+        *(uint32_t*)(h->data + offset) = SHM_SKIP;
+        head += contiguous;
+        offset = 0;
+    }
+    *(uint32_t*)(h->data + offset) = len;
+    *next_head = head + record;
+    return h->data + offset + 4;
+}
+
+static void end_record(mapper_shm_header_t *h, uint32_t next_head)
+{
+    // publish the record before moving the head
+    __sync_synchronize();
+    h->head = next_head;
+    __sync_lock_release(&h->lock);
+}
+
+int mapper_shm_flush(mapper_shm shm)
+{
+    mapper_shm_header_t *h = shm->header;
+    size_t done = 0;
+    uint32_t len, head;
+    char *data;
+
+    while (done < shm->pending_len) {
+        len = *(uint32_t*)(shm->pending + done);
+        if (!(data = begin_record(h, len, &head)))
+            break;
+        memcpy(data, shm->pending + done + 4, len);
+        end_record(h, head);
+        done += 4 + PAD4(len);
+    }
+    if (!done)
+        return 0;
+    shm->pending_len -= done;
+    memmove(shm->pending, shm->pending + done, shm->pending_len);
+    return 1;
+}
+
+int mapper_shm_send_bundle(mapper_shm shm, lo_bundle b)
+{
+    mapper_shm_header_t *h = shm->header;
+    uint32_t head;
+    size_t len = lo_bundle_length(b), record = 4 + PAD4(len);
+    char *data;
+
+    if (record > h->capacity / 4)
+        return 1;
+
+    // bundles kept earlier must be written first
+    if (shm->pending_len)
+        mapper_shm_flush(shm);
+    if (!shm->pending_len && (data = begin_record(h, len, &head))) {
+        lo_bundle_serialise(b, data, &len);
+        end_record(h, head);
+        return 0;
+    }
+
+    /* Sending through the network is only safe once the reader has caught
+     * up, otherwise the bundle could overtake those still in the ring. */
+    if (!shm->pending_len && h->head == h->tail)
+        return 1;
+    if (shm->pending_len + record > h->capacity)
+        return 1;
+    if (shm->pending_len + record > shm->pending_size) {
+        size_t size = shm->pending_size ?: 4096;
+        while (shm->pending_len + record > size)
+            size *= 2;
+        shm->pending = realloc(shm->pending, size);
+        shm->pending_size = size;
+    }
+    *(uint32_t*)(shm->pending + shm->pending_len) = len;
+    lo_bundle_serialise(b, shm->pending + shm->pending_len + 4, &len);
+    shm->pending_len += record;
+    return 0;
+}
+
+int mapper_shm_wakeup(mapper_shm shm)
+{
+    return __sync_lock_test_and_set(&shm->header->waiting, 0);
+}
+
+int mapper_shm_dispatch(mapper_shm shm, lo_server server)
+{
+    mapper_shm_header_t *h = shm->header;
+    uint32_t cap = h->capacity, head, tail, offset, len;
+    int count = 0, pass;
+
+    for (pass = 0; pass < 2; pass++) {
+        head = h->head;
+        __sync_synchronize();
+        tail = h->tail;
+        while (tail != head) {
+            offset = tail % cap;
+            len = *(uint32_t*)(h->data + offset);
+            if (len == SHM_SKIP) {
+                tail += cap - offset;
+                continue;
+            }
+            if (len > cap / 4) {
+                // corrupted by a writer, discard everything
+                h->tail = tail = head;
+                break;
+            }
+            // copy the bundle out so the space can be reused while it is
+            // being dispatched
+            if (shm->buffer_size < len) {
+                shm->buffer = realloc(shm->buffer, len);
+                shm->buffer_size = len;
+            }
+            memcpy(shm->buffer, h->data + offset + 4, len);
+            tail += 4 + PAD4(len);
+            __sync_synchronize();
+            h->tail = tail;
+            lo_server_dispatch_data(server, shm->buffer, len);
+            ++count;
+        }
+        /* Ask writers to wake us, then check again in case a record arrived
+         * before the request was seen. */
+        h->waiting = 1;
+        __sync_synchronize();
+        if (h->head == tail)
+            break;
+    }
+    return count;
+}
@@ -156,6 +156,9 @@ void mapper_signal_init(mapper_signal sig, mapper_direction dir,
 
     mapper_table_set_record(sig->props, AT_IS_LOCAL, NULL, 1, 'b', &sig->local,
                             LOCAL_ACCESS_ONLY | NON_MODIFIABLE);
+
+    mapper_database_add_record(sig->device->database, MAPPER_OBJ_SIGNALS, sig,
+                               sig->props);
 }
 
 void mapper_signal_free(mapper_signal sig)
@@ -181,6 +184,7 @@ void mapper_signal_free(mapper_signal sig)
         free(sig->local->instances);
         if (sig->local->has_complete_value)
             free(sig->local->has_complete_value);
+        mapper_fragment_free_all(sig);
         free(sig->local);
     }
 
@@ -348,6 +352,7 @@ const void *mapper_signal_value(mapper_signal sig, mapper_timetag_t *timetag)
 static void mapper_signal_init_instance(mapper_signal_instance si)
 {
     si->has_value = 0;
+    si->is_dirty = 0;
     mapper_timetag_now(&si->created);
 }
 
@@ -910,6 +915,7 @@ void mapper_signal_instance_release_internal(mapper_signal sig,
 
     // Put instance back in reserve list
     smap->instance->is_active = 0;
+    smap->instance->is_dirty = 0;
     smap->instance = 0;
 }
 
@@ -1137,6 +1143,29 @@ void mapper_signal_set_callback(mapper_signal sig,
     }
 }
 
+void mapper_signal_set_callback_mode(mapper_signal sig,
+                                     mapper_callback_mode mode)
+{
+    if (!sig || !sig->local)
+        return;
+    // values that are already waiting will still be delivered on next poll
+    sig->local->callback_mode = mode;
+}
+
+mapper_callback_mode mapper_signal_callback_mode(mapper_signal sig)
+{
+    if (sig && sig->local)
+        return sig->local->callback_mode;
+    return MAPPER_CALLBACK_IMMEDIATE;
+}
+
+void mapper_signal_set_batch_callback(mapper_signal sig,
+                                      mapper_signal_batch_handler *handler)
+{
+    if (sig && sig->local)
+        sig->local->batch_handler = handler;
+}
+
 int mapper_signal_query_remotes(mapper_signal sig, mapper_timetag_t tt)
 {
     if (!sig || !sig->local)
@@ -1339,6 +1368,25 @@ void mapper_signal_set_rate(mapper_signal sig, float rate)
                             LOCAL_MODIFY);
 }
 
+void mapper_signal_set_send_policy(mapper_signal sig,
+                                   const mapper_send_policy_t *policy)
+{
+    if (!sig || !sig->local)
+        return;
+    if (policy)
+        sig->local->send_policy = *policy;
+    sig->local->has_send_policy = (policy != 0);
+}
+
+int mapper_signal_send_policy(mapper_signal sig, mapper_send_policy_t *policy)
+{
+    if (!sig || !sig->local || !sig->local->has_send_policy)
+        return 1;
+    if (policy)
+        *policy = sig->local->send_policy;
+    return 0;
+}
+
 void mapper_signal_set_unit(mapper_signal sig, const char *unit)
 {
     if (!sig || !sig->local)
@@ -1507,6 +1555,7 @@ void mapper_signal_send_state(mapper_signal sig, network_message_t cmd)
         mapper_table_add_to_message(sig->local ? sig->props : 0,
                                     sig->staged_props, msg);
 
+        mapper_network_set_dest_object(sig->device->database->network, sig);
         mapper_network_add_message(sig->device->database->network, 0, cmd, msg);
     }
 }
@@ -1521,6 +1570,7 @@ void mapper_signal_send_removed(mapper_signal sig)
     char sig_name[1024];
     mapper_signal_full_name(sig, sig_name, 1024);
     lo_message_add_string(msg, sig_name);
+    mapper_network_set_dest_object(sig->device->database->network, sig);
     mapper_network_add_message(sig->device->database->network, 0,
                                MSG_SIGNAL_REMOVED, msg);
 }
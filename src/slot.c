@@ -265,6 +265,8 @@ void mapper_slot_upgrade_extrema_memory(mapper_slot slot)
         if (new_mem)
             free(new_mem);
     }
+    if (slot->local)
+        slot->local->boundary.compiled = 0;
 }
 
 int mapper_slot_set_from_message(mapper_slot slot, mapper_message msg,
@@ -358,11 +360,22 @@ int mapper_slot_set_from_message(mapper_slot slot, mapper_message msg,
                 if (slot->map->local)
                     break;
             default:
+                /* The alias assigned by the destination device is only used
+                 * by the source device, and is not kept as a property. */
+                if ((atom->index & ~mask) == AT_EXTRA
+                    && strcmp(atom->key, "alias") == 0) {
+                    if (slot->signal->local && atom->length == 1
+                        && atom->types[0] == 'i')
+                        slot->alias = atom->values[0]->i32;
+                    break;
+                }
                 updated += mapper_table_set_record_from_atom(slot->props, atom,
                                                              REMOTE_MODIFY);
                 break;
         }
     }
+    if (updated && slot->local)
+        slot->local->boundary.compiled = 0;
     return updated;
 }
 
@@ -390,6 +403,12 @@ void mapper_slot_add_props_to_message(lo_message msg, mapper_slot slot,
         lo_message_add_char(msg, slot->signal->type);
     }
 
+    if (!staged && slot->alias) {
+        snprintf(temp+len, 16-len, "@alias");
+        lo_message_add_string(msg, temp);
+        lo_message_add_int32(msg, slot->alias);
+    }
+
     mapper_table_add_to_message(0, staged ? slot->staged_props : slot->props,
                                 msg);
 
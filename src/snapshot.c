@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include "config.h"
+#include <mapper/mapper.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
+/* A snapshot is a deep copy of the records in a database, published by the
+ * thread polling the database whenever the database has changed. Readers on
+ * other threads acquire the latest snapshot and may then walk it without any
+ * locking while the poller keeps applying updates to the database itself.
+ * Each snapshot is reference counted: the database holds one reference until
+ * the next snapshot replaces it, and the snapshot is freed when the last
+ * reader releases it. The lock below only guards the reference counts and the
+ * swap of the latest snapshot. */
+
+#ifdef HAVE_PTHREAD
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+#define lock_snapshots()    pthread_mutex_lock(&snapshot_lock)
+#define unlock_snapshots()  pthread_mutex_unlock(&snapshot_lock)
+#else
+#define lock_snapshots()
+#define unlock_snapshots()
+#endif
+
+static int snapshot_type_index(mapper_object_type type)
+{
+    switch (type) {
+        case MAPPER_OBJ_DEVICES:        return SNAPSHOT_DEVICES;
+        case MAPPER_OBJ_SIGNALS:        return SNAPSHOT_SIGNALS;
+        case MAPPER_OBJ_LINKS:          return SNAPSHOT_LINKS;
+        case MAPPER_OBJ_MAPS:           return SNAPSHOT_MAPS;
+        default:                        return -1;
+    }
+}
+
+/* Only property types with a known size can be copied; user data and other
+ * local pointers are left out of snapshots. */
+static int copyable_type(char type)
+{
+    switch (type) {
+        case 'i': case 'b': case 'T': case 'F': case 'f': case 'd':
+        case 's': case 'S': case 'h': case 't': case 'c':
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void copy_property(mapper_snapshot_property_t *prop, const char *key,
+                          int length, char type, const void *value)
+{
+    int i;
+    prop->key = strdup(key);
+    prop->length = length;
+    prop->type = type;
+    if (type == 's' || type == 'S') {
+        if (length == 1) {
+            prop->value = value ? strdup((const char*)value) : 0;
+            return;
+        }
+        char **from = (char**)value, **to = calloc(length, sizeof(char*));
+        for (i = 0; i < length; i++)
+            to[i] = from[i] ? strdup(from[i]) : 0;
+        prop->value = to;
+        return;
+    }
+    size_t size = mapper_type_size(type) * length;
+    prop->value = malloc(size);
+    memcpy(prop->value, value, size);
+}
+
+static void free_property(mapper_snapshot_property_t *prop)
+{
+    int i;
+    if ((prop->type == 's' || prop->type == 'S') && prop->length > 1) {
+        char **values = (char**)prop->value;
+        for (i = 0; i < prop->length; i++) {
+            if (values[i])
+                free(values[i]);
+        }
+    }
+    if (prop->value)
+        free(prop->value);
+    free(prop->key);
+}
+
+/* Copy a table of properties into a record, leaving room for a number of
+ * extra properties identifying related records. */
+static void copy_record(mapper_snapshot_record rec, mapper_id id,
+                        mapper_table tab, int num_extra)
+{
+    int i;
+    mapper_table_record_t *tab_rec;
+    const void *value;
+
+    rec->id = id;
+    rec->num_props = 0;
+    rec->props = calloc(tab->num_records + num_extra,
+                        sizeof(mapper_snapshot_property_t));
+    for (i = 0; i < tab->num_records; i++) {
+        tab_rec = &tab->records[i];
+        if (!tab_rec->value || !copyable_type(tab_rec->type))
+            continue;
+        value = tab_rec->flags & INDIRECT ? *tab_rec->value : tab_rec->value;
+        if (!value || tab_rec->length <= 0)
+            continue;
+        copy_property(&rec->props[rec->num_props++],
+                      (tab_rec->key ? tab_rec->key
+                       : mapper_property_string(tab_rec->index)),
+                      tab_rec->length, tab_rec->type, value);
+    }
+}
+
+static void add_ids(mapper_snapshot_record rec, const char *key, int num_ids,
+                    mapper_id *ids)
+{
+    copy_property(&rec->props[rec->num_props++], key, num_ids, 'h', ids);
+}
+
+static int compare_records(const void *l, const void *r)
+{
+    mapper_id lid = ((const mapper_snapshot_record_t*)l)->id;
+    mapper_id rid = ((const mapper_snapshot_record_t*)r)->id;
+    return lid < rid ? -1 : lid > rid;
+}
+
+static mapper_snapshot_record alloc_records(mapper_snapshot snap, int type,
+                                            void *list)
+{
+    int count = 0;
+    while (list) {
+        ++count;
+        list = mapper_list_next(list);
+    }
+    snap->num_records[type] = 0;
+    snap->records[type] = calloc(count ? count : 1,
+                                 sizeof(mapper_snapshot_record_t));
+    return snap->records[type];
+}
+
+static mapper_snapshot build_snapshot(mapper_database db)
+{
+    int i, n;
+    mapper_id ids[MAX_NUM_MAP_SOURCES];
+    mapper_snapshot_record rec;
+    mapper_snapshot snap = calloc(1, sizeof(mapper_snapshot_t));
+    snap->refcount = 1;
+
+    mapper_device dev = db->devices;
+    rec = alloc_records(snap, SNAPSHOT_DEVICES, dev);
+    for (n = 0; dev; dev = mapper_list_next(dev), n++)
+        copy_record(&rec[n], dev->id, dev->props, 0);
+    snap->num_records[SNAPSHOT_DEVICES] = n;
+
+    mapper_signal sig = db->signals;
+    rec = alloc_records(snap, SNAPSHOT_SIGNALS, sig);
+    for (n = 0; sig; sig = mapper_list_next(sig), n++) {
+        copy_record(&rec[n], sig->id, sig->props, 1);
+        if (sig->device)
+            add_ids(&rec[n], "device_id", 1, &sig->device->id);
+    }
+    snap->num_records[SNAPSHOT_SIGNALS] = n;
+
+    mapper_link link = db->links;
+    rec = alloc_records(snap, SNAPSHOT_LINKS, link);
+    for (n = 0; link; link = mapper_list_next(link), n++) {
+        copy_record(&rec[n], link->id, link->props, 1);
+        if (link->devices[0] && link->devices[1]) {
+            ids[0] = link->devices[0]->id;
+            ids[1] = link->devices[1]->id;
+            add_ids(&rec[n], "device_ids", 2, ids);
+        }
+    }
+    snap->num_records[SNAPSHOT_LINKS] = n;
+
+    mapper_map map = db->maps;
+    rec = alloc_records(snap, SNAPSHOT_MAPS, map);
+    for (n = 0; map; map = mapper_list_next(map), n++) {
+        copy_record(&rec[n], map->id, map->props, 2);
+        for (i = 0; i < map->num_sources; i++)
+            ids[i] = map->sources[i]->signal->id;
+        add_ids(&rec[n], "source_ids", map->num_sources, ids);
+        add_ids(&rec[n], "destination_id", 1, &map->destination.signal->id);
+    }
+    snap->num_records[SNAPSHOT_MAPS] = n;
+
+    for (i = 0; i < NUM_SNAPSHOT_TYPES; i++)
+        qsort(snap->records[i], snap->num_records[i],
+              sizeof(mapper_snapshot_record_t), compare_records);
+    return snap;
+}
+
+static void free_snapshot(mapper_snapshot snap)
+{
+    int i, j, k;
+    for (i = 0; i < NUM_SNAPSHOT_TYPES; i++) {
+        for (j = 0; j < snap->num_records[i]; j++) {
+            mapper_snapshot_record rec = &snap->records[i][j];
+            for (k = 0; k < rec->num_props; k++)
+                free_property(&rec->props[k]);
+            free(rec->props);
+        }
+        free(snap->records[i]);
+    }
+    free(snap);
+}
+
+void mapper_snapshot_release(mapper_snapshot snap)
+{
+    if (!snap)
+        return;
+    lock_snapshots();
+    int refcount = --snap->refcount;
+    unlock_snapshots();
+    if (!refcount)
+        free_snapshot(snap);
+}
+
+static void swap_snapshot(mapper_database db, mapper_snapshot snap)
+{
+    lock_snapshots();
+    mapper_snapshot old = db->snapshot;
+    db->snapshot = snap;
+    unlock_snapshots();
+    mapper_snapshot_release(old);
+}
+
+void mapper_database_publish_snapshot(mapper_database db)
+{
+    if (!db->publish_snapshots)
+        return;
+    // each counter only increases, so their sum changes with any of them
+    uint32_t revision = (db->revisions[0] + db->revisions[1]
+                         + db->revisions[2] + db->revisions[3]);
+    if (db->snapshot && revision == db->snapshot_revision)
+        return;
+    db->snapshot_revision = revision;
+    swap_snapshot(db, build_snapshot(db));
+}
+
+void mapper_database_set_snapshots(mapper_database db, int enable)
+{
+    db->publish_snapshots = enable ? 1 : 0;
+    if (enable)
+        mapper_database_publish_snapshot(db);
+    else
+        swap_snapshot(db, 0);
+}
+
+mapper_snapshot mapper_database_snapshot(mapper_database db)
+{
+    lock_snapshots();
+    mapper_snapshot snap = db->snapshot;
+    if (snap)
+        ++snap->refcount;
+    unlock_snapshots();
+    return snap;
+}
+
+int mapper_snapshot_num_records(mapper_snapshot snap, mapper_object_type type)
+{
+    int i = snapshot_type_index(type);
+    return i < 0 ? 0 : snap->num_records[i];
+}
+
+mapper_snapshot_record mapper_snapshot_record_by_index(mapper_snapshot snap,
+                                                       mapper_object_type type,
+                                                       int index)
+{
+    int i = snapshot_type_index(type);
+    if (i < 0 || index < 0 || index >= snap->num_records[i])
+        return 0;
+    return &snap->records[i][index];
+}
+
+mapper_snapshot_record mapper_snapshot_record_by_id(mapper_snapshot snap,
+                                                    mapper_object_type type,
+                                                    mapper_id id)
+{
+    int i = snapshot_type_index(type);
+    if (i < 0)
+        return 0;
+    mapper_snapshot_record_t key = { id, 0, 0 };
+    return bsearch(&key, snap->records[i], snap->num_records[i],
+                   sizeof(mapper_snapshot_record_t), compare_records);
+}
+
+mapper_id mapper_snapshot_record_id(mapper_snapshot_record rec)
+{
+    return rec->id;
+}
+
+int mapper_snapshot_record_num_properties(mapper_snapshot_record rec)
+{
+    return rec->num_props;
+}
+
+int mapper_snapshot_record_property(mapper_snapshot_record rec,
+                                    const char *name, int *length, char *type,
+                                    const void **value)
+{
+    int i;
+    for (i = 0; i < rec->num_props; i++) {
+        if (strcmp(rec->props[i].key, name) == 0)
+            return mapper_snapshot_record_property_index(rec, i, 0, length,
+                                                         type, value);
+    }
+    return -1;
+}
+
+int mapper_snapshot_record_property_index(mapper_snapshot_record rec,
+                                          unsigned int index,
+                                          const char **name, int *length,
+                                          char *type, const void **value)
+{
+    if (index >= rec->num_props)
+        return -1;
+    mapper_snapshot_property_t *prop = &rec->props[index];
+    if (name)
+        *name = prop->key;
+    if (length)
+        *length = prop->length;
+    if (type)
+        *type = prop->type;
+    if (value)
+        *value = prop->value;
+    return 0;
+}
@@ -0,0 +1,377 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include <lo/lo.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include <mapper/mapper.h>
+
+/* Counters may be written by the thread polling the device while being read
+ * by a monitoring thread, so all accesses use relaxed atomics where available.
+ * A snapshot may therefore be momentarily inconsistent between fields, but
+ * individual values are never torn. */
+#ifdef __GNUC__
+#define STAT_ADD(PTR, N)    __atomic_fetch_add(PTR, N, __ATOMIC_RELAXED)
+#define STAT_LOAD(PTR)      __atomic_load_n(PTR, __ATOMIC_RELAXED)
+#define STAT_STORE(PTR, V)  __atomic_store_n(PTR, V, __ATOMIC_RELAXED)
+#else
+#define STAT_ADD(PTR, N)    (*(PTR) += (N))
+#define STAT_LOAD(PTR)      (*(PTR))
+#define STAT_STORE(PTR, V)  (*(PTR) = (V))
+#endif
+
+mapper_local_stats mapper_stats_new(void)
+{
+    return (mapper_local_stats) calloc(1, sizeof(mapper_local_stats_t));
+}
+
+uint64_t mapper_stats_now(void)
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#else
+    return (uint64_t)(mapper_get_monotonic_time() * 1e9);
+#endif
+}
+
+void mapper_stats_add(uint64_t *counter, uint64_t n)
+{
+    STAT_ADD(counter, n);
+}
+
+static int most_significant_bit(uint64_t v)
+{
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(v);
+#else
+    int msb = 0;
+    while (v >>= 1)
+        ++msb;
+    return msb;
+#endif
+}
+
+static int bucket_index(uint64_t ns)
+{
+    if (ns < STATS_SUB_BUCKETS)
+        return (int)ns;
+    if (ns >> STATS_MAX_BITS)
+        return STATS_NUM_BUCKETS - 1;
+    int shift = most_significant_bit(ns) - STATS_SUB_BUCKET_BITS;
+    return (((shift + 1) << STATS_SUB_BUCKET_BITS)
+            + (int)((ns >> shift) - STATS_SUB_BUCKETS));
+}
+
+// Returns the midpoint of a bucket in nanoseconds.
+static double bucket_value(int index)
+{
+    if (index < STATS_SUB_BUCKETS)
+        return index;
+    int shift = (index >> STATS_SUB_BUCKET_BITS) - 1;
+    uint64_t lower = ((uint64_t)(STATS_SUB_BUCKETS
+                                 + (index & (STATS_SUB_BUCKETS - 1))) << shift);
+    return lower + (double)((uint64_t)1 << shift) * 0.5;
+}
+
+void mapper_stats_record(mapper_local_stats stats, mapper_stat_timer timer,
+                         uint64_t ns)
+{
+    if (!stats || timer < 0 || timer >= NUM_MAPPER_STAT_TIMERS)
+        return;
+    mapper_histogram h = &stats->timers[timer];
+    STAT_ADD(&h->counts[bucket_index(ns)], 1);
+    STAT_ADD(&h->total, 1);
+    STAT_ADD(&h->sum, ns);
+    // only the polling thread records values so a plain compare is sufficient
+    if (ns > STAT_LOAD(&h->max))
+        STAT_STORE(&h->max, ns);
+}
+
+void mapper_stats_record_latency(mapper_local_stats map_stats, mapper_link link,
+                                 mapper_timetag_t tt)
+{
+    mapper_local_stats link_stats = (link && link->local) ? link->local->stats : 0;
+    if (!map_stats && !link_stats)
+        return;
+    if (tt.sec == 0 && tt.frac == 1) {
+        // MAPPER_NOW carries no timing information
+        return;
+    }
+
+    double offset = 0;
+    if (link && link->local && link->remote_device != link->local_device) {
+        if (link->local->clock.new) {
+            // clocks have not yet been synchronised
+            return;
+        }
+        offset = mapper_sync_clock_offset(&link->local->clock, 0);
+    }
+
+    mapper_timetag_t now;
+    mapper_timetag_now(&now);
+    double latency = mapper_timetag_difference(now, tt) - offset;
+    uint64_t ns = latency > 0 ? (uint64_t)(latency * 1e9) : 0;
+    mapper_stats_record(map_stats, MAPPER_STAT_LATENCY, ns);
+    mapper_stats_record(link_stats, MAPPER_STAT_LATENCY, ns);
+}
+
+static void stats_copy(mapper_local_stats stats, mapper_stats_t *out)
+{
+    out->sent = STAT_LOAD(&stats->counters.sent);
+    out->received = STAT_LOAD(&stats->counters.received);
+    out->bytes_sent = STAT_LOAD(&stats->counters.bytes_sent);
+    out->bytes_received = STAT_LOAD(&stats->counters.bytes_received);
+    out->dropped_muted = STAT_LOAD(&stats->counters.dropped_muted);
+    out->dropped_out_of_scope = STAT_LOAD(&stats->counters.dropped_out_of_scope);
+    out->dropped_not_ready = STAT_LOAD(&stats->counters.dropped_not_ready);
+    out->dropped_backpressure =
+        STAT_LOAD(&stats->counters.dropped_backpressure);
+    out->scheduled = STAT_LOAD(&stats->counters.scheduled);
+    out->late = STAT_LOAD(&stats->counters.late);
+    out->coalesced = STAT_LOAD(&stats->counters.coalesced);
+    out->rate_limited = STAT_LOAD(&stats->counters.rate_limited);
+    out->below_deadband = STAT_LOAD(&stats->counters.below_deadband);
+    out->converged = STAT_LOAD(&stats->counters.converged);
+}
+
+static double stats_percentile(mapper_local_stats stats,
+                               mapper_stat_timer timer, double percentile)
+{
+    int i;
+    if (!stats || timer < 0 || timer >= NUM_MAPPER_STAT_TIMERS)
+        return 0;
+    mapper_histogram h = &stats->timers[timer];
+    uint64_t total = STAT_LOAD(&h->total);
+    double max = (double)STAT_LOAD(&h->max);
+    if (!total)
+        return 0;
+    if (percentile >= 100)
+        return max * 1e-9;
+    if (percentile < 0)
+        percentile = 0;
+
+    uint64_t target = (uint64_t)ceil(total * percentile * 0.01), count = 0;
+    if (target < 1)
+        target = 1;
+    for (i = 0; i < STATS_NUM_BUCKETS; i++) {
+        count += STAT_LOAD(&h->counts[i]);
+        if (count >= target) {
+            double value = bucket_value(i);
+            return (value < max ? value : max) * 1e-9;
+        }
+    }
+    return max * 1e-9;
+}
+
+static void stats_reset(mapper_local_stats stats)
+{
+    int i, j;
+    STAT_STORE(&stats->counters.sent, 0);
+    STAT_STORE(&stats->counters.received, 0);
+    STAT_STORE(&stats->counters.bytes_sent, 0);
+    STAT_STORE(&stats->counters.bytes_received, 0);
+    STAT_STORE(&stats->counters.dropped_muted, 0);
+    STAT_STORE(&stats->counters.dropped_out_of_scope, 0);
+    STAT_STORE(&stats->counters.dropped_not_ready, 0);
+    STAT_STORE(&stats->counters.dropped_backpressure, 0);
+    STAT_STORE(&stats->counters.scheduled, 0);
+    STAT_STORE(&stats->counters.late, 0);
+    STAT_STORE(&stats->counters.coalesced, 0);
+    STAT_STORE(&stats->counters.rate_limited, 0);
+    STAT_STORE(&stats->counters.below_deadband, 0);
+    STAT_STORE(&stats->counters.converged, 0);
+    for (i = 0; i < NUM_MAPPER_STAT_TIMERS; i++) {
+        mapper_histogram h = &stats->timers[i];
+        for (j = 0; j < STATS_NUM_BUCKETS; j++)
+            STAT_STORE(&h->counts[j], 0);
+        STAT_STORE(&h->total, 0);
+        STAT_STORE(&h->sum, 0);
+        STAT_STORE(&h->max, 0);
+    }
+}
+
+void mapper_map_init_stats(mapper_map map)
+{
+    if (!map->local)
+        return;
+    mapper_device dev = map->local->router->device;
+    if (dev->local->stats_flags & MAPPER_STATS_COLLECT) {
+        if (!map->local->stats)
+            map->local->stats = mapper_stats_new();
+    }
+    else if (map->local->stats) {
+        free(map->local->stats);
+        map->local->stats = 0;
+    }
+}
+
+void mapper_link_init_stats(mapper_link link)
+{
+    if (!link->local || !link->local_device->local)
+        return;
+    if (link->local_device->local->stats_flags & MAPPER_STATS_COLLECT) {
+        if (!link->local->stats)
+            link->local->stats = mapper_stats_new();
+    }
+    else if (link->local->stats) {
+        free(link->local->stats);
+        link->local->stats = 0;
+    }
+}
+
+void mapper_device_set_stats(mapper_device dev, int flags)
+{
+    if (!dev || !dev->local)
+        return;
+    dev->local->stats_flags = flags;
+
+    mapper_map map = dev->database->maps;
+    while (map) {
+        mapper_map_init_stats(map);
+        map = mapper_list_next(map);
+    }
+    mapper_link link = dev->database->links;
+    while (link) {
+        mapper_link_init_stats(link);
+        link = mapper_list_next(link);
+    }
+}
+
+int mapper_device_stats(mapper_device dev)
+{
+    return (dev && dev->local) ? dev->local->stats_flags : MAPPER_STATS_NONE;
+}
+
+int mapper_map_stats(mapper_map map, mapper_stats_t *stats)
+{
+    if (!map || !map->local || !map->local->stats || !stats)
+        return 1;
+    stats_copy(map->local->stats, stats);
+    return 0;
+}
+
+double mapper_map_stats_percentile(mapper_map map, mapper_stat_timer timer,
+                                   double percentile)
+{
+    if (!map || !map->local)
+        return 0;
+    return stats_percentile(map->local->stats, timer, percentile);
+}
+
+void mapper_map_reset_stats(mapper_map map)
+{
+    if (map && map->local && map->local->stats)
+        stats_reset(map->local->stats);
+}
+
+int mapper_link_stats(mapper_link link, mapper_stats_t *stats)
+{
+    if (!link || !link->local || !link->local->stats || !stats)
+        return 1;
+    stats_copy(link->local->stats, stats);
+    return 0;
+}
+
+double mapper_link_stats_percentile(mapper_link link, mapper_stat_timer timer,
+                                    double percentile)
+{
+    if (!link || !link->local)
+        return 0;
+    return stats_percentile(link->local->stats, timer, percentile);
+}
+
+void mapper_link_reset_stats(mapper_link link)
+{
+    if (link && link->local && link->local->stats)
+        stats_reset(link->local->stats);
+}
+
+static void set_timer_prop(mapper_table tab, const char *key,
+                           mapper_local_stats stats, mapper_stat_timer timer)
+{
+    double vals[3];
+    vals[0] = stats_percentile(stats, timer, 50);
+    vals[1] = stats_percentile(stats, timer, 99);
+    vals[2] = stats_percentile(stats, timer, 100);
+    mapper_table_set_record(tab, AT_EXTRA, key, 3, 'd', vals, NON_MODIFIABLE);
+}
+
+static void set_stats_props(mapper_table tab, mapper_local_stats stats)
+{
+    mapper_stats_t s;
+    stats_copy(stats, &s);
+    int64_t counts[4];
+
+    counts[0] = (int64_t)s.sent;
+    counts[1] = (int64_t)s.received;
+    mapper_table_set_record(tab, AT_EXTRA, "stats_messages", 2, 'h', counts,
+                            NON_MODIFIABLE);
+    counts[0] = (int64_t)s.bytes_sent;
+    counts[1] = (int64_t)s.bytes_received;
+    mapper_table_set_record(tab, AT_EXTRA, "stats_bytes", 2, 'h', counts,
+                            NON_MODIFIABLE);
+    counts[0] = (int64_t)s.dropped_muted;
+    counts[1] = (int64_t)s.dropped_out_of_scope;
+    counts[2] = (int64_t)s.dropped_not_ready;
+    counts[3] = (int64_t)s.dropped_backpressure;
+    mapper_table_set_record(tab, AT_EXTRA, "stats_dropped", 4, 'h', counts,
+                            NON_MODIFIABLE);
+    counts[0] = (int64_t)s.scheduled;
+    counts[1] = (int64_t)s.late;
+    mapper_table_set_record(tab, AT_EXTRA, "stats_scheduling", 2, 'h', counts,
+                            NON_MODIFIABLE);
+    counts[0] = (int64_t)s.coalesced;
+    counts[1] = (int64_t)s.rate_limited;
+    counts[2] = (int64_t)s.below_deadband;
+    mapper_table_set_record(tab, AT_EXTRA, "stats_suppressed", 3, 'h', counts,
+                            NON_MODIFIABLE);
+    counts[0] = (int64_t)s.converged;
+    mapper_table_set_record(tab, AT_EXTRA, "stats_converged", 1, 'h', counts,
+                            NON_MODIFIABLE);
+    set_timer_prop(tab, "stats_eval_time", stats, MAPPER_STAT_EVAL_TIME);
+    set_timer_prop(tab, "stats_latency", stats, MAPPER_STAT_LATENCY);
+    set_timer_prop(tab, "stats_schedule_error", stats,
+                   MAPPER_STAT_SCHEDULE_ERROR);
+}
+
+void mapper_device_publish_stats(mapper_device dev)
+{
+    if (!dev->local || (dev->local->stats_flags & MAPPER_STATS_PUBLISH)
+        != MAPPER_STATS_PUBLISH)
+        return;
+    mapper_network net = dev->database->network;
+
+    mapper_map map = dev->database->maps;
+    while (map) {
+        if (map->local && map->local->stats) {
+            set_stats_props(map->props, map->local->stats);
+            if (dev->local->subscribers && map->status >= STATUS_READY) {
+                if (map->destination.direction == MAPPER_DIR_OUTGOING)
+                    mapper_network_set_dest_subscribers(net, MAPPER_OBJ_OUTGOING_MAPS);
+                else
+                    mapper_network_set_dest_subscribers(net, MAPPER_OBJ_INCOMING_MAPS);
+                mapper_map_send_state(map, -1, MSG_MAPPED);
+            }
+        }
+        map = mapper_list_next(map);
+    }
+
+    mapper_link link = dev->database->links;
+    while (link) {
+        if (link->local && link->local->stats) {
+            set_stats_props(link->props, link->local->stats);
+            if (dev->local->subscribers) {
+                mapper_network_set_dest_subscribers(net, MAPPER_OBJ_LINKS);
+                mapper_link_send_state(link, MSG_LINKED, 0);
+            }
+        }
+        link = mapper_list_next(link);
+    }
+}
@@ -0,0 +1,360 @@
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <lo/lo.h>
+
+#include "mapper_internal.h"
+#include "types_internal.h"
+#include "config.h"
+#include <mapper/mapper.h>
+
+#ifdef HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* Links can carry updates over a TCP connection to the remote device instead
+ * of UDP. Each bundle is sent as a frame prefixed with its length as a 32-bit
+ * big-endian integer, which is the framing used by liblo's own TCP servers.
+ * Frames wait in a list until the socket accepts them, and are written in
+ * batches with a single gathering write. sendmsg() is used rather than
+ * writev() so that a closed connection does not raise SIGPIPE. */
+
+// maximum number of frames written by a single call to sendmsg()
+#define STREAM_IOV_MAX 64
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#ifdef HAVE_ARPA_INET_H
+
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags < 0 ? -1 : fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+int mapper_stream_server_listen(mapper_stream_server srv,
+                                struct in_addr iface, int port)
+{
+    struct sockaddr_in addr;
+    int yes = 1;
+
+    srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->fd < 0)
+        return 1;
+    setsockopt(srv->fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = iface;
+    addr.sin_port = htons(port);
+    if (   bind(srv->fd, (struct sockaddr*)&addr, sizeof(addr))
+        || listen(srv->fd, 8) || set_nonblocking(srv->fd)) {
+        close(srv->fd);
+        srv->fd = -1;
+        return 1;
+    }
+    return 0;
+}
+
+static void close_input(mapper_stream_server srv, mapper_stream_input in)
+{
+    mapper_stream_input *prev = &srv->inputs;
+    while (*prev && *prev != in)
+        prev = &(*prev)->next;
+    if (*prev)
+        *prev = in->next;
+    close(in->fd);
+    if (in->buffer)
+        free(in->buffer);
+    free(in);
+    --srv->num_inputs;
+}
+
+/* Read up to MAPPER_STREAM_MAX_READ bytes waiting on a connection and
+ * dispatch the complete frames. Returns the number of frames dispatched, or
+ * -1 if the connection should be closed. */
+static int recv_input(mapper_stream_input in, lo_server server)
+{
+    int count = 0;
+    ssize_t n;
+    uint32_t len;
+    size_t offset, total = 0;
+
+    while (total < MAPPER_STREAM_MAX_READ) {
+        if (in->size - in->length < 4096) {
+            in->size = in->size ? in->size * 2 : 65536;
+            in->buffer = realloc(in->buffer, in->size);
+        }
+        n = recv(in->fd, in->buffer + in->length, in->size - in->length, 0);
+        if (n == 0)
+            return -1;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            return -1;
+        }
+        in->length += n;
+        total += n;
+
+        // dispatch complete frames
+        offset = 0;
+        while (in->length - offset >= 4) {
+            memcpy(&len, in->buffer + offset, 4);
+            len = ntohl(len);
+            if (len > MAPPER_STREAM_MAX_FRAME)
+                return -1;
+            if (in->length - offset - 4 < len)
+                break;
+            lo_server_dispatch_data(server, in->buffer + offset + 4, len);
+            offset += 4 + len;
+            ++count;
+        }
+        if (offset) {
+            in->length -= offset;
+            memmove(in->buffer, in->buffer + offset, in->length);
+        }
+    }
+    return count;
+}
+
+int mapper_stream_server_fds(mapper_stream_server srv, int *fds, int num)
+{
+    int i = 0;
+    mapper_stream_input in = srv->inputs;
+    if (srv->fd >= 0 && i < num)
+        fds[i++] = srv->fd;
+    while (in && i < num) {
+        fds[i++] = in->fd;
+        in = in->next;
+    }
+    return i;
+}
+
+int mapper_stream_server_recv(mapper_stream_server srv, lo_server server)
+{
+    int fd, count = 0, n;
+    mapper_stream_input in, next;
+
+    if (srv->fd < 0)
+        return 0;
+
+    while ((fd = accept(srv->fd, 0, 0)) >= 0) {
+        if (srv->num_inputs >= MAPPER_STREAM_MAX_INPUTS
+            || set_nonblocking(fd)) {
+            // the sender will fall back to the network
+            close(fd);
+            continue;
+        }
+        in = (mapper_stream_input) calloc(1, sizeof(mapper_stream_input_t));
+        in->fd = fd;
+        in->next = srv->inputs;
+        srv->inputs = in;
+        ++srv->num_inputs;
+    }
+
+    in = srv->inputs;
+    while (in) {
+        next = in->next;
+        n = recv_input(in, server);
+        if (n < 0)
+            close_input(srv, in);
+        else
+            count += n;
+        in = next;
+    }
+    return count;
+}
+
+void mapper_stream_server_free(mapper_stream_server srv)
+{
+    while (srv->inputs)
+        close_input(srv, srv->inputs);
+    if (srv->fd >= 0)
+        close(srv->fd);
+    srv->fd = -1;
+}
+
+mapper_stream mapper_stream_open(const char *host, const char *port)
+{
+    struct addrinfo hints, *info;
+    int fd, yes = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &info))
+        return 0;
+
+    fd = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(info);
+        return 0;
+    }
+    // updates are batched by the stream itself
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(int));
+#ifdef SO_NOSIGPIPE
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(int));
+#endif
+    if (set_nonblocking(fd)
+        || (   connect(fd, info->ai_addr, info->ai_addrlen)
+            && errno != EINPROGRESS)) {
+        freeaddrinfo(info);
+        close(fd);
+        return 0;
+    }
+    freeaddrinfo(info);
+
+    mapper_stream s = (mapper_stream) calloc(1, sizeof(mapper_stream_t));
+    s->fd = fd;
+    return s;
+}
+
+int mapper_stream_flush(mapper_stream s)
+{
+    struct iovec iov[STREAM_IOV_MAX];
+    struct msghdr msg;
+    mapper_stream_frame f;
+    ssize_t n;
+    int i;
+
+    if (!s->connected) {
+        // check whether the connection has been established
+        int err = 0;
+        socklen_t len = sizeof(int);
+        fd_set fds;
+        struct timeval tv = {0, 0};
+        FD_ZERO(&fds);
+        FD_SET(s->fd, &fds);
+        if (select(s->fd + 1, 0, &fds, 0, &tv) <= 0)
+            return 0;
+        if (getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len) || err)
+            return 1;
+        s->connected = 1;
+    }
+
+    while (s->head) {
+        for (i = 0, f = s->head; f && i < STREAM_IOV_MAX; i++, f = f->next) {
+            iov[i].iov_base = f->data;
+            iov[i].iov_len = f->length;
+        }
+        iov[0].iov_base = s->head->data + s->offset;
+        iov[0].iov_len -= s->offset;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = i;
+        n = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            return 1;
+        }
+        s->backlog -= n;
+        n += s->offset;
+        while (s->head && n >= s->head->length) {
+            f = s->head;
+            n -= f->length;
+            s->head = f->next;
+            free(f);
+        }
+        if (!s->head)
+            s->tail = 0;
+        s->offset = n;
+    }
+    return 0;
+}
+
+void mapper_stream_free(mapper_stream s)
+{
+    mapper_stream_frame f;
+    if (!s)
+        return;
+    close(s->fd);
+    while ((f = s->head)) {
+        s->head = f->next;
+        free(f);
+    }
+    free(s);
+}
+
+#else // HAVE_ARPA_INET_H
+
+int mapper_stream_server_listen(mapper_stream_server srv,
+                                struct in_addr iface, int port)
+{
+    srv->fd = -1;
+    return 1;
+}
+
+int mapper_stream_server_fds(mapper_stream_server srv, int *fds, int num)
+{
+    return 0;
+}
+
+int mapper_stream_server_recv(mapper_stream_server srv, lo_server server)
+{
+    return 0;
+}
+
+void mapper_stream_server_free(mapper_stream_server srv)
+{
+}
+
+mapper_stream mapper_stream_open(const char *host, const char *port)
+{
+    return 0;
+}
+
+int mapper_stream_flush(mapper_stream s)
+{
+    return 1;
+}
+
+void mapper_stream_free(mapper_stream s)
+{
+}
+
+#endif // HAVE_ARPA_INET_H
+
+int mapper_stream_send_bundle(mapper_stream s, lo_bundle b)
+{
+    size_t len = lo_bundle_length(b);
+    if (s->backlog + len + 4 > MAPPER_STREAM_MAX_BACKLOG)
+        return 1;
+
+    mapper_stream_frame f = ((mapper_stream_frame)
+                             malloc(sizeof(mapper_stream_frame_t) + len + 4));
+    if (!f)
+        return 1;
+    f->data[0] = (len >> 24) & 0xFF;
+    f->data[1] = (len >> 16) & 0xFF;
+    f->data[2] = (len >> 8) & 0xFF;
+    f->data[3] = len & 0xFF;
+    lo_bundle_serialise(b, f->data + 4, &len);
+    f->length = len + 4;
+    f->next = 0;
+    if (s->tail)
+        s->tail->next = f;
+    else
+        s->head = f;
+    s->tail = f;
+    s->backlog += f->length;
+    return 0;
+}
@@ -33,6 +33,9 @@ mapper_table mapper_table_new()
     if (!tab) return 0;
     tab->num_records = 0;
     tab->alloced = 1;
+    tab->db = 0;
+    tab->owner = 0;
+    tab->serial = 0;
     tab->records = (mapper_table_record_t*)malloc(sizeof(mapper_table_record_t));
     return tab;
 }
@@ -192,8 +195,12 @@ int mapper_table_remove_record(mapper_table tab, mapper_property_t index,
         // set value to null rather than removing key
         if (rec->flags & INDIRECT) {
             if (rec->value && *rec->value) {
+                if (tab->db)
+                    mapper_database_unindex_property(tab, rec->index, rec->key);
                 free(*rec->value);
                 *rec->value = 0;
+                if (tab->db)
+                    mapper_database_index_property(tab, rec->index, rec->key);
             }
             rec->index |= PROPERTY_REMOVE;
             return 1;
@@ -207,6 +214,8 @@ int mapper_table_remove_record(mapper_table tab, mapper_property_t index,
 
     /* Calculate its index in the records. */
     int i;
+    if (tab->db)
+        mapper_database_unindex_property(tab, rec->index, rec->key);
     if (rec->value) {
         if ((rec->type == 's' || rec->type == 'S') && rec->length > 1) {
             char **vals = (char**)rec->value;
@@ -218,6 +227,8 @@ int mapper_table_remove_record(mapper_table tab, mapper_property_t index,
         free(rec->value);
         rec->value = 0;
     }
+    if (tab->db)
+        mapper_database_index_property(tab, rec->index, rec->key);
 
     rec->index |= PROPERTY_REMOVE;
     return 1;
@@ -470,8 +481,12 @@ int set_record_internal(mapper_table tab, mapper_property_t index,
     if (rec) {
         if (!is_value_different(rec, length, type, value))
             return 0;
+        if (tab->db)
+            mapper_database_unindex_property(tab, index, key);
         update_value_elements(rec, length, type, value);
         tab->dirty = 1;
+        if (tab->db)
+            mapper_database_index_property(tab, index, key);
         return 1;
     }
     else {
@@ -480,6 +495,8 @@ int set_record_internal(mapper_table tab, mapper_property_t index,
         update_value_elements(rec, length, type, value);
         table_sort(tab);
         tab->dirty = 1;
+        if (tab->db)
+            mapper_database_index_property(tab, index, key);
         return 1;
     }
     return 0;
@@ -711,9 +728,13 @@ int mapper_table_set_record_from_atom(mapper_table tab,
     if (rec) {
         if (!is_value_different_osc(rec, atom->length, atom->types, atom->values))
             return 0;
+        if (tab->db)
+            mapper_database_unindex_property(tab, atom->index, atom->key);
         update_value_elements_osc(rec, atom->length, atom->types, atom->values,
                                   rec->flags & INDIRECT);
         tab->dirty = 1;
+        if (tab->db)
+            mapper_database_index_property(tab, atom->index, atom->key);
         return 1;
     }
     else {
@@ -725,6 +746,8 @@ int mapper_table_set_record_from_atom(mapper_table tab,
                                   atom->values, 0);
         table_sort(tab);
         tab->dirty = 1;
+        if (tab->db)
+            mapper_database_index_property(tab, atom->index, atom->key);
         return 1;
     }
     return 0;
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 #include <sys/time.h>
 
 #include "mapper_internal.h"
@@ -13,10 +14,17 @@
 
 static double multiplier = 1.0/((double)(1LL<<32));
 
+// seconds between the NTP epoch (1900) and the Unix epoch (1970)
+#define NTP_EPOCH_OFFSET 2208988800UL
+
 /*! Internal function to get the current time. */
 double mapper_get_current_time()
 {
-#ifdef HAVE_GETTIMEOFDAY
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 0.000000001;
+#elif defined(HAVE_GETTIMEOFDAY)
     struct timeval tv;
     gettimeofday(&tv, NULL);
     return (double)tv.tv_sec + tv.tv_usec / 1000000.0;
@@ -25,9 +33,29 @@ double mapper_get_current_time()
 #endif
 }
 
+/*! Internal function to get a time that is not affected by adjustments to the
+ *  system clock, for measuring intervals. */
+double mapper_get_monotonic_time()
+{
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 0.000000001;
+#else
+    return mapper_get_current_time();
+#endif
+}
+
 void mapper_timetag_now(mapper_timetag_t *timetag)
 {
+#ifdef HAVE_CLOCK_GETTIME
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    timetag->sec = (uint32_t)ts.tv_sec + NTP_EPOCH_OFFSET;
+    timetag->frac = (uint32_t)(((uint64_t)ts.tv_nsec << 32) / 1000000000);
+#else
     lo_timetag_now((lo_timetag*)timetag);
+#endif
 }
 
 double mapper_timetag_difference(const mapper_timetag_t a,
@@ -125,10 +125,72 @@ typedef struct _mapper_table {
     int num_records;
     int alloced;
     char dirty;
+    struct _mapper_database *db;    //!< Database notified of changes, or 0.
+    void *owner;                    //!< The record holding this table.
+    int owner_type;                 //!< The object type of the record.
+    uint32_t serial;                /*!< Order in which the record was added
+                                     *   to the database. */
 } mapper_table_t, *mapper_table;
 
+/**** Lists ****/
+
+/*! Counts of the memory requested for list items and queries, and of the
+ *  allocations actually made to satisfy those requests. */
+typedef struct _mapper_list_allocation_counts {
+    uint64_t blocks;                //!< List items and query headers.
+    uint64_t allocations;           //!< Slabs and unpooled blocks allocated.
+    uint64_t releases;              //!< Empty slabs returned to the system.
+    uint64_t query_contexts;        //!< Query contexts requested.
+    uint64_t query_allocations;     //!< Query contexts allocated.
+} mapper_list_allocation_counts_t;
+
 /**** Database ****/
 
+/*! A property copied into a database snapshot. */
+typedef struct _mapper_snapshot_property {
+    char *key;
+    void *value;
+    int length;
+    char type;
+} mapper_snapshot_property_t;
+
+/*! A device, signal, link or map copied into a database snapshot. */
+typedef struct _mapper_snapshot_record {
+    mapper_id id;
+    int num_props;
+    mapper_snapshot_property_t *props;
+} mapper_snapshot_record_t, *mapper_snapshot_record;
+
+// record types held by a snapshot
+#define SNAPSHOT_DEVICES    0
+#define SNAPSHOT_SIGNALS    1
+#define SNAPSHOT_LINKS      2
+#define SNAPSHOT_MAPS       3
+#define NUM_SNAPSHOT_TYPES  4
+
+/*! An immutable copy of a database's records. */
+typedef struct _mapper_snapshot {
+    int refcount;                   /*!< Readers holding the snapshot, plus
+                                     *   one while it is the latest. */
+    int num_records[NUM_SNAPSHOT_TYPES];
+    mapper_snapshot_record_t *records[NUM_SNAPSHOT_TYPES];  /*!< Sorted by
+                                                             *   id. */
+} mapper_snapshot_t, *mapper_snapshot;
+
+/*! A bounded log of record changes, with at most one pending change for each
+ *  record where possible. */
+typedef struct _mapper_change_feed {
+    struct _mapper_change_feed *next;
+    mapper_change_t *log;       //!< Circular buffer of pending changes.
+    uint32_t *index;            /*!< Hash table of log positions plus one, or
+                                 *   zero for empty slots. */
+    uint32_t head;              //!< Count of changes read or discarded.
+    uint32_t tail;              //!< Count of changes logged.
+    int capacity;               //!< Size of the log, a power of two.
+    int flags;                  //!< Bitflags of object types to record.
+    int resync;                 //!< Non-zero if changes have been lost.
+} mapper_change_feed_t, *mapper_change_feed;
+
 /*! A list of function and context pointers. */
 typedef struct _fptr_list {
     void *f;
@@ -136,23 +198,66 @@ typedef struct _fptr_list {
     struct _fptr_list *next;
 } *fptr_list;
 
+/*! A property test applied by a subscription filter. */
+typedef struct _mapper_subscription_predicate {
+    char *property;
+    void *value;
+    mapper_op op;
+    int length;
+    char type;
+} mapper_subscription_predicate_t;
+
+/*! Limits the signals and maps sent to a subscriber. Signals must match the
+ *  name pattern if there is one, and pass all of the predicates. Maps are
+ *  sent if any of their signals on the subscribed device passes. */
+typedef struct _mapper_subscription_filter {
+    char *pattern;
+    mapper_subscription_predicate_t *predicates;
+    int num_predicates;
+} mapper_subscription_filter_t, *mapper_subscription_filter;
+
 typedef struct _mapper_subscription {
     struct _mapper_subscription *next;
     mapper_device device;
+    mapper_subscription_filter filter;
     int flags;
     uint32_t lease_expiration_sec;
 } *mapper_subscription;
 
+/*! The records of a secondary index whose values share a hash. */
+typedef struct _mapper_index_group {
+    void **records;             //!< Records in database order.
+    uint32_t *serials;          //!< Serial numbers of the records.
+    int num_records;
+    int alloced;
+} mapper_index_group_t;
+
+/*! A secondary index of database records by the value of one property.
+ *  Records are grouped by the hash of their value, and kept in database order
+ *  within each group so that lookups return them in the usual order. Records
+ *  are moved between groups as they are added, removed or modified, and the
+ *  index is only rebuilt when it needs more groups. */
+typedef struct _mapper_index {
+    struct _mapper_index *next;
+    char *name;                 //!< Name of the indexed property.
+    mapper_property_t property; //!< Table index of the property.
+    int type;                   //!< MAPPER_OBJ_DEVICES, _SIGNALS or _MAPS.
+    mapper_index_group_t *groups;   //!< Indexed records grouped by hash.
+    int size;                   //!< Number of groups, a power of two.
+    int num_records;            //!< Number of indexed records.
+    int built;
+} mapper_index_t, *mapper_index;
+
 typedef struct _mapper_database {
     struct _mapper_network *network;
-    mapper_device devices;              //<! List of devices.
-    mapper_signal signals;              //<! List of signals.
-    mapper_map maps;                    //<! List of mappings.
-    mapper_link links;                  //<! List of network links.
-    fptr_list device_callbacks;         //<! List of device record callbacks.
-    fptr_list signal_callbacks;         //<! List of signal record callbacks.
-    fptr_list link_callbacks;           //<! List of link record callbacks.
-    fptr_list map_callbacks;            //<! List of mapping record callbacks.
+    mapper_device devices;              //!< List of devices.
+    mapper_signal signals;              //!< List of signals.
+    mapper_map maps;                    //!< List of mappings.
+    mapper_link links;                  //!< List of network links.
+    fptr_list device_callbacks;         //!< List of device record callbacks.
+    fptr_list signal_callbacks;         //!< List of signal record callbacks.
+    fptr_list link_callbacks;           //!< List of link record callbacks.
+    fptr_list map_callbacks;            //!< List of mapping record callbacks.
 
     /*! Linked-list of autorenewing device subscriptions. */
     mapper_subscription subscriptions;
@@ -165,6 +270,23 @@ typedef struct _mapper_database {
     int timeout_sec;
     uint32_t resource_counter;
 
+    mapper_index indexes;       //!< Secondary indexes of record properties.
+    uint32_t revisions[4];      /*!< Counts of changes to the devices, signals,
+                                 *   links and maps. */
+    uint32_t serial;            //!< Serial number of the latest record.
+    mapper_map *map_index;      //!< Hash buckets of maps indexed by id.
+    int map_index_size;         //!< Number of buckets, a power of two.
+    int num_indexed_maps;
+
+    int transaction_depth;      //!< Nesting depth of map transactions.
+    int transaction_count;      //!< Map requests collected in a transaction.
+
+    mapper_snapshot snapshot;   //!< The latest snapshot, or zero.
+    int publish_snapshots;      //!< Non-zero to publish snapshots when polled.
+    uint32_t snapshot_revision; //!< Revision of the latest snapshot.
+
+    mapper_change_feed change_feeds;    //!< Logs of record changes.
+
     int own_network;
 } mapper_database_t, *mapper_database;
 
@@ -197,6 +319,9 @@ typedef enum {
     NUM_MSG_STRINGS
 } network_message_t;
 
+/*! Size of the table for finding message types by path, a power of two. */
+#define MSG_TABLE_SIZE 64
+
 /*! Function to call when an allocated resource is locked. */
 typedef void mapper_resource_on_lock(struct _mapper_allocated_t *resource);
 
@@ -229,23 +354,57 @@ typedef struct _mapper_sync_timetag_t {
     int message_id;
 } mapper_sync_timetag_t;
 
+#define SYNC_NUM_SAMPLES    8       // size of the clock filter window
+#define SYNC_BURST          8       // number of pings sent on link creation
+#define SYNC_BURST_INTERVAL 0.1     // minimum seconds between burst pings
+#define SYNC_MAX_SKEW       500e-6  // largest plausible clock skew
+#define SYNC_DISPERSION     15e-6   // error bound growth per second
+
+/*! A single round-trip measurement of the offset between two clocks. */
+typedef struct _mapper_sync_sample_t {
+    double time;                    //!< Local monotonic time of the sample.
+    double offset;                  //!< Measured offset (local - remote).
+    double delay;                   //!< Round-trip delay minus remote hold.
+} mapper_sync_sample_t;
+
 typedef struct _mapper_sync_clock_t {
-    double rate;
-    double offset;
-    double latency;
-    double jitter;
+    double skew;                    /*!< Estimated rate of change of the offset
+                                     *   in seconds per second. */
+    double offset;                  /*!< Estimated offset (local - remote) at
+                                     *   monotonic time ref. */
+    double ref;                     //!< Local monotonic time of the estimate.
+    double latency;                 //!< Estimated one-way latency.
+    double jitter;                  //!< RMS residual of the filtered samples.
+    mapper_sync_sample_t samples[SYNC_NUM_SAMPLES];
+    int num_samples;
+    int next_sample;
+    double sent_times[SYNC_NUM_SAMPLES];    /*!< Monotonic send times of the
+                                             *   most recent pings. */
+    double response_time;           /*!< Monotonic time of last ping received
+                                     *   from the remote device. */
     mapper_sync_timetag_t sent;
     mapper_sync_timetag_t response;
+    int burst;                      //!< Number of burst pings remaining.
     int new;
 } mapper_sync_clock_t, *mapper_sync_clock;
 
 typedef struct _mapper_subscriber {
     struct _mapper_subscriber *next;
     lo_address                      address;
+    struct _mapper_subscription_filter *filter;
     uint32_t                        lease_expiration_sec;
     int                             flags;
 } *mapper_subscriber;
 
+/*! A bundle held back while messages are being batched, along with the
+ *  destination it will be sent to. */
+typedef struct _mapper_queued_bundle {
+    lo_bundle bundle;
+    lo_address dest;
+    int message_type;
+    void *message_object;
+} mapper_queued_bundle_t;
+
 /*! A structure that keeps information about a device. */
 typedef struct _mapper_network {
     lo_server_thread bus_server;    /*!< LibLo server thread for the
@@ -257,17 +416,45 @@ typedef struct _mapper_network {
     struct in_addr interface_ip;    /*!< The IP address of interface. */
     struct _mapper_device *device;  /*!< Device that this structure is
                                      *   in charge of. */
-    mapper_database_t database;     /*<! Database of local and remote libmapper
+    mapper_database_t database;     /*!< Database of local and remote libmapper
                                      *   objects. */
     lo_bundle bundle;               /*!< Bundle pointer for sending
                                      *   messages on the multicast bus. */
     lo_address bundle_dest;
+    mapper_queued_bundle_t *queued; /*!< Bundles held back while batching,
+                                     *   one per destination. */
+    int num_queued;
+    int batch_depth;                /*!< Nesting depth of message batches. */
 
     int random_id;                  /*!< Random ID for allocation speedup. */
     int msgs_recvd;                 /*!< Number of messages received on the
                                      *   multicast bus. */
     int message_type;
-    uint32_t next_ping;
+    void *message_object;           /*!< The signal or map described by the
+                                     *   bundle for subscribers, if any
+                                     *   subscriber has a filter. */
+    uint32_t next_ping;             /*!< When link housekeeping is next due. */
+    uint32_t next_sync;             /*!< When /sync is next due on the bus. */
+    int sync_interval;              /*!< Seconds between /sync announcements,
+                                     *   scaled with the number of peers. */
+    float max_sync_rate;            /*!< Target rate of /sync announcements
+                                     *   on the bus, in messages per second. */
+    float num_peers;                /*!< Estimated number of devices
+                                     *   announcing on the bus. */
+    double peer_weight;             /*!< Sum of the intervals announced in
+                                     *   /sync messages since the estimate
+                                     *   was last updated. */
+    double peer_time;               /*!< When the estimate was last updated. */
+    double legacy_peer_time;        /*!< When a /sync without an interval was
+                                     *   last heard, or zero. */
+    double who_deadline;            /*!< When a delayed response to /who is
+                                     *   due, or zero if none is pending. */
+    uint32_t msgs_sent[NUM_MSG_STRINGS + 1];      /*!< Counts of messages of
+                                                   *   each type, plus one for
+                                                   *   any other messages. */
+    uint32_t msgs_received[NUM_MSG_STRINGS + 1];
+    signed char message_table[MSG_TABLE_SIZE];  /*!< Message types by hash
+                                                 *   of their path. */
     uint8_t own_network;            /*! Zero if this network was created
                                      *  automatically by mapper_device_new()
                                      *  or mapper_database_new(), non-zero if
@@ -281,6 +468,14 @@ typedef struct _mapper_network {
 typedef mapper_network_t *mapper_network;
 
 #define TIMEOUT_SEC 10       // timeout after 10 seconds without ping
+#define SYNC_INTERVAL_SEC 5  // minimum seconds between /sync announcements
+#define SYNC_JITTER_SEC 4    // random variation added to the interval
+#define MAX_SYNC_INTERVAL_SEC 60
+// largest interval accepted from a /sync announcement
+#define MAX_ANNOUNCED_SYNC_SEC (MAX_SYNC_INTERVAL_SEC + SYNC_JITTER_SEC)
+#define MAX_SYNC_RATE 20     // default /sync announcements per second on bus
+#define WHO_BACKOFF_PER_PEER_SEC 0.005
+#define MAX_WHO_BACKOFF_SEC 2.0
 
 /**** Signal ****/
 
@@ -289,14 +484,36 @@ typedef mapper_network_t *mapper_network;
  *  of mapping expressions.
  *  @ingroup signals */
 
+/*! Incremental state for a moving sum, mean, minimum or maximum computed
+ *  over a window of an input history.  Minima and maxima are kept using a
+ *  monotonic deque of sample counts for each vector element. */
+typedef struct _mapper_history_window
+{
+    double *sum;                //!< Running sum for each vector element.
+    uint32_t *deque;            //!< Deques of sample counts for min/max.
+    uint32_t *head;             //!< Deque head for each vector element.
+    uint32_t *tail;             //!< Deque tail for each vector element.
+    uint32_t count;             //!< Last history sample accumulated.
+    uint32_t base;              //!< Samples up to this count were not added.
+    int size;                   //!< Window size in samples.
+    int capacity;               //!< Deque capacity, a power of two.
+    int offset;                 //!< Index of the first vector element.
+    int length;                 //!< Number of vector elements.
+    char func;                  //!< Reduction performed over the window.
+} mapper_history_window_t, *mapper_history_window;
+
 typedef struct _mapper_history
 {
     void *value;                /*!< Value of the signal for each sample of
                                  *   stored history. */
     mapper_timetag_t *timetag;  //!< Timetag for each sample of stored history.
+    mapper_history_window windows;  //!< Windowed reductions over this history.
+    int num_windows;            //!< Number of windowed reductions.
+    uint32_t count;             //!< Number of samples written to the history.
     int length;                 //!< Vector length.
     int position;               //!< Current position in the circular buffer.
-    char size;                  //!< History size of the buffer.
+    int size;                   /*!< History size of the buffer, always a
+                                 *   power of two. */
     char type;                  /*!< The type of this signal, specified as an
                                  *   OSC type character. */
 } mapper_history_t, *mapper_history;
@@ -319,6 +536,8 @@ typedef struct _mapper_signal_instance
     int index;                  //!< Index for accessing value history.
     uint8_t has_value;          //!< Indicates whether this instance has a value.
     uint8_t is_active;          //!< Status of this instance.
+    uint8_t is_dirty;           /*!< Indicates a value that has not yet been
+                                 *   passed to the update handler. */
 } mapper_signal_instance_t, *mapper_signal_instance;
 
 typedef struct _mapper_signal_id_map
@@ -359,6 +578,23 @@ typedef struct _mapper_local_signal
     int instance_event_flags;
 
     mapper_signal_group group;
+
+    /*! Large updates which have only partially arrived. */
+    struct _mapper_fragment *fragments;
+
+    /*! Default send policy for maps from this signal. */
+    mapper_send_policy_t send_policy;
+    int has_send_policy;
+
+    /*! When the update handler is called, from mapper_callback_mode. */
+    int callback_mode;
+
+    /*! An optional function to be called once with all updated instances. */
+    void *batch_handler;
+
+    /*! The next signal with instances waiting for the update handler. */
+    struct _mapper_signal *next_dirty;
+    int is_dirty;
 } mapper_local_signal_t, *mapper_local_signal;
 
 /*! A record that describes properties of a signal. */
@@ -392,20 +628,256 @@ struct _mapper_signal {
 
 /**** Router ****/
 
+/*! The messages of an open queue destined for a single link. */
+typedef struct _mapper_link_bundle {
+    lo_bundle bundle;
+    struct _mapper_queue *queue;            //!< The queue owning this bundle.
+    mapper_link link;                       //!< The link to send to.
+    struct _mapper_link_bundle *next;       /*!< The next bundle for the same
+                                             *   link. */
+    struct _mapper_link_bundle *next_in_queue;  /*!< The next bundle in the
+                                                 *   same queue. */
+} mapper_link_bundle_t, *mapper_link_bundle;
+
+/*! A queue of signal updates sharing a timetag, opened with
+ *  mapper_device_start_queue().  Bundles are only created for links that
+ *  receive messages while the queue is open. */
 typedef struct _mapper_queue {
     mapper_timetag_t tt;
-    lo_bundle bundle;
-    struct _mapper_queue *next;
-} *mapper_queue;
+    mapper_device device;
+    mapper_link_bundle bundles;             //!< Bundles to send.
+    struct _mapper_queue *next;             //!< The next open queue.
+} mapper_queue_t, *mapper_queue;
+
+/**** Statistics ****/
+
+/* Histogram buckets are log-linear: each power of two is split into
+ * STATS_SUB_BUCKETS linear sub-buckets, giving a relative error of 1/8. */
+#define STATS_SUB_BUCKET_BITS   3
+#define STATS_SUB_BUCKETS       (1 << STATS_SUB_BUCKET_BITS)
+#define STATS_MAX_BITS          40  // ~18 minutes in nanoseconds
+#define STATS_NUM_BUCKETS       ((STATS_MAX_BITS - STATS_SUB_BUCKET_BITS + 1) \
+                                 * STATS_SUB_BUCKETS)
+
+/*! A histogram of durations in nanoseconds. */
+typedef struct _mapper_histogram {
+    uint64_t counts[STATS_NUM_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max;
+} mapper_histogram_t, *mapper_histogram;
+
+/*! Runtime statistics for a local map or link. Counters are updated with
+ *  relaxed atomic operations so they may be read from another thread. */
+typedef struct _mapper_local_stats {
+    mapper_stats_t counters;
+    mapper_histogram_t timers[NUM_MAPPER_STAT_TIMERS];
+} mapper_local_stats_t, *mapper_local_stats;
+
+/**** Scheduler ****/
+
+/* Updates due within this many seconds are delivered immediately. */
+#define SCHEDULER_TOLERANCE 0.0005
+
+/*! An incoming signal update held until its timetag is due. */
+typedef struct _mapper_scheduled_update {
+    mapper_timetag_t due;           //!< Delivery time in local time.
+    mapper_timetag_t timetag;       //!< Timetag of the update.
+    mapper_signal signal;           //!< The signal receiving the update.
+    int slot;                       /*!< For updates addressed by an alias,
+                                     *   the slot it stands for; the alias
+                                     *   is the first argument of msg.
+                                     *   Otherwise -1. */
+    lo_message msg;                 //!< A copy of the received message.
+} mapper_scheduled_update_t, *mapper_scheduled_update;
+
+/*! A binary min-heap of scheduled updates ordered by due time. */
+typedef struct _mapper_scheduler {
+    mapper_scheduled_update_t *heap;
+    int size;
+    int capacity;
+    int enabled;
+    mapper_scheduled_update dispatching;    /*!< The update being delivered,
+                                             *   or zero. */
+} mapper_scheduler_t, *mapper_scheduler;
+
+/**** Direct delivery ****/
+
+/* Maximum number of updates waiting for a device in the same process. When
+ * the queue is full, updates are sent through the network instead. */
+#define MAPPER_DIRECT_QUEUE_SIZE 4096
+
+/* Number of direct updates taken from the queue under a single lock. */
+#define MAPPER_DIRECT_BATCH_SIZE 32
+
+/*! An update passed directly from a device in the same process. */
+typedef struct _mapper_direct_update {
+    mapper_timetag_t timetag;       //!< Timetag of the update.
+    mapper_signal signal;           /*!< The receiving signal, or zero if it
+                                     *   was removed. */
+    lo_message msg;                 //!< The update message.
+} mapper_direct_update_t, *mapper_direct_update;
+
+/*! A ring buffer of direct updates waiting for the next poll. */
+typedef struct _mapper_direct_queue {
+    mapper_direct_update_t *updates;
+    int head;                       //!< Index of the oldest update.
+    int size;
+    int capacity;
+    /*! Updates taken from the queue for delivery. */
+    mapper_direct_update_t batch[MAPPER_DIRECT_BATCH_SIZE];
+    int batch_head;                     //!< Next update in the batch.
+    int batch_size;
+    mapper_direct_update dispatching;   /*!< The update being delivered, or
+                                         *   zero. */
+} mapper_direct_queue_t, *mapper_direct_queue;
+
+/**** Shared memory ****/
+
+/* Size in bytes of the ring buffer each local device receives updates
+ * through from devices on the same host. */
+#define MAPPER_SHM_SIZE 1048576
+
+/*! A mapping of a device's shared memory ring buffer, either by the device
+ *  receiving through it or by a link sending to it. */
+typedef struct _mapper_shm {
+    struct _mapper_shm_header *header;  //!< The mapped header and ring.
+    size_t size;                        //!< Size of the mapping in bytes.
+    char *name;                         //!< Name of the shared memory object.
+    int owner;                          /*!< Non-zero if this mapping created
+                                         *   the object. */
+    void *buffer;                       //!< Scratch space for reading.
+    size_t buffer_size;
+    char *pending;                      /*!< Records waiting for space in the
+                                         *   ring, in the same format. */
+    size_t pending_len;
+    size_t pending_size;
+} mapper_shm_t, *mapper_shm;
+
+/**** Stream transport ****/
+
+/* Bytes waiting to be written to a link's stream before further updates are
+ * dropped. */
+#define MAPPER_STREAM_MAX_BACKLOG   1048576
+
+/* Waiting frames are written as soon as this many bytes have accumulated,
+ * otherwise at the end of each poll. */
+#define MAPPER_STREAM_BATCH_SIZE    65536
+
+// largest frame accepted from a stream connection
+#define MAPPER_STREAM_MAX_FRAME     4194304
+
+/* Bytes read from each stream connection per poll. Anything further is left
+ * in the socket for the next poll, so one busy sender cannot stall the
+ * device. */
+#define MAPPER_STREAM_MAX_READ      262144
+
+// maximum number of incoming stream connections per device
+#define MAPPER_STREAM_MAX_INPUTS    64
+
+// seconds to wait before reopening a stream connection that failed
+#define MAPPER_STREAM_RETRY_SEC     0.5
+
+/*! A length-prefixed bundle waiting to be written to a stream. */
+typedef struct _mapper_stream_frame {
+    struct _mapper_stream_frame *next;
+    size_t length;                  //!< Length including the prefix.
+    char data[0];
+} mapper_stream_frame_t, *mapper_stream_frame;
+
+/*! An outgoing stream connection carrying updates for a link. */
+typedef struct _mapper_stream {
+    int fd;
+    int connected;                  /*!< Zero while the connection is still
+                                     *   being established. */
+    mapper_stream_frame head;       //!< The oldest waiting frame.
+    mapper_stream_frame tail;       //!< The most recent waiting frame.
+    size_t offset;                  /*!< Bytes of the oldest frame already
+                                     *   written. */
+    size_t backlog;                 //!< Total bytes waiting to be written.
+} mapper_stream_t, *mapper_stream;
+
+/*! An incoming stream connection accepted by a device. */
+typedef struct _mapper_stream_input {
+    struct _mapper_stream_input *next;
+    int fd;
+    char *buffer;                   //!< Bytes received but not dispatched.
+    size_t size;                    //!< Allocated size of the buffer.
+    size_t length;                  //!< Bytes held in the buffer.
+} mapper_stream_input_t, *mapper_stream_input;
+
+/*! The socket a device accepts stream connections on, and the connections
+ *  it has accepted. */
+typedef struct _mapper_stream_server {
+    int fd;                         //!< Listening socket, or -1.
+    int num_inputs;
+    mapper_stream_input inputs;
+} mapper_stream_server_t, *mapper_stream_server;
+
+/**** Aliases ****/
+
+/* Updates addressed by an alias are sent to this path, with the alias as the
+ * first argument. The alias is assigned by the receiving device and stands
+ * for the destination signal path and the map slot. */
+#define MAPPER_ALIAS_PATH       "/@"
+
+// short property keys used in aliased updates
+#define MAPPER_ALIAS_INSTANCE   "@i"
+#define MAPPER_ALIAS_FRAGMENT   "@f"
+
+/*! The map slot an alias received by a device stands for. */
+typedef struct _mapper_alias {
+    struct _mapper_map *map;        //!< The map, or zero if unused.
+    struct _mapper_signal *signal;  //!< The destination signal.
+    int slot;                       //!< The source slot id.
+} mapper_alias_t, *mapper_alias;
+
+/**** Fragmentation ****/
+
+/* Updates with more elements than this are sent as several messages. */
+#define MAPPER_FRAGMENT_LEN 1024
+
+/* Fragmented updates with more elements than this are not reassembled. */
+#define MAPPER_MAX_FRAGMENTED_LEN (MAPPER_MAX_VECTOR_LEN * 16)
+
+/*! A large signal update being reassembled from its fragments. */
+typedef struct _mapper_fragment {
+    struct _mapper_fragment *next;
+    mapper_timetag_t timetag;       //!< Timetag shared by all fragments.
+    mapper_link link;               /*!< The link the fragments arrived on,
+                                     *   or zero if unknown. */
+    mapper_id global_id;            //!< Global instance id, or zero.
+    int slot;                       //!< Slot index, or -1 if none.
+    int length;                     //!< Number of elements in the update.
+    int received;                   //!< Number of elements received so far.
+    char *types;                    /*!< Type of each element, or zero if it
+                                     *   has not been received yet. */
+    lo_arg *values;                 //!< Value of each element.
+} mapper_fragment_t, *mapper_fragment;
 
 /*! The link structure is a linked list of links each associated
  *  with a destination address that belong to a controller device. */
 typedef struct _mapper_local_link {
     lo_address admin_addr;              //!< Network address of remote endpoint
     lo_address data_addr;               //!< Network address of remote endpoint
-    mapper_queue queues;                /*!< Linked-list of message queues
-                                         *   waiting to be sent. */
+    mapper_link_bundle bundles;         /*!< Linked-list of bundles belonging
+                                         *   to open queues. */
     mapper_sync_clock_t clock;
+    mapper_local_stats stats;           //!< Runtime statistics, or NULL.
+    struct _mapper_device *peer;        /*!< The remote device if it belongs
+                                         *   to this process, or zero. */
+    mapper_id peer_id;                  /*!< Id of the peer device, checked
+                                         *   before each direct delivery. */
+    mapper_shm shm;                     /*!< The remote device's shared memory
+                                         *   if it is on the same host, or
+                                         *   zero. */
+    mapper_stream stream;               /*!< Stream connection carrying
+                                         *   updates if selected by the
+                                         *   "transport" property, or zero. */
+    int use_stream;                     /*!< Non-zero if the "transport"
+                                         *   property selects a stream. */
+    double stream_retry;                /*!< When a failed stream connection
+                                         *   may be opened again. */
 } *mapper_local_link;
 
 typedef struct _mapper_link {
@@ -437,11 +909,33 @@ typedef struct _mapper_link {
 #define STATUS_READY        0x0F
 #define STATUS_ACTIVE       0x1F
 
+/*! Kernels used for boundary processing. */
+#define BOUNDARY_NONE       0x00    //!< No boundary actions apply.
+#define BOUNDARY_CLAMP      0x01    //!< Only clamping, or no action, applies.
+#define BOUNDARY_GENERIC    0x02    //!< Mute, fold or wrap may apply.
+
+/*! Boundary processing compiled from a slot's range and boundary actions,
+ *  so that it does not need to be derived again for every update. */
+typedef struct _mapper_boundary {
+    double *lo;                 //!< Lower bound for each element.
+    double *hi;                 //!< Upper bound for each element.
+    void *typed_lo;             //!< Lower clamping bounds in the signal type.
+    void *typed_hi;             //!< Upper clamping bounds in the signal type.
+    char *action_lo;            //!< Action below the lower bound.
+    char *action_hi;            //!< Action above the upper bound.
+    int length;                 //!< Vector length.
+    char type;                  //!< Signal type.
+    char kernel;                //!< Kernel to use for this slot.
+    char compiled;              /*!< Zero if the slot range, boundary actions
+                                 *   or signal type changed since compiling. */
+} mapper_boundary_t, *mapper_boundary;
+
 typedef struct _mapper_local_slot {
     // each slot can point to local signal or a remote link structure
     struct _mapper_router_signal *router_sig;    //!< Parent signal if local
     mapper_history history;                 /*!< Array of value histories for
                                              *   each signal instance. */
+    mapper_boundary_t boundary;             //!< Compiled boundary processing.
     int history_size;                       //!< History size.
     char status;
 } mapper_local_slot_t, *mapper_local_slot;
@@ -460,6 +954,9 @@ typedef struct _mapper_slot {
     void *maximum;                      //!< Array of maxima, or NULL for N/A
     int id;                             //!< Slot ID
     int num_instances;
+    int alias;                          /*!< Alias assigned by the destination
+                                         *   device for updates from this
+                                         *   slot, or 0. */
 
     mapper_boundary_action bound_max;   //!< Operation for exceeded upper bound.
     mapper_boundary_action bound_min;   //!< Operation for exceeded lower bound.
@@ -470,6 +967,29 @@ typedef struct _mapper_slot {
     int calibrating;                    //!< >1 if calibrating, 0 otherwise
 } mapper_slot_t, *mapper_slot;
 
+/*! Updates of a convergent map held until every source has arrived. */
+typedef struct _mapper_converge_state {
+    mapper_timetag_t timetag;       //!< Timetag of the latest source update.
+    mapper_timetag_t deadline;      /*!< Time at which the map is evaluated
+                                     *   even if sources are missing. */
+    mapper_id global_id;            //!< Global instance id, or zero.
+    int id_map_index;               //!< Index of the destination id map.
+    unsigned int arrived;           //!< Bit flags of updated source slots.
+} mapper_converge_state_t, *mapper_converge_state;
+
+/*! Send policy state for one instance of a local map. */
+typedef struct _mapper_send_state {
+    double *last_value;             //!< Last value sent, for the deadband.
+    void *pending_value;            //!< Value held for sending, if any.
+    char *pending_types;            //!< Typestring of the held value.
+    struct _mapper_id_map *id_map;  //!< Instance id map of the held value.
+    mapper_timetag_t pending_tt;    //!< Timetag of the held value.
+    mapper_timetag_t last_sent;     //!< Time the last update was sent.
+    int length;                     //!< Vector length of the buffers.
+    char has_sent;                  //!< Non-zero once an update was sent.
+    char pending;                   //!< Non-zero if a value is held.
+} mapper_send_state_t, *mapper_send_state;
+
 /*! The mapper_local_map structure is a linked list of mappings for a given
  *  signal.  Each signal can be associated with multiple inputs or outputs. This
  *  structure only contains state information used for performing mapping, the
@@ -482,6 +1002,30 @@ typedef struct _mapper_local_map {
     int num_expr_vars;                  //!< Number of user variables.
     int num_var_instances;
 
+    mapper_local_stats stats;           //!< Runtime statistics, or NULL.
+
+    double *scale;                      //!< Per-element scale in linear mode.
+    double *offset;                     //!< Per-element offset in linear mode.
+    int linear_length;                  //!< Number of elements scaled.
+    int linear_stale;                   /*!< Non-zero if the expression string
+                                         *   lags behind the linear scaling. */
+
+    mapper_send_policy_t send_policy;   //!< Send policy for this map.
+    int has_send_policy;                /*!< Zero if the source signal's
+                                         *   policy applies instead. */
+    mapper_send_state send_states;      //!< Send policy state per instance.
+    int num_send_states;
+
+    int convergence;                    //!< Convergence mode of the map.
+    double convergence_timeout;         /*!< Time in seconds to wait for the
+                                         *   remaining sources. */
+    mapper_converge_state converge_states;  /*!< Convergence state per
+                                             *   destination instance. */
+    int num_converge_states;
+    struct _mapper_map *next_converging;    /*!< Next map in the device list of
+                                             *   maps awaiting sources. */
+    int is_converging;
+
     uint8_t is_local_only;
     uint8_t one_source;
 } mapper_local_map_t, *mapper_local_map;
@@ -512,6 +1056,10 @@ typedef struct _mapper_map {
     mapper_location process_location;
     int status;
     int version;
+
+    struct _mapper_map *next_by_id;     //!< Next map in the same id bucket.
+    mapper_id indexed_id;               //!< Id under which map is indexed.
+    int is_indexed;
 } mapper_map_t, *mapper_map;
 
 /*! The router_signal is a linked list containing a signal and a list of
@@ -533,6 +1081,8 @@ typedef struct _mapper_router_signal {
 typedef struct _mapper_router {
     struct _mapper_device *device;  //!< The device associated with this link.
     mapper_router_signal signals;   //!< The list of mappings for each signal.
+    int num_pending;                /*!< Number of map instances holding a
+                                     *   value until the next poll. */
 } mapper_router_t, *mapper_router;
 
 /*! The instance ID map is a linked list of int32 instance ids for coordinating
@@ -580,6 +1130,44 @@ typedef struct _mapper_local_device {
 
     int own_network;
     int num_signal_groups;
+    int stats_flags;        /* Bitflags from mapper_stats_flags. */
+
+    mapper_scheduler_t scheduler;   /*!< Incoming updates held for delivery at
+                                     *   their timetag. */
+
+    mapper_direct_queue_t direct;   /*!< Updates passed directly from devices
+                                     *   in the same process. */
+    int direct_delivery;            /*!< Non-zero to pass updates directly to
+                                     *   devices in the same process. */
+    struct _mapper_device *next_in_process; /*!< The next local device in
+                                             *   this process. */
+    mapper_shm shm;                 /*!< Shared memory for receiving updates
+                                     *   from devices on the same host. */
+    mapper_stream_server_t streams; /*!< Stream connections for receiving
+                                     *   updates. */
+
+    mapper_alias aliases;           /*!< Map slots indexed by the aliases
+                                     *   assigned to them, less one. */
+    int num_aliases;
+
+    mapper_fragment reassembled;    /*!< The reassembled update being
+                                     *   delivered, or zero. */
+
+    mapper_queue queues;            /*!< Open queues, most recently started
+                                     *   first. */
+
+    struct _mapper_signal *dirty_signals;   /*!< Signals with coalesced
+                                             *   updates waiting for the next
+                                             *   poll. */
+
+    struct _mapper_map *converging_maps;    /*!< Convergent maps waiting for
+                                             *   the remaining sources. */
+
+    /* Adjustment applied to this device's clock, used for testing clock
+     * synchronisation within a single process. */
+    double clock_adjust_offset;
+    double clock_adjust_skew;
+    double clock_adjust_ref;
 } mapper_local_device_t, *mapper_local_device;
 
 
@@ -608,6 +1196,7 @@ struct _mapper_device {
     int num_outgoing_maps;      //!< Number of associated outgoing maps.
     int version;                //!< Reported device state version.
     int status;
+    int sync_interval;          //!< Announced seconds between syncs.
 
     uint8_t subscribed;
 };
@@ -652,6 +1241,8 @@ typedef struct _mapper_message
 {
     mapper_message_atom_t *atoms;
     int num_atoms;
+    int size;                       //!< Allocated number of atoms.
+    struct _mapper_message *next;   //!< Next message in the free pool.
 } *mapper_message;
 
 #endif // __MAPPER_TYPES_H__
@@ -0,0 +1,279 @@
+
+#include <mapper/mapper.h>
+#include <lo/lo.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_INPUTS 100
+#define NUM_UPDATES 2000
+#define BURST_SIZE 50
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_map map = 0;
+
+char path[128];
+int received = 0;
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value)
+        ++received;
+}
+
+int setup_devices()
+{
+    int i;
+    char name[128];
+
+    source = mapper_device_new("testalias-send", 0, 0);
+    destination = mapper_device_new("testalias-recv", 0, 0);
+    if (!source || !destination)
+        return 1;
+
+    // aliases are not used for updates passed directly between devices
+    mapper_device_set_direct_delivery(source, 0);
+    mapper_device_set_stats(source, MAPPER_STATS_COLLECT);
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'f', 0, 0,
+                                              0);
+
+    // many inputs with long names, all handled by the same server
+    for (i = 0; i < NUM_INPUTS; i++) {
+        snprintf(name, 128, "controller/section_%02d/parameter/value_%03d",
+                 i / 10, i);
+        recvsig = mapper_device_add_input_signal(destination, name, 1, 'f', 0,
+                                                 0, 0, insig_handler, 0);
+    }
+    if (!sendsig || !recvsig)
+        return 1;
+    snprintf(path, 128, "/%s", mapper_signal_name(recvsig));
+    eprintf("Devices created.\n");
+    return 0;
+}
+
+void cleanup_devices()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(source, block_ms);
+    mapper_device_poll(destination, 0);
+}
+
+/* Get the mean size in bytes of the updates sent by the map. */
+double bytes_per_update()
+{
+    mapper_stats_t stats;
+    if (mapper_map_stats(map, &stats) || !stats.sent)
+        return 0;
+    return (double)stats.bytes_sent / stats.sent;
+}
+
+int setup_map()
+{
+    int i;
+    float value = 0;
+
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        poll_all(25);
+    }
+
+    // process at the destination so that updates identify their slot
+    map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_set_process_location(map, MAPPER_LOC_DESTINATION);
+    mapper_map_push(map);
+    while (!done && !mapper_map_ready(map))
+        poll_all(10);
+
+    // the alias arrives with the destination's /mapped message
+    for (i = 0; i < 200 && !done; i++) {
+        mapper_map_reset_stats(map);
+        mapper_signal_update(sendsig, &value, 1, MAPPER_NOW);
+        poll_all(10);
+        if (bytes_per_update() > 0 && bytes_per_update() < 32)
+            return 0;
+    }
+    return 1;
+}
+
+/* Build an update in the form used without an alias. */
+lo_message long_form(float value)
+{
+    lo_message msg = lo_message_new();
+    lo_message_add_float(msg, value);
+    lo_message_add_string(msg, "@slot");
+    lo_message_add_int32(msg,
+                         mapper_slot_index(mapper_map_slot(map,
+                                                           MAPPER_LOC_SOURCE,
+                                                           0)));
+    return msg;
+}
+
+/* Wait for the destination to handle the expected number of updates, and
+ * return the time spent polling it. */
+double receive(int expected)
+{
+    int tries;
+    double start = current_time();
+    for (tries = 0; tries < 1000 && received < expected; tries++)
+        mapper_device_poll(destination, 1);
+    return current_time() - start;
+}
+
+/* Send bursts of updates either through the map, which addresses them by
+ * alias, or directly in the long form, and report the time the destination
+ * spent receiving them. */
+double send_updates(int aliased)
+{
+    int i, j;
+    float value;
+    double elapsed = 0;
+    char port[16];
+
+    snprintf(port, 16, "%d", mapper_device_port(destination));
+    lo_address a = lo_address_new("localhost", port);
+    lo_server s = lo_server_new(0, 0);
+    received = 0;
+
+    for (i = 0; i < NUM_UPDATES / BURST_SIZE && !done; i++) {
+        for (j = 0; j < BURST_SIZE; j++) {
+            value = i * BURST_SIZE + j;
+            if (aliased) {
+                mapper_signal_update(sendsig, &value, 1, MAPPER_NOW);
+            }
+            else {
+                lo_message msg = long_form(value);
+                lo_send_message_from(a, s, path, msg);
+                lo_message_free(msg);
+            }
+        }
+        if (aliased)
+            mapper_device_poll(source, 0);
+        usleep(1000);
+        elapsed += receive((i + 1) * BURST_SIZE);
+    }
+    lo_server_free(s);
+    lo_address_free(a);
+    return elapsed;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testalias.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_devices()) {
+        eprintf("Error initializing devices.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_map()) {
+        eprintf("Map was not assigned an alias.\n");
+        result = 1;
+        goto done;
+    }
+
+    lo_message msg = long_form(0);
+    int long_bytes = lo_message_length(msg, path);
+    lo_message_free(msg);
+    double alias_bytes = bytes_per_update();
+    eprintf("bytes per update: %d long form, %.0f aliased (%.0f%% saved)\n",
+            long_bytes, alias_bytes, (1 - alias_bytes / long_bytes) * 100);
+
+    double long_time = send_updates(0);
+    if (received != NUM_UPDATES) {
+        eprintf("Received %d of %d long form updates.\n", received,
+                NUM_UPDATES);
+        result = 1;
+    }
+    double alias_time = send_updates(1);
+    if (received != NUM_UPDATES) {
+        eprintf("Received %d of %d aliased updates.\n", received,
+                NUM_UPDATES);
+        result = 1;
+    }
+    eprintf("receive time per update: %.2f us long form, %.2f us aliased\n",
+            long_time * 1000000. / NUM_UPDATES,
+            alias_time * 1000000. / NUM_UPDATES);
+
+  done:
+    cleanup_devices();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,244 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_OUTPUTS 100
+#define NUM_INPUTS 100
+#define NUM_MAPS (NUM_OUTPUTS * NUM_INPUTS)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_database db = 0;
+mapper_signal sendsig[NUM_OUTPUTS];
+mapper_signal recvsig[NUM_INPUTS];
+
+int setup_devices()
+{
+    int i;
+    char name[32];
+    source = mapper_device_new("testbulkmaps-send", 0, 0);
+    destination = mapper_device_new("testbulkmaps-recv", 0, 0);
+    if (!source || !destination)
+        return 1;
+    for (i = 0; i < NUM_OUTPUTS; i++) {
+        snprintf(name, 32, "outsig%d", i);
+        sendsig[i] = mapper_device_add_output_signal(source, name, 1, 'f', 0,
+                                                     0, 0);
+    }
+    for (i = 0; i < NUM_INPUTS; i++) {
+        snprintf(name, 32, "insig%d", i);
+        recvsig[i] = mapper_device_add_input_signal(destination, name, 1, 'f',
+                                                    0, 0, 0, 0, 0);
+    }
+    eprintf("Devices created with %d outputs and %d inputs.\n", NUM_OUTPUTS,
+            NUM_INPUTS);
+    return 0;
+}
+
+void cleanup_devices()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 0);
+    mapper_database_poll(db, block_ms);
+}
+
+int num_ready_maps()
+{
+    int count = 0;
+    mapper_map *maps = mapper_database_maps(db);
+    while (maps) {
+        if (mapper_map_ready(*maps))
+            ++count;
+        maps = mapper_map_query_next(maps);
+    }
+    return count;
+}
+
+/* Poll until the database and both devices hold the expected number of active
+ * maps, or give up after two minutes. */
+int wait_maps(int expected)
+{
+    int i;
+    for (i = 0; i < 12000 && !done; i++) {
+        poll_all(10);
+        if (mapper_device_num_maps(source, MAPPER_DIR_OUTGOING) == expected
+            && mapper_device_num_maps(destination, MAPPER_DIR_INCOMING) == expected
+            && mapper_database_num_maps(db) == expected
+            && num_ready_maps() == expected)
+            return 0;
+    }
+    eprintf("Expected %d maps, found %d.\n", expected, num_ready_maps());
+    return 1;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination)
+                      && mapper_database_num_signals(db, MAPPER_DIR_ANY)
+                         >= NUM_OUTPUTS + NUM_INPUTS)) {
+        poll_all(10);
+    }
+}
+
+double elapsed(mapper_timetag_t *start)
+{
+    mapper_timetag_t now;
+    mapper_timetag_now(&now);
+    return mapper_timetag_difference(now, *start);
+}
+
+int create_maps()
+{
+    int i, j, count;
+    mapper_timetag_t start;
+    mapper_timetag_now(&start);
+
+    mapper_database_begin_transaction(db);
+    for (i = 0; i < NUM_OUTPUTS; i++) {
+        for (j = 0; j < NUM_INPUTS; j++) {
+            mapper_map map = mapper_map_new(1, &sendsig[i], 1, &recvsig[j]);
+            mapper_map_set_mode(map, MAPPER_MODE_LINEAR);
+            mapper_map_push(map);
+        }
+    }
+    count = mapper_database_commit_transaction(db);
+    eprintf("Committed %d map requests in %f seconds.\n", count,
+            elapsed(&start));
+    if (count != NUM_MAPS)
+        return 1;
+
+    if (wait_maps(NUM_MAPS))
+        return 1;
+    eprintf("Established %d maps in %f seconds.\n", NUM_MAPS, elapsed(&start));
+    return 0;
+}
+
+int release_maps()
+{
+    int count;
+    mapper_timetag_t start;
+    mapper_timetag_now(&start);
+
+    mapper_database_begin_transaction(db);
+    mapper_map *maps = mapper_database_maps(db);
+    while (maps) {
+        mapper_map_release(*maps);
+        maps = mapper_map_query_next(maps);
+    }
+    count = mapper_database_commit_transaction(db);
+    eprintf("Committed %d map removals in %f seconds.\n", count,
+            elapsed(&start));
+    if (count != NUM_MAPS)
+        return 1;
+
+    if (wait_maps(0))
+        return 1;
+    eprintf("Released %d maps in %f seconds.\n", NUM_MAPS, elapsed(&start));
+    return 0;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testbulkmaps.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_devices()) {
+        eprintf("Error initializing devices.\n");
+        result = 1;
+        goto done;
+    }
+
+    db = mapper_database_new(0, MAPPER_OBJ_ALL);
+    if (!db) {
+        eprintf("Error initializing database.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (create_maps()) {
+        eprintf("Error creating maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (release_maps()) {
+        eprintf("Error releasing maps.\n");
+        result = 1;
+        goto done;
+    }
+
+  done:
+    if (db)
+        mapper_database_free(db);
+    cleanup_devices();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
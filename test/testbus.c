@@ -0,0 +1,206 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_DEVICES 30
+#define SYNC_RATE 3         // target /sync announcements per second on the bus
+#define SETTLE_SEC 10
+#define WINDOW_SEC 12
+#define NUM_WHO 5
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+int num_expired = 0;
+
+mapper_device devices[NUM_DEVICES];
+mapper_database db = 0;
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void on_device(mapper_database db, mapper_device dev, mapper_record_event e,
+               const void *user)
+{
+    if (e == MAPPER_EXPIRED)
+        ++num_expired;
+}
+
+void poll_all()
+{
+    int i;
+    for (i = 0; i < NUM_DEVICES; i++)
+        mapper_device_poll(devices[i], 0);
+    mapper_database_poll(db, 0);
+    usleep(5000);
+}
+
+void poll_for(double seconds)
+{
+    double end = current_time() + seconds;
+    while (!done && current_time() < end)
+        poll_all();
+}
+
+int all_ready()
+{
+    int i;
+    for (i = 0; i < NUM_DEVICES; i++) {
+        if (!mapper_device_ready(devices[i]))
+            return 0;
+    }
+    return 1;
+}
+
+/* Get the total number of messages of a kind sent by all devices. */
+int count_sent(const char *path)
+{
+    int i, sent, total = 0;
+    for (i = 0; i < NUM_DEVICES; i++) {
+        mapper_network_message_counts(mapper_device_network(devices[i]), path,
+                                      &sent, 0);
+        total += sent;
+    }
+    return total;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testbus.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    memset(devices, 0, sizeof(devices));
+    db = mapper_database_new(0, MAPPER_OBJ_DEVICES);
+    if (!db) {
+        eprintf("Error creating database.\n");
+        result = 1;
+        goto done;
+    }
+    mapper_database_add_device_callback(db, on_device, 0);
+
+    for (i = 0; i < NUM_DEVICES; i++) {
+        if (!(devices[i] = mapper_device_new("testbus", 0, 0))) {
+            eprintf("Error creating device %d.\n", i);
+            result = 1;
+            goto done;
+        }
+        mapper_network_set_max_sync_rate(mapper_device_network(devices[i]),
+                                         SYNC_RATE);
+    }
+    while (!done && !all_ready())
+        poll_all();
+    eprintf("%d devices ready.\n", NUM_DEVICES);
+
+    // let the devices estimate the number of peers
+    poll_for(SETTLE_SEC);
+
+    int syncs = count_sent("/sync");
+    poll_for(WINDOW_SEC);
+    syncs = count_sent("/sync") - syncs;
+
+    /* Without adapting, each device would announce itself about every 6.5
+     * seconds. With the target rate, the interval should be near 10. */
+    int min_interval = 0;
+    for (i = 0; i < NUM_DEVICES; i++) {
+        int interval = mapper_network_sync_interval(
+            mapper_device_network(devices[i]));
+        if (!min_interval || interval < min_interval)
+            min_interval = interval;
+    }
+    eprintf("%d /sync messages in %d seconds (%.1f per second), minimum "
+            "interval %d seconds.\n", syncs, WINDOW_SEC,
+            (float)syncs / WINDOW_SEC, min_interval);
+    if (min_interval <= 5 || syncs > NUM_DEVICES * WINDOW_SEC / 8) {
+        eprintf("Announce intervals did not adapt to the number of peers.\n");
+        result = 1;
+    }
+
+    // many /who requests at once should only be answered once per device
+    syncs = count_sent("/sync");
+    for (i = 0; i < NUM_WHO; i++)
+        mapper_database_request_devices(db);
+    poll_for(3);
+    syncs = count_sent("/sync") - syncs;
+    eprintf("%d /sync messages in response to %d /who requests.\n", syncs,
+            NUM_WHO);
+    if (syncs > NUM_DEVICES * 2) {
+        eprintf("Redundant /who responses were not suppressed.\n");
+        result = 1;
+    }
+
+    if (num_expired || mapper_database_num_devices(db) != NUM_DEVICES) {
+        eprintf("Database has %d of %d devices after %d expired.\n",
+                mapper_database_num_devices(db), NUM_DEVICES, num_expired);
+        result = 1;
+    }
+
+    int sent, received;
+    mapper_network_message_counts(mapper_device_network(devices[0]), 0, &sent,
+                                  &received);
+    eprintf("First device sent %d and received %d admin messages.\n", sent,
+            received);
+
+    while (!terminate && !done)
+        poll_all();
+
+  done:
+    for (i = 0; i < NUM_DEVICES; i++) {
+        if (devices[i])
+            mapper_device_free(devices[i]);
+    }
+    if (db)
+        mapper_database_free(db);
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,268 @@
+
+#include "../src/mapper_internal.h"
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define INJECTED_OFFSET 0.5
+#define INJECTED_SKEW   200e-6
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+
+/* Feed the estimator synthetic samples from a remote clock running 100 ppm
+ * fast, with randomly asymmetric network delays. */
+int test_estimator()
+{
+    mapper_sync_clock_t clock;
+    int i, result = 0;
+    double base = mapper_get_monotonic_time(), error;
+
+    memset(&clock, 0, sizeof(clock));
+    clock.new = 1;
+
+    for (i = 0; i < SYNC_NUM_SAMPLES; i++) {
+        double time = base - 60 + i * 60. / (SYNC_NUM_SAMPLES - 1);
+        double offset = 0.25 - 100e-6 * (time - base);
+        double delay = 0.002 + (rand() % 1000) * 0.000003;
+        double asymmetry = ((rand() % 1000) * 0.001 - 0.5) * 0.5
+                           * (delay - 0.002);
+        mapper_sync_clock_add_sample(&clock, time, offset + asymmetry, delay);
+    }
+
+    double offset = mapper_sync_clock_offset(&clock, &error);
+    eprintf("estimator: offset %f (error %f), skew %g\n", offset, error,
+            clock.skew);
+    if (fabs(clock.skew + 100e-6) > 20e-6) {
+        eprintf("Estimated skew is incorrect.\n");
+        result = 1;
+    }
+    if (error < 0 || fabs(offset - 0.25) > error + 0.001) {
+        eprintf("Estimated offset is incorrect.\n");
+        result = 1;
+    }
+    return result;
+}
+
+int setup_source(char *iface)
+{
+    source = mapper_device_new("testsend", 0, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    // run the source clock fast so that offset estimation can be checked
+    mapper_device_set_clock_adjustment(source, INJECTED_OFFSET, INJECTED_SKEW);
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'f', 0, 0, 0);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+int setup_destination(char *iface)
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'f', 0,
+                                             0, 0, 0, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int setup_maps()
+{
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // Wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+        usleep(500 * 1000);
+    }
+}
+
+void loop()
+{
+    eprintf("Polling device..\n");
+    int i = 0;
+    while ((!terminate || i < 30) && !done) {
+        mapper_device_poll(source, 50);
+        mapper_device_poll(destination, 50);
+        i++;
+    }
+}
+
+int check_offset()
+{
+    mapper_link link = mapper_device_link_by_remote_device(destination, source);
+    mapper_timetag_t src_now, dst_now;
+    double offset, error;
+
+    if (!link) {
+        eprintf("Could not retrieve link.\n");
+        return 1;
+    }
+    if (mapper_link_clock_offset(link, &offset, &error)) {
+        eprintf("Clock offset was not estimated.\n");
+        return 1;
+    }
+
+    mapper_device_now(source, &src_now);
+    mapper_device_now(destination, &dst_now);
+    double expected = mapper_timetag_difference(dst_now, src_now);
+
+    eprintf("link offset %f (error %f), expected %f\n", offset, error,
+            expected);
+    if (error > 0.01) {
+        eprintf("Error bound is too large.\n");
+        return 1;
+    }
+    if (fabs(offset - expected) > error + 0.002) {
+        eprintf("Estimated offset is incorrect.\n");
+        return 1;
+    }
+    return 0;
+}
+
+void ctrlc(int signal)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    char *iface = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testclock.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    case '-':
+                        if (strcmp(argv[i], "--iface")==0 && argc>i+1) {
+                            i++;
+                            iface = argv[i];
+                            j = 1;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (test_estimator()) {
+        result = 1;
+        goto done;
+    }
+
+    if (setup_destination(iface)) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source(iface)) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error initializing maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    loop();
+
+    result = check_offset();
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
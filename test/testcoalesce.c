@@ -0,0 +1,279 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_INSTANCES 5
+#define NUM_ROUNDS 10
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+
+int updates = 0;
+int batches = 0;
+int batched = 0;
+float last_values[NUM_INSTANCES];
+
+int setup_source()
+{
+    source = mapper_device_new("testsend", 0, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    sendsig = mapper_device_add_signal(source, MAPPER_DIR_OUTGOING,
+                                       NUM_INSTANCES, "outsig", 1, 'f', 0, 0,
+                                       0, 0, 0);
+    if (!sendsig)
+        goto error;
+
+    eprintf("Output signal 'outsig' registered with %d instances.\n",
+            NUM_INSTANCES);
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (!value)
+        return;
+    eprintf("handler: instance %d got %f\n", (int)instance, *(float*)value);
+    if (instance >= 0 && instance < NUM_INSTANCES)
+        last_values[instance] = *(float*)value;
+    updates++;
+}
+
+void batch_handler(mapper_signal sig, int num_instances, mapper_id *instances)
+{
+    int i;
+    eprintf("batch handler: %d instances\n", num_instances);
+    for (i = 0; i < num_instances; i++) {
+        const float *value = mapper_signal_instance_value(sig, instances[i], 0);
+        if (value && instances[i] >= 0 && instances[i] < NUM_INSTANCES)
+            last_values[instances[i]] = *value;
+    }
+    batched += num_instances;
+    batches++;
+}
+
+int setup_destination()
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    recvsig = mapper_device_add_signal(destination, MAPPER_DIR_INCOMING,
+                                       NUM_INSTANCES, "insig", 1, 'f', 0, 0,
+                                       0, insig_handler, 0);
+    if (!recvsig)
+        goto error;
+
+    eprintf("Input signal 'insig' registered with %d instances.\n",
+            NUM_INSTANCES);
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int setup_maps()
+{
+    int i = 0;
+
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+        if (i++ > 100)
+            return 1;
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+        usleep(500 * 1000);
+    }
+}
+
+/* Update every instance several times, then receive all of the updates
+ * within a single poll of the destination. */
+void send_rounds()
+{
+    int i, j;
+    float value;
+    updates = batches = batched = 0;
+    for (i = 0; i < NUM_INSTANCES; i++)
+        last_values[i] = -1;
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        for (j = 0; j < NUM_INSTANCES; j++) {
+            value = i * NUM_INSTANCES + j;
+            mapper_signal_instance_update(sendsig, j, &value, 1, MAPPER_NOW);
+        }
+        mapper_device_poll(source, 0);
+    }
+    mapper_device_poll(destination, 200);
+}
+
+int check_values()
+{
+    int i;
+    for (i = 0; i < NUM_INSTANCES; i++) {
+        if (last_values[i] != (NUM_ROUNDS - 1) * NUM_INSTANCES + i) {
+            eprintf("instance %d ended with %f, expected %d\n", i,
+                    last_values[i], (NUM_ROUNDS - 1) * NUM_INSTANCES + i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int test_modes()
+{
+    int result = 0;
+
+    eprintf("Coalescing updates for each instance...\n");
+    mapper_signal_set_callback_mode(recvsig, MAPPER_CALLBACK_COALESCE);
+    send_rounds();
+    if (updates != NUM_INSTANCES || check_values()) {
+        eprintf("Expected %d handler calls, got %d.\n", NUM_INSTANCES, updates);
+        result = 1;
+    }
+
+    eprintf("Coalescing updates into a batch...\n");
+    mapper_signal_set_batch_callback(recvsig, batch_handler);
+    send_rounds();
+    if (updates || batches != 1 || batched != NUM_INSTANCES || check_values()) {
+        eprintf("Expected 1 batch of %d instances, got %d batches of %d "
+                "instances and %d handler calls.\n", NUM_INSTANCES, batches,
+                batched, updates);
+        result = 1;
+    }
+
+    eprintf("Calling the handler for every update...\n");
+    mapper_signal_set_callback_mode(recvsig, MAPPER_CALLBACK_IMMEDIATE);
+    send_rounds();
+    if (updates != NUM_INSTANCES * NUM_ROUNDS || batches || check_values()) {
+        eprintf("Expected %d handler calls, got %d.\n",
+                NUM_INSTANCES * NUM_ROUNDS, updates);
+        result = 1;
+    }
+
+    return result;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testcoalesce.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source()) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error connecting signals.\n");
+        result = 1;
+        goto done;
+    }
+
+    result = test_modes();
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
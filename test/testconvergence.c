@@ -0,0 +1,278 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_SOURCES 4
+#define NUM_ROUNDS 10
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device sources[NUM_SOURCES];
+mapper_device destination = 0;
+mapper_signal sendsig[NUM_SOURCES];
+mapper_signal recvsig = 0;
+mapper_map map = 0;
+
+int received = 0;
+float last_value = 0;
+
+int setup_sources()
+{
+    int i;
+    for (i = 0; i < NUM_SOURCES; i++)
+        sources[i] = 0;
+    for (i = 0; i < NUM_SOURCES; i++) {
+        sources[i] = mapper_device_new("testsend", 0, 0);
+        if (!sources[i])
+            goto error;
+        sendsig[i] = mapper_device_add_output_signal(sources[i], "outsig", 1,
+                                                     'f', 0, 0, 0);
+        if (!sendsig[i])
+            goto error;
+        eprintf("source %d created.\n", i);
+    }
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_sources()
+{
+    int i;
+    for (i = 0; i < NUM_SOURCES; i++) {
+        if (sources[i]) {
+            eprintf("Freeing source %d... ", i);
+            fflush(stdout);
+            mapper_device_free(sources[i]);
+            eprintf("ok\n");
+        }
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        last_value = *(float*)value;
+        eprintf("handler: Got %f\n", last_value);
+    }
+    received++;
+}
+
+int setup_destination()
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    mapper_device_set_stats(destination, MAPPER_STATS_COLLECT);
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'f', 0,
+                                             0, 0, insig_handler, 0);
+    if (!recvsig)
+        goto error;
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void poll_all(int block_ms)
+{
+    int i;
+    for (i = 0; i < NUM_SOURCES; i++)
+        mapper_device_poll(sources[i], 0);
+    mapper_device_poll(destination, block_ms);
+}
+
+int setup_maps()
+{
+    int i;
+    map = mapper_map_new(NUM_SOURCES, sendsig, 1, &recvsig);
+    mapper_map_set_mode(map, MAPPER_MODE_EXPRESSION);
+    mapper_map_set_expression(map, "y=x0+x1+x2+x3");
+    mapper_map_push(map);
+
+    // wait until mapping has been established
+    while (!done && !mapper_map_ready(map))
+        poll_all(10);
+
+    // use the destination device's copy of the map
+    mapper_map *maps = mapper_device_maps(destination, MAPPER_DIR_INCOMING);
+    if (!maps)
+        return 1;
+    map = *maps;
+    mapper_map_query_done(maps);
+
+    for (i = 0; i < 10; i++)
+        poll_all(10);
+    return 0;
+}
+
+void wait_ready()
+{
+    int i, ready = 0;
+    while (!done && !ready) {
+        ready = mapper_device_ready(destination);
+        for (i = 0; i < NUM_SOURCES; i++)
+            ready &= mapper_device_ready(sources[i]);
+        poll_all(10);
+    }
+}
+
+/* Update the first num sources in each round, and poll the destination long
+ * enough to receive all of the updates. */
+void send_rounds(int num)
+{
+    int i, j;
+    float value;
+    received = 0;
+    mapper_map_reset_stats(map);
+    for (i = 0; i < NUM_ROUNDS && !done; i++) {
+        for (j = 0; j < num; j++) {
+            value = i;
+            mapper_signal_update(sendsig[j], &value, 1, MAPPER_NOW);
+            mapper_device_poll(sources[j], 0);
+        }
+        mapper_device_poll(destination, 100);
+    }
+}
+
+int check(const char *name, int expect_received, float expect_value,
+          uint64_t expect_converged)
+{
+    mapper_stats_t stats;
+    mapper_map_stats(map, &stats);
+    eprintf("%s: received %d, last value %f, converged %llu\n", name, received,
+            last_value, (unsigned long long)stats.converged);
+    if (received != expect_received || last_value != expect_value
+        || stats.converged != expect_converged) {
+        eprintf("  expected %d updates ending with %f, %llu converged\n",
+                expect_received, expect_value,
+                (unsigned long long)expect_converged);
+        return 1;
+    }
+    return 0;
+}
+
+int test_convergence()
+{
+    int result = 0;
+    float last = (NUM_ROUNDS - 1) * NUM_SOURCES;
+
+    // the expression is evaluated for every source update
+    send_rounds(NUM_SOURCES);
+    result |= check("each", NUM_ROUNDS * NUM_SOURCES, last, 0);
+
+    // the expression is evaluated once all sources have been updated
+    mapper_map_set_convergence(map, MAPPER_CONVERGE_ALL, 1);
+    send_rounds(NUM_SOURCES);
+    result |= check("all", NUM_ROUNDS, last, NUM_ROUNDS * (NUM_SOURCES - 1));
+
+    // a missing source delays evaluation until the timeout expires
+    mapper_map_set_convergence(map, MAPPER_CONVERGE_ALL, 0.05);
+    send_rounds(NUM_SOURCES - 1);
+    result |= check("timeout", NUM_ROUNDS, last,
+                    NUM_ROUNDS * (NUM_SOURCES - 1));
+
+    mapper_map_set_convergence(map, MAPPER_CONVERGE_EACH, 0);
+    send_rounds(NUM_SOURCES);
+    result |= check("each again", NUM_ROUNDS * NUM_SOURCES, last, 0);
+
+    return result;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testconvergence.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_sources()) {
+        eprintf("Error initializing sources.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error setting map.\n");
+        result = 1;
+        goto done;
+    }
+
+    result = test_convergence();
+
+  done:
+    cleanup_destination();
+    cleanup_sources();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
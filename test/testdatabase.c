@@ -1120,6 +1120,77 @@ int main(int argc, char **argv)
     }
 
     /*********/
+
+    eprintf("\nAdd and remove devices and signals repeatedly:\n");
+
+    mapper_list_allocation_counts_t before, after;
+    mapper_list_allocation_counts(&before);
+
+    char name[32];
+    for (i = 0; i < 50; i++) {
+        for (j = 0; j < 20; j++) {
+            snprintf(name, 32, "churn%d.1", j);
+            mapper_database_add_or_update_device(db, name, 0);
+            snprintf(name, 32, "sig%d", j);
+            mapper_database_add_or_update_signal(db, name, "churn0.1", 0);
+        }
+        dev = mapper_database_device_by_name(db, "churn0.1");
+        psig = mapper_device_signals(dev, MAPPER_DIR_ANY);
+        count = 0;
+        while (psig) {
+            ++count;
+            psig = mapper_signal_query_next(psig);
+        }
+        if (count != 20) {
+            eprintf("Expected 20 records, but counted %d.\n", count);
+            result = 1;
+            goto done;
+        }
+        for (j = 0; j < 20; j++) {
+            snprintf(name, 32, "churn%d.1", j);
+            dev = mapper_database_device_by_name(db, name);
+            mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+        }
+    }
+
+    mapper_list_allocation_counts(&after);
+    eprintf("  %llu list items and query headers used %llu allocations, "
+            "%llu query contexts used %llu allocations.\n",
+            (unsigned long long)(after.blocks - before.blocks),
+            (unsigned long long)(after.allocations - before.allocations),
+            (unsigned long long)(after.query_contexts - before.query_contexts),
+            (unsigned long long)(after.query_allocations
+                                 - before.query_allocations));
+    if (after.allocations - before.allocations
+        >= (after.blocks - before.blocks) / 10) {
+        eprintf("Expected freed records to be reused.\n");
+        result = 1;
+        goto done;
+    }
+
+    eprintf("\nAdd and remove many devices at once:\n");
+
+    mapper_list_allocation_counts(&before);
+    for (i = 0; i < 500; i++) {
+        snprintf(name, 32, "burst%d.1", i);
+        mapper_database_add_or_update_device(db, name, 0);
+    }
+    for (i = 0; i < 500; i++) {
+        snprintf(name, 32, "burst%d.1", i);
+        dev = mapper_database_device_by_name(db, name);
+        mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+    }
+    mapper_list_allocation_counts(&after);
+    eprintf("  %llu allocations, %llu slabs released.\n",
+            (unsigned long long)(after.allocations - before.allocations),
+            (unsigned long long)(after.releases - before.releases));
+    if (after.releases == before.releases) {
+        eprintf("Expected empty slabs to be released.\n");
+        result = 1;
+        goto done;
+    }
+
+    /*********/
 done:
     mapper_network_free(net);
     if (!verbose)
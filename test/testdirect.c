@@ -0,0 +1,215 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_UPDATES 5000
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_signal selfsig = 0;
+
+int received = 0;
+int self_received = 0;
+float last_value = 0;
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (!value)
+        return;
+    last_value = *(float*)value;
+    if (sig == selfsig)
+        ++self_received;
+    else
+        ++received;
+}
+
+int setup_devices()
+{
+    source = mapper_device_new("testdirect-send", 0, 0);
+    destination = mapper_device_new("testdirect-recv", 0, 0);
+    if (!source || !destination)
+        return 1;
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'f', 0, 0,
+                                              0);
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'f', 0,
+                                             0, 0, insig_handler, 0);
+    selfsig = mapper_device_add_input_signal(source, "selfsig", 1, 'f', 0, 0,
+                                             0, insig_handler, 0);
+    if (!sendsig || !recvsig || !selfsig)
+        return 1;
+    eprintf("Devices created.\n");
+    return 0;
+}
+
+void cleanup_devices()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(source, block_ms);
+    mapper_device_poll(destination, 0);
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        poll_all(25);
+    }
+}
+
+int setup_maps()
+{
+    mapper_map map1 = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map1);
+    mapper_map map2 = mapper_map_new(1, &sendsig, 1, &selfsig);
+    mapper_map_push(map2);
+
+    // wait until maps have been established
+    while (!done && !(mapper_map_ready(map1) && mapper_map_ready(map2)))
+        poll_all(10);
+    return done;
+}
+
+/* Send updates one at a time, polling both devices until each has arrived,
+ * and report the mean round trip. */
+int send_updates(const char *label)
+{
+    int i, tries;
+    float value;
+    double start = current_time();
+    received = self_received = 0;
+
+    for (i = 0; i < NUM_UPDATES && !done; i++) {
+        value = i;
+        mapper_signal_update(sendsig, &value, 1, MAPPER_NOW);
+        for (tries = 0; tries < 1000; tries++) {
+            mapper_device_poll(source, 0);
+            mapper_device_poll(destination, 0);
+            if (received > i && self_received > i)
+                break;
+        }
+    }
+    double elapsed = current_time() - start;
+    eprintf("%s: received %d and %d of %d updates, %.2f us per update\n",
+            label, received, self_received, NUM_UPDATES,
+            elapsed * 1000000. / NUM_UPDATES);
+    if (received != NUM_UPDATES || self_received != NUM_UPDATES
+        || last_value != NUM_UPDATES - 1) {
+        eprintf("  not all updates were received.\n");
+        return 1;
+    }
+    return 0;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testdirect.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_devices()) {
+        eprintf("Error initializing devices.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error setting maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (!mapper_device_direct_delivery(source)) {
+        eprintf("Direct delivery should be enabled by default.\n");
+        result = 1;
+    }
+    result |= send_updates("direct");
+
+    mapper_device_set_direct_delivery(source, 0);
+    result |= send_updates("network");
+
+    mapper_device_set_direct_delivery(source, 1);
+    result |= send_updates("direct again");
+
+  done:
+    cleanup_devices();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,247 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <lo/lo_lowlevel.h>
+#include "../src/mapper_internal.h"
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_DEVICES 50
+#define SIGNALS_PER_DEVICE 1000
+#define NUM_SIGNALS (NUM_DEVICES * SIGNALS_PER_DEVICE)
+#define BATCH_SIZE 1024
+
+int verbose = 1;
+int num_callbacks = 0;
+
+mapper_database db = 0;
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void on_signal(mapper_database db, mapper_signal sig, mapper_record_event e,
+               const void *user)
+{
+    ++num_callbacks;
+}
+
+/* Read a change feed in batches, counting the changes of each kind. */
+int read_feed(mapper_change_feed feed, int *added, int *modified,
+              int *removed, int *resyncs)
+{
+    mapper_change_t changes[BATCH_SIZE];
+    int i, count, batches = 0;
+    *added = *modified = *removed = *resyncs = 0;
+    while ((count = mapper_change_feed_read(feed, changes, BATCH_SIZE))) {
+        for (i = 0; i < count; i++) {
+            if (changes[i].type == MAPPER_OBJ_ALL)
+                ++(*resyncs);
+            else if (changes[i].event == MAPPER_ADDED)
+                ++(*added);
+            else if (changes[i].event == MAPPER_MODIFIED)
+                ++(*modified);
+            else
+                ++(*removed);
+        }
+        ++batches;
+    }
+    return batches;
+}
+
+/* Add a signal record with the given id. */
+mapper_signal add_signal(const char *devname, const char *signame,
+                         mapper_id id)
+{
+    lo_message lom = lo_message_new();
+    lo_message_add_string(lom, "@id");
+    lo_message_add_int64(lom, id);
+    mapper_message msg = mapper_message_parse_properties(
+        lo_message_get_argc(lom), lo_message_get_types(lom),
+        lo_message_get_argv(lom));
+    mapper_signal sig = mapper_database_add_or_update_signal(db, signame,
+                                                             devname, msg);
+    mapper_message_free(msg);
+    lo_message_free(lom);
+    return sig;
+}
+
+/* Add signals with unique ids, then modify them. */
+int add_signals(const char *devname, int num, mapper_message modify)
+{
+    int i;
+    char signame[32];
+    static mapper_id id = 1;
+    for (i = 0; i < num; i++) {
+        snprintf(signame, 32, "sig%d", i);
+        if (!add_signal(devname, signame, id++))
+            return 1;
+        if (modify)
+            mapper_database_add_or_update_signal(db, signame, devname, modify);
+    }
+    return 0;
+}
+
+mapper_signal find_signal(const char *devname, const char *signame)
+{
+    mapper_device dev = mapper_database_device_by_name(db, devname);
+    return dev ? mapper_device_signal_by_name(dev, signame) : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    int added, modified, removed, resyncs, batches;
+    char devname[32];
+
+    // process flags for -v verbose, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testfeed.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    mapper_network net = mapper_network_new(0, 0, 0);
+    db = &net->database;
+    mapper_database_add_signal_callback(db, on_signal, 0);
+
+    mapper_change_feed feed = mapper_database_add_change_feed(db,
+        MAPPER_OBJ_DEVICES | MAPPER_OBJ_SIGNALS, NUM_SIGNALS + NUM_DEVICES);
+    mapper_change_feed small = mapper_database_add_change_feed(db,
+        MAPPER_OBJ_SIGNALS, BATCH_SIZE);
+
+    // a message modifying each signal after it is added
+    lo_message lom = lo_message_new();
+    lo_message_add_string(lom, "@test_count");
+    lo_message_add_int32(lom, 1);
+    mapper_message msg = mapper_message_parse_properties(
+        lo_message_get_argc(lom), lo_message_get_types(lom),
+        lo_message_get_argv(lom));
+    if (!msg) {
+        eprintf("Error parsing message.\n");
+        result = 1;
+        goto done;
+    }
+
+    /* Add and then modify many signals. */
+    double start = current_time();
+    for (i = 0; i < NUM_DEVICES && !result; i++) {
+        snprintf(devname, 32, "testfeed%d.1", i);
+        result = add_signals(devname, SIGNALS_PER_DEVICE, msg);
+    }
+    if (result) {
+        eprintf("Error adding signals.\n");
+        goto done;
+    }
+    eprintf("Added and modified %d signals in %.2f seconds, with %d signal "
+            "callbacks.\n", NUM_SIGNALS, current_time() - start,
+            num_callbacks);
+
+    start = current_time();
+    batches = read_feed(feed, &added, &modified, &removed, &resyncs);
+    eprintf("Read %d changes in %d batches in %.4f seconds.\n",
+            added + modified + removed + resyncs, batches,
+            current_time() - start);
+    if (added != NUM_SIGNALS + NUM_DEVICES || modified || removed || resyncs) {
+        eprintf("Expected %d additions, but read %d added, %d modified, %d "
+                "removed, %d resyncs.\n", NUM_SIGNALS + NUM_DEVICES, added,
+                modified, removed, resyncs);
+        result = 1;
+        goto done;
+    }
+
+    /* The small feed overflowed and should ask for a resync. */
+    read_feed(small, &added, &modified, &removed, &resyncs);
+    if (resyncs != 1 || added + modified + removed > BATCH_SIZE) {
+        eprintf("Expected a resync from the overflowing feed.\n");
+        result = 1;
+        goto done;
+    }
+    eprintf("Overflowing feed asked for a resync.\n");
+
+    /* Records which are added and then removed are not reported. */
+    add_signals("testfeed_transient.1", 10, msg);
+    mapper_database_remove_device(db, mapper_database_device_by_name(
+        db, "testfeed_transient.1"), MAPPER_REMOVED, 0);
+    if (read_feed(feed, &added, &modified, &removed, &resyncs)) {
+        eprintf("Expected no changes for removed records.\n");
+        result = 1;
+        goto done;
+    }
+
+    /* Repeated modifications are reported once, a record which is removed
+     * and added again is reported as modified, and a record which is modified
+     * and then removed is reported as removed. */
+    lo_message_add_string(lom, "@test_label");
+    lo_message_add_string(lom, "modified");
+    mapper_message_free(msg);
+    msg = mapper_message_parse_properties(lo_message_get_argc(lom),
+                                          lo_message_get_types(lom),
+                                          lo_message_get_argv(lom));
+    for (i = 0; i < 10; i++) {
+        mapper_database_add_or_update_signal(db, "sig0", "testfeed0.1", msg);
+        mapper_database_add_or_update_signal(db, "sig2", "testfeed0.1", msg);
+    }
+    mapper_signal sig = find_signal("testfeed0.1", "sig1");
+    mapper_id id = sig->id;
+    mapper_database_remove_signal(db, sig, MAPPER_REMOVED);
+    add_signal("testfeed0.1", "sig1", id);
+    mapper_database_add_or_update_signal(db, "sig1", "testfeed0.1", msg);
+    mapper_database_remove_signal(db, find_signal("testfeed0.1", "sig2"),
+                                  MAPPER_REMOVED);
+    read_feed(feed, &added, &modified, &removed, &resyncs);
+    if (added || modified != 2 || removed != 1) {
+        eprintf("Expected 2 modifications and 1 removal, but read %d added, "
+                "%d modified, %d removed.\n", added, modified, removed);
+        result = 1;
+        goto done;
+    }
+
+    /* Remove everything. */
+    for (i = 0; i < NUM_DEVICES; i++) {
+        snprintf(devname, 32, "testfeed%d.1", i);
+        mapper_database_remove_device(db, mapper_database_device_by_name(
+            db, devname), MAPPER_REMOVED, 0);
+    }
+    read_feed(feed, &added, &modified, &removed, &resyncs);
+    if (removed != NUM_SIGNALS + NUM_DEVICES - 1 || added || modified) {
+        eprintf("Expected %d removals, but read %d.\n",
+                NUM_SIGNALS + NUM_DEVICES - 1, removed);
+        result = 1;
+        goto done;
+    }
+    eprintf("Read %d removals.\n", removed);
+
+done:
+    if (msg)
+        mapper_message_free(msg);
+    lo_message_free(lom);
+    mapper_network_free(net);
+    if (!verbose)
+        printf("..................................................");
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
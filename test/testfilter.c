@@ -0,0 +1,195 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_SIGNALS 100
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device dev = 0;
+mapper_database db = 0;
+mapper_device remote = 0;
+
+int setup_device()
+{
+    int i;
+    char name[32];
+
+    dev = mapper_device_new("testfilter", 0, 0);
+    if (!dev)
+        return 1;
+
+    // a quarter of the signals are named "sensor/*" and have length 2
+    for (i = 0; i < NUM_SIGNALS; i++) {
+        snprintf(name, 32, "%s/%d", i % 2 ? "sensor" : "other", i);
+        if (!mapper_device_add_output_signal(dev, name, i % 4 < 2 ? 1 : 2, 'f',
+                                             0, 0, 0))
+            return 1;
+    }
+    eprintf("Device created with %d signals.\n", NUM_SIGNALS);
+    return 0;
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(dev, block_ms);
+    mapper_database_poll(db, 0);
+}
+
+/* Poll until the number of remote signal records stops changing. */
+int wait_for_signals()
+{
+    int i, count = -1, stable = 0;
+    for (i = 0; i < 200 && !done && stable < 10; i++) {
+        poll_all(10);
+        int num = mapper_device_num_signals(remote, MAPPER_DIR_ANY);
+        stable = (num == count) ? stable + 1 : 0;
+        count = num;
+    }
+    return count;
+}
+
+/* Check that every remote signal record passes the filter. */
+int check_signals()
+{
+    int errors = 0;
+    mapper_signal *sigs = mapper_device_signals(remote, MAPPER_DIR_ANY);
+    while (sigs) {
+        if (strncmp(mapper_signal_name(*sigs), "sensor/", 7)
+            || mapper_signal_length(*sigs) != 2) {
+            eprintf("Received unexpected signal '%s'.\n",
+                    mapper_signal_name(*sigs));
+            ++errors;
+        }
+        sigs = mapper_signal_query_next(sigs);
+    }
+    return errors;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0, count;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testfilter.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    // only device records are received until the filter is set
+    db = mapper_database_new(0, MAPPER_OBJ_DEVICES);
+    if (!db || setup_device()) {
+        eprintf("Error initializing device.\n");
+        result = 1;
+        goto done;
+    }
+
+    while (!done && !mapper_device_ready(dev))
+        poll_all(25);
+    mapper_database_request_devices(db);
+    for (i = 0; i < 100 && !done && !remote; i++) {
+        poll_all(10);
+        remote = mapper_database_device_by_name(db, mapper_device_name(dev));
+    }
+    if (!remote) {
+        eprintf("Database did not find device.\n");
+        result = 1;
+        goto done;
+    }
+
+    // subscribe to "sensor/*" signals of length 2
+    int length = 2;
+    mapper_subscription_filter filter;
+    filter = mapper_subscription_filter_new("sensor/*");
+    mapper_subscription_filter_add_predicate(filter, "length",
+                                             MAPPER_OP_EQUAL, 1, 'i', &length);
+    mapper_database_subscribe_filtered(db, remote, (MAPPER_OBJ_DEVICES
+                                                    | MAPPER_OBJ_SIGNALS),
+                                       -1, filter);
+    mapper_subscription_filter_free(filter);
+
+    count = wait_for_signals();
+    eprintf("Received %d of %d signals.\n", count, NUM_SIGNALS);
+    if (count != NUM_SIGNALS / 4 || check_signals()) {
+        eprintf("Expected %d filtered signals.\n", NUM_SIGNALS / 4);
+        result = 1;
+        goto done;
+    }
+
+    // only new signals passing the filter are announced to the subscriber
+    mapper_device_add_output_signal(dev, "sensor/new", 2, 'f', 0, 0, 0);
+    mapper_device_add_output_signal(dev, "other/new", 2, 'f', 0, 0, 0);
+    mapper_device_add_output_signal(dev, "sensor/short", 1, 'f', 0, 0, 0);
+    count = wait_for_signals();
+    if (count != NUM_SIGNALS / 4 + 1 || check_signals()
+        || !mapper_device_signal_by_name(remote, "sensor/new")) {
+        eprintf("Expected only the new matching signal, but received %d "
+                "signals.\n", count);
+        result = 1;
+        goto done;
+    }
+    eprintf("Received only the new matching signal.\n");
+
+    // removing the filter brings the subscriber up to date
+    mapper_database_subscribe(db, remote,
+                              MAPPER_OBJ_DEVICES | MAPPER_OBJ_SIGNALS, -1);
+    count = wait_for_signals();
+    eprintf("Received %d signals without a filter.\n", count);
+    if (count != NUM_SIGNALS + 3) {
+        eprintf("Expected %d signals.\n", NUM_SIGNALS + 3);
+        result = 1;
+    }
+
+    while (!terminate && !done)
+        poll_all(100);
+
+  done:
+    if (db)
+        mapper_database_free(db);
+    if (dev)
+        mapper_device_free(dev);
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
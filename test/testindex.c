@@ -0,0 +1,321 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lo/lo_lowlevel.h>
+#include "../src/mapper_internal.h"
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_DEVICES 20
+#define SIGNALS_PER_DEVICE 500
+#define NUM_SIGNALS (NUM_DEVICES * SIGNALS_PER_DEVICE)
+#define NUM_REPEATS 20
+
+int verbose = 1;
+
+mapper_network net = 0;
+mapper_database db = 0;
+
+typedef mapper_signal *query_func(int arg);
+
+int add_device(const char *name, int port)
+{
+    lo_message lom = lo_message_new();
+    if (!lom)
+        return 1;
+    lo_message_add_string(lom, "@port");
+    lo_message_add_int32(lom, port);
+    lo_message_add_string(lom, "@host");
+    lo_message_add_string(lom, "localhost");
+
+    mapper_message msg;
+    msg = mapper_message_parse_properties(lo_message_get_argc(lom),
+                                          lo_message_get_types(lom),
+                                          lo_message_get_argv(lom));
+    if (!msg) {
+        lo_message_free(lom);
+        return 1;
+    }
+    mapper_database_add_or_update_device(db, name, msg);
+    mapper_message_free(msg);
+    lo_message_free(lom);
+    return 0;
+}
+
+int add_signal(const char *devname, int index, int group)
+{
+    char name[32];
+    lo_message lom = lo_message_new();
+    if (!lom)
+        return 1;
+    lo_message_add_string(lom, "@direction");
+    lo_message_add_string(lom, index % 3 ? "output" : "input");
+    lo_message_add_string(lom, "@type");
+    lo_message_add_char(lom, index % 2 ? 'f' : 'i');
+    lo_message_add_string(lom, "@length");
+    lo_message_add_int32(lom, index % 4 + 1);
+    lo_message_add_string(lom, "@group");
+    lo_message_add_int32(lom, group);
+
+    mapper_message msg;
+    msg = mapper_message_parse_properties(lo_message_get_argc(lom),
+                                          lo_message_get_types(lom),
+                                          lo_message_get_argv(lom));
+    if (!msg) {
+        lo_message_free(lom);
+        return 1;
+    }
+    snprintf(name, 32, "sig%d", index);
+    mapper_database_add_or_update_signal(db, name, devname, msg);
+    mapper_message_free(msg);
+    lo_message_free(lom);
+    return 0;
+}
+
+mapper_signal *query_direction(int arg)
+{
+    return mapper_database_signals(db, arg);
+}
+
+mapper_signal *query_type_and_length(int arg)
+{
+    char type = 'f';
+    return mapper_signal_query_intersection(
+        mapper_database_signals_by_property(db, "type", 1, 'c', &type,
+                                            MAPPER_OP_EQUAL),
+        mapper_database_signals_by_property(db, "length", 1, 'i', &arg,
+                                            MAPPER_OP_EQUAL));
+}
+
+mapper_signal *query_group(int arg)
+{
+    return mapper_database_signals_by_property(db, "group", 1, 'i', &arg,
+                                               MAPPER_OP_EQUAL);
+}
+
+mapper_signal *query_device(int arg)
+{
+    char name[32];
+    snprintf(name, 32, "testindex.%d", arg);
+    return mapper_device_signals(mapper_database_device_by_name(db, name),
+                                 MAPPER_DIR_ANY);
+}
+
+/* Collect the results of a query, and time repeated evaluations of it. */
+int run_query(query_func *f, int arg, mapper_signal **results, double *time)
+{
+    int i, count = 0;
+    mapper_signal *sigs;
+    mapper_timetag_t start, end;
+
+    mapper_timetag_now(&start);
+    for (i = 0; i < NUM_REPEATS; i++) {
+        count = 0;
+        sigs = f(arg);
+        while (sigs) {
+            if (results && i == 0) {
+                *results = realloc(*results,
+                                   sizeof(mapper_signal) * (count + 1));
+                (*results)[count] = *sigs;
+            }
+            ++count;
+            sigs = mapper_signal_query_next(sigs);
+        }
+    }
+    mapper_timetag_now(&end);
+    *time = mapper_timetag_difference(end, start) / NUM_REPEATS;
+    return count;
+}
+
+/* Compare the results and timing of a query before and after indexing. */
+int check_query(const char *label, query_func *f, int arg, int type,
+                const char *property, int expected)
+{
+    int result = 0, count1, count2;
+    double time1, time2;
+    mapper_signal *results1 = 0, *results2 = 0;
+
+    count1 = run_query(f, arg, &results1, &time1);
+    if (mapper_database_add_index(db, type, property)) {
+        eprintf("%s: failed to add index on '%s'.\n", label, property);
+        result = 1;
+        goto done;
+    }
+    count2 = run_query(f, arg, &results2, &time2);
+    mapper_database_remove_index(db, type, property);
+
+    eprintf("%-20s %5d results, scan %9.3f us, indexed %9.3f us\n", label,
+            count2, time1 * 1000000., time2 * 1000000.);
+    if (count1 != expected || count2 != expected) {
+        eprintf("  expected %d results, found %d and %d.\n", expected, count1,
+                count2);
+        result = 1;
+    }
+    else if (count1 && memcmp(results1, results2,
+                              sizeof(mapper_signal) * count1)) {
+        eprintf("  indexed results differ.\n");
+        result = 1;
+    }
+
+  done:
+    if (results1)
+        free(results1);
+    if (results2)
+        free(results2);
+    return result;
+}
+
+/* Check that indexes follow changes to the database. */
+int check_updates()
+{
+    double time;
+    int count, group = 3, result = 0;
+    mapper_database_add_index(db, MAPPER_OBJ_SIGNALS, "group");
+
+    count = run_query(query_group, group, 0, &time);
+    if (add_signal("testindex.0", NUM_SIGNALS + 3, group)) {
+        mapper_database_remove_index(db, MAPPER_OBJ_SIGNALS, "group");
+        return 1;
+    }
+    if (run_query(query_group, group, 0, &time) != count + 1) {
+        eprintf("Index did not include new signal.\n");
+        result = 1;
+    }
+
+    // move an existing signal to another group
+    if (add_signal("testindex.0", 3, group + 1)) {
+        mapper_database_remove_index(db, MAPPER_OBJ_SIGNALS, "group");
+        return 1;
+    }
+    if (run_query(query_group, group, 0, &time) != count) {
+        eprintf("Index did not follow property update.\n");
+        result = 1;
+    }
+
+    mapper_database_remove_index(db, MAPPER_OBJ_SIGNALS, "group");
+    return result;
+}
+
+/* Check that an indexed query can be indexed after records have changed
+ * during its iteration. */
+int check_query_index()
+{
+    double time;
+    int i, count, group = 5, result = 0;
+    mapper_signal *sigs, *results = 0, removed = 0;
+    mapper_database_add_index(db, MAPPER_OBJ_SIGNALS, "group");
+
+    sigs = query_group(group);
+    for (i = 0; sigs && i < 10; i++) {
+        if (i == 3)
+            removed = *sigs;
+        sigs = mapper_signal_query_next(sigs);
+    }
+    if (!sigs || !removed) {
+        eprintf("Query on 'group' returned too few results.\n");
+        mapper_database_remove_index(db, MAPPER_OBJ_SIGNALS, "group");
+        return 1;
+    }
+
+    // add a signal before the current one and remove one already returned
+    if (add_signal("testindex.1", NUM_SIGNALS + 5, group)) {
+        mapper_signal_query_done(sigs);
+        mapper_database_remove_index(db, MAPPER_OBJ_SIGNALS, "group");
+        return 1;
+    }
+    mapper_database_remove_signal(db, removed, MAPPER_REMOVED);
+
+    mapper_database_remove_index(db, MAPPER_OBJ_SIGNALS, "group");
+    count = run_query(query_group, group, &results, &time);
+
+    int indexes[4] = {0, 1, count / 2, count - 1};
+    for (i = 0; i < 4; i++) {
+        if (mapper_signal_query_index(sigs, indexes[i])
+            != results[indexes[i]]) {
+            eprintf("Query index %d differs after database changes.\n",
+                    indexes[i]);
+            result = 1;
+        }
+    }
+    mapper_signal_query_done(sigs);
+    if (results)
+        free(results);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    char name[32];
+
+    // process flags for -v verbose, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testindex.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    net = mapper_network_new(0, 0, 0);
+    db = &net->database;
+
+    for (i = 0; i < NUM_DEVICES; i++) {
+        snprintf(name, 32, "testindex.%d", i);
+        if (add_device(name, 1000 + i)) {
+            result = 1;
+            goto done;
+        }
+        for (j = 0; j < SIGNALS_PER_DEVICE; j++) {
+            if (add_signal(name, i * SIGNALS_PER_DEVICE + j,
+                           (i * SIGNALS_PER_DEVICE + j) % 10)) {
+                result = 1;
+                goto done;
+            }
+        }
+    }
+    eprintf("Database holds %d devices and %d signals.\n",
+            mapper_database_num_devices(db),
+            mapper_database_num_signals(db, MAPPER_DIR_ANY));
+
+    if (!mapper_database_add_index(db, MAPPER_OBJ_SIGNALS, "num_maps")) {
+        eprintf("Index on 'num_maps' should have been refused.\n");
+        result = 1;
+    }
+
+    result |= check_query("direction", query_direction, MAPPER_DIR_INCOMING,
+                          MAPPER_OBJ_SIGNALS, "direction",
+                          (NUM_SIGNALS + 2) / 3);
+    result |= check_query("type and length", query_type_and_length, 2,
+                          MAPPER_OBJ_SIGNALS, "length", NUM_SIGNALS / 4);
+    result |= check_query("custom property", query_group, 7,
+                          MAPPER_OBJ_SIGNALS, "group", NUM_SIGNALS / 10);
+    result |= check_query("device signals", query_device, NUM_DEVICES / 2,
+                          MAPPER_OBJ_SIGNALS, "device", SIGNALS_PER_DEVICE);
+    result |= check_updates();
+    result |= check_query_index();
+
+  done:
+    mapper_network_free(net);
+    if (!verbose)
+        printf("..................................................");
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,254 @@
+
+#include "../src/mapper_internal.h"
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define LENGTH 4096
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+
+int sent = 0;
+int received = 0;
+int mismatched = 0;
+float values[LENGTH];
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int setup_source()
+{
+    source = mapper_device_new("testsend", 0, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    // send through the network so that updates are fragmented
+    mapper_device_set_direct_delivery(source, 0);
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", LENGTH, 'f', 0,
+                                              0, 0);
+    if (!sendsig)
+        goto error;
+
+    eprintf("Output signal 'outsig' registered with length %d.\n", LENGTH);
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    int i;
+    if (!value)
+        return;
+    const float *f = (const float*)value;
+    for (i = 0; i < LENGTH; i++) {
+        if (f[i] != values[i] * 2) {
+            eprintf("handler: element %d is %f, expected %f\n", i, f[i],
+                    values[i] * 2);
+            ++mismatched;
+            break;
+        }
+    }
+    received++;
+}
+
+int setup_destination()
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", LENGTH, 'f',
+                                             0, 0, 0, insig_handler, 0);
+    if (!recvsig)
+        goto error;
+
+    eprintf("Input signal 'insig' registered with length %d.\n", LENGTH);
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int setup_maps()
+{
+    int i = 0;
+
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_set_expression(map, "y=x*2");
+    mapper_map_push(map);
+
+    // wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+        if (i++ > 100)
+            return 1;
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+        usleep(500 * 1000);
+    }
+}
+
+/* Send updates as fast as they are received, and report the throughput. */
+void loop()
+{
+    int i = 0, j, tries;
+    eprintf("Sending %d-element updates..\n", LENGTH);
+    double start = current_time();
+    while ((!terminate || i < 1000) && !done) {
+        mapper_device_poll(source, 0);
+        for (j = 0; j < LENGTH; j++)
+            values[j] = (float)(i + j);
+        mapper_signal_update(sendsig, values, 1, MAPPER_NOW);
+        sent++;
+        for (tries = 0; received < sent && tries < 100; tries++)
+            mapper_device_poll(destination, 1);
+        i++;
+
+        if (!verbose) {
+            printf("\r  Sent: %4i, Received: %4i   ", sent, received);
+            fflush(stdout);
+        }
+    }
+    double elapsed = current_time() - start;
+    printf("\n%d updates of %d floats in %f seconds: %.1f updates/s, "
+           "%.1f MB/s\n", sent, LENGTH, elapsed, sent / elapsed,
+           sent * LENGTH * sizeof(float) / elapsed / 1000000.);
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testlargevector.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination()) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source()) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error connecting signals.\n");
+        result = 1;
+        goto done;
+    }
+
+    loop();
+
+    if (sent != received) {
+        eprintf("Not all sent messages were received.\n");
+        eprintf("Updated value %d time%s, but received %d of them.\n",
+                sent, sent == 1 ? "" : "s", received);
+        result = 1;
+    }
+    if (mismatched) {
+        eprintf("%d received vectors did not match.\n", mismatched);
+        result = 1;
+    }
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
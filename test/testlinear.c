@@ -25,9 +25,120 @@ mapper_device source = 0;
 mapper_device destination = 0;
 mapper_signal sendsig = 0;
 mapper_signal recvsig = 0;
+mapper_map map = 0;
 
 int sent = 0;
 int received = 0;
+int mismatched = 0;
+float expected = 0;
+
+/* Check the compiled boundary kernels against values computed by hand for
+ * each boundary action. Expected outputs of NAN denote muted elements. */
+int check_bounds(mapper_slot slot, mapper_boundary_action bound_min,
+                 mapper_boundary_action bound_max, float *in, float *out,
+                 int expect_muted)
+{
+    int i, muted, result = 0;
+    char types[4] = "ffff";
+    float values[4];
+    mapper_history_t history;
+
+    memcpy(values, in, sizeof(values));
+    memset(&history, 0, sizeof(history));
+    history.value = values;
+    history.length = 4;
+    history.size = 1;
+    history.type = 'f';
+
+    slot->bound_min = bound_min;
+    slot->bound_max = bound_max;
+    slot->local->boundary.compiled = 0;
+
+    muted = mapper_boundary_perform(&history, slot, types);
+    for (i = 0; i < 4; i++) {
+        if ((types[i] == 'N') != (isnan(out[i]) != 0)) {
+            eprintf("  element %d was %smuted\n", i,
+                    types[i] == 'N' ? "" : "not ");
+            result = 1;
+        }
+        else if (types[i] != 'N' && fabs(values[i] - out[i]) > 0.0001) {
+            eprintf("  element %d is %f, expected %f\n", i, values[i],
+                    out[i]);
+            result = 1;
+        }
+    }
+    if (muted != expect_muted) {
+        eprintf("  muted flag is %d, expected %d\n", muted, expect_muted);
+        result = 1;
+    }
+    return result;
+}
+
+int test_boundaries()
+{
+    int result = 0;
+    float min[] = {0.f, 0.f, 10.f, -1.f}, max[] = {10.f, 10.f, 0.f, 1.f};
+    float in[] = {-3.f, 13.f, 12.f, 0.5f};
+    float clamp[] = {0.f, 10.f, 10.f, 0.5f};
+    float wrap[] = {7.f, 3.f, 2.f, 0.5f};
+    float fold[] = {3.f, 7.f, 8.f, 0.5f};
+    float mute[] = {NAN, NAN, NAN, 0.5f};
+    float mute_all[] = {NAN, NAN, NAN, NAN};
+    float clamp_point[] = {0.f, 10.f, 10.f, 5.f};
+    float clamp_min[] = {0.f, 13.f, 12.f, 0.5f};
+
+    mapper_signal_t sig;
+    mapper_local_slot_t local;
+    mapper_slot_t slot;
+
+    memset(&sig, 0, sizeof(sig));
+    sig.length = 4;
+    sig.type = 'f';
+    memset(&local, 0, sizeof(local));
+    memset(&slot, 0, sizeof(slot));
+    slot.signal = &sig;
+    slot.local = &local;
+    slot.minimum = min;
+    slot.maximum = max;
+
+    eprintf("Checking boundary actions..\n");
+    result |= check_bounds(&slot, MAPPER_BOUND_NONE, MAPPER_BOUND_NONE, in,
+                           in, 0);
+    if (local.boundary.kernel != BOUNDARY_NONE) {
+        eprintf("  unbounded slot did not use the no-op kernel\n");
+        result = 1;
+    }
+    result |= check_bounds(&slot, MAPPER_BOUND_CLAMP, MAPPER_BOUND_CLAMP, in,
+                           clamp, 0);
+    if (local.boundary.kernel != BOUNDARY_CLAMP) {
+        eprintf("  clamped slot did not use the clamp kernel\n");
+        result = 1;
+    }
+    result |= check_bounds(&slot, MAPPER_BOUND_WRAP, MAPPER_BOUND_WRAP, in,
+                           wrap, 0);
+    result |= check_bounds(&slot, MAPPER_BOUND_FOLD, MAPPER_BOUND_FOLD, in,
+                           fold, 0);
+    result |= check_bounds(&slot, MAPPER_BOUND_MUTE, MAPPER_BOUND_MUTE, in,
+                           mute, 0);
+
+    // collapse the last element's range to a point
+    min[3] = max[3] = 5.f;
+    result |= check_bounds(&slot, MAPPER_BOUND_CLAMP, MAPPER_BOUND_CLAMP, in,
+                           clamp_point, 0);
+    result |= check_bounds(&slot, MAPPER_BOUND_MUTE, MAPPER_BOUND_MUTE, in,
+                           mute_all, 1);
+
+    // with only a lower bound, values above it are left unchanged
+    slot.maximum = 0;
+    min[2] = 0.f;
+    min[3] = -1.f;
+    result |= check_bounds(&slot, MAPPER_BOUND_CLAMP, MAPPER_BOUND_NONE, in,
+                           clamp_min, 0);
+
+    mapper_boundary_free(&local.boundary);
+    eprintf("Boundary actions %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
 
 int setup_source(char *iface)
 {
@@ -64,6 +175,10 @@ void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
 {
     if (value) {
         eprintf("handler: Got %f\n", (*(float*)value));
+        if (fabs(*(float*)value - expected) > 0.0001) {
+            eprintf("  expected %f\n", expected);
+            ++mismatched;
+        }
     }
     received++;
 }
@@ -102,7 +217,7 @@ int setup_maps()
 {
     float src_min = 0.f, src_max = 100.f, dest_min = -10.f, dest_max = 10.f;
 
-    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    map = mapper_map_new(1, &sendsig, 1, &recvsig);
     mapper_map_set_mode(map, MAPPER_MODE_LINEAR);
 
     mapper_slot slot = mapper_map_slot(map, MAPPER_LOC_SOURCE, 0);
@@ -142,6 +257,7 @@ void loop()
     while ((!terminate || i < 50) && !done) {
         mapper_device_poll(source, 0);
         eprintf("Updating signal %s to %d\n", mapper_signal_name(sendsig), i);
+        expected = i * 0.2f - 10.f;
         mapper_signal_update_int(sendsig, i);
         sent++;
         mapper_device_poll(destination, 100);
@@ -154,6 +270,34 @@ void loop()
     }
 }
 
+/* Calibrate the source range from the values sent, checking that the linear
+ * scaling follows each new extremum. */
+void calibrate()
+{
+    int i, values[] = {20, 40, 60, 80, 50};
+    float outputs[] = {-10.f, 10.f, 10.f, 10.f, 0.f};
+
+    mapper_slot slot = mapper_map_slot(map, MAPPER_LOC_SOURCE, 0);
+    mapper_slot_set_calibrating(slot, 1);
+    mapper_map_push(map);
+    while (!done && !mapper_slot_calibrating(slot)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    eprintf("Calibrating..\n");
+    for (i = 0; i < 5 && !done; i++) {
+        mapper_device_poll(source, 0);
+        eprintf("Updating signal %s to %d\n", mapper_signal_name(sendsig),
+                values[i]);
+        expected = outputs[i];
+        mapper_signal_update_int(sendsig, values[i]);
+        sent++;
+        mapper_device_poll(destination, 100);
+    }
+    eprintf("Calibrated expression: %s\n", mapper_map_expression(map));
+}
+
 void ctrlc(int signal)
 {
     done = 1;
@@ -199,6 +343,11 @@ int main(int argc, char **argv)
 
     signal(SIGINT, ctrlc);
 
+    if (test_boundaries()) {
+        result = 1;
+        goto done;
+    }
+
     if (setup_destination(iface)) {
         eprintf("Error initializing destination.\n");
         result = 1;
@@ -221,12 +370,20 @@ int main(int argc, char **argv)
 
     loop();
 
+    if (autoconnect)
+        calibrate();
+
     if (sent != received) {
         eprintf("Not all sent messages were received.\n");
         eprintf("Updated value %d time%s, but received %d of them.\n",
                 sent, sent == 1 ? "" : "s", received);
         result = 1;
     }
+    if (mismatched) {
+        eprintf("%d received values did not match the linear scaling.\n",
+                mismatched);
+        result = 1;
+    }
 
   done:
     cleanup_destination();
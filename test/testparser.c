@@ -7,8 +7,9 @@
 #include <sys/time.h>
 #include <string.h>
 
-#define DEST_ARRAY_LEN 6
+#define DEST_ARRAY_LEN 8
 #define MAX_VARS 3
+#define WINDOW_SAMPLES 2000
 
 #define eprintf(format, ...) do {               \
     if (verbose)                                \
@@ -51,7 +52,7 @@ typedef struct _variable {
     int vector_length;
     char datatype;
     char casttype;
-    char history_size;
+    int history_size;
     char vector_length_locked;
     char assigned;
 } mapper_variable_t, *mapper_variable;
@@ -67,7 +68,12 @@ struct _mapper_expr
     int input_history_size;
     int output_history_size;
     int num_variables;
+    int num_windows;
     int constant_output;
+    void *stack;
+    int *dims;
+    void *cache;
+    int num_cached;
 };
 
 /* TODO:
@@ -192,9 +198,9 @@ int parse_and_eval(int expectation)
         goto fail;
     }
     for (i = 0; i < num_sources; i++) {
-        inh[i].size = mapper_expr_input_history_size(e, i);
+        inh[i].size = mapper_history_capacity(mapper_expr_input_history_size(e, i));
     }
-    outh.size = mapper_expr_output_history_size(e);
+    outh.size = mapper_history_capacity(mapper_expr_output_history_size(e));
 
     if (mapper_expr_num_variables(e) > MAX_VARS) {
         eprintf("Maximum variables exceeded.\n");
@@ -252,6 +258,166 @@ fail:
     return expectation != EXPECT_FAILURE;
 }
 
+/* Feed a sequence of samples through an input history and compare a windowed
+ * reduction with a direct computation over the same samples. Some samples
+ * are skipped to exercise catching up and rebuilding the window state. */
+int check_window(const char *func, int window)
+{
+    mapper_history_t h;
+    int i, j, n, result = 0, samples[WINDOW_SAMPLES];
+
+    snprintf(str, 256, "y=%s(x{%d:0})", func, 1 - window);
+    eprintf("***************** Expression %d *****************\n",
+            expression_count++);
+    eprintf("Parsing string '%s'\n", str);
+    setup_test('i', 1, 'f', 1);
+    e = mapper_expr_new_from_string(str, num_sources, src_types, src_lengths,
+                                    outh.type, outh.length);
+    if (!e) {
+        eprintf("Parser FAILED.\n");
+        return 1;
+    }
+    outh.size = mapper_history_capacity(mapper_expr_output_history_size(e));
+
+    memset(&h, 0, sizeof(mapper_history_t));
+    h.type = 'i';
+    h.length = 1;
+    h.position = -1;
+    h.size = mapper_history_capacity(mapper_expr_input_history_size(e, 0));
+    h.value = calloc(1, sizeof(int) * h.size);
+    h.timetag = calloc(1, sizeof(mapper_timetag_t) * h.size);
+    inh_p[0] = &h;
+
+    then = current_time();
+    for (i = 0; i < WINDOW_SAMPLES; i++) {
+        samples[i] = rand() % 1000 - 500;
+        mapper_history_advance(&h);
+        ((int*)h.value)[h.position] = samples[i];
+        if ((i % 97) > 90 || (i > 500 && i < 600))
+            continue;
+        if (!mapper_expr_evaluate(e, inh_p, 0, &outh, &tt_in, typestring)) {
+            eprintf("Evaluation FAILED.\n");
+            result = 1;
+            break;
+        }
+        n = i + 1 < window ? i + 1 : window;
+        double expected = samples[i];
+        for (j = i - n + 1; j < i; j++) {
+            if (strcmp(func, "min") == 0)
+                expected = samples[j] < expected ? samples[j] : expected;
+            else if (strcmp(func, "max") == 0)
+                expected = samples[j] > expected ? samples[j] : expected;
+            else
+                expected += samples[j];
+        }
+        if (strcmp(func, "mean") == 0)
+            expected /= n;
+        if (fabs(dest_float[outh.position] - expected) > 0.001) {
+            eprintf("Got %f at sample %d, expected %f\n",
+                    dest_float[outh.position], i, expected);
+            result = 1;
+            break;
+        }
+    }
+    now = current_time();
+    eprintf("%s over %d samples: %g seconds.\n", result ? "FAILED" : "OK",
+            WINDOW_SAMPLES, now - then);
+    if (!verbose)
+        printf(".");
+
+    inh_p[0] = &inh[0];
+    mapper_expr_free_history_windows(&h);
+    free(h.value);
+    free(h.timetag);
+    mapper_expr_free(e);
+    return result;
+}
+
+/* Parse and evaluate an expression, returning its token count and storing
+ * its output and evaluation time. */
+int eval_timed(int optimize, float *output, double *elapsed)
+{
+    int i;
+    mapper_expr_set_optimization(optimize);
+    e = mapper_expr_new_from_string(str, num_sources, src_types, src_lengths,
+                                    outh.type, outh.length);
+    mapper_expr_set_optimization(1);
+    if (!e)
+        return -1;
+    for (i = 0; i < num_sources; i++)
+        inh[i].size = mapper_history_capacity(mapper_expr_input_history_size(e, i));
+    outh.size = mapper_history_capacity(mapper_expr_output_history_size(e));
+    outh.position = -1;
+    for (i = 0; i < e->num_variables; i++)
+        mhist_realloc(&user_vars[i], e->variables[i].history_size,
+                      sizeof(double), 0);
+    user_vars_p = user_vars;
+
+#ifdef DEBUG
+    if (verbose) {
+        char str[128];
+        snprintf(str, 128, "%s returned %d tokens:",
+                 optimize ? "Optimizer" : "Parser", e->length);
+        printexpr(str, e);
+    }
+#endif
+
+    then = current_time();
+    for (i = 0; i < iterations; i++) {
+        if (!mapper_expr_evaluate(e, inh_p, &user_vars_p, &outh, &tt_in,
+                                  typestring)) {
+            mapper_expr_free(e);
+            return -1;
+        }
+    }
+    *elapsed = current_time() - then;
+
+    for (i = 0; i < outh.length; i++)
+        output[i] = propval_double(outh.value, outh.type,
+                                   outh.position * outh.length + i);
+    i = e->length;
+    mapper_expr_free(e);
+    return i;
+}
+
+/* Check that an optimized expression has the expected number of tokens and
+ * produces the same output as the unoptimized expression. */
+int check_optimization(int expected_tokens)
+{
+    int i, before, after;
+    float unoptimized[DEST_ARRAY_LEN], optimized[DEST_ARRAY_LEN];
+    double unoptimized_time, optimized_time;
+
+    eprintf("***************** Expression %d *****************\n",
+            expression_count++);
+    eprintf("Optimizing string '%s'\n", str);
+    before = eval_timed(0, unoptimized, &unoptimized_time);
+    after = eval_timed(1, optimized, &optimized_time);
+    if (before < 0 || after < 0) {
+        eprintf("Parsing or evaluation FAILED.\n");
+        return 1;
+    }
+    token_count += after;
+    total_elapsed_time += optimized_time;
+    eprintf("%d tokens reduced to %d, evaluation %g -> %g seconds (%.2fx)\n",
+            before, after, unoptimized_time, optimized_time,
+            unoptimized_time / optimized_time);
+    if (after != expected_tokens) {
+        eprintf("Expected %d tokens.\n", expected_tokens);
+        return 1;
+    }
+    for (i = 0; i < outh.length; i++) {
+        if (fabs(optimized[i] - unoptimized[i]) > 1e-5 * fabs(unoptimized[i])) {
+            eprintf("Element %d is %f, expected %f\n", i, optimized[i],
+                    unoptimized[i]);
+            return 1;
+        }
+    }
+    if (!verbose)
+        printf(".");
+    return 0;
+}
+
 int run_tests()
 {
     /* 1) Complex string */
@@ -394,14 +560,14 @@ int run_tests()
     eprintf("Expected: %i\n", src_int[0]+1);
 
     /* 19) Invalid history index */
-    snprintf(str, 256, "y=x{-101}");
+    snprintf(str, 256, "y=x{-4097}");
     setup_test('i', 1, 'i', 1);
     if (parse_and_eval(EXPECT_FAILURE))
         return 1;
     eprintf("Expected: FAILURE\n");
 
     /* 20) Invalid history index */
-    snprintf(str, 256, "y=x-y{-101}");
+    snprintf(str, 256, "y=x-y{-4097}");
     setup_test('i', 1, 'i', 1);
     if (parse_and_eval(EXPECT_FAILURE))
         return 1;
@@ -635,6 +801,132 @@ int run_tests()
         eprintf("Expected: %d\n", (cycles % 2) ? 80 - remainder : 20 + remainder);
     }
 
+    /* 51) Windowed reductions over input history */
+    if (check_window("sum", 50) || check_window("mean", 50)
+        || check_window("min", 50) || check_window("max", 1000)
+        || check_window("mean", 1000))
+        return 1;
+
+    /* 52) History windows must be the sole argument of a reduction */
+    snprintf(str, 256, "y=mean(x{-4:0}+1)");
+    setup_test('i', 1, 'f', 1);
+    if (parse_and_eval(EXPECT_FAILURE))
+        return 1;
+    eprintf("Expected: FAILURE\n");
+
+    /* 53) History windows are only supported for inputs */
+    snprintf(str, 256, "y=sum(y{-4:0})");
+    setup_test('i', 1, 'f', 1);
+    if (parse_and_eval(EXPECT_FAILURE))
+        return 1;
+    eprintf("Expected: FAILURE\n");
+
+    /* 54) Optimization: common subexpressions */
+    snprintf(str, 256, "y=sin(x)*2+sin(x)*2+sin(x)+(x{-1}+x)*(x{-1}+x)");
+    setup_test('f', 3, 'f', 3);
+    if (check_optimization(18))
+        return 1;
+
+    /* 55) Optimization: pow() with small exponents */
+    snprintf(str, 256, "y=pow(x+1,2)+pow(x,3)-pow(x,0.5)+pow(x,1)");
+    setup_test('f', 3, 'f', 3);
+    if (check_optimization(18))
+        return 1;
+
+    /* 56) Optimization: ternary operators with constant conditions */
+    snprintf(str, 256, "y=(1?x*2:x*3)+(0?x:4)+((x>1)?cos(x):cos(x))");
+    setup_test('f', 3, 'f', 3);
+    if (check_optimization(9))
+        return 1;
+
+    /* 57) Optimization: unused variables, division by a power of two */
+    snprintf(str, 256, "unused=x*10;half=x/2;y=half+x/4");
+    setup_test('f', 3, 'd', 3);
+    if (check_optimization(10))
+        return 1;
+
+    return 0;
+}
+
+/* Check that every static property is found by its name, then time the
+ * parsing of a typical signal announcement with slot and extra properties. */
+int run_property_tests()
+{
+    int i, num_messages = iterations / 10, expected = 15;
+    mapper_property_t prop;
+    mapper_message props;
+    float values[3] = {0.f, 1.f, 2.f};
+
+    for (prop = 0; prop < AT_EXTRA; prop++) {
+        if (mapper_property_from_string(mapper_property_string(prop)) != prop) {
+            eprintf("Property '%s' was not found by name.\n",
+                    mapper_property_string(prop));
+            return 1;
+        }
+    }
+    if (mapper_property_from_string("maximum") != AT_EXTRA
+        || mapper_property_from_string("") != AT_EXTRA) {
+        eprintf("Unknown property name was matched.\n");
+        return 1;
+    }
+
+    lo_message m = lo_message_new();
+    lo_message_add_string(m, "@direction");
+    lo_message_add_string(m, "output");
+    lo_message_add_string(m, "@id");
+    lo_message_add_int64(m, 0x123456789abcdefLL);
+    lo_message_add_string(m, "@length");
+    lo_message_add_int32(m, 3);
+    lo_message_add_string(m, "@type");
+    lo_message_add_char(m, 'f');
+    lo_message_add_string(m, "@unit");
+    lo_message_add_string(m, "m");
+    lo_message_add_string(m, "@min");
+    for (i = 0; i < 3; i++)
+        lo_message_add_float(m, values[i]);
+    lo_message_add_string(m, "@max");
+    for (i = 0; i < 3; i++)
+        lo_message_add_float(m, values[i] + 10.f);
+    lo_message_add_string(m, "@num_instances");
+    lo_message_add_int32(m, 1);
+    lo_message_add_string(m, "@rate");
+    lo_message_add_float(m, 100.f);
+    lo_message_add_string(m, "@description");
+    lo_message_add_string(m, "position of the left hand");
+    lo_message_add_string(m, "@src.1@bound_max");
+    lo_message_add_string(m, "clamp");
+    lo_message_add_string(m, "@dst@min");
+    lo_message_add_float(m, 0.f);
+    lo_message_add_string(m, "@custom_key");
+    lo_message_add_string(m, "custom value");
+    lo_message_add_string(m, "+@scope");
+    lo_message_add_string(m, "testparser.1");
+    lo_message_add_string(m, "-@user_key");
+
+    const char *types = lo_message_get_types(m);
+    lo_arg **argv = lo_message_get_argv(m);
+    int argc = lo_message_get_argc(m);
+
+    then = current_time();
+    for (i = 0; i < num_messages; i++) {
+        props = mapper_message_parse_properties(argc, types, argv);
+        if (!props || props->num_atoms != expected
+            || props->atoms[0].index != AT_DIRECTION
+            || props->atoms[10].index != (AT_BOUND_MAX | SRC_SLOT_PROPERTY(1))
+            || props->atoms[11].index != (AT_MIN | DST_SLOT_PROPERTY)
+            || props->atoms[12].index != AT_EXTRA) {
+            eprintf("Error parsing properties.\n");
+            mapper_message_free(props);
+            lo_message_free(m);
+            return 1;
+        }
+        mapper_message_free(props);
+    }
+    now = current_time();
+    eprintf("Parsed %d messages with %d properties in %f seconds "
+            "(%.3f us per message).\n", num_messages, expected, now - then,
+            (now - then) * 1000000. / num_messages);
+    lo_message_free(m);
     return 0;
 }
 
@@ -670,6 +962,8 @@ int main(int argc, char **argv)
     }
 
     result = run_tests();
+    if (!result)
+        result = run_property_tests();
     eprintf("**********************************\n");
     printf("...............Test %s ", result ? "FAILED" : "PASSED");
     if (!result)
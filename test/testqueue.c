@@ -145,12 +145,16 @@ void loop()
         j=i;
         mapper_timetag_t now;
         mapper_timetag_now(&now);
-        mapper_device_start_queue(source, now);
+        mapper_queue q = mapper_device_start_queue(source, now);
 		mapper_device_poll(source, 0);
         eprintf("Updating signal %s to %f\n", mapper_signal_name(sendsig), j);
         mapper_signal_update(sendsig, &j, 0, now);
 		mapper_signal_update(sendsig1, &j, 0, now);
-		mapper_device_send_queue(sendsig->device, now);
+        // alternate between sending by timetag and by queue handle
+        if (i % 2)
+            mapper_queue_send(q);
+        else
+            mapper_device_send_queue(sendsig->device, now);
 		sent = sent+2;
         mapper_device_poll(destination, 100);
         i++;
@@ -0,0 +1,272 @@
+
+#include "../src/mapper_internal.h"
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define DELAY       0.2     // seconds in the future to schedule updates
+#define MAX_ERROR   0.005   // maximum acceptable delivery error in seconds
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_map map = 0;
+
+int sent = 0;
+int received = 0;
+double max_error = 0;
+
+int setup_source(char *iface)
+{
+    source = mapper_device_new("testsend", 0, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    int mn=0, mx=100;
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'i', 0,
+                                              &mn, &mx);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    mapper_timetag_t now;
+    mapper_timetag_now(&now);
+    double error = mapper_timetag_difference(now, *timetag);
+    if (value) {
+        eprintf("handler: Got %d, delivery error %fs\n", (*(int*)value), error);
+    }
+    if (fabs(error) > max_error)
+        max_error = fabs(error);
+    received++;
+}
+
+int setup_destination(char *iface)
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    mapper_device_set_stats(destination, MAPPER_STATS_COLLECT);
+    mapper_device_set_scheduling(destination, 1);
+
+    int mn=0, mx=100;
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'i', 0,
+                                             &mn, &mx, insig_handler, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int setup_maps()
+{
+    map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_set_mode(map, MAPPER_MODE_RAW);
+    mapper_map_push(map);
+
+    // Wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+        usleep(500 * 1000);
+    }
+}
+
+void loop()
+{
+    eprintf("Polling device..\n");
+    int i = 0;
+    mapper_timetag_t tt;
+    while ((!terminate || i < 50) && !done) {
+        mapper_device_poll(source, 0);
+        mapper_timetag_now(&tt);
+        mapper_timetag_add_double(&tt, DELAY);
+        eprintf("Updating signal %s to %d\n", mapper_signal_name(sendsig), i);
+        mapper_signal_update(sendsig, &i, 1, tt);
+        sent++;
+        mapper_device_poll(destination, 50);
+        i++;
+
+        if (!verbose) {
+            printf("\r  Sent: %4i, Received: %4i   ", sent, received);
+            fflush(stdout);
+        }
+    }
+
+    // allow the remaining scheduled updates to become due
+    i = 0;
+    while (!done && received < sent && i++ < 20)
+        mapper_device_poll(destination, 50);
+}
+
+int check_stats()
+{
+    mapper_stats_t stats;
+    mapper_map dst_map = 0;
+    int result = 0;
+
+    mapper_map *maps = mapper_device_maps(destination, MAPPER_DIR_INCOMING);
+    if (maps) {
+        dst_map = *maps;
+        mapper_map_query_done(maps);
+    }
+    if (!dst_map || mapper_map_stats(dst_map, &stats)) {
+        eprintf("Could not retrieve statistics.\n");
+        return 1;
+    }
+
+    eprintf("scheduled %llu, late %llu, schedule error p99 %gs, max %gs\n",
+            (unsigned long long)stats.scheduled,
+            (unsigned long long)stats.late,
+            mapper_map_stats_percentile(dst_map, MAPPER_STAT_SCHEDULE_ERROR, 99),
+            max_error);
+
+    if (received != sent) {
+        eprintf("Received %d of %d updates.\n", received, sent);
+        result = 1;
+    }
+    if (stats.scheduled != sent) {
+        eprintf("Not all updates were scheduled.\n");
+        result = 1;
+    }
+    if (max_error > MAX_ERROR) {
+        eprintf("Updates were not delivered at their timetag.\n");
+        result = 1;
+    }
+    return result;
+}
+
+void ctrlc(int signal)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    char *iface = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testschedule.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    case '-':
+                        if (strcmp(argv[i], "--iface")==0 && argc>i+1) {
+                            i++;
+                            iface = argv[i];
+                            j = 1;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination(iface)) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source(iface)) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error initializing maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    loop();
+
+    result = check_stats();
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,286 @@
+
+#include "../src/mapper_internal.h"
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_map map = 0;
+
+int received = 0;
+float last_value = 0;
+
+int setup_source(char *iface)
+{
+    source = mapper_device_new("testsend", 0, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    mapper_device_set_stats(source, MAPPER_STATS_COLLECT);
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'f', 0, 0, 0);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        last_value = *(float*)value;
+        eprintf("handler: Got %f\n", last_value);
+    }
+    received++;
+}
+
+int setup_destination(char *iface)
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'f', 0,
+                                             0, 0, insig_handler, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int setup_maps()
+{
+    map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+
+    // Wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    // use the source device's copy of the map
+    mapper_map *maps = mapper_device_maps(source, MAPPER_DIR_OUTGOING);
+    if (!maps)
+        return 1;
+    map = *maps;
+    mapper_map_query_done(maps);
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+        usleep(500 * 1000);
+    }
+}
+
+/* Update the source signal without polling the source device, then poll
+ * both devices so that held values are sent and received. */
+void send_values(float *values, int num)
+{
+    int i;
+    received = 0;
+    mapper_map_reset_stats(map);
+    for (i = 0; i < num; i++) {
+        eprintf("Updating signal %s to %f\n", mapper_signal_name(sendsig),
+                values[i]);
+        mapper_signal_update_float(sendsig, values[i]);
+    }
+    for (i = 0; i < 10; i++) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 10);
+    }
+}
+
+int check(const char *name, int expect_received, float expect_value,
+          uint64_t expect_suppressed, uint64_t suppressed)
+{
+    eprintf("%s: received %d, last value %f, suppressed %llu\n", name,
+            received, last_value, (unsigned long long)suppressed);
+    if (received != expect_received
+        || (expect_received && last_value != expect_value)
+        || suppressed != expect_suppressed) {
+        eprintf("  expected %d updates ending with %f, %llu suppressed\n",
+                expect_received, expect_value,
+                (unsigned long long)expect_suppressed);
+        return 1;
+    }
+    return 0;
+}
+
+int test_policies()
+{
+    int result = 0;
+    mapper_stats_t stats;
+    mapper_send_policy_t policy;
+
+    // changes smaller than the deadband are not sent
+    float deadband[] = {0.f, 0.1f, 0.2f, 1.f, 1.1f, 2.f};
+    memset(&policy, 0, sizeof(policy));
+    policy.deadband = 0.5;
+    mapper_signal_set_send_policy(sendsig, &policy);
+    send_values(deadband, 6);
+    mapper_map_stats(map, &stats);
+    result |= check("deadband", 3, 2.f, 3, stats.below_deadband);
+
+    // only the latest value is sent when the source device is polled
+    float coalesce[] = {10.f, 11.f, 12.f, 13.f, 14.f};
+    memset(&policy, 0, sizeof(policy));
+    policy.coalesce = 1;
+    mapper_signal_set_send_policy(sendsig, &policy);
+    send_values(coalesce, 5);
+    mapper_map_stats(map, &stats);
+    result |= check("coalesce", 1, 14.f, 4, stats.coalesced);
+
+    // a map policy overrides the signal policy
+    float rate[] = {20.f, 21.f, 22.f, 23.f, 24.f};
+    memset(&policy, 0, sizeof(policy));
+    policy.max_rate = 1;
+    mapper_map_set_send_policy(map, &policy);
+    send_values(rate, 5);
+    mapper_map_stats(map, &stats);
+    result |= check("max_rate", 0, 0.f, 5, stats.rate_limited);
+
+    // with coalescing, the latest value is sent once the rate allows
+    policy.max_rate = 20;
+    policy.coalesce = 1;
+    mapper_map_set_send_policy(map, &policy);
+    usleep(100 * 1000);
+    send_values(rate, 5);
+    mapper_map_stats(map, &stats);
+    result |= check("max_rate with coalesce", 2, 24.f, 3, stats.coalesced);
+
+    mapper_map_set_send_policy(map, 0);
+    mapper_signal_set_send_policy(sendsig, 0);
+    send_values(deadband, 6);
+    mapper_map_stats(map, &stats);
+    result |= check("no policy", 6, 2.f, 0,
+                    stats.coalesced + stats.rate_limited + stats.below_deadband);
+
+    return result;
+}
+
+void ctrlc(int signal)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    char *iface = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testsendpolicy.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    case '-':
+                        if (strcmp(argv[i], "--iface")==0 && argc>i+1) {
+                            i++;
+                            iface = argv[i];
+                            j = 1;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination(iface)) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source(iface)) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error initializing maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    result = test_policies();
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
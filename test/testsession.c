@@ -0,0 +1,314 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_OUTPUTS 50
+#define NUM_INPUTS 20
+#define NUM_MAPS (NUM_OUTPUTS * NUM_INPUTS)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_database db = 0;
+mapper_signal sendsig[NUM_OUTPUTS];
+mapper_signal recvsig[NUM_INPUTS];
+
+int progress_calls = 0;
+int last_loaded = 0;
+
+int setup_devices()
+{
+    int i;
+    char name[32];
+    source = mapper_device_new("testsession-send", 0, 0);
+    destination = mapper_device_new("testsession-recv", 0, 0);
+    if (!source || !destination)
+        return 1;
+    for (i = 0; i < NUM_OUTPUTS; i++) {
+        snprintf(name, 32, "outsig%d", i);
+        sendsig[i] = mapper_device_add_output_signal(source, name, 1, 'f', 0,
+                                                     0, 0);
+    }
+    for (i = 0; i < NUM_INPUTS; i++) {
+        snprintf(name, 32, "insig%d", i);
+        recvsig[i] = mapper_device_add_input_signal(destination, name, 1, 'f',
+                                                    0, 0, 0, 0, 0);
+    }
+    eprintf("Devices created with %d outputs and %d inputs.\n", NUM_OUTPUTS,
+            NUM_INPUTS);
+    return 0;
+}
+
+void cleanup_devices()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(source, 0);
+    mapper_device_poll(destination, 0);
+    mapper_database_poll(db, block_ms);
+}
+
+int num_ready_maps()
+{
+    int count = 0;
+    mapper_map *maps = mapper_database_maps(db);
+    while (maps) {
+        if (mapper_map_ready(*maps))
+            ++count;
+        maps = mapper_map_query_next(maps);
+    }
+    return count;
+}
+
+/* Poll until the database holds the expected number of active maps, or give
+ * up after 30 seconds. */
+int wait_maps(int expected)
+{
+    int i;
+    for (i = 0; i < 3000 && !done; i++) {
+        poll_all(10);
+        if (num_ready_maps() == expected
+            && mapper_database_num_maps(db) == expected)
+            return 0;
+    }
+    eprintf("Expected %d maps, found %d.\n", expected, num_ready_maps());
+    return 1;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination)
+                      && mapper_database_num_signals(db, MAPPER_DIR_ANY)
+                         >= NUM_OUTPUTS + NUM_INPUTS)) {
+        poll_all(10);
+    }
+}
+
+int create_maps()
+{
+    int i, j;
+    char expr[32];
+    for (i = 0; i < NUM_OUTPUTS; i++) {
+        for (j = 0; j < NUM_INPUTS; j++) {
+            mapper_map map = mapper_map_new(1, &sendsig[i], 1, &recvsig[j]);
+            mapper_map_set_mode(map, MAPPER_MODE_EXPRESSION);
+            snprintf(expr, 32, "y=x*%d+%d", i, j);
+            mapper_map_set_expression(map, expr);
+            if ((i + j) % 7 == 0)
+                mapper_map_set_muted(map, 1);
+            mapper_map_push(map);
+        }
+        poll_all(0);
+    }
+    return wait_maps(NUM_MAPS);
+}
+
+int release_maps()
+{
+    mapper_map *maps = mapper_database_maps(db);
+    while (maps) {
+        mapper_map_release(*maps);
+        maps = mapper_map_query_next(maps);
+    }
+    return wait_maps(0);
+}
+
+void progress(mapper_database db, int num_loaded, int num_skipped,
+              const void *user)
+{
+    ++progress_calls;
+    last_loaded = num_loaded;
+    if (num_skipped)
+        eprintf("  skipped %d maps\n", num_skipped);
+}
+
+int compare_lines(const void *a, const void *b)
+{
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+/* Read the lines of a file, ignoring trailing commas, and sort them so files
+ * listing the same maps in a different order can be compared. */
+char **read_lines(const char *path, int *count)
+{
+    char buf[4096], **lines = 0;
+    int len;
+    FILE *f = fopen(path, "r");
+    *count = 0;
+    if (!f)
+        return 0;
+    while (fgets(buf, 4096, f)) {
+        len = strlen(buf);
+        while (len && (buf[len-1] == '\n' || buf[len-1] == ','))
+            buf[--len] = 0;
+        lines = realloc(lines, sizeof(char*) * (*count + 1));
+        lines[(*count)++] = strdup(buf);
+    }
+    fclose(f);
+    qsort(lines, *count, sizeof(char*), compare_lines);
+    return lines;
+}
+
+int compare_files(const char *path1, const char *path2)
+{
+    int i, count1, count2, result = 0;
+    char **lines1 = read_lines(path1, &count1);
+    char **lines2 = read_lines(path2, &count2);
+    if (count1 != count2) {
+        eprintf("Saved sessions have %d and %d lines.\n", count1, count2);
+        result = 1;
+    }
+    for (i = 0; i < count1 && i < count2 && !result; i++) {
+        if (strcmp(lines1[i], lines2[i])) {
+            eprintf("Saved sessions differ:\n  %s\n  %s\n", lines1[i],
+                    lines2[i]);
+            result = 1;
+        }
+    }
+    for (i = 0; i < count1; i++)
+        free(lines1[i]);
+    for (i = 0; i < count2; i++)
+        free(lines2[i]);
+    free(lines1);
+    free(lines2);
+    return result;
+}
+
+int test_session()
+{
+    int count, result = 0;
+    char path1[64], path2[64];
+    snprintf(path1, 64, "testsession-%d-1.json", (int)getpid());
+    snprintf(path2, 64, "testsession-%d-2.json", (int)getpid());
+
+    if (create_maps())
+        return 1;
+
+    count = mapper_database_save_maps(db, path1);
+    eprintf("Saved %d maps to %s.\n", count, path1);
+    if (count != NUM_MAPS) {
+        result = 1;
+        goto done;
+    }
+
+    if (release_maps()) {
+        result = 1;
+        goto done;
+    }
+    eprintf("Released all maps.\n");
+
+    count = mapper_database_load_maps(db, path1, progress, 0);
+    eprintf("Loaded %d maps with %d progress updates.\n", count,
+            progress_calls);
+    if (count != NUM_MAPS || last_loaded != NUM_MAPS || progress_calls < 2) {
+        result = 1;
+        goto done;
+    }
+    if (wait_maps(NUM_MAPS)) {
+        result = 1;
+        goto done;
+    }
+
+    count = mapper_database_save_maps(db, path2);
+    eprintf("Saved %d maps to %s.\n", count, path2);
+    if (count != NUM_MAPS || compare_files(path1, path2))
+        result = 1;
+
+  done:
+    remove(path1);
+    remove(path2);
+    return result;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testsession.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_devices()) {
+        eprintf("Error initializing devices.\n");
+        result = 1;
+        goto done;
+    }
+
+    db = mapper_database_new(0, MAPPER_OBJ_ALL);
+    if (!db) {
+        eprintf("Error initializing database.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    result = test_session();
+
+  done:
+    if (db)
+        mapper_database_free(db);
+    cleanup_devices();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,221 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_UPDATES 5000
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+pid_t child = 0;
+mapper_device source = 0;
+mapper_database db = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_signal echosig = 0;
+
+int received = 0;
+float last_value = 0;
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void echo_handler(mapper_signal sig, mapper_id instance, const void *value,
+                  int count, mapper_timetag_t *timetag)
+{
+    if (value)
+        mapper_signal_update(echosig, value, 1, *timetag);
+}
+
+/* Run a device in a separate process which echoes its input back. */
+void run_echo()
+{
+    mapper_device dev = mapper_device_new("testshm-echo", 0, 0);
+    if (!dev)
+        exit(1);
+    echosig = mapper_device_add_output_signal(dev, "outsig", 1, 'f', 0, 0, 0);
+    mapper_device_add_input_signal(dev, "insig", 1, 'f', 0, 0, 0, echo_handler,
+                                   0);
+    while (!done && getppid() != 1)
+        mapper_device_poll(dev, 10);
+    mapper_device_free(dev);
+    exit(0);
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (!value)
+        return;
+    last_value = *(float*)value;
+    ++received;
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(source, block_ms);
+    mapper_database_poll(db, 0);
+}
+
+mapper_signal find_echo_signal(const char *name)
+{
+    mapper_device dev = mapper_database_device_by_name(db, "testshm-echo.1");
+    return dev ? mapper_device_signal_by_name(dev, name) : 0;
+}
+
+int setup()
+{
+    int i;
+    source = mapper_device_new("testshm-send", 0, 0);
+    db = mapper_database_new(0, MAPPER_OBJ_DEVICES | MAPPER_OBJ_SIGNALS);
+    if (!source || !db)
+        return 1;
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'f', 0, 0,
+                                              0);
+    recvsig = mapper_device_add_input_signal(source, "insig", 1, 'f', 0, 0, 0,
+                                             insig_handler, 0);
+
+    mapper_signal remote_in = 0, remote_out = 0;
+    for (i = 0; i < 1000 && !done; i++) {
+        poll_all(10);
+        remote_in = find_echo_signal("insig");
+        remote_out = find_echo_signal("outsig");
+        if (mapper_device_ready(source) && remote_in && remote_out)
+            break;
+    }
+    if (!remote_in || !remote_out)
+        return 1;
+    eprintf("Found echo device.\n");
+
+    mapper_map map1 = mapper_map_new(1, &sendsig, 1, &remote_in);
+    mapper_map_push(map1);
+    mapper_map map2 = mapper_map_new(1, &remote_out, 1, &recvsig);
+    mapper_map_push(map2);
+
+    // wait until maps have been established and updates make the round trip
+    for (i = 0; i < 1000 && !done; i++) {
+        float value = -1;
+        poll_all(10);
+        if (mapper_map_ready(map1))
+            mapper_signal_update(sendsig, &value, 1, MAPPER_NOW);
+        if (received)
+            return 0;
+    }
+    return 1;
+}
+
+/* Send updates one at a time, polling until each has returned from the echo
+ * device, and report the mean round trip. */
+int send_updates(const char *label)
+{
+    int i, tries;
+    float value;
+    double start = current_time();
+    received = 0;
+
+    for (i = 0; i < NUM_UPDATES && !done; i++) {
+        value = i;
+        mapper_signal_update(sendsig, &value, 1, MAPPER_NOW);
+        for (tries = 0; tries < 100 && received <= i; tries++)
+            mapper_device_poll(source, 1);
+    }
+    double elapsed = current_time() - start;
+    eprintf("%s: received %d of %d updates, %.2f us per round trip\n", label,
+            received, NUM_UPDATES, elapsed * 1000000. / NUM_UPDATES);
+    if (received != NUM_UPDATES || last_value != NUM_UPDATES - 1) {
+        eprintf("  not all updates were received.\n");
+        return 1;
+    }
+    return 0;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("testshm.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+    signal(SIGTERM, ctrlc);
+
+    child = fork();
+    if (child < 0) {
+        eprintf("Error starting echo process.\n");
+        result = 1;
+        goto done;
+    }
+    if (child == 0)
+        run_echo();
+
+    if (setup()) {
+        eprintf("Error setting up maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    result |= send_updates("shared memory");
+
+    mapper_device_set_direct_delivery(source, 0);
+    result |= send_updates("network");
+
+    mapper_device_set_direct_delivery(source, 1);
+    result |= send_updates("shared memory again");
+
+  done:
+    if (child > 0) {
+        kill(child, SIGTERM);
+        waitpid(child, 0, 0);
+    }
+    if (db)
+        mapper_database_free(db);
+    if (source)
+        mapper_device_free(source);
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
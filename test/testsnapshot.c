@@ -0,0 +1,184 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "../src/mapper_internal.h"
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define NUM_ROUNDS 200
+#define NUM_DEVICES 10
+#define NUM_SIGNALS 10
+
+int verbose = 1;
+volatile int done = 0;
+mapper_database db = 0;
+
+int snapshots_read = 0;
+int records_read = 0;
+int errors = 0;
+
+/* Check that every signal in a snapshot belongs to a device in the same
+ * snapshot, and that record names can be read. */
+int check_snapshot(mapper_snapshot snap)
+{
+    int i, length, num_errors = 0;
+    char type;
+    const void *value;
+    mapper_snapshot_record rec;
+
+    int num_sigs = mapper_snapshot_num_records(snap, MAPPER_OBJ_SIGNALS);
+    for (i = 0; i < num_sigs; i++) {
+        rec = mapper_snapshot_record_by_index(snap, MAPPER_OBJ_SIGNALS, i);
+        if (mapper_snapshot_record_property(rec, "device_id", &length, &type,
+                                            &value)
+            || type != 'h' || length != 1
+            || !mapper_snapshot_record_by_id(snap, MAPPER_OBJ_DEVICES,
+                                             *(mapper_id*)value)) {
+            ++num_errors;
+        }
+        if (mapper_snapshot_record_property(rec, "name", &length, &type,
+                                            &value)
+            || type != 's' || strncmp((const char*)value, "sig", 3)) {
+            ++num_errors;
+        }
+        ++records_read;
+    }
+    return num_errors;
+}
+
+/* Acquire snapshots repeatedly while the main thread updates the database. */
+void *reader(void *user)
+{
+    mapper_snapshot snap;
+    while (!done) {
+        if (!(snap = mapper_database_snapshot(db))) {
+            usleep(10);
+            continue;
+        }
+        errors += check_snapshot(snap);
+        ++snapshots_read;
+        mapper_snapshot_release(snap);
+    }
+    return 0;
+}
+
+void add_records(int round)
+{
+    int i, j;
+    char devname[32], signame[32];
+    for (i = 0; i < NUM_DEVICES; i++) {
+        snprintf(devname, 32, "testsnapshot%d.%d", i, round + 1);
+        mapper_database_add_or_update_device(db, devname, 0);
+        for (j = 0; j < NUM_SIGNALS; j++) {
+            snprintf(signame, 32, "sig%d", j);
+            mapper_database_add_or_update_signal(db, signame, devname, 0);
+        }
+    }
+}
+
+void remove_records()
+{
+    mapper_device *devs = mapper_database_devices(db);
+    while (devs) {
+        mapper_device dev = *devs;
+        devs = mapper_device_query_next(devs);
+        mapper_database_remove_device(db, dev, MAPPER_REMOVED, 1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    pthread_t thread;
+
+    // process flags for -v verbose, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        eprintf("testsnapshot.c: possible arguments "
+                                "-q quiet (suppress output), "
+                                "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    mapper_network net = mapper_network_new(0, 0, 0);
+    db = &net->database;
+
+    if (mapper_database_snapshot(db)) {
+        eprintf("Expected no snapshot before snapshots are enabled.\n");
+        result = 1;
+        goto done;
+    }
+    mapper_database_set_snapshots(db, 1);
+
+    /* A snapshot keeps its records after they are removed. */
+    add_records(0);
+    mapper_database_publish_snapshot(db);
+    mapper_snapshot snap = mapper_database_snapshot(db);
+    remove_records();
+    mapper_database_publish_snapshot(db);
+    if (!snap
+        || mapper_snapshot_num_records(snap, MAPPER_OBJ_DEVICES) != NUM_DEVICES
+        || (mapper_snapshot_num_records(snap, MAPPER_OBJ_SIGNALS)
+            != NUM_DEVICES * NUM_SIGNALS)
+        || check_snapshot(snap)) {
+        eprintf("Snapshot changed after its records were removed.\n");
+        result = 1;
+        mapper_snapshot_release(snap);
+        goto done;
+    }
+    mapper_snapshot_release(snap);
+    snap = mapper_database_snapshot(db);
+    if (!snap || mapper_snapshot_num_records(snap, MAPPER_OBJ_DEVICES)) {
+        eprintf("Latest snapshot still contains removed records.\n");
+        result = 1;
+    }
+    mapper_snapshot_release(snap);
+    if (result)
+        goto done;
+    eprintf("Removed records remain in earlier snapshot.\n");
+
+    /* Read snapshots from another thread while the database churns. */
+    records_read = 0;
+    pthread_create(&thread, 0, reader, 0);
+    for (i = 0; i < NUM_ROUNDS; i++) {
+        add_records(i);
+        mapper_database_publish_snapshot(db);
+        remove_records();
+        mapper_database_publish_snapshot(db);
+    }
+    done = 1;
+    pthread_join(thread, 0);
+
+    eprintf("Read %d snapshots containing %d signal records while applying "
+            "%d rounds of updates.\n", snapshots_read, records_read,
+            NUM_ROUNDS);
+    if (!snapshots_read || errors) {
+        eprintf("Found %d inconsistent records.\n", errors);
+        result = 1;
+    }
+
+done:
+    mapper_network_free(net);
+    if (!verbose)
+        printf("..................................................");
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
@@ -0,0 +1,295 @@
+
+#include "../src/mapper_internal.h"
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_map map = 0;
+
+int sent = 0;
+int received = 0;
+
+int setup_source(char *iface)
+{
+    source = mapper_device_new("testsend", 0, 0);
+    if (!source)
+        goto error;
+    eprintf("source created.\n");
+
+    mapper_device_set_stats(source, MAPPER_STATS_COLLECT);
+
+    int mn=0, mx=100;
+    sendsig = mapper_device_add_output_signal(source, "outsig", 1, 'i', 0,
+                                              &mn, &mx);
+
+    eprintf("Output signal 'outsig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_source()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (value) {
+        eprintf("handler: Got %f\n", (*(float*)value));
+    }
+    received++;
+}
+
+int setup_destination(char *iface)
+{
+    destination = mapper_device_new("testrecv", 0, 0);
+    if (!destination)
+        goto error;
+    eprintf("destination created.\n");
+
+    mapper_device_set_stats(destination, MAPPER_STATS_PUBLISH);
+
+    float mn=0, mx=1;
+    recvsig = mapper_device_add_input_signal(destination, "insig", 1, 'f', 0,
+                                             &mn, &mx, insig_handler, 0);
+
+    eprintf("Input signal 'insig' registered.\n");
+    return 0;
+
+  error:
+    return 1;
+}
+
+void cleanup_destination()
+{
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+int setup_maps()
+{
+    int src_max = 25;
+
+    map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_set_mode(map, MAPPER_MODE_LINEAR);
+
+    // mute source values above 25 so that drops are counted
+    mapper_slot slot = mapper_map_slot(map, MAPPER_LOC_SOURCE, 0);
+    mapper_slot_set_maximum(slot, 1, 'i', &src_max);
+    mapper_slot_set_bound_max(slot, MAPPER_BOUND_MUTE);
+
+    mapper_map_push(map);
+
+    // Wait until mapping has been established
+    while (!done && !mapper_map_ready(map)) {
+        mapper_device_poll(source, 10);
+        mapper_device_poll(destination, 10);
+    }
+
+    return 0;
+}
+
+void wait_ready()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        mapper_device_poll(source, 0);
+        mapper_device_poll(destination, 0);
+        usleep(500 * 1000);
+    }
+}
+
+void loop()
+{
+    eprintf("Polling device..\n");
+    int i = 0;
+    while ((!terminate || i < 50) && !done) {
+        mapper_device_poll(source, 0);
+        eprintf("Updating signal %s to %d\n", mapper_signal_name(sendsig), i);
+        mapper_signal_update_int(sendsig, i);
+        sent++;
+        mapper_device_poll(destination, 100);
+        i++;
+
+        if (!verbose) {
+            printf("\r  Sent: %4i, Received: %4i   ", sent, received);
+            fflush(stdout);
+        }
+    }
+}
+
+int check_stats()
+{
+    mapper_stats_t src_stats, dst_stats;
+    mapper_map src_map = 0, dst_map = 0;
+    int result = 0;
+
+    mapper_map *maps = mapper_device_maps(source, MAPPER_DIR_OUTGOING);
+    if (maps) {
+        src_map = *maps;
+        mapper_map_query_done(maps);
+    }
+    maps = mapper_device_maps(destination, MAPPER_DIR_INCOMING);
+    if (maps) {
+        dst_map = *maps;
+        mapper_map_query_done(maps);
+    }
+    if (!src_map || !dst_map) {
+        eprintf("Could not retrieve local maps.\n");
+        return 1;
+    }
+
+    if (mapper_map_stats(src_map, &src_stats)
+        || mapper_map_stats(dst_map, &dst_stats)) {
+        eprintf("Statistics were not collected.\n");
+        return 1;
+    }
+
+    eprintf("source: sent %llu (%llu bytes), muted %llu, eval p50 %gs\n",
+            (unsigned long long)src_stats.sent,
+            (unsigned long long)src_stats.bytes_sent,
+            (unsigned long long)src_stats.dropped_muted,
+            mapper_map_stats_percentile(src_map, MAPPER_STAT_EVAL_TIME, 50));
+    eprintf("destination: received %llu (%llu bytes), latency p99 %gs\n",
+            (unsigned long long)dst_stats.received,
+            (unsigned long long)dst_stats.bytes_received,
+            mapper_map_stats_percentile(dst_map, MAPPER_STAT_LATENCY, 99));
+
+    if (src_stats.sent + src_stats.dropped_muted != sent) {
+        eprintf("Source counters do not match number of updates.\n");
+        result = 1;
+    }
+    if (!src_stats.dropped_muted) {
+        eprintf("Muted updates were not counted.\n");
+        result = 1;
+    }
+    if (dst_stats.received != received || dst_stats.received != src_stats.sent) {
+        eprintf("Destination counters do not match received updates.\n");
+        result = 1;
+    }
+    if (!src_stats.bytes_sent || src_stats.bytes_sent != dst_stats.bytes_received) {
+        eprintf("Byte counters do not match.\n");
+        result = 1;
+    }
+    if (mapper_map_stats_percentile(src_map, MAPPER_STAT_EVAL_TIME, 100) <= 0) {
+        eprintf("Evaluation time was not recorded.\n");
+        result = 1;
+    }
+
+    mapper_map_reset_stats(src_map);
+    mapper_map_stats(src_map, &src_stats);
+    if (src_stats.sent
+        || mapper_map_stats_percentile(src_map, MAPPER_STAT_EVAL_TIME, 50)) {
+        eprintf("Statistics were not reset.\n");
+        result = 1;
+    }
+    return result;
+}
+
+void ctrlc(int signal)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+    char *iface = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("teststats.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    case '-':
+                        if (strcmp(argv[i], "--iface")==0 && argc>i+1) {
+                            i++;
+                            iface = argv[i];
+                            j = 1;
+                        }
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_destination(iface)) {
+        eprintf("Error initializing destination.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_source(iface)) {
+        eprintf("Done initializing source.\n");
+        result = 1;
+        goto done;
+    }
+
+    wait_ready();
+
+    if (setup_maps()) {
+        eprintf("Error initializing maps.\n");
+        result = 1;
+        goto done;
+    }
+
+    loop();
+
+    result = check_stats();
+
+  done:
+    cleanup_destination();
+    cleanup_source();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}
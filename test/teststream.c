@@ -0,0 +1,260 @@
+
+#include <mapper/mapper.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+
+#ifdef WIN32
+#define usleep(x) Sleep(x/1000)
+#endif
+
+#define eprintf(format, ...) do {               \
+    if (verbose)                                \
+        fprintf(stdout, format, ##__VA_ARGS__); \
+} while(0)
+
+#define VECTOR_LENGTH 512
+#define NUM_BURSTS 20
+#define BURST_SIZE 200
+#define NUM_UPDATES (NUM_BURSTS * BURST_SIZE)
+
+int verbose = 1;
+int terminate = 0;
+int done = 0;
+
+mapper_device source = 0;
+mapper_device destination = 0;
+mapper_signal sendsig = 0;
+mapper_signal recvsig = 0;
+mapper_link stream_link = 0;
+
+int received = 0;
+int out_of_order = 0;
+float last_value = -1;
+
+/*! Internal function to get the current time. */
+static double current_time()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double) tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+void insig_handler(mapper_signal sig, mapper_id instance, const void *value,
+                   int count, mapper_timetag_t *timetag)
+{
+    if (!value)
+        return;
+    float v = ((float*)value)[0];
+    if (v <= last_value)
+        ++out_of_order;
+    last_value = v;
+    ++received;
+}
+
+int setup_devices()
+{
+    source = mapper_device_new("teststream-send", 0, 0);
+    destination = mapper_device_new("teststream-recv", 0, 0);
+    if (!source || !destination)
+        return 1;
+
+    // make sure updates go through the network rather than shared memory
+    mapper_device_set_direct_delivery(source, 0);
+    mapper_device_set_stats(source, MAPPER_STATS_COLLECT);
+
+    sendsig = mapper_device_add_output_signal(source, "outsig", VECTOR_LENGTH,
+                                              'f', 0, 0, 0);
+    recvsig = mapper_device_add_input_signal(destination, "insig",
+                                             VECTOR_LENGTH, 'f', 0, 0, 0,
+                                             insig_handler, 0);
+    if (!sendsig || !recvsig)
+        return 1;
+    eprintf("Devices created.\n");
+    return 0;
+}
+
+void cleanup_devices()
+{
+    if (source) {
+        eprintf("Freeing source.. ");
+        fflush(stdout);
+        mapper_device_free(source);
+        eprintf("ok\n");
+    }
+    if (destination) {
+        eprintf("Freeing destination.. ");
+        fflush(stdout);
+        mapper_device_free(destination);
+        eprintf("ok\n");
+    }
+}
+
+void poll_all(int block_ms)
+{
+    mapper_device_poll(source, block_ms);
+    mapper_device_poll(destination, 0);
+}
+
+int setup_map()
+{
+    while (!done && !(mapper_device_ready(source)
+                      && mapper_device_ready(destination))) {
+        poll_all(25);
+    }
+
+    mapper_map map = mapper_map_new(1, &sendsig, 1, &recvsig);
+    mapper_map_push(map);
+    while (!done && !mapper_map_ready(map))
+        poll_all(10);
+
+    mapper_link *links = mapper_device_links(source, MAPPER_DIR_ANY);
+    if (links) {
+        stream_link = *links;
+        mapper_link_query_done(links);
+    }
+    return done || !stream_link;
+}
+
+/* Set the transport used by the link and wait until both devices have seen
+ * the change. */
+int set_transport(const char *transport)
+{
+    int i, result = 1;
+    const void *value;
+    char type;
+    int length;
+
+    mapper_link_set_property(stream_link, "transport", 1, 's', transport, 1);
+    mapper_link_push(stream_link);
+    for (i = 0; i < 500 && !done && result; i++) {
+        poll_all(10);
+        if (!mapper_link_property(stream_link, "transport", &length, &type,
+                                  &value)
+            && type == 's' && strcmp((const char*)value, transport) == 0)
+            result = 0;
+    }
+    // allow the connection to be established
+    for (i = 0; i < 10; i++)
+        poll_all(10);
+    return result;
+}
+
+/* Send bursts of large vector updates without polling the destination, then
+ * let it catch up. Reports the proportion of updates received and the
+ * throughput, and returns the number received. */
+int send_bursts(const char *label)
+{
+    int i, j, idle;
+    float value[VECTOR_LENGTH];
+    double start = current_time();
+    mapper_stats_t stats;
+
+    memset(value, 0, sizeof(value));
+    received = out_of_order = 0;
+    last_value = -1;
+    mapper_link_reset_stats(stream_link);
+
+    for (i = 0; i < NUM_BURSTS && !done; i++) {
+        for (j = 0; j < BURST_SIZE; j++) {
+            value[0] = i * BURST_SIZE + j;
+            mapper_signal_update(sendsig, value, 1, MAPPER_NOW);
+        }
+        // flush the source, and poll until the destination stops receiving
+        for (idle = 0; idle < 50 && received < (i + 1) * BURST_SIZE; idle++) {
+            int count = received;
+            poll_all(0);
+            usleep(100);
+            if (received != count)
+                idle = 0;
+        }
+    }
+    double elapsed = current_time() - start;
+    mapper_link_stats(stream_link, &stats);
+
+    eprintf("%-6s received %5d of %d updates (%.1f%% lost), %d out of order, "
+            "%.1f MB/s, %llu dropped by backpressure\n", label, received,
+            NUM_UPDATES, (NUM_UPDATES - received) * 100. / NUM_UPDATES,
+            out_of_order, received * VECTOR_LENGTH * sizeof(float)
+            / elapsed / 1000000.,
+            (unsigned long long)stats.dropped_backpressure);
+    return received;
+}
+
+void ctrlc(int sig)
+{
+    done = 1;
+}
+
+int main(int argc, char **argv)
+{
+    int i, j, result = 0;
+
+    // process flags for -v verbose, -t terminate, -h help
+    for (i = 1; i < argc; i++) {
+        if (argv[i] && argv[i][0] == '-') {
+            int len = strlen(argv[i]);
+            for (j = 1; j < len; j++) {
+                switch (argv[i][j]) {
+                    case 'h':
+                        printf("teststream.c: possible arguments "
+                               "-q quiet (suppress output), "
+                               "-t terminate automatically, "
+                               "-h help\n");
+                        return 1;
+                        break;
+                    case 'q':
+                        verbose = 0;
+                        break;
+                    case 't':
+                        terminate = 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+        }
+    }
+
+    signal(SIGINT, ctrlc);
+
+    if (setup_devices()) {
+        eprintf("Error initializing devices.\n");
+        result = 1;
+        goto done;
+    }
+
+    if (setup_map()) {
+        eprintf("Error setting map.\n");
+        result = 1;
+        goto done;
+    }
+    send_bursts("udp");
+
+    if (set_transport("tcp")) {
+        eprintf("Link did not switch to tcp transport.\n");
+        result = 1;
+        goto done;
+    }
+    if (send_bursts("tcp") != NUM_UPDATES || out_of_order) {
+        eprintf("Updates were lost or reordered over tcp transport.\n");
+        result = 1;
+    }
+    if (mapper_link_stream_backlog(stream_link)) {
+        eprintf("Updates are still waiting to be written.\n");
+        result = 1;
+    }
+
+    if (set_transport("udp")) {
+        eprintf("Link did not switch back to udp transport.\n");
+        result = 1;
+    }
+
+  done:
+    cleanup_devices();
+    printf("Test %s.\n", result ? "FAILED" : "PASSED");
+    return result;
+}